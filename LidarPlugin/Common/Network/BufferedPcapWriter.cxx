@@ -0,0 +1,292 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "BufferedPcapWriter.h"
+
+// STD
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+// BOOST
+#include <boost/align/aligned_alloc.hpp>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+//! Global header and record header of the pcap format, see pcap-savefile(5)
+struct PcapGlobalHeader
+{
+  std::uint32_t MagicNumber;
+  std::uint16_t VersionMajor;
+  std::uint16_t VersionMinor;
+  std::int32_t ThisZone;
+  std::uint32_t SigFigs;
+  std::uint32_t SnapLength;
+  std::uint32_t LinkType;
+};
+
+struct PcapRecordHeader
+{
+  std::uint32_t Seconds;
+  std::uint32_t Microseconds;
+  std::uint32_t CapturedLength;
+  std::uint32_t Length;
+};
+static_assert(sizeof(PcapRecordHeader) == BufferedPcapWriter::RecordHeaderSize, "pcap record header");
+
+//! Same values as the files opened by vtkPacketFileWriter
+const std::uint32_t PcapMagicNumber = 0xa1b2c3d4;
+const std::uint32_t SnapLength = 65535;
+const std::uint32_t LinkTypeEthernet = 1;
+
+//-----------------------------------------------------------------------------
+bool WriteAll(int file, const unsigned char* data, std::size_t size)
+{
+  while (size > 0)
+  {
+#ifdef _WIN32
+    const int written = _write(file, data, static_cast<unsigned int>(size));
+#else
+    const ssize_t written = write(file, data, size);
+#endif
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+}
+
+//-----------------------------------------------------------------------------
+BufferedPcapWriter::BufferedPcapWriter(std::size_t bufferSize)
+{
+  // a record is at most the snap length plus its header
+  bufferSize = std::max<std::size_t>(bufferSize, 2 * SnapLength);
+  this->BufferCapacity = (bufferSize + Alignment - 1) / Alignment * Alignment;
+  this->Buffer = static_cast<unsigned char*>(
+    boost::alignment::aligned_alloc(Alignment, this->BufferCapacity));
+}
+
+//-----------------------------------------------------------------------------
+BufferedPcapWriter::~BufferedPcapWriter()
+{
+  this->Close();
+  boost::alignment::aligned_free(this->Buffer);
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::Open(const std::string& filename, bool useDirectIO)
+{
+  this->Close();
+  this->LastError.clear();
+  if (!this->Buffer)
+  {
+    this->LastError = "the write buffer could not be allocated";
+    return false;
+  }
+
+#ifdef _WIN32
+  this->File = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                     _S_IREAD | _S_IWRITE);
+  this->DirectIO = false;
+#else
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  this->DirectIO = false;
+#ifdef O_DIRECT
+  if (useDirectIO)
+  {
+    // not all file systems support it, the file is then written through the page cache
+    this->File = open(filename.c_str(), flags | O_DIRECT, 0644);
+    this->DirectIO = this->File >= 0;
+  }
+#endif
+  if (this->File < 0)
+  {
+    this->File = open(filename.c_str(), flags, 0644);
+  }
+#endif
+  if (this->File < 0)
+  {
+    return this->SetError("open " + filename);
+  }
+  (void)useDirectIO;
+
+  this->FileName = filename;
+  this->FileSize = 0;
+  this->BufferedSize = 0;
+
+  PcapGlobalHeader header;
+  header.MagicNumber = PcapMagicNumber;
+  header.VersionMajor = 2;
+  header.VersionMinor = 4;
+  header.ThisZone = 0;
+  header.SigFigs = 0;
+  header.SnapLength = SnapLength;
+  header.LinkType = LinkTypeEthernet;
+  return this->Append(&header, sizeof(header));
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::Close()
+{
+  if (!this->IsOpen())
+  {
+    return true;
+  }
+  bool isWritten = true;
+#if !defined(_WIN32) && defined(O_DIRECT)
+  if (this->DirectIO && this->BufferedSize % Alignment != 0)
+  {
+    // the end of the file is not a whole block, it is written through the page cache
+    isWritten = this->Flush() && fcntl(this->File, F_SETFL, fcntl(this->File, F_GETFL) & ~O_DIRECT) == 0;
+    this->DirectIO = false;
+  }
+#endif
+  isWritten = isWritten && this->WriteBuffer(this->BufferedSize);
+  if (!isWritten)
+  {
+    this->SetError("write " + this->FileName);
+  }
+#ifdef _WIN32
+  const bool isClosed = _close(this->File) == 0;
+#else
+  const bool isClosed = close(this->File) == 0;
+#endif
+  if (!isClosed && isWritten)
+  {
+    this->SetError("close " + this->FileName);
+  }
+  this->File = -1;
+  this->BufferedSize = 0;
+  return isWritten && isClosed;
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::WritePacket(const unsigned char* packetData, unsigned int packetSize,
+                                     const struct timeval& receptionTime)
+{
+  if (!this->IsOpen())
+  {
+    return false;
+  }
+  PcapRecordHeader header;
+  header.Seconds = static_cast<std::uint32_t>(receptionTime.tv_sec);
+  header.Microseconds = static_cast<std::uint32_t>(receptionTime.tv_usec);
+  header.CapturedLength = std::min<std::uint32_t>(packetSize, SnapLength);
+  header.Length = packetSize;
+  return this->Append(&header, sizeof(header)) && this->Append(packetData, header.CapturedLength);
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::Flush()
+{
+  if (!this->IsOpen())
+  {
+    return false;
+  }
+  const std::size_t size =
+    this->DirectIO ? this->BufferedSize / Alignment * Alignment : this->BufferedSize;
+  return this->WriteBuffer(size) || this->SetError("write " + this->FileName);
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::Sync()
+{
+  if (!this->Flush())
+  {
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+#if defined(_WIN32)
+  const bool isSynced = _commit(this->File) == 0;
+#elif defined(__linux__)
+  const bool isSynced = fdatasync(this->File) == 0;
+#else
+  const bool isSynced = fsync(this->File) == 0;
+#endif
+  if (this->Observer)
+  {
+    this->Observer(0, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return isSynced || this->SetError("sync " + this->FileName);
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::Append(const void* data, std::size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  while (size > 0)
+  {
+    const std::size_t copiedSize = std::min(size, this->BufferCapacity - this->BufferedSize);
+    std::memcpy(this->Buffer + this->BufferedSize, bytes, copiedSize);
+    this->BufferedSize += copiedSize;
+    bytes += copiedSize;
+    size -= copiedSize;
+    if (this->BufferedSize == this->BufferCapacity && !this->WriteBuffer(this->BufferCapacity))
+    {
+      return this->SetError("write " + this->FileName);
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::WriteBuffer(std::size_t size)
+{
+  if (size == 0)
+  {
+    return true;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (!WriteAll(this->File, this->Buffer, size))
+  {
+    return false;
+  }
+  if (this->Observer)
+  {
+    this->Observer(size, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  this->FileSize += size;
+  this->BufferedSize -= size;
+  // with O_DIRECT the end of the last block stays buffered until it is complete
+  std::memmove(this->Buffer, this->Buffer + size, this->BufferedSize);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool BufferedPcapWriter::SetError(const std::string& operation)
+{
+  if (this->LastError.empty())
+  {
+    this->LastError = operation + ": " + std::strerror(errno);
+  }
+  return false;
+}
@@ -0,0 +1,115 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BUFFEREDPCAPWRITER_H
+#define BUFFEREDPCAPWRITER_H
+
+// STD
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/time.h>
+#endif
+
+/**
+ * \class BufferedPcapWriter
+ * \brief Write packets in the pcap format through a large aligned buffer, so that the disk
+ * receives a few large writes instead of one small write per packet.
+ *
+ * The records are the ones libpcap writes with vtkPacketFileWriter (Ethernet link type,
+ * native byte order), so the files are read by vtkPacketFileReader as usual. On Linux the
+ * file can be opened with O_DIRECT to bypass the page cache: the buffer, the writes and
+ * their size are then aligned on Alignment bytes, only the end of the file is written
+ * through the page cache when it is closed.
+ */
+class BufferedPcapWriter
+{
+public:
+  //! Alignment of the buffer, of the position and of the size of the writes
+  static const std::size_t Alignment = 4096;
+
+  //! Size of the header of each record
+  static const std::size_t RecordHeaderSize = 16;
+
+  //! Called after each write to the file with the number of bytes and the duration in
+  //! seconds, and after each Sync with 0 bytes
+  using WriteObserver = std::function<void(std::size_t, double)>;
+
+  //! @param bufferSize size of the buffer, rounded up to a multiple of Alignment
+  explicit BufferedPcapWriter(std::size_t bufferSize = 4 << 20);
+  ~BufferedPcapWriter();
+
+  BufferedPcapWriter(const BufferedPcapWriter&) = delete;
+  BufferedPcapWriter& operator=(const BufferedPcapWriter&) = delete;
+
+  /**
+   * @brief Open create the file, replacing an existing one, and add the pcap global header
+   * @param useDirectIO bypass the page cache, ignored where O_DIRECT is not supported
+   * (other systems, some file systems such as tmpfs)
+   */
+  bool Open(const std::string& filename, bool useDirectIO = false);
+
+  bool IsOpen() const { return this->File >= 0; }
+
+  //! Write the buffered records and close the file
+  bool Close();
+
+  //! Add a record, the buffer is written to the file each time it is full
+  bool WritePacket(const unsigned char* packetData, unsigned int packetSize,
+                   const struct timeval& receptionTime);
+
+  //! Write the buffered records, except the end of the last block with O_DIRECT
+  bool Flush();
+
+  //! Flush, then wait for the written data to be on the disk (fdatasync)
+  bool Sync();
+
+  //! Position of the next record, as vtkPacketFileReader::GetFilePosition reports it
+  std::int64_t GetFilePosition() const { return this->FileSize + this->BufferedSize; }
+
+  const std::string& GetFileName() const { return this->FileName; }
+  const std::string& GetLastError() const { return this->LastError; }
+  bool IsDirectIO() const { return this->DirectIO; }
+
+  void SetWriteObserver(const WriteObserver& observer) { this->Observer = observer; }
+
+private:
+  //! Copy data in the buffer, writing it each time it is full
+  bool Append(const void* data, std::size_t size);
+
+  //! Write the first bytes of the buffer and move the remaining ones to its beginning
+  bool WriteBuffer(std::size_t size);
+
+  bool SetError(const std::string& operation);
+
+  unsigned char* Buffer = nullptr;
+  std::size_t BufferCapacity = 0;
+  std::size_t BufferedSize = 0;
+
+  int File = -1;
+  bool DirectIO = false;
+  //! Bytes written to the file
+  std::int64_t FileSize = 0;
+
+  std::string FileName;
+  std::string LastError;
+  WriteObserver Observer;
+};
+
+#endif // BUFFEREDPCAPWRITER_H
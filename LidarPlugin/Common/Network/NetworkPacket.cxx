@@ -24,7 +24,7 @@ int gettimeofday(struct timeval* tp, void*)
 #endif
 
 // in network (big endian) order
-const unsigned char NetworkPacket::EthIP4UDPHeaderDefault[42] = {
+const unsigned char NetworkPacket::EthIP4UDPHeaderDefault[EthIP4UDPHeaderSize] = {
   // 14 bytes ethernet header
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // dst MAC addr
   0x60, 0x76, 0x88, 0x00, 0x00, 0x00, // src MAC addr
@@ -54,44 +54,64 @@ NetworkPacket* NetworkPacket::BuildEthernetIP4UDP(const unsigned char* payload,
                                                  unsigned short destinationPort)
 {
   NetworkPacket* packet = new NetworkPacket();
-  gettimeofday(&packet->ReceptionTime, nullptr);
-  packet->PacketSize = sizeof(NetworkPacket::EthIP4UDPHeaderDefault) + payloadSize;
+  NetworkPacket::GetTimeOfDay(&packet->ReceptionTime);
+  packet->PacketSize = EthIP4UDPHeaderSize + payloadSize;
   packet->PacketData.resize(packet->PacketSize);
 
-  packet->PayloadStart = sizeof(NetworkPacket::EthIP4UDPHeaderDefault);
+  packet->PayloadStart = EthIP4UDPHeaderSize;
 
-  std::copy(NetworkPacket::EthIP4UDPHeaderDefault,
-            NetworkPacket::EthIP4UDPHeaderDefault + sizeof(NetworkPacket::EthIP4UDPHeaderDefault),
-            packet->PacketData.begin());
+  NetworkPacket::WriteEthernetIP4UDPHeader(packet->PacketData.data(),
+                                           payloadSize,
+                                           sourceIPv4BigEndian,
+                                           sourcePort,
+                                           destinationPort);
   std::copy(payload,
             payload + payloadSize,
-            packet->PacketData.begin() + sizeof(NetworkPacket::EthIP4UDPHeaderDefault));
+            packet->PacketData.begin() + EthIP4UDPHeaderSize);
+
+  return packet;
+}
+
+//------------------------------------------------------------------------------
+void NetworkPacket::WriteEthernetIP4UDPHeader(unsigned char* header,
+                                              unsigned int payloadSize,
+                                              const unsigned char* sourceIPv4BigEndian,
+                                              unsigned short sourcePort,
+                                              unsigned short destinationPort)
+{
+  std::copy(NetworkPacket::EthIP4UDPHeaderDefault,
+            NetworkPacket::EthIP4UDPHeaderDefault + EthIP4UDPHeaderSize,
+            header);
 
   // Set IP-frame length (which is payloadSize + 28), in network order: big endian
-  packet->PacketData[EthIPUDPHeader_IPFRAMELEN] = ((payloadSize + 28) & 0xFF00) >> 8;
-  packet->PacketData[EthIPUDPHeader_IPFRAMELEN + 1] = ((payloadSize + 28) & 0x00FF) >> 0;
+  header[EthIPUDPHeader_IPFRAMELEN] = ((payloadSize + 28) & 0xFF00) >> 8;
+  header[EthIPUDPHeader_IPFRAMELEN + 1] = ((payloadSize + 28) & 0x00FF) >> 0;
 
   // Set UDP-frame length (which is payloadSize + 8), in network order: big endian
-  packet->PacketData[EthIPUDPHeader_UDPFRAMELEN] = ((payloadSize + 8) & 0xFF00) >> 8;
-  packet->PacketData[EthIPUDPHeader_UDPFRAMELEN + 1] = ((payloadSize + 8) & 0x00FF) >> 0;
+  header[EthIPUDPHeader_UDPFRAMELEN] = ((payloadSize + 8) & 0xFF00) >> 8;
+  header[EthIPUDPHeader_UDPFRAMELEN + 1] = ((payloadSize + 8) & 0x00FF) >> 0;
 
   // Set IPv4 of source, from big endian to big endian
   std::copy(sourceIPv4BigEndian,
             sourceIPv4BigEndian + 4,
-            packet->PacketData.begin() + EthIPUDPHeader_SOURCEIP4);
+            header + EthIPUDPHeader_SOURCEIP4);
 
   // Set source port, in network order: big endian
-  packet->PacketData[EthIPUDPHeader_SOURCEPORT] = (sourcePort & 0xFF00) >> 8;
-  packet->PacketData[EthIPUDPHeader_SOURCEPORT + 1] = (sourcePort & 0x00FF) >> 0;
+  header[EthIPUDPHeader_SOURCEPORT] = (sourcePort & 0xFF00) >> 8;
+  header[EthIPUDPHeader_SOURCEPORT + 1] = (sourcePort & 0x00FF) >> 0;
 
   // Set destination port, in network order: big endian
-  packet->PacketData[EthIPUDPHeader_DESTPORT] = (destinationPort & 0xFF00) >> 8;
-  packet->PacketData[EthIPUDPHeader_DESTPORT + 1] = (destinationPort & 0x00FF) >> 0;
+  header[EthIPUDPHeader_DESTPORT] = (destinationPort & 0xFF00) >> 8;
+  header[EthIPUDPHeader_DESTPORT + 1] = (destinationPort & 0x00FF) >> 0;
 
   // We could compute and set the UDP checksum, then the IP checksum but this
   // was not done in the past.
+}
 
-  return packet;
+//------------------------------------------------------------------------------
+void NetworkPacket::GetTimeOfDay(struct timeval* time)
+{
+  gettimeofday(time, nullptr);
 }
 
 //------------------------------------------------------------------------------
@@ -34,6 +34,18 @@ public:
                                            unsigned short sourcePort,
                                            unsigned short destinationPort);
 
+  // Write the Ethernet/IPv4/UDP header of a packet of payloadSize bytes in the
+  // EthIP4UDPHeaderSize bytes pointed by header. Used to build packets in
+  // preallocated buffers, see PacketRing.
+  static void WriteEthernetIP4UDPHeader(unsigned char* header,
+                                        unsigned int payloadSize,
+                                        const unsigned char* sourceIPv4BigEndian,
+                                        unsigned short sourcePort,
+                                        unsigned short destinationPort);
+
+  // Current time, as stored in ReceptionTime
+  static void GetTimeOfDay(struct timeval* time);
+
   // Note that the memory zone returned by P->GetPayloadData() has a lifetime equal
   // to the instance P of NetworkPacket (no copy is done), and must not be freed
   // by the user of NetworkPacket
@@ -43,6 +55,8 @@ public:
   unsigned int GetPayloadSize() const;
   struct timeval ReceptionTime;
 
+  static const unsigned int EthIP4UDPHeaderSize = 42;
+
   // useful offsets in packet header:
   static const unsigned int EthIPUDPHeader_IPFRAMELEN = 16;
   static const unsigned int EthIPUDPHeader_SOURCEIP4 = 26;
@@ -58,7 +72,7 @@ private:
   std::vector<unsigned char> PacketData;
   // default header used only by BuildEthernetIP4UDP, inside of which we
   // override some fields when they are available
-  static const unsigned char EthIP4UDPHeaderDefault[42];
+  static const unsigned char EthIP4UDPHeaderDefault[EthIP4UDPHeaderSize];
 };
 
 
@@ -0,0 +1,325 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "PacketReplayer.h"
+#include "vtkPacketFileMappedReader.h"
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <vtkSetGet.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#endif
+
+namespace
+{
+//! Largest payload of an UDP datagram over IPv4
+const unsigned int MaximumUdpPayloadSize = 65507;
+
+//! Size of the send buffer of the socket, which absorbs the bursts
+const int SendBufferSize = 4 << 20;
+}
+
+//-----------------------------------------------------------------------------
+PacketReplayer::PacketReplayer(const std::string& destinationIp)
+  : DestinationIp(destinationIp)
+  , Socket(IOService)
+{
+  this->Socket.open(boost::asio::ip::udp::v4());
+  this->Socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
+  // Allow to send the packet on the same machine
+  this->Socket.set_option(boost::asio::ip::multicast::enable_loopback(true));
+  boost::system::error_code errCode;
+  this->Socket.set_option(boost::asio::socket_base::send_buffer_size(SendBufferSize), errCode);
+}
+
+//-----------------------------------------------------------------------------
+void PacketReplayer::SetBatchSize(int size)
+{
+  // not std::min, which would take the address of MaximumBatchSize
+  this->BatchSize = size < 1 ? 1 : (size > MaximumBatchSize ? MaximumBatchSize : size);
+}
+
+//-----------------------------------------------------------------------------
+bool PacketReplayer::AddFile(const std::string& filename, int lidarPort, int positionPort)
+{
+  boost::system::error_code errCode;
+  const boost::asio::ip::address address = boost::asio::ip::address_v4::from_string(this->DestinationIp, errCode);
+  if (errCode)
+  {
+    this->LastError = "Invalid destination ip address " + this->DestinationIp;
+    return false;
+  }
+
+  vtkPacketFileMappedReader reader;
+  if (!reader.Open(filename))
+  {
+    this->LastError = "Unable to open packet file " + filename + ": " + reader.GetLastError();
+    return false;
+  }
+
+  const std::size_t lidarDestination = this->Destinations.size();
+  const std::size_t positionDestination = lidarDestination + 1;
+  this->Destinations.push_back(boost::asio::ip::udp::endpoint(address, lidarPort));
+  this->Destinations.push_back(boost::asio::ip::udp::endpoint(address, positionPort));
+
+  std::vector<Packet> filePackets;
+  const unsigned char* data = nullptr;
+  unsigned int dataLength = 0;
+  double time = 0;
+  std::size_t skippedPackets = 0;
+  while (reader.NextPacket(data, dataLength, time))
+  {
+    if (dataLength > MaximumUdpPayloadSize)
+    {
+      skippedPackets++;
+      continue;
+    }
+    Packet packet;
+    packet.Time = static_cast<std::int64_t>(std::llround(time * 1e9));
+    // a packet is never sent before the one which precedes it in the file
+    if (!filePackets.empty())
+    {
+      packet.Time = std::max(packet.Time, filePackets.back().Time);
+    }
+    packet.Offset = this->Data.size();
+    packet.Size = dataLength;
+    // Position packet
+    packet.Destination = dataLength == 512 ? positionDestination : lidarDestination;
+    this->Data.insert(this->Data.end(), data, data + dataLength);
+    filePackets.push_back(packet);
+  }
+  if (skippedPackets != 0)
+  {
+    vtkGenericWarningMacro(<< skippedPackets << " packets of " << filename
+                           << " are too large to be sent and are skipped");
+  }
+
+  // the packets of the previous files come first when they have the same time
+  std::vector<Packet> packets;
+  packets.reserve(this->Packets.size() + filePackets.size());
+  std::merge(this->Packets.begin(), this->Packets.end(), filePackets.begin(), filePackets.end(),
+             std::back_inserter(packets),
+             [](const Packet& a, const Packet& b) { return a.Time < b.Time; });
+  this->Packets.swap(packets);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool PacketReplayer::AddPacket(const unsigned char* data, unsigned int dataLength, double time, int port)
+{
+  const int destination = this->GetDestination(port);
+  if (destination < 0 || dataLength > MaximumUdpPayloadSize)
+  {
+    return false;
+  }
+
+  Packet packet;
+  packet.Time = static_cast<std::int64_t>(std::llround(time * 1e9));
+  packet.Offset = this->Data.size();
+  packet.Size = dataLength;
+  packet.Destination = static_cast<std::size_t>(destination);
+  this->Data.insert(this->Data.end(), data, data + dataLength);
+  // the packets usually come in order, the ones added before with the same time come first
+  auto position = std::upper_bound(this->Packets.begin(), this->Packets.end(), packet,
+                                   [](const Packet& a, const Packet& b) { return a.Time < b.Time; });
+  this->Packets.insert(position, packet);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+int PacketReplayer::GetDestination(int port)
+{
+  boost::system::error_code errCode;
+  const boost::asio::ip::address address = boost::asio::ip::address_v4::from_string(this->DestinationIp, errCode);
+  if (errCode)
+  {
+    this->LastError = "Invalid destination ip address " + this->DestinationIp;
+    return -1;
+  }
+  const boost::asio::ip::udp::endpoint endpoint(address, port);
+  auto found = std::find(this->Destinations.begin(), this->Destinations.end(), endpoint);
+  if (found != this->Destinations.end())
+  {
+    return static_cast<int>(found - this->Destinations.begin());
+  }
+  this->Destinations.push_back(endpoint);
+  return static_cast<int>(this->Destinations.size()) - 1;
+}
+
+//-----------------------------------------------------------------------------
+double PacketReplayer::GetCaptureDuration() const
+{
+  return this->Packets.empty() ? 0. : (this->Packets.back().Time - this->Packets.front().Time) * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+PacketReplayer::Statistics PacketReplayer::Replay(const ProgressCallback& progress,
+                                                  std::size_t progressInterval)
+{
+  using Clock = std::chrono::steady_clock;
+  Statistics statistics;
+  if (this->Packets.empty())
+  {
+    return statistics;
+  }
+
+  const bool isPaced = this->Speed > 0;
+  const std::int64_t firstTime = this->Packets.front().Time;
+  const Clock::time_point start = Clock::now();
+  // time at which a packet must be sent
+  auto dueTime = [&](std::size_t index) {
+    return start + std::chrono::nanoseconds(static_cast<std::int64_t>(
+      (this->Packets[index].Time - firstTime) / this->Speed));
+  };
+  const auto spinDuration = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(this->SpinDuration));
+
+  double latenessSum = 0;
+  double latenessSquareSum = 0;
+  std::size_t timedPackets = 0;
+  auto updateStatistics = [&]() {
+    statistics.Duration = std::chrono::duration<double>(Clock::now() - start).count();
+    statistics.PacketRate = statistics.Duration > 0 ? statistics.SentPackets / statistics.Duration : 0;
+    if (timedPackets != 0)
+    {
+      statistics.MeanLateness = latenessSum / timedPackets;
+      const double variance = latenessSquareSum / timedPackets - statistics.MeanLateness * statistics.MeanLateness;
+      statistics.Jitter = std::sqrt(std::max(variance, 0.));
+    }
+  };
+
+  std::size_t nextProgress = progressInterval;
+  std::size_t index = 0;
+  while (index < this->Packets.size())
+  {
+    if (isPaced)
+    {
+      // sleep until shortly before the packet is due, the sleep is not precise enough for
+      // the bursts of the sensors, then spin
+      const Clock::time_point due = dueTime(index);
+      const Clock::duration remaining = due - Clock::now();
+      if (remaining > spinDuration)
+      {
+        std::this_thread::sleep_for(remaining - spinDuration);
+      }
+      while (Clock::now() < due)
+      {
+      }
+    }
+
+    // send the packets which are due together
+    const Clock::time_point now = Clock::now();
+    std::size_t count = 1;
+    while (count < static_cast<std::size_t>(this->BatchSize) && index + count < this->Packets.size() &&
+           (!isPaced || dueTime(index + count) <= now))
+    {
+      count++;
+    }
+    this->SendBatch(index, count, statistics);
+
+    if (isPaced)
+    {
+      for (std::size_t i = index; i < index + count; ++i)
+      {
+        const double lateness = std::chrono::duration<double>(now - dueTime(i)).count();
+        latenessSum += lateness;
+        latenessSquareSum += lateness * lateness;
+        statistics.MaximumLateness = std::max(statistics.MaximumLateness, lateness);
+      }
+      timedPackets += count;
+    }
+    index += count;
+
+    if (progress && progressInterval > 0 && statistics.SentPackets >= nextProgress)
+    {
+      updateStatistics();
+      progress(statistics);
+      nextProgress = (statistics.SentPackets / progressInterval + 1) * progressInterval;
+    }
+  }
+  updateStatistics();
+  return statistics;
+}
+
+//-----------------------------------------------------------------------------
+std::size_t PacketReplayer::SendBatch(std::size_t first, std::size_t count, Statistics& statistics)
+{
+  std::size_t sent = 0;
+#ifdef __linux__
+  struct mmsghdr messages[MaximumBatchSize];
+  struct iovec buffers[MaximumBatchSize];
+  std::memset(messages, 0, sizeof(messages));
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const Packet& packet = this->Packets[first + i];
+    boost::asio::ip::udp::endpoint& destination = this->Destinations[packet.Destination];
+    buffers[i].iov_base = this->Data.data() + packet.Offset;
+    buffers[i].iov_len = packet.Size;
+    messages[i].msg_hdr.msg_iov = &buffers[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+    messages[i].msg_hdr.msg_name = destination.data();
+    messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(destination.size());
+  }
+
+  std::size_t done = 0;
+  while (done < count)
+  {
+    const int result = sendmmsg(this->Socket.native_handle(), messages + done,
+                                static_cast<unsigned int>(count - done), 0);
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      // the first packet could not be sent, the next ones are tried
+      statistics.SendErrors++;
+      done++;
+      continue;
+    }
+    for (int i = 0; i < result; ++i)
+    {
+      statistics.SentBytes += messages[done + i].msg_len;
+    }
+    sent += result;
+    done += result;
+  }
+#else
+  for (std::size_t i = first; i < first + count; ++i)
+  {
+    const Packet& packet = this->Packets[i];
+    boost::system::error_code errCode;
+    this->Socket.send_to(boost::asio::buffer(this->Data.data() + packet.Offset, packet.Size),
+                         this->Destinations[packet.Destination], 0, errCode);
+    if (errCode)
+    {
+      statistics.SendErrors++;
+      continue;
+    }
+    statistics.SentBytes += packet.Size;
+    sent++;
+  }
+#endif
+  statistics.SentPackets += sent;
+  return sent;
+}
@@ -0,0 +1,141 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PACKETREPLAYER_H
+#define PACKETREPLAYER_H
+
+// STD
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// VTK
+#include <vtkSystemIncludes.h>
+
+// BOOST
+#include <boost/asio.hpp>
+
+/**
+ * \class PacketReplayer
+ * \brief Send the UDP packets of one or several pcap files with the timing of their
+ * capture, to test the streaming with the load of real sensors.
+ *
+ * The packets of all the files are loaded in memory first, and merged by capture time,
+ * so that the file reading never delays the sending. Each file is sent to its own ports.
+ * The packets are sent by batches of the ones which are due (sendmmsg on Linux), each
+ * batch waiting for its time on a steady clock: the thread sleeps until shortly before,
+ * then spins, so that the bursts of the sensors are reproduced at any speed without
+ * accumulating any drift. A speed of 0 sends the packets as fast as possible.
+ */
+class VTK_EXPORT PacketReplayer
+{
+public:
+  //! Maximum number of packets sent by one system call
+  static const int MaximumBatchSize = 64;
+
+  //! Timing achieved by a replay, the lateness of a packet is the delay between the time
+  //! it was due and the time it was sent
+  struct Statistics
+  {
+    std::size_t SentPackets = 0;
+    std::size_t SentBytes = 0;
+    std::size_t SendErrors = 0;
+    //! Seconds since the start of the replay
+    double Duration = 0;
+    //! Packets per second
+    double PacketRate = 0;
+    //! Mean, standard deviation (jitter) and maximum lateness in seconds
+    double MeanLateness = 0;
+    double Jitter = 0;
+    double MaximumLateness = 0;
+  };
+
+  //! Called every progress interval with the statistics of the replay so far
+  using ProgressCallback = std::function<void(const Statistics&)>;
+
+  explicit PacketReplayer(const std::string& destinationIp = "127.0.0.1");
+
+  /**
+   * @brief AddFile load the UDP packets of a pcap file
+   * @param lidarPort destination port of its lidar packets
+   * @param positionPort destination port of its position packets (512 bytes)
+   * @return false if the file can not be read, see GetLastError
+   */
+  bool AddFile(const std::string& filename, int lidarPort, int positionPort);
+
+  /**
+   * @brief AddPacket add a packet generated in memory, see VelodynePacketGenerator
+   * @param time capture time in seconds, the packets of a port must be added in order
+   * @param port destination port of the packet
+   * @return false if the packet is too large or the destination ip address not valid
+   */
+  bool AddPacket(const unsigned char* data, unsigned int dataLength, double time, int port);
+
+  //! Playback speed, 0 to send the packets as fast as possible
+  void SetSpeed(double speed) { this->Speed = speed; }
+
+  //! Number of packets sent by one system call at most, up to MaximumBatchSize
+  void SetBatchSize(int size);
+
+  //! Duration in seconds of the end of each wait spent spinning instead of sleeping
+  void SetSpinDuration(double duration) { this->SpinDuration = duration; }
+
+  std::size_t GetNumberOfPackets() const { return this->Packets.size(); }
+
+  //! Capture time between the first and the last packets, in seconds
+  double GetCaptureDuration() const;
+
+  const std::string& GetLastError() const { return this->LastError; }
+
+  //! Send all the packets once
+  Statistics Replay(const ProgressCallback& progress = ProgressCallback(),
+                    std::size_t progressInterval = 1000);
+
+private:
+  struct Packet
+  {
+    //! Capture time in nanoseconds
+    std::int64_t Time;
+    std::size_t Offset;
+    unsigned int Size;
+    std::size_t Destination;
+  };
+
+  //! Index of the destination of a port, added if needed, or -1 if the ip is not valid
+  int GetDestination(int port);
+
+  //! Send Packets[first, first + count), return the number sent
+  std::size_t SendBatch(std::size_t first, std::size_t count, Statistics& statistics);
+
+  std::string DestinationIp;
+  double Speed = 1;
+  int BatchSize = 32;
+  double SpinDuration = 200e-6;
+
+  /*!< Payloads of all the packets, one after the other */
+  std::vector<unsigned char> Data;
+  /*!< Sorted by capture time, the packets of different files with the same time keep
+   *   the order of the files */
+  std::vector<Packet> Packets;
+  std::vector<boost::asio::ip::udp::endpoint> Destinations;
+
+  boost::asio::io_service IOService;
+  boost::asio::ip::udp::socket Socket;
+
+  std::string LastError;
+};
+
+#endif // PACKETREPLAYER_H
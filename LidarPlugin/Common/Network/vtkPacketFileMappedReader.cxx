@@ -0,0 +1,403 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "vtkPacketFileMappedReader.h"
+
+// BOOST
+#include <boost/algorithm/string.hpp>
+
+namespace
+{
+// Classic pcap file format, see https://wiki.wireshark.org/Development/LibpcapFileFormat
+constexpr unsigned int GLOBAL_HEADER_SIZE = 24;
+constexpr unsigned int RECORD_HEADER_SIZE = 16;
+constexpr uint32_t MAGIC_MICROSECONDS = 0xa1b2c3d4;
+constexpr uint32_t MAGIC_NANOSECONDS = 0xa1b23c4d;
+constexpr uint32_t MAGIC_MICROSECONDS_SWAPPED = 0xd4c3b2a1;
+constexpr uint32_t MAGIC_NANOSECONDS_SWAPPED = 0x4d3cb2a1;
+
+// Snapshot length used by libpcap when the global header does not give one
+constexpr uint32_t MAXIMUM_SNAPSHOT_LENGTH = 262144;
+// Number of consecutive plausible records required to resynchronize on a record
+constexpr int RECORD_CHAIN_LENGTH = 8;
+// Maximum time between consecutive records of a plausible chain, in seconds
+constexpr uint32_t RECORD_CHAIN_MAXIMUM_TIME_GAP = 60;
+
+constexpr unsigned int LOOPBACK_HEADER_SIZE = 4;
+constexpr unsigned int ETHERNET_HEADER_SIZE = 14;
+constexpr unsigned int IPV6_HEADER_SIZE = 40;
+constexpr unsigned int UDP_HEADER_SIZE = 8;
+constexpr unsigned char UDP_PROTOCOL = 17;
+constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint16_t ETHERTYPE_IPV6 = 0x86DD;
+
+//-----------------------------------------------------------------------------
+uint16_t ReadBigEndianUInt16(const unsigned char* data)
+{
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::Open(const std::string& filename, std::string filter_arg)
+{
+  this->Close();
+
+  if (!this->ParseFilter(filter_arg))
+  {
+    return this->vtkPacketFileReader::Open(filename, filter_arg);
+  }
+
+  try
+  {
+    this->File.open(filename);
+  }
+  catch (const std::exception&)
+  {
+    // let libpcap report the error in the same way as before
+    return this->vtkPacketFileReader::Open(filename, filter_arg);
+  }
+
+  if (!this->File.is_open() || !this->ReadGlobalHeader())
+  {
+    // pcapng, unsupported link type, ... libpcap knows better
+    this->File.close();
+    return this->vtkPacketFileReader::Open(filename, filter_arg);
+  }
+
+  this->Mapped = true;
+  this->Position = GLOBAL_HEADER_SIZE;
+  this->FirstRecordSeconds = 0;
+  if (this->File.size() >= GLOBAL_HEADER_SIZE + RECORD_HEADER_SIZE)
+  {
+    // used to reject record candidates much older than the capture
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(this->File.data());
+    const uint32_t seconds = this->ReadUInt32(data + GLOBAL_HEADER_SIZE);
+    this->FirstRecordSeconds = seconds > RECORD_CHAIN_MAXIMUM_TIME_GAP
+      ? seconds - RECORD_CHAIN_MAXIMUM_TIME_GAP : 0;
+  }
+  this->FileName = filename;
+  this->StartTime.tv_sec = this->StartTime.tv_usec = 0;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::IsOpen()
+{
+  if (!this->Mapped)
+  {
+    return this->vtkPacketFileReader::IsOpen();
+  }
+  return this->File.is_open();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPacketFileMappedReader::Close()
+{
+  if (!this->Mapped)
+  {
+    this->vtkPacketFileReader::Close();
+    return;
+  }
+  this->File.close();
+  this->Mapped = false;
+  this->FileName.clear();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPacketFileMappedReader::GetFilePosition(int64_t* position)
+{
+  if (!this->Mapped)
+  {
+    this->vtkPacketFileReader::GetFilePosition(position);
+    return;
+  }
+  *position = this->Position;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPacketFileMappedReader::SetFilePosition(int64_t* position)
+{
+  if (!this->Mapped)
+  {
+    this->vtkPacketFileReader::SetFilePosition(position);
+    return;
+  }
+  this->Position = std::max<int64_t>(*position, GLOBAL_HEADER_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::ReadNextPacket(pcap_pkthdr*& header,
+                                               const unsigned char*& packetData)
+{
+  if (!this->Mapped)
+  {
+    return this->vtkPacketFileReader::ReadNextPacket(header, packetData);
+  }
+
+  const unsigned char* fileData = reinterpret_cast<const unsigned char*>(this->File.data());
+  const int64_t fileSize = static_cast<int64_t>(this->File.size());
+
+  while (this->Position + RECORD_HEADER_SIZE <= fileSize)
+  {
+    const unsigned char* record = fileData + this->Position;
+    const uint32_t capturedLength = this->ReadUInt32(record + 8);
+    if (this->Position + RECORD_HEADER_SIZE + capturedLength > fileSize)
+    {
+      // truncated file, libpcap also stops here
+      return false;
+    }
+    this->Position += RECORD_HEADER_SIZE + capturedLength;
+
+    const unsigned char* packet = record + RECORD_HEADER_SIZE;
+    if (!this->IsPacketAccepted(packet, capturedLength))
+    {
+      continue;
+    }
+
+    this->Header.ts.tv_sec = this->ReadUInt32(record);
+    this->Header.ts.tv_usec = this->NanosecondResolution ? this->ReadUInt32(record + 4) / 1000
+                                                         : this->ReadUInt32(record + 4);
+    this->Header.caplen = capturedLength;
+    this->Header.len = this->ReadUInt32(record + 12);
+    header = &this->Header;
+    packetData = packet;
+    return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+int64_t vtkPacketFileMappedReader::FindNextRecord(int64_t offset) const
+{
+  if (!this->Mapped)
+  {
+    return -1;
+  }
+  const int64_t fileSize = static_cast<int64_t>(this->File.size());
+  for (int64_t position = std::max<int64_t>(offset, GLOBAL_HEADER_SIZE);
+       position + RECORD_HEADER_SIZE <= fileSize; ++position)
+  {
+    if (this->IsRecordChainPlausible(position))
+    {
+      return position;
+    }
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::IsRecordChainPlausible(int64_t position) const
+{
+  const unsigned char* fileData = reinterpret_cast<const unsigned char*>(this->File.data());
+  const int64_t fileSize = static_cast<int64_t>(this->File.size());
+  const uint32_t subsecondLimit = this->NanosecondResolution ? 1000000000 : 1000000;
+
+  uint32_t previousSeconds = 0;
+  for (int i = 0; i < RECORD_CHAIN_LENGTH; ++i)
+  {
+    if (position == fileSize)
+    {
+      // the chain ends exactly at the end of the file
+      return i > 0;
+    }
+    if (position + RECORD_HEADER_SIZE > fileSize)
+    {
+      return false;
+    }
+    const unsigned char* record = fileData + position;
+    const uint32_t seconds = this->ReadUInt32(record);
+    const uint32_t subseconds = this->ReadUInt32(record + 4);
+    const uint32_t capturedLength = this->ReadUInt32(record + 8);
+    const uint32_t originalLength = this->ReadUInt32(record + 12);
+    if (seconds < this->FirstRecordSeconds || subseconds >= subsecondLimit ||
+        capturedLength > this->SnapshotLength || capturedLength > originalLength ||
+        originalLength > MAXIMUM_SNAPSHOT_LENGTH || capturedLength < this->FrameHeaderLength ||
+        position + RECORD_HEADER_SIZE + capturedLength > fileSize)
+    {
+      return false;
+    }
+    if (i > 0 &&
+        std::max(seconds, previousSeconds) - std::min(seconds, previousSeconds) >
+          RECORD_CHAIN_MAXIMUM_TIME_GAP)
+    {
+      return false;
+    }
+    previousSeconds = seconds;
+    position += RECORD_HEADER_SIZE + capturedLength;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::ReadGlobalHeader()
+{
+  if (this->File.size() < GLOBAL_HEADER_SIZE)
+  {
+    return false;
+  }
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(this->File.data());
+  uint32_t magic;
+  std::memcpy(&magic, data, sizeof(magic));
+  switch (magic)
+  {
+    case MAGIC_MICROSECONDS:
+      this->SwappedBytes = false;
+      this->NanosecondResolution = false;
+      break;
+    case MAGIC_NANOSECONDS:
+      this->SwappedBytes = false;
+      this->NanosecondResolution = true;
+      break;
+    case MAGIC_MICROSECONDS_SWAPPED:
+      this->SwappedBytes = true;
+      this->NanosecondResolution = false;
+      break;
+    case MAGIC_NANOSECONDS_SWAPPED:
+      this->SwappedBytes = true;
+      this->NanosecondResolution = true;
+      break;
+    default:
+      return false;
+  }
+
+  this->SnapshotLength = this->ReadUInt32(data + 16);
+  if (this->SnapshotLength == 0 || this->SnapshotLength > MAXIMUM_SNAPSHOT_LENGTH)
+  {
+    this->SnapshotLength = MAXIMUM_SNAPSHOT_LENGTH;
+  }
+
+  // the link type is the lower 16 bits of the last field,
+  // the upper bits may contain the FCS length
+  const uint32_t linktype = this->ReadUInt32(data + 20) & 0xFFFF;
+  switch (linktype)
+  {
+    case DLT_EN10MB:
+      this->FrameHeaderLength = ETHERNET_HEADER_SIZE;
+      break;
+    case DLT_NULL:
+      this->FrameHeaderLength = LOOPBACK_HEADER_SIZE;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::ParseFilter(const std::string& filter)
+{
+  std::vector<std::string> tokens;
+  std::string trimmedFilter = boost::algorithm::trim_copy(filter);
+  boost::algorithm::split(tokens, trimmedFilter, boost::algorithm::is_space(),
+                          boost::algorithm::token_compress_on);
+
+  if (tokens.size() == 1 && tokens[0] == "udp")
+  {
+    this->PortFilter = -1;
+    return true;
+  }
+  if (tokens.size() == 3 && tokens[0] == "udp" && tokens[1] == "port")
+  {
+    try
+    {
+      std::size_t parsedLength = 0;
+      int port = std::stoi(tokens[2], &parsedLength);
+      if (parsedLength == tokens[2].size() && port >= 0 && port <= 0xFFFF)
+      {
+        this->PortFilter = port;
+        return true;
+      }
+    }
+    catch (const std::exception&)
+    {
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPacketFileMappedReader::IsPacketAccepted(const unsigned char* packet,
+                                                 unsigned int length) const
+{
+  unsigned int ipOffset = this->FrameHeaderLength;
+  if (length <= ipOffset)
+  {
+    return false;
+  }
+  if (this->FrameHeaderLength == ETHERNET_HEADER_SIZE)
+  {
+    uint16_t ethertype = ReadBigEndianUInt16(packet + 12);
+    if (ethertype != ETHERTYPE_IPV4 && ethertype != ETHERTYPE_IPV6)
+    {
+      return false;
+    }
+  }
+
+  const unsigned char* ip = packet + ipOffset;
+  const unsigned int ipVersion = ip[0] >> 4;
+  unsigned int udpOffset = 0;
+  bool isFirstFragment = true;
+  if (ipVersion == 4)
+  {
+    const unsigned int ipHeaderLength = (ip[0] & 0xf) * 4;
+    if (length < ipOffset + 20 || ip[9] != UDP_PROTOCOL)
+    {
+      return false;
+    }
+    isFirstFragment = (ReadBigEndianUInt16(ip + 6) & 0x1FFF) == 0;
+    udpOffset = ipOffset + ipHeaderLength;
+  }
+  else if (ipVersion == 6)
+  {
+    // IPv6 extension headers are not followed, as the "udp" BPF primitive does
+    if (length < ipOffset + IPV6_HEADER_SIZE || ip[6] != UDP_PROTOCOL)
+    {
+      return false;
+    }
+    udpOffset = ipOffset + IPV6_HEADER_SIZE;
+  }
+  else
+  {
+    return false;
+  }
+
+  if (this->PortFilter < 0)
+  {
+    return true;
+  }
+  // Same behavior as BPF "udp port N": the ports are only known in the first
+  // fragment, the following fragments are rejected
+  if (!isFirstFragment || length < udpOffset + UDP_HEADER_SIZE)
+  {
+    return false;
+  }
+  const uint16_t sourcePort = ReadBigEndianUInt16(packet + udpOffset);
+  const uint16_t destinationPort = ReadBigEndianUInt16(packet + udpOffset + 2);
+  return sourcePort == this->PortFilter || destinationPort == this->PortFilter;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t vtkPacketFileMappedReader::ReadUInt32(const unsigned char* data) const
+{
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  if (this->SwappedBytes)
+  {
+    value = ((value & 0x000000FF) << 24) | ((value & 0x0000FF00) << 8) |
+      ((value & 0x00FF0000) >> 8) | ((value & 0xFF000000) >> 24);
+  }
+  return value;
+}
@@ -0,0 +1,122 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VTKPACKETFILEMAPPEDREADER_H
+#define VTKPACKETFILEMAPPEDREADER_H
+
+#include "vtkPacketFileReader.h"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+/**
+ * \class vtkPacketFileMappedReader
+ * \brief Zero-copy pcap reader backend based on a memory mapping of the file.
+ *
+ * libpcap copies each packet from the stdio buffer to its own buffer and runs a
+ * BPF program for each of them. This reader maps the whole file in memory instead,
+ * parses the pcap record headers and the Ethernet/IP/UDP headers itself and returns
+ * pointers directly inside the mapping.
+ *
+ * It has the same contract as vtkPacketFileReader (NextPacket, GetFilePosition,
+ * SetFilePosition, ...) and the file positions are the same 64 bits offsets, so both
+ * backends are interchangeable.
+ *
+ * Only the classic pcap format (microsecond or nanosecond timestamps, any endianness)
+ * and the filters "udp" and "udp port N" are supported. For anything else (pcapng,
+ * other filter expressions, ...) the reader transparently falls back on libpcap.
+ */
+class vtkPacketFileMappedReader : public vtkPacketFileReader
+{
+public:
+  vtkPacketFileMappedReader() = default;
+  ~vtkPacketFileMappedReader() override { this->Close(); }
+
+  bool Open(const std::string& filename, std::string filter_arg = "udp") override;
+
+  bool IsOpen() override;
+
+  void Close() override;
+
+  void GetFilePosition(int64_t* position) override;
+
+  void SetFilePosition(int64_t* position) override;
+
+  /**
+   * @brief IsMapped return true if the file is read through the memory mapping,
+   * false if the reader has fallen back on libpcap
+   */
+  bool IsMapped() const { return this->Mapped; }
+
+  /**
+   * @brief GetFileSize return the size of the mapped file in bytes
+   */
+  int64_t GetFileSize() const { return static_cast<int64_t>(this->File.size()); }
+
+  /**
+   * @brief FindNextRecord return the offset of the first pcap record which starts at
+   * or after the given offset. As the pcap format has no synchronization marker, a
+   * record is recognized by checking that its header and the headers of the following
+   * records are plausible. This enables to split a file in chunks processed in parallel.
+   * @return the offset of the record, or -1 if none was found (or the file is not mapped)
+   */
+  int64_t FindNextRecord(int64_t offset) const;
+
+protected:
+  bool ReadNextPacket(pcap_pkthdr*& header, const unsigned char*& packetData) override;
+
+  //! Parse the classic pcap global header, return false if the format is not supported
+  bool ReadGlobalHeader();
+
+  //! Parse the filter expression, return false if it is not supported
+  bool ParseFilter(const std::string& filter);
+
+  //! Check that the record at position and the following ones look like valid records
+  bool IsRecordChainPlausible(int64_t position) const;
+
+  //! Check if a packet satisfy the filter
+  bool IsPacketAccepted(const unsigned char* packet, unsigned int length) const;
+
+  //! Read an unsigned 32 bits integer written with the endianness of the file
+  uint32_t ReadUInt32(const unsigned char* data) const;
+
+  //! Memory mapping of the whole file
+  boost::iostreams::mapped_file_source File;
+
+  //! True if the file is read through the mapping, false if libpcap is used
+  bool Mapped = false;
+
+  //! Offset of the next record to read
+  int64_t Position = 0;
+
+  //! True if the file was written on a machine with a different endianness
+  bool SwappedBytes = false;
+
+  //! True if the timestamps are given in nanoseconds instead of microseconds
+  bool NanosecondResolution = false;
+
+  //! Maximum number of bytes captured per packet, given by the global header
+  uint32_t SnapshotLength = 0;
+
+  //! Lower bound of the timestamps (in seconds) of the records, deduced from the first
+  //! record of the file
+  uint32_t FirstRecordSeconds = 0;
+
+  //! Port to filter the packets on (source or destination), -1 to accept all ports
+  int PortFilter = -1;
+
+  //! Header of the last packet read, returned by NextPacket
+  pcap_pkthdr Header;
+};
+
+#endif // VTKPACKETFILEMAPPEDREADER_H
@@ -34,6 +34,8 @@
 
 #include <pcap.h>
 #include <string>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <vector>
@@ -69,7 +71,7 @@ public:
     this->PCAPFile = 0;
   }
 
-  ~vtkPacketFileReader()
+  virtual ~vtkPacketFileReader()
   {
     this->Close();
   }
@@ -79,7 +81,7 @@ public:
   // 2-A packet filter is then compile to convert an high level filtering
   //  expression in a program that can be interpreted by the kernel-level filtering engine
   // 3- The compiled filter is then associate to the capture
-  bool Open(const std::string& filename, std::string filter_arg="udp")
+  virtual bool Open(const std::string& filename, std::string filter_arg="udp")
   {
     char errbuff[PCAP_ERRBUF_SIZE];
     pcap_t* pcapFile = pcap_open_offline(filename.c_str(), errbuff);
@@ -124,9 +126,9 @@ public:
     this->StartTime.tv_sec = this->StartTime.tv_usec = 0;
     return true;
   }
-  bool IsOpen() { return (this->PCAPFile != 0); }
+  virtual bool IsOpen() { return (this->PCAPFile != 0); }
 
-  void Close()
+  virtual void Close()
   {
     if (this->PCAPFile)
     {
@@ -140,30 +142,35 @@ public:
 
   const std::string& GetFileName() { return this->FileName; }
 
-  void GetFilePosition(fpos_t* position)
+  // File positions are 64 bits offsets from the beginning of the file, so that they
+  // can be stored, compared and exchanged between the different reader backends.
+  virtual void GetFilePosition(int64_t* position)
   {
 #ifdef _MSC_VER
-    pcap_fgetpos(this->PCAPFile, position);
+    fpos_t filePosition;
+    pcap_fgetpos(this->PCAPFile, &filePosition);
+    *position = static_cast<int64_t>(filePosition);
 #else
     FILE* f = pcap_file(this->PCAPFile);
-    fgetpos(f, position);
+    *position = static_cast<int64_t>(ftello(f));
 #endif
   }
 
-  void SetFilePosition(fpos_t* position)
-{
+  virtual void SetFilePosition(int64_t* position)
+  {
 #ifdef _MSC_VER
-    pcap_fsetpos(this->PCAPFile, position);
+    fpos_t filePosition = static_cast<fpos_t>(*position);
+    pcap_fsetpos(this->PCAPFile, &filePosition);
 #else
     FILE* f = pcap_file(this->PCAPFile);
-    fsetpos(f, position);
+    fseeko(f, static_cast<off_t>(*position), SEEK_SET);
 #endif
   }
 
   bool NextPacket(const unsigned char*& data, unsigned int& dataLength, double& timeSinceStart,
     pcap_pkthdr** headerReference = NULL, unsigned int* dataHeaderLength = NULL)
   {
-    if (!this->PCAPFile)
+    if (!this->IsOpen())
     {
       return false;
     }
@@ -189,8 +196,7 @@ public:
       unsigned char const * tmpData = nullptr;
       unsigned int tmpDataLength;
 
-      int returnValue = pcap_next_ex(this->PCAPFile, &header, &tmpData);
-      if (returnValue < 0)
+      if (!this->ReadNextPacket(header, tmpData))
       {
         this->Close();
         return false;
@@ -280,6 +286,13 @@ public:
   }
 
 protected:
+  // Read the next packet of the file which satisfy the filter.
+  // Return false at the end of the file or in case of error.
+  virtual bool ReadNextPacket(pcap_pkthdr*& header, const unsigned char*& packetData)
+  {
+    return pcap_next_ex(this->PCAPFile, &header, &packetData) >= 0;
+  }
+
   double GetElapsedTime(const timeval& end, const timeval& start)
   {
     return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.00;
@@ -80,6 +80,13 @@ const std::string& vtkPacketFileWriter::GetFileName()
 //--------------------------------------------------------------------------------
 // Write an UDP packet from the data (without providing a header, so we construct it)
 bool vtkPacketFileWriter::WritePacket(const NetworkPacket& packet)
+{
+  return this->WritePacket(packet.GetPacketData(), packet.GetPacketSize(), packet.ReceptionTime);
+}
+
+//--------------------------------------------------------------------------------
+bool vtkPacketFileWriter::WritePacket(const unsigned char* packetData, unsigned int packetSize,
+                                      const struct timeval& receptionTime)
 {
   if (!this->PCAPFile)
   {
@@ -87,11 +94,11 @@ bool vtkPacketFileWriter::WritePacket(const NetworkPacket& packet)
   }
 
   struct pcap_pkthdr header;
-  header.caplen = packet.GetPacketSize();
-  header.len = packet.GetPacketSize();
-  header.ts = packet.ReceptionTime;
+  header.caplen = packetSize;
+  header.len = packetSize;
+  header.ts = receptionTime;
 
-  pcap_dump((u_char*)this->PCAPDump, &header, packet.GetPacketData());
+  pcap_dump((u_char*)this->PCAPDump, &header, packetData);
   return true;
 }
 
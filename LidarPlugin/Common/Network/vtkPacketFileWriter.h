@@ -62,6 +62,9 @@ public:
   const std::string& GetFileName();
 
   bool WritePacket(const NetworkPacket& packet);
+  // Write a packet which data includes the packet header
+  bool WritePacket(const unsigned char* packetData, unsigned int packetSize,
+                   const struct timeval& receptionTime);
   bool WritePacket(pcap_pkthdr* packetHeader, unsigned char* packetData);
 
 protected:
@@ -0,0 +1,485 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "SharedMemoryFrameRing.h"
+
+// STD
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+//-----------------------------------------------------------------------------
+std::uint64_t Align(std::uint64_t size)
+{
+  return (size + SHARED_MEMORY_FRAME_RING_ALIGNMENT - 1) / SHARED_MEMORY_FRAME_RING_ALIGNMENT *
+    SHARED_MEMORY_FRAME_RING_ALIGNMENT;
+}
+
+//-----------------------------------------------------------------------------
+// POSIX shared memory names start with a single slash
+std::string GetPosixName(const std::string& name)
+{
+  return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+//-----------------------------------------------------------------------------
+std::string GetSystemError(const std::string& message)
+{
+  return message + ": " + std::strerror(errno);
+}
+
+//-----------------------------------------------------------------------------
+// Retries of ReadLatestFrame when the latest frame is overwritten while it is copied
+const int MAXIMUM_NUMBER_OF_READ_ATTEMPTS = 4;
+}
+
+//-----------------------------------------------------------------------------
+std::size_t GetSharedMemoryArrayTypeSize(std::uint32_t type)
+{
+  switch (type)
+  {
+    case SHARED_MEMORY_INT8:
+    case SHARED_MEMORY_UINT8:
+      return 1;
+    case SHARED_MEMORY_INT16:
+    case SHARED_MEMORY_UINT16:
+      return 2;
+    case SHARED_MEMORY_INT32:
+    case SHARED_MEMORY_UINT32:
+    case SHARED_MEMORY_FLOAT32:
+      return 4;
+    case SHARED_MEMORY_INT64:
+    case SHARED_MEMORY_UINT64:
+    case SHARED_MEMORY_FLOAT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+SharedMemoryFrameWriter::~SharedMemoryFrameWriter()
+{
+  this->Close();
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameWriter::Open(const std::string& name, std::uint32_t numberOfSlots,
+                                   std::uint64_t slotSize)
+{
+  this->Close();
+#ifdef _WIN32
+  this->LastError = "the shared memory frame ring is not supported on Windows";
+  return false;
+#else
+  numberOfSlots = std::max(numberOfSlots, 1u);
+  slotSize = Align(std::max<std::uint64_t>(slotSize, sizeof(SharedMemorySlotHeader)));
+  const std::uint64_t slotsOffset = Align(sizeof(SharedMemoryRingHeader));
+  const std::size_t size = static_cast<std::size_t>(slotsOffset + numberOfSlots * slotSize);
+
+  // the readers of a previous writer keep their mapping of the old memory
+  const std::string posixName = GetPosixName(name);
+  shm_unlink(posixName.c_str());
+  const int fd = shm_open(posixName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd == -1)
+  {
+    this->LastError = GetSystemError("could not create the shared memory " + posixName);
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+  {
+    this->LastError = GetSystemError("could not allocate " + std::to_string(size) +
+                                     " bytes of shared memory");
+    close(fd);
+    shm_unlink(posixName.c_str());
+    return false;
+  }
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED)
+  {
+    this->LastError = GetSystemError("could not map the shared memory " + posixName);
+    shm_unlink(posixName.c_str());
+    return false;
+  }
+
+  // the memory is zeroed by ftruncate, the magic is written last so that the readers
+  // never see a partially initialized header
+  this->Header = new (memory) SharedMemoryRingHeader;
+  this->Header->Version = SHARED_MEMORY_FRAME_RING_VERSION;
+  this->Header->HeaderSize = sizeof(SharedMemoryRingHeader);
+  this->Header->SlotHeaderSize = sizeof(SharedMemorySlotHeader);
+  this->Header->NumberOfSlots = numberOfSlots;
+  this->Header->SlotSize = slotSize;
+  this->Header->SlotsOffset = slotsOffset;
+  this->Header->MaximumNumberOfArrays = SHARED_MEMORY_FRAME_RING_MAX_ARRAYS;
+  this->Header->WriterProcessId = static_cast<std::uint32_t>(getpid());
+  this->Header->NumberOfFrames.store(0);
+  for (std::uint32_t i = 0; i < numberOfSlots; ++i)
+  {
+    new (this->GetSlot(i + 1)) SharedMemorySlotHeader;
+    this->GetSlot(i + 1)->Generation.store(0);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(this->Header->Magic, SHARED_MEMORY_FRAME_RING_MAGIC, sizeof(this->Header->Magic));
+
+  this->Name = posixName;
+  this->MappedSize = size;
+  this->LastError.clear();
+  return true;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryFrameWriter::Close()
+{
+#ifndef _WIN32
+  if (this->Header)
+  {
+    munmap(this->Header, this->MappedSize);
+    shm_unlink(this->Name.c_str());
+  }
+#endif
+  this->Header = nullptr;
+  this->CurrentSlot = nullptr;
+  this->MappedSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t SharedMemoryFrameWriter::GetMaximumDataSize() const
+{
+  return this->Header ? this->Header->SlotSize - sizeof(SharedMemorySlotHeader) : 0;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t SharedMemoryFrameWriter::GetArrayStorageSize(std::uint64_t size)
+{
+  return Align(size);
+}
+
+//-----------------------------------------------------------------------------
+SharedMemorySlotHeader* SharedMemoryFrameWriter::GetSlot(std::uint64_t frameNumber) const
+{
+  unsigned char* memory = reinterpret_cast<unsigned char*>(this->Header);
+  return reinterpret_cast<SharedMemorySlotHeader*>(memory + this->Header->SlotsOffset +
+    ((frameNumber - 1) % this->Header->NumberOfSlots) * this->Header->SlotSize);
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryFrameWriter::BeginFrame(double time, std::uint64_t numberOfPoints)
+{
+  if (!this->Header)
+  {
+    return;
+  }
+  const std::uint64_t frameNumber = this->Header->NumberOfFrames.load(std::memory_order_relaxed) + 1;
+  this->CurrentSlot = this->GetSlot(frameNumber);
+  this->CurrentDataSize = 0;
+
+  // odd generation: the readers must not trust what they read from now on
+  this->CurrentSlot->Generation.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const double publicationTime = std::chrono::duration<double>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  this->CurrentSlot->FrameNumber = frameNumber;
+  this->CurrentSlot->Time = time;
+  this->CurrentSlot->PublicationTime = publicationTime;
+  this->CurrentSlot->NumberOfPoints = numberOfPoints;
+  this->CurrentSlot->NumberOfArrays = 0;
+  this->CurrentSlot->DataSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameWriter::AddArray(const std::string& name, std::uint32_t type,
+                                       std::uint32_t association, std::uint32_t numberOfComponents,
+                                       std::uint64_t numberOfTuples, const void* data)
+{
+  SharedMemorySlotHeader* slot = this->CurrentSlot;
+  const std::uint64_t size = numberOfTuples * numberOfComponents * GetSharedMemoryArrayTypeSize(type);
+  if (!slot || slot->NumberOfArrays == SHARED_MEMORY_FRAME_RING_MAX_ARRAYS ||
+      GetSharedMemoryArrayTypeSize(type) == 0 ||
+      this->CurrentDataSize + Align(size) > this->GetMaximumDataSize())
+  {
+    return false;
+  }
+
+  SharedMemoryArrayDescriptor& descriptor = slot->Arrays[slot->NumberOfArrays];
+  std::memset(descriptor.Name, 0, sizeof(descriptor.Name));
+  name.copy(descriptor.Name, sizeof(descriptor.Name) - 1);
+  descriptor.Type = type;
+  descriptor.Association = association;
+  descriptor.NumberOfComponents = numberOfComponents;
+  descriptor.Reserved = 0;
+  descriptor.NumberOfTuples = numberOfTuples;
+  descriptor.Offset = sizeof(SharedMemorySlotHeader) + this->CurrentDataSize;
+  if (size != 0)
+  {
+    std::memcpy(reinterpret_cast<unsigned char*>(slot) + descriptor.Offset, data, size);
+  }
+
+  this->CurrentDataSize += Align(size);
+  slot->NumberOfArrays++;
+  slot->DataSize = this->CurrentDataSize;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryFrameWriter::EndFrame()
+{
+  if (!this->CurrentSlot)
+  {
+    return;
+  }
+  // even generation: the slot is consistent again, then the frame is announced
+  this->CurrentSlot->Generation.fetch_add(1, std::memory_order_release);
+  this->Header->NumberOfFrames.store(this->CurrentSlot->FrameNumber, std::memory_order_release);
+  this->CurrentSlot = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t SharedMemoryFrameWriter::GetNumberOfFrames() const
+{
+  return this->Header ? this->Header->NumberOfFrames.load() : 0;
+}
+
+//-----------------------------------------------------------------------------
+const SharedMemoryFrameReader::Array* SharedMemoryFrameReader::Frame::GetArray(const std::string& name) const
+{
+  for (const Array& array : this->Arrays)
+  {
+    if (array.Name == name)
+    {
+      return &array;
+    }
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+SharedMemoryFrameReader::~SharedMemoryFrameReader()
+{
+  this->Close();
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameReader::Open(const std::string& name)
+{
+  this->Close();
+#ifdef _WIN32
+  this->LastError = "the shared memory frame ring is not supported on Windows";
+  return false;
+#else
+  const std::string posixName = GetPosixName(name);
+  const int fd = shm_open(posixName.c_str(), O_RDONLY, 0);
+  if (fd == -1)
+  {
+    this->LastError = GetSystemError("could not open the shared memory " + posixName);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(SharedMemoryRingHeader))
+  {
+    this->LastError = "the shared memory " + posixName + " is not initialized yet";
+    close(fd);
+    return false;
+  }
+  const std::size_t size = static_cast<std::size_t>(status.st_size);
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED)
+  {
+    this->LastError = GetSystemError("could not map the shared memory " + posixName);
+    return false;
+  }
+
+  const SharedMemoryRingHeader* header = static_cast<const SharedMemoryRingHeader*>(memory);
+  if (std::memcmp(header->Magic, SHARED_MEMORY_FRAME_RING_MAGIC, sizeof(header->Magic)) != 0)
+  {
+    this->LastError = "the shared memory " + posixName + " is not initialized yet";
+    munmap(memory, size);
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->Version != SHARED_MEMORY_FRAME_RING_VERSION ||
+      header->SlotsOffset + header->NumberOfSlots * header->SlotSize > size)
+  {
+    this->LastError = "the shared memory " + posixName + " has the layout version " +
+      std::to_string(header->Version) + " instead of " + std::to_string(SHARED_MEMORY_FRAME_RING_VERSION);
+    munmap(memory, size);
+    return false;
+  }
+
+  this->Header = header;
+  this->MappedSize = size;
+  this->LastError.clear();
+  return true;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryFrameReader::Close()
+{
+#ifndef _WIN32
+  if (this->Header)
+  {
+    munmap(const_cast<SharedMemoryRingHeader*>(this->Header), this->MappedSize);
+  }
+#endif
+  this->Header = nullptr;
+  this->MappedSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t SharedMemoryFrameReader::GetNumberOfFrames() const
+{
+  return this->Header ? this->Header->NumberOfFrames.load(std::memory_order_acquire) : 0;
+}
+
+//-----------------------------------------------------------------------------
+std::uint32_t SharedMemoryFrameReader::GetNumberOfSlots() const
+{
+  return this->Header ? this->Header->NumberOfSlots : 0;
+}
+
+//-----------------------------------------------------------------------------
+const SharedMemorySlotHeader* SharedMemoryFrameReader::GetSlot(std::uint64_t frameNumber) const
+{
+  const unsigned char* memory = reinterpret_cast<const unsigned char*>(this->Header);
+  return reinterpret_cast<const SharedMemorySlotHeader*>(memory + this->Header->SlotsOffset +
+    ((frameNumber - 1) % this->Header->NumberOfSlots) * this->Header->SlotSize);
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameReader::AcquireFrame(std::uint64_t frameNumber, Frame& frame) const
+{
+  if (!this->Header || frameNumber == 0 || frameNumber > this->GetNumberOfFrames())
+  {
+    return false;
+  }
+  const SharedMemorySlotHeader* slot = this->GetSlot(frameNumber);
+  const std::uint64_t generation = slot->Generation.load(std::memory_order_acquire);
+  if (generation % 2 != 0)
+  {
+    return false;
+  }
+
+  // the header of the slot is copied, then checked to be consistent
+  frame.FrameNumber = slot->FrameNumber;
+  frame.Time = slot->Time;
+  frame.PublicationTime = slot->PublicationTime;
+  frame.NumberOfPoints = slot->NumberOfPoints;
+  const std::uint32_t numberOfArrays = std::min<std::uint32_t>(slot->NumberOfArrays,
+                                                               SHARED_MEMORY_FRAME_RING_MAX_ARRAYS);
+  frame.Arrays.resize(numberOfArrays);
+  const unsigned char* slotMemory = reinterpret_cast<const unsigned char*>(slot);
+  for (std::uint32_t i = 0; i < numberOfArrays; ++i)
+  {
+    const SharedMemoryArrayDescriptor& descriptor = slot->Arrays[i];
+    Array& array = frame.Arrays[i];
+    array.Name.assign(descriptor.Name, strnlen(descriptor.Name, sizeof(descriptor.Name)));
+    array.Type = descriptor.Type;
+    array.Association = descriptor.Association;
+    array.NumberOfComponents = descriptor.NumberOfComponents;
+    array.NumberOfTuples = descriptor.NumberOfTuples;
+    array.Data = slotMemory + std::min<std::uint64_t>(descriptor.Offset, this->Header->SlotSize);
+  }
+  frame.Generation = generation;
+  frame.Storage.clear();
+
+  return this->IsValid(frame) && frame.FrameNumber == frameNumber;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameReader::IsValid(const Frame& frame) const
+{
+  if (!this->Header || frame.FrameNumber == 0)
+  {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return this->GetSlot(frame.FrameNumber)->Generation.load(std::memory_order_relaxed) == frame.Generation;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameReader::ReadFrame(std::uint64_t frameNumber, Frame& frame) const
+{
+  if (!this->AcquireFrame(frameNumber, frame))
+  {
+    return false;
+  }
+
+  // the sizes may be garbage if the slot is overwritten meanwhile, they are bounded by
+  // the slot so that the copy stays in the mapping
+  const std::uint64_t maximumDataSize = this->Header->SlotSize - sizeof(SharedMemorySlotHeader);
+  std::vector<std::uint64_t> offsets(frame.Arrays.size());
+  std::uint64_t storageSize = 0;
+  for (std::size_t i = 0; i < frame.Arrays.size(); ++i)
+  {
+    const Array& array = frame.Arrays[i];
+    offsets[i] = storageSize;
+    storageSize += Align(array.NumberOfTuples * array.NumberOfComponents *
+                         GetSharedMemoryArrayTypeSize(array.Type));
+    if (storageSize > maximumDataSize)
+    {
+      return false;
+    }
+  }
+  frame.Storage.resize(storageSize);
+  const unsigned char* slotEnd = reinterpret_cast<const unsigned char*>(this->GetSlot(frameNumber)) +
+    this->Header->SlotSize;
+  for (std::size_t i = 0; i < frame.Arrays.size(); ++i)
+  {
+    Array& array = frame.Arrays[i];
+    const unsigned char* data = static_cast<const unsigned char*>(array.Data);
+    const std::size_t size = std::min<std::size_t>(
+      array.NumberOfTuples * array.NumberOfComponents * GetSharedMemoryArrayTypeSize(array.Type),
+      static_cast<std::size_t>(slotEnd - data));
+    std::memcpy(frame.Storage.data() + offsets[i], data, size);
+  }
+  if (!this->IsValid(frame))
+  {
+    return false;
+  }
+  for (std::size_t i = 0; i < frame.Arrays.size(); ++i)
+  {
+    frame.Arrays[i].Data = frame.Storage.data() + offsets[i];
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFrameReader::ReadLatestFrame(Frame& frame) const
+{
+  for (int attempt = 0; attempt < MAXIMUM_NUMBER_OF_READ_ATTEMPTS; ++attempt)
+  {
+    if (this->ReadFrame(this->GetNumberOfFrames(), frame))
+    {
+      return true;
+    }
+  }
+  return false;
+}
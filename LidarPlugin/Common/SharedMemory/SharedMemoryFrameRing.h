@@ -0,0 +1,296 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAREDMEMORYFRAMERING_H
+#define SHAREDMEMORYFRAMERING_H
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Layout of the shared memory ring in which the frames are published, see
+ * SharedMemoryFrameWriter and SharedMemoryFrameReader. It does not depend on VTK, so
+ * that other processes can read the frames by linking only this library, or with the
+ * lidarview.sharedmemory python module which must be kept in sync with this layout.
+ *
+ * The memory starts with a SharedMemoryRingHeader, followed by NumberOfSlots slots of
+ * SlotSize bytes. Each slot starts with a SharedMemorySlotHeader describing its arrays,
+ * which follow it at their Offset from the start of the slot. All values are in the
+ * byte order of the host, all offsets are multiples of 64.
+ *
+ * The frames are numbered from 1, frame n is written in slot (n - 1) % NumberOfSlots.
+ * Each slot is protected by a sequence lock: its Generation is odd while the writer
+ * fills it, and a reader which finds the same even Generation before and after reading
+ * the slot has read a consistent frame.
+ */
+
+/*!< First bytes of the memory, written once the ring is initialized */
+#define SHARED_MEMORY_FRAME_RING_MAGIC "LVFRAMES"
+
+/*!< Incremented when the layout changes */
+#define SHARED_MEMORY_FRAME_RING_VERSION 1
+
+/*!< Maximum number of arrays of a frame */
+#define SHARED_MEMORY_FRAME_RING_MAX_ARRAYS 32
+
+/*!< Size of the name of an array, null terminator included */
+#define SHARED_MEMORY_FRAME_RING_NAME_SIZE 32
+
+/*!< Alignment of the slots and of the arrays */
+#define SHARED_MEMORY_FRAME_RING_ALIGNMENT 64
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the shared memory counters must be lock free");
+
+//! Type of the values of an array, the same codes are used by the python module
+enum SharedMemoryArrayType
+{
+  SHARED_MEMORY_INT8 = 1,
+  SHARED_MEMORY_UINT8 = 2,
+  SHARED_MEMORY_INT16 = 3,
+  SHARED_MEMORY_UINT16 = 4,
+  SHARED_MEMORY_INT32 = 5,
+  SHARED_MEMORY_UINT32 = 6,
+  SHARED_MEMORY_INT64 = 7,
+  SHARED_MEMORY_UINT64 = 8,
+  SHARED_MEMORY_FLOAT32 = 9,
+  SHARED_MEMORY_FLOAT64 = 10,
+};
+
+//! Size in bytes of a value of the type, 0 if the type is unknown
+std::size_t GetSharedMemoryArrayTypeSize(std::uint32_t type);
+
+//! What the tuples of an array describe
+enum SharedMemoryArrayAssociation
+{
+  SHARED_MEMORY_POINTS = 0,     /*!< the point coordinates, one tuple per point */
+  SHARED_MEMORY_POINT_DATA = 1, /*!< one tuple per point */
+  SHARED_MEMORY_FIELD_DATA = 2, /*!< values describing the whole frame */
+};
+
+struct SharedMemoryRingHeader
+{
+  char Magic[8];
+  std::uint32_t Version;
+  std::uint32_t HeaderSize;
+  std::uint32_t SlotHeaderSize;
+  std::uint32_t NumberOfSlots;
+  std::uint64_t SlotSize;
+  std::uint64_t SlotsOffset;
+  std::uint32_t MaximumNumberOfArrays;
+  std::uint32_t WriterProcessId;
+  char Padding0[16];
+  /*!< Number of frames published, on a cache line of its own as the readers poll it */
+  std::atomic<std::uint64_t> NumberOfFrames;
+  char Padding1[56];
+};
+
+struct SharedMemoryArrayDescriptor
+{
+  char Name[SHARED_MEMORY_FRAME_RING_NAME_SIZE];
+  std::uint32_t Type;
+  std::uint32_t Association;
+  std::uint32_t NumberOfComponents;
+  std::uint32_t Reserved;
+  std::uint64_t NumberOfTuples;
+  /*!< From the start of the slot */
+  std::uint64_t Offset;
+};
+
+struct SharedMemorySlotHeader
+{
+  /*!< Sequence lock, odd while the slot is written */
+  std::atomic<std::uint64_t> Generation;
+  std::uint64_t FrameNumber;
+  /*!< Time of the frame given by the publisher, NaN if unknown */
+  double Time;
+  /*!< Seconds since the epoch at which the frame was published */
+  double PublicationTime;
+  std::uint64_t NumberOfPoints;
+  std::uint32_t NumberOfArrays;
+  std::uint32_t Reserved;
+  /*!< Bytes used by the arrays, after the header */
+  std::uint64_t DataSize;
+  char Padding[8];
+  SharedMemoryArrayDescriptor Arrays[SHARED_MEMORY_FRAME_RING_MAX_ARRAYS];
+};
+
+static_assert(sizeof(SharedMemoryRingHeader) == 128, "unexpected layout of the ring header");
+static_assert(sizeof(SharedMemoryArrayDescriptor) == 64, "unexpected layout of the array descriptor");
+static_assert(sizeof(SharedMemorySlotHeader) % SHARED_MEMORY_FRAME_RING_ALIGNMENT == 0,
+              "unexpected layout of the slot header");
+
+/**
+ * \class SharedMemoryFrameWriter
+ * \brief Create a shared memory ring and publish frames in it, made of named arrays.
+ * A single writer publishes in a ring, it never waits for the readers: a reader which
+ * is too slow misses the frames overwritten in the meantime. POSIX only.
+ */
+class SharedMemoryFrameWriter
+{
+public:
+  SharedMemoryFrameWriter() = default;
+  ~SharedMemoryFrameWriter();
+
+  SharedMemoryFrameWriter(const SharedMemoryFrameWriter&) = delete;
+  SharedMemoryFrameWriter& operator=(const SharedMemoryFrameWriter&) = delete;
+
+  /**
+   * @brief Open create the shared memory, replacing an existing one of the same name
+   * @param name name of the shared memory, e.g. "lidarview", in /dev/shm on Linux
+   * @param numberOfSlots number of frames kept for the readers
+   * @param slotSize bytes of a slot, which limits the size of the frames
+   * @return false if it could not be created, see GetLastError
+   */
+  bool Open(const std::string& name, std::uint32_t numberOfSlots, std::uint64_t slotSize);
+
+  //! Unmap and remove the shared memory, the readers keep their mapping
+  void Close();
+
+  bool IsOpen() const { return this->Header != nullptr; }
+
+  //! Bytes available in a slot for the arrays of a frame
+  std::uint64_t GetMaximumDataSize() const;
+
+  //! Bytes taken in a slot by an array of the given size, once aligned
+  static std::uint64_t GetArrayStorageSize(std::uint64_t size);
+
+  /**
+   * @brief BeginFrame start writing the next frame in its slot, the readers see that
+   * the slot is being written until EndFrame
+   * @param time time of the frame, NaN if unknown
+   */
+  void BeginFrame(double time, std::uint64_t numberOfPoints);
+
+  /**
+   * @brief AddArray copy an array in the frame started by BeginFrame, the arrays which
+   * do not fit in the slot are skipped
+   * @param name truncated to SHARED_MEMORY_FRAME_RING_NAME_SIZE - 1 characters
+   * @param type one of SharedMemoryArrayType
+   * @param association one of SharedMemoryArrayAssociation
+   * @param data numberOfTuples * numberOfComponents values of the type
+   * @return false if the array was skipped
+   */
+  bool AddArray(const std::string& name, std::uint32_t type, std::uint32_t association,
+                std::uint32_t numberOfComponents, std::uint64_t numberOfTuples, const void* data);
+
+  //! Publish the frame started by BeginFrame
+  void EndFrame();
+
+  //! Number of frames published since Open
+  std::uint64_t GetNumberOfFrames() const;
+
+  const std::string& GetName() const { return this->Name; }
+  const std::string& GetLastError() const { return this->LastError; }
+
+private:
+  SharedMemorySlotHeader* GetSlot(std::uint64_t frameNumber) const;
+
+  std::string Name;
+  std::string LastError;
+  SharedMemoryRingHeader* Header = nullptr;
+  std::size_t MappedSize = 0;
+  /*!< Slot of the frame being written, and bytes written after its header */
+  SharedMemorySlotHeader* CurrentSlot = nullptr;
+  std::uint64_t CurrentDataSize = 0;
+};
+
+/**
+ * \class SharedMemoryFrameReader
+ * \brief Read the frames published by a SharedMemoryFrameWriter of another process.
+ * Several readers can read the same ring, they never block the writer.
+ */
+class SharedMemoryFrameReader
+{
+public:
+  struct Array
+  {
+    std::string Name;
+    std::uint32_t Type;
+    std::uint32_t Association;
+    std::uint32_t NumberOfComponents;
+    std::uint64_t NumberOfTuples;
+    /*!< In the shared memory for AcquireFrame, in Frame::Storage for ReadFrame */
+    const void* Data;
+  };
+
+  struct Frame
+  {
+    std::uint64_t FrameNumber = 0;
+    double Time = 0;
+    double PublicationTime = 0;
+    std::uint64_t NumberOfPoints = 0;
+    std::vector<Array> Arrays;
+
+    //! Return the array of the given name, or nullptr
+    const Array* GetArray(const std::string& name) const;
+
+    /*!< Generation of the slot when the frame was acquired */
+    std::uint64_t Generation = 0;
+    /*!< Copy of the arrays made by ReadFrame */
+    std::vector<unsigned char> Storage;
+  };
+
+  SharedMemoryFrameReader() = default;
+  ~SharedMemoryFrameReader();
+
+  SharedMemoryFrameReader(const SharedMemoryFrameReader&) = delete;
+  SharedMemoryFrameReader& operator=(const SharedMemoryFrameReader&) = delete;
+
+  //! Map the shared memory created by a writer, return false if it does not exist yet
+  //! or has another layout version, see GetLastError
+  bool Open(const std::string& name);
+
+  void Close();
+
+  bool IsOpen() const { return this->Header != nullptr; }
+
+  //! Number of frames published by the writer, the last one being the latest frame
+  std::uint64_t GetNumberOfFrames() const;
+
+  std::uint32_t GetNumberOfSlots() const;
+
+  /**
+   * @brief AcquireFrame describe a frame without copying it, its arrays point in the
+   * shared memory. The writer may overwrite the frame while it is read: IsValid must
+   * be checked once the data is used, to know whether it was consistent.
+   * @return false if the frame is not published yet, is being written or was overwritten
+   */
+  bool AcquireFrame(std::uint64_t frameNumber, Frame& frame) const;
+
+  //! Return true if the frame acquired by AcquireFrame was not modified since
+  bool IsValid(const Frame& frame) const;
+
+  /**
+   * @brief ReadFrame copy a frame, its arrays point in frame.Storage
+   * @return false if the frame is not published yet or was overwritten while copied
+   */
+  bool ReadFrame(std::uint64_t frameNumber, Frame& frame) const;
+
+  //! Copy the latest frame, retrying if it is overwritten while copied
+  bool ReadLatestFrame(Frame& frame) const;
+
+  const std::string& GetLastError() const { return this->LastError; }
+
+private:
+  const SharedMemorySlotHeader* GetSlot(std::uint64_t frameNumber) const;
+
+  std::string LastError;
+  const SharedMemoryRingHeader* Header = nullptr;
+  std::size_t MappedSize = 0;
+};
+
+#endif // SHAREDMEMORYFRAMERING_H
@@ -0,0 +1,104 @@
+#include "vtkSharedMemoryPublisher.h"
+
+#include <limits>
+
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkPolyData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+#include "SharedMemoryFramePublisher.h"
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSharedMemoryPublisher)
+
+//----------------------------------------------------------------------------
+vtkSharedMemoryPublisher::vtkSharedMemoryPublisher()
+  : Publisher(new SharedMemoryFramePublisher)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkSharedMemoryPublisher::~vtkSharedMemoryPublisher()
+{
+  this->Publisher->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkSharedMemoryPublisher::SetSharedMemoryName(const std::string& name)
+{
+  if (this->SharedMemoryName != name)
+  {
+    this->SharedMemoryName = name;
+    this->ClosePublisher();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSharedMemoryPublisher::SetNumberOfSlots(int numberOfSlots)
+{
+  if (this->NumberOfSlots != numberOfSlots)
+  {
+    this->NumberOfSlots = numberOfSlots;
+    this->ClosePublisher();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSharedMemoryPublisher::SetSlotSize(int size)
+{
+  if (this->SlotSize != size)
+  {
+    this->SlotSize = size;
+    this->ClosePublisher();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSharedMemoryPublisher::ClosePublisher()
+{
+  this->Publisher->Close();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSharedMemoryPublisher::RequestData(vtkInformation* vtkNotUsed(request),
+                                          vtkInformationVector** inputVector,
+                                          vtkInformationVector* outputVector)
+{
+  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+  vtkPolyData* input = vtkPolyData::GetData(inputVector[0]);
+  vtkPolyData* output = vtkPolyData::GetData(outputVector);
+  output->ShallowCopy(input);
+
+  if (this->SharedMemoryName.empty())
+  {
+    return 1;
+  }
+  if (!this->Publisher->IsOpen())
+  {
+    if (this->NumberOfSlots < 1 || this->SlotSize < 1)
+    {
+      vtkErrorMacro("The shared memory must have at least one slot of one megabyte");
+      return 0;
+    }
+    if (!this->Publisher->Open(this->SharedMemoryName, static_cast<std::uint32_t>(this->NumberOfSlots),
+                               static_cast<std::uint64_t>(this->SlotSize) * 1024 * 1024))
+    {
+      vtkErrorMacro("Could not create the shared memory: " << this->Publisher->GetLastError());
+      return 0;
+    }
+  }
+
+  // a live source has no time steps, its frames are published without time
+  double time = std::numeric_limits<double>::quiet_NaN();
+  if (inInfo->Has(vtkStreamingDemandDrivenPipeline::UPDATE_TIME_STEP()))
+  {
+    time = inInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_TIME_STEP());
+  }
+  if (!this->Publisher->Publish(input, time))
+  {
+    vtkWarningMacro("Frame too large for a slot of the shared memory, some arrays were not published");
+  }
+  return 1;
+}
@@ -0,0 +1,67 @@
+#ifndef VTKSHAREDMEMORYPUBLISHER_H
+#define VTKSHAREDMEMORYPUBLISHER_H
+
+#include <memory>
+#include <string>
+
+#include "vtkPolyDataAlgorithm.h"
+
+class SharedMemoryFramePublisher;
+
+/**
+ * @brief The vtkSharedMemoryPublisher class is a pass-through filter that publishes
+ * each frame it processes in a shared memory ring, so that other processes of the host
+ * can read the frames of a reader, see SharedMemoryFramePublisher.
+ * The shared memory is created at the first frame and kept until one of its settings
+ * changes, in which case the readers must open it again. POSIX only.
+ */
+class VTK_EXPORT vtkSharedMemoryPublisher : public vtkPolyDataAlgorithm
+{
+public:
+  static vtkSharedMemoryPublisher* New();
+  vtkTypeMacro(vtkSharedMemoryPublisher, vtkPolyDataAlgorithm)
+
+  //! @{
+  //! @copydoc SharedMemoryName
+  vtkGetMacro(SharedMemoryName, std::string)
+  void SetSharedMemoryName(const std::string& name);
+  //! @}
+
+  //! @{
+  //! @copydoc NumberOfSlots
+  vtkGetMacro(NumberOfSlots, int)
+  void SetNumberOfSlots(int numberOfSlots);
+  //! @}
+
+  //! @{
+  //! @copydoc SlotSize
+  vtkGetMacro(SlotSize, int)
+  void SetSlotSize(int size);
+  //! @}
+
+protected:
+  vtkSharedMemoryPublisher();
+  ~vtkSharedMemoryPublisher() override;
+
+  int RequestData(vtkInformation* request,
+                  vtkInformationVector** inputVector,
+                  vtkInformationVector* outputVector) override;
+
+private:
+  //! Close the shared memory so that it is created again with the new settings
+  void ClosePublisher();
+
+  //! Name of the shared memory, e.g. "lidarview", empty to publish none
+  std::string SharedMemoryName;
+  //! Number of frames kept in the shared memory for the readers
+  int NumberOfSlots = 4;
+  //! Megabytes of a frame in the shared memory, the arrays of the larger frames are skipped
+  int SlotSize = 32;
+
+  std::unique_ptr<SharedMemoryFramePublisher> Publisher;
+
+  vtkSharedMemoryPublisher(const vtkSharedMemoryPublisher&); // not implemented
+  void operator=(const vtkSharedMemoryPublisher&); // not implemented
+};
+
+#endif // VTKSHAREDMEMORYPUBLISHER_H
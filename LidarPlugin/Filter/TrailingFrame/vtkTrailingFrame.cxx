@@ -100,26 +100,32 @@ int vtkTrailingFrame::RequestUpdateExtent(vtkInformation* vtkNotUsed(request),
         unsigned int newIndex = this->LastTimeProcessedIndex % (this->NumberOfTrailingFrames + 1);
         this->Cache->SetBlock(newIndex, oldCache->GetBlock(previousIndex));
       }
-      this->Direction = -1;
+      this->LastTimeToProcessIndex = this->LastTimeProcessedIndex;
+      this->LastTimeProcessedIndex = this->CacheTimeRange[0];
     }
     // handle case when jumping backward
     else if (this->CacheTimeRange[1] < previousCacheTimeRange[1])
     {
-      this->Direction = -1;
-      this->LastTimeProcessedIndex = std::max(0, std::min(this->CacheTimeRange[1], previousCacheTimeRange[0]) - 1);
+      this->LastTimeToProcessIndex = std::max(0, std::min(this->CacheTimeRange[1], previousCacheTimeRange[0]) - 1);
+      this->LastTimeProcessedIndex = this->CacheTimeRange[0];
     }
     // handle case when jumping forward
     else if (this->CacheTimeRange[1] > previousCacheTimeRange[1])
     {
-      this->Direction = 1;
+      this->LastTimeToProcessIndex = this->CacheTimeRange[1] - 1;
       this->LastTimeProcessedIndex = std::max(this->CacheTimeRange[0], previousCacheTimeRange[1]);
     }
+    // handle case when the time does not change, only the last time index is processed again
+    else
+    {
+      this->LastTimeToProcessIndex = this->LastTimeProcessedIndex;
+    }
     this->FirstFilterIteration = false;
   }
   // not first loop
   else
   {
-    this->LastTimeProcessedIndex += this->Direction;
+    this->LastTimeProcessedIndex++;
   }
 
   inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_TIME_STEP(),
@@ -142,8 +148,7 @@ int vtkTrailingFrame::RequestData(vtkInformation* request,
   if (!this->TimeSteps.empty())
   {
 
-    if ((this->LastTimeProcessedIndex == this->CacheTimeRange[0] && this->Direction == -1)
-        || (this->LastTimeProcessedIndex == this->CacheTimeRange[1]-1 && this->Direction == 1))
+    if (this->LastTimeProcessedIndex >= this->LastTimeToProcessIndex)
     {
       // Stop the pipeline loop
       request->Remove(vtkStreamingDemandDrivenPipeline::CONTINUE_EXECUTING());
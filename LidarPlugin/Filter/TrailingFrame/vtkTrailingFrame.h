@@ -55,8 +55,10 @@ private:
   int CacheTimeRange[2] = {-1, -1};
   //! Last Time index required from the filter to its input filter
   int LastTimeProcessedIndex = -1;
-  //! Indicate if the next time to process is after or before the last processed
-  int Direction = 1;
+  //! Last Time index to require from the input filter during the current pipeline loop.
+  //! The time indexes are always required in increasing order, so that a reader can decode
+  //! consecutive frames without seeking
+  int LastTimeToProcessIndex = -1;
   //! Cache to save ouput previously produced by the filter
   vtkNew<vtkMultiBlockDataSet> Cache;
   //! List of available time steps from the source
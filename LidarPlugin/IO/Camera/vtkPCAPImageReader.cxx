@@ -22,7 +22,7 @@
 #include <algorithm>
 #include <sstream>
 
-#include "vtkPacketFileReader.h"
+#include "vtkPacketFileMappedReader.h"
 #include "vtkOpenCVConversions.h"
 #include "statistics.h"
 
@@ -156,7 +156,7 @@ int vtkPCAPImageReader::ReadFrameInformation()
   // keep track of the file position
   // and the network timestamp of the
   // current udp packet to process
-  fpos_t lastFilePosition;
+  int64_t lastFilePosition = 0;
   double lastPacketNetworkTime = 0;
   this->Reader->GetFilePosition(&lastFilePosition);
 
@@ -303,7 +303,7 @@ cv::Mat vtkPCAPImageReader::GetOpenCVFrame(int frameNumber)
 void vtkPCAPImageReader::Open()
 {
   this->Close();
-  this->Reader = new vtkPacketFileReader;
+  this->Reader = new vtkPacketFileMappedReader;
 
   std::string filterPCAP = "udp";
   if (this->NetworkPort != -1)
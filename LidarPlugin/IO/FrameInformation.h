@@ -15,7 +15,10 @@
 #ifndef FRAMEINFORMATION_H
 #define FRAMEINFORMATION_H
 
+#include <cstdint>
+#include <istream>
 #include <memory>
+#include <ostream>
 
 /**
  * @brief SpecificFrameInformation placeholder for
@@ -24,6 +27,11 @@
 struct SpecificFrameInformation {
   virtual void reset() = 0;
   virtual std::unique_ptr<SpecificFrameInformation> clone() = 0;
+
+  //! Binary (de)serialization used to store the frame catalog on disk.
+  //! read returns false if the stream does not contain a valid information.
+  virtual void write(std::ostream& os) const = 0;
+  virtual bool read(std::istream& is) = 0;
 };
 
 /**
@@ -31,8 +39,9 @@ struct SpecificFrameInformation {
  */
 struct FrameInformation
 {
-  //! position of the first packet of the given frame
-  fpos_t FilePosition;
+  //! position of the first packet of the given frame, as an offset from the
+  //! beginning of the file (see vtkPacketFileReader::GetFilePosition)
+  int64_t FilePosition = 0;
 
   //! To be agnostic to the underlying data, we rely on the first packet timestep to determine
   //! the Time of frame. The packet timestep has no relation with the timesteps that are in the
@@ -43,11 +52,17 @@ struct FrameInformation
   //! timestamp of data contained in the first packet
   double FirstPacketDataTime = 0;
 
+  //! timestamp of data contained in the first packet in nanoseconds, on a timeline which
+  //! keeps increasing when the timestamps of the sensor roll over (ex: every hour).
+  //! It is the base time of the decoded frame, see vtkLidarPacketInterpreter
+  int64_t FirstPacketDataTimeNs = 0;
+
   //! Packet information that are specific to a sensor
   std::shared_ptr<SpecificFrameInformation> SpecificInformation = nullptr;
 
   void Reset() {
     this->FirstPacketDataTime = 0;
+    this->FirstPacketDataTimeNs = 0;
     this->FirstPacketNetworkTime = 0;
     this->SpecificInformation->reset();
   }
@@ -60,6 +75,7 @@ struct FrameInformation
     this->FilePosition = arg.FilePosition;
     this->FirstPacketNetworkTime = arg.FirstPacketNetworkTime;
     this->FirstPacketDataTime = arg.FirstPacketDataTime;
+    this->FirstPacketDataTimeNs = arg.FirstPacketDataTimeNs;
     if(arg.SpecificInformation != nullptr)
     {
       this->SpecificInformation = arg.SpecificInformation->clone();
@@ -28,7 +28,7 @@
 
 #include "vtkVelodyneHDLPositionReader.h"
 
-#include "vtkPacketFileReader.h"
+#include "vtkPacketFileMappedReader.h"
 #include "vtkPacketFileWriter.h"
 #include "vtkCustomTransformInterpolator.h"
 
@@ -678,7 +678,7 @@ void vtkVelodyneHDLPositionReader::SetUseGPGGASentences(bool useGPGGASentences)
 void vtkVelodyneHDLPositionReader::Open()
 {
   this->Close();
-  this->Internal->Reader = new vtkPacketFileReader;
+  this->Internal->Reader = new vtkPacketFileMappedReader;
   if (!this->Internal->Reader->Open(this->FileName))
   {
     vtkErrorMacro("Failed to open packet file: " << this->FileName << '\n'
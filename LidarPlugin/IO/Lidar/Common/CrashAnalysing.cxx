@@ -19,85 +19,351 @@
 #include "CrashAnalysing.h"
 
 // STD
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
 #include <ctime>
 #include <fstream>
-#include <sstream>
+#include <mutex>
 #include <stdio.h>
 
 // VTK
 #include <vtkInformation.h>
 
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+//! Same global header and records as the files written by BufferedPcapWriter
+struct PcapGlobalHeader
+{
+  std::uint32_t MagicNumber;
+  std::uint16_t VersionMajor;
+  std::uint16_t VersionMinor;
+  std::int32_t ThisZone;
+  std::uint32_t SigFigs;
+  std::uint32_t SnapLength;
+  std::uint32_t LinkType;
+};
+
+struct PcapRecordHeader
+{
+  std::uint32_t Seconds;
+  std::uint32_t Microseconds;
+  std::uint32_t CapturedLength;
+  std::uint32_t Length;
+};
+
+const PcapGlobalHeader GlobalHeader = { 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1 };
+
+//! Writers whose ring is saved by the signal handler, a slot is empty when null
+const int MaximumNumberOfWriters = 64;
+std::atomic<CrashAnalysisWriter*> Writers[MaximumNumberOfWriters];
+
+const int FatalSignals[] = {
+  SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifndef _WIN32
+  SIGBUS,
+#endif
+};
+const int NumberOfFatalSignals = sizeof(FatalSignals) / sizeof(FatalSignals[0]);
+#ifndef _WIN32
+struct sigaction PreviousActions[NumberOfFatalSignals];
+#endif
+std::atomic<bool> IsHandlingSignal{ false };
+
+//-----------------------------------------------------------------------------
+bool WriteAll(int file, const void* data, std::size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  while (size > 0)
+  {
+#ifdef _WIN32
+    const int written = _write(file, bytes, static_cast<unsigned int>(size));
+#else
+    const ssize_t written = write(file, bytes, size);
+#endif
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void FatalSignalHandler(int signalNumber)
+{
+  // a second fatal signal while saving goes directly to the previous handler
+  if (!IsHandlingSignal.exchange(true))
+  {
+    for (int i = 0; i < MaximumNumberOfWriters; ++i)
+    {
+      if (CrashAnalysisWriter* writer = Writers[i].load())
+      {
+        writer->WriteCapture(nullptr, true);
+      }
+    }
+  }
+
+  // let the previous handler, or the default action, terminate the process
+#ifdef _WIN32
+  std::signal(signalNumber, SIG_DFL);
+#else
+  for (int i = 0; i < NumberOfFatalSignals; ++i)
+  {
+    if (FatalSignals[i] == signalNumber)
+    {
+      sigaction(signalNumber, &PreviousActions[i], nullptr);
+    }
+  }
+#endif
+  raise(signalNumber);
+}
+
 //-----------------------------------------------------------------------------
-void CrashAnalysisWriter::AddPacket(const NetworkPacket& packet)
-{
-  // The idea is to store 2 .pcap files. One corresponding
-  // to the last N packets received and one corresponding to
-  // the N older ones. Switching from one file to the other
-  // insure that we always have at least the N last packets
-  // (except for the very beginning).
-  // When switching to file 0 or 1, the existing content of the
-  // file is discarded resulting in a storage of a number of packets
-  // between N and 2*N
-  if (this->PacketCount % this->NbrPacketsToStore == 0)
-  {
-    // Close the writer if it is already opened
-    if (this->Writer.IsOpen())
+void RegisterWriter(CrashAnalysisWriter* writer)
+{
+  static std::once_flag isInstalled;
+  std::call_once(isInstalled, []() {
+    for (int i = 0; i < NumberOfFatalSignals; ++i)
     {
-      this->Writer.Close();
+#ifdef _WIN32
+      std::signal(FatalSignals[i], FatalSignalHandler);
+#else
+      struct sigaction action;
+      std::memset(&action, 0, sizeof(action));
+      action.sa_handler = FatalSignalHandler;
+      sigemptyset(&action.sa_mask);
+      // a stack overflow can still be saved if an alternate stack was set up
+      action.sa_flags = SA_ONSTACK;
+      sigaction(FatalSignals[i], &action, &PreviousActions[i]);
+#endif
     }
+  });
 
-    // Switch the filename and open the writer
-    this->FileToStore++;
-    unsigned int nbrFile = this->FileToStore % 2; // file name: 0 or 1
-    std::stringstream ss;
-    ss << this->Filename << nbrFile << ".bin";
-    if (!this->Writer.Open(ss.str()))
+  for (int i = 0; i < MaximumNumberOfWriters; ++i)
+  {
+    CrashAnalysisWriter* empty = nullptr;
+    if (Writers[i].compare_exchange_strong(empty, writer))
     {
-      vtkGenericWarningMacro("Crash analysis failed to open the log file.");
       return;
     }
   }
+  vtkGenericWarningMacro("Too many crash analyses, the last packets will not be saved on a crash");
+}
 
-  this->WriteLastPacket(packet);
-  this->PacketCount++;
+//-----------------------------------------------------------------------------
+void UnregisterWriter(CrashAnalysisWriter* writer)
+{
+  for (int i = 0; i < MaximumNumberOfWriters; ++i)
+  {
+    CrashAnalysisWriter* registered = writer;
+    Writers[i].compare_exchange_strong(registered, nullptr);
+  }
+}
+}
+
+//-----------------------------------------------------------------------------
+CrashAnalysisWriter::~CrashAnalysisWriter()
+{
+  this->Stop(false);
+}
+
+//-----------------------------------------------------------------------------
+void CrashAnalysisWriter::Start()
+{
+  this->Stop(false);
+
+  // the ring is large enough for the number of packets asked, whatever their size
+  const std::size_t maximumRecordSize =
+    sizeof(PcapRecordHeader) + PacketSlot::HeaderSize + PacketSlot::MaximumPayloadSize;
+  this->NbrPacketsToStore = std::max(this->NbrPacketsToStore, 1u);
+  // assign touches the whole ring, no page fault happens while streaming
+  this->Ring.assign(this->NbrPacketsToStore * maximumRecordSize, 0);
+  this->Begin = 0;
+  this->End = 0;
+  this->PacketCount = 0;
+  this->IsFrozen = false;
+  this->CrashFilename = this->Filename + "_crash.pcap";
+  this->IsStarted = true;
+  RegisterWriter(this);
 }
 
 //-----------------------------------------------------------------------------
-void CrashAnalysisWriter::WriteLastPacket(const NetworkPacket& packet)
+void CrashAnalysisWriter::Stop(bool saveCapture)
 {
-  // check that the writer is opened
-  if (!this->Writer.IsOpen())
+  if (!this->IsStarted)
   {
-    vtkGenericWarningMacro("Crash analysis couldn't save last packet received since the writer is not opened");
     return;
   }
-
-  this->Writer.WritePacket(packet);
+  UnregisterWriter(this);
+  if (saveCapture)
+  {
+    this->SaveCapture();
+  }
+  this->IsStarted = false;
+  std::vector<unsigned char>().swap(this->Ring);
 }
 
 //-----------------------------------------------------------------------------
-void CrashAnalysisWriter::CloseAnalyzer()
+void CrashAnalysisWriter::AddPacket(const PacketSlot& packet)
 {
-  if (this->Writer.IsOpen())
+  if (!this->IsStarted)
+  {
+    return;
+  }
+  // WriteCapture sets IsFrozen then waits for IsAdding to be false, so the ring never
+  // changes while it is written
+  this->IsAdding = true;
+  if (this->IsFrozen)
   {
-    this->Writer.Close();
+    this->IsAdding = false;
     return;
   }
+
+  // remove the oldest packets
+  const double time = packet.ReceptionTime.tv_sec + 1e-6 * packet.ReceptionTime.tv_usec;
+  std::uint64_t begin = this->Begin.load(std::memory_order_relaxed);
+  while (this->PacketCount > 0)
+  {
+    PcapRecordHeader oldest;
+    this->CopyFromRing(begin, &oldest, sizeof(oldest));
+    const bool isTooOld = this->DurationToStore > 0 &&
+      time - (oldest.Seconds + 1e-6 * oldest.Microseconds) > this->DurationToStore;
+    if (this->PacketCount < this->NbrPacketsToStore && !isTooOld)
+    {
+      break;
+    }
+    begin += sizeof(oldest) + oldest.CapturedLength;
+    this->PacketCount--;
+  }
+  // released before the space is reused
+  this->Begin = begin;
+
+  PcapRecordHeader header;
+  header.Seconds = static_cast<std::uint32_t>(packet.ReceptionTime.tv_sec);
+  header.Microseconds = static_cast<std::uint32_t>(packet.ReceptionTime.tv_usec);
+  header.CapturedLength = packet.GetPacketSize();
+  header.Length = packet.GetPacketSize();
+  std::uint64_t end = this->End.load(std::memory_order_relaxed);
+  this->CopyToRing(end, &header, sizeof(header));
+  this->CopyToRing(end + sizeof(header), packet.GetPacketData(), packet.GetPacketSize());
+  this->End = end + sizeof(header) + packet.GetPacketSize();
+  this->PacketCount++;
+
+  this->IsAdding = false;
+}
+
+//-----------------------------------------------------------------------------
+bool CrashAnalysisWriter::SaveCapture()
+{
+  if (!this->IsStarted)
+  {
+    return false;
+  }
+  const std::string filename = this->Filename + ".pcap";
+  if (!this->WriteCapture(filename.c_str(), false))
+  {
+    vtkGenericWarningMacro("Crash analysis failed to save the last packets in " << filename);
+    return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool CrashAnalysisWriter::WriteCapture(const char* filename, bool freeze)
+{
+  if (!filename)
+  {
+    filename = this->CrashFilename.c_str();
+  }
+  this->IsFrozen = true;
+  // wait for the packet being added by another thread, if any. If the thread adding a
+  // packet is the one which is interrupted by the signal, the ring between Begin and End
+  // is still consistent, the packet being added is after End.
+  for (int i = 0; i < (1 << 24) && this->IsAdding; ++i)
+  {
+  }
+
+  const std::uint64_t begin = this->Begin;
+  const std::uint64_t end = this->End;
+#ifdef _WIN32
+  const int file = _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  const int file = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+  bool isWritten = file >= 0 && WriteAll(file, &GlobalHeader, sizeof(GlobalHeader));
+  if (isWritten && end > begin)
+  {
+    // at most two parts, the end of the ring then its beginning
+    const std::size_t size = this->Ring.size();
+    const std::size_t first = static_cast<std::size_t>(begin % size);
+    const std::size_t length = static_cast<std::size_t>(end - begin);
+    const std::size_t firstLength = std::min(length, size - first);
+    isWritten = WriteAll(file, this->Ring.data() + first, firstLength) &&
+      WriteAll(file, this->Ring.data(), length - firstLength);
+  }
+  if (file >= 0)
+  {
+#ifdef _WIN32
+    isWritten = _close(file) == 0 && isWritten;
+#else
+    isWritten = close(file) == 0 && isWritten;
+#endif
+  }
+
+  if (!freeze)
+  {
+    this->IsFrozen = false;
+  }
+  return isWritten;
 }
 
 //-----------------------------------------------------------------------------
-void CrashAnalysisWriter::DeleteLogFiles()
+void CrashAnalysisWriter::CopyToRing(std::uint64_t position, const void* data, std::size_t size)
 {
-  std::remove((this->Filename + "0.bin").c_str());
-  std::remove((this->Filename + "1.bin").c_str());
+  const std::size_t index = static_cast<std::size_t>(position % this->Ring.size());
+  const std::size_t firstSize = std::min(size, this->Ring.size() - index);
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  std::memcpy(this->Ring.data() + index, bytes, firstSize);
+  std::memcpy(this->Ring.data(), bytes + firstSize, size - firstSize);
+}
+
+//-----------------------------------------------------------------------------
+void CrashAnalysisWriter::CopyFromRing(std::uint64_t position, void* data, std::size_t size) const
+{
+  const std::size_t index = static_cast<std::size_t>(position % this->Ring.size());
+  const std::size_t firstSize = std::min(size, this->Ring.size() - index);
+  unsigned char* bytes = static_cast<unsigned char*>(data);
+  std::memcpy(bytes, this->Ring.data() + index, firstSize);
+  std::memcpy(bytes + firstSize, this->Ring.data(), size - firstSize);
 }
 
 //-----------------------------------------------------------------------------
 void CrashAnalysisWriter::ArchivePreviousLogIfExist()
 {
   // check if the file exists
-  std::ifstream file1((this->Filename + "0.bin").c_str());
-  std::ifstream file2((this->Filename + "1.bin").c_str());
+  const std::string crashFilename = this->Filename + "_crash.pcap";
+  std::ifstream file(crashFilename.c_str());
+  if (!file.good())
+  {
+    return;
+  }
+  file.close();
 
   // Get the date and time
   std::time_t rawtime;
@@ -108,25 +374,9 @@ void CrashAnalysisWriter::ArchivePreviousLogIfExist()
   std::strftime(buffer, sizeof(buffer), "%d_%m_%Y_%H_%M_%S", timeinfo);
   std::string timeStr(buffer);
 
-  bool fileHasBeenRenamed = false;
   // The file exists, rename it
-  if (file1.good())
-  {
-    file1.close();
-    std::rename((this->Filename + "0.bin").c_str(), (this->Filename + timeStr + "_0.bin").c_str());
-    fileHasBeenRenamed = true;
-  }
-  if (file2.good())
-  {
-    file2.close();
-    std::rename((this->Filename + "1.bin").c_str(), (this->Filename + timeStr + "_1.bin").c_str());
-    fileHasBeenRenamed = true;
-  }
-
-  if (fileHasBeenRenamed)
-  {
-    vtkGenericWarningMacro("We found log files in folder: " << this->Filename
-                           << " which may be due to " << SOFTWARE_NAME << " previous crash. "
-                           << "The log files have been renamed using timestamp: " << timeStr);
-  }
+  std::rename(crashFilename.c_str(), (this->Filename + "_crash_" + timeStr + ".pcap").c_str());
+  vtkGenericWarningMacro("We found a crash capture in folder: " << this->Filename
+                         << " which may be due to " << SOFTWARE_NAME << " previous crash. "
+                         << "The capture has been renamed using timestamp: " << timeStr);
 }
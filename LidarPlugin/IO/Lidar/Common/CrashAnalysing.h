@@ -19,54 +19,88 @@
 #define CRASH_ANALYSING_H
 
 // LOCAL
-#include "vtkPacketFileWriter.h"
-#include "NetworkPacket.h"
+#include "PacketRing.h"
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 /**
  * \class CrashAnalysisWriter
- * \brief This class is responsible to save as a .pcap file
- *        the last N packets received and remove the older ones.
- *        The idea is to generate a small .pcap to analyze when
- *        the software crashes in streaming mode
+ * \brief This class keeps in memory the last N packets received, or the ones of the
+ *        last seconds, so that they can be saved as a .pcap file to analyze when the
+ *        software crashes in streaming mode.
+ *
+ * The packets are copied as pcap records in a ring allocated once by Start, nothing is
+ * written to the disk while streaming. The ring is saved:
+ *  - in <filename>_crash.pcap by a handler of the fatal signals (SIGSEGV, SIGABRT...),
+ *    which only uses async-signal-safe functions,
+ *  - in <filename>.pcap on demand (SaveCapture) and by Stop if requested.
+ * A crash capture found by the next Start is archived with a timestamp.
 */
 class CrashAnalysisWriter
 {
 public:
-  // Default constructor
-  CrashAnalysisWriter() {this->PacketCount = 0;}
+  CrashAnalysisWriter() = default;
+  ~CrashAnalysisWriter();
+
+  CrashAnalysisWriter(const CrashAnalysisWriter&) = delete;
+  CrashAnalysisWriter& operator=(const CrashAnalysisWriter&) = delete;
 
-  // Setters
+  // Setters, applied by the next Start
   void SetNbrPacketsToStore(unsigned int arg) {this->NbrPacketsToStore = arg;}
+  //! Only keep the packets received in the last seconds, 0 for no limit
+  void SetDurationToStore(double arg) {this->DurationToStore = arg;}
   void SetFilename(const std::string& arg) {this->Filename = arg;}
 
-  // Add a packet to the crash analyzer
-  void AddPacket(const NetworkPacket& packet);
+  //! Allocate the ring and save it if the software crashes
+  void Start();
+
+  //! Stop saving the ring if the software crashes, and save it in <filename>.pcap if asked
+  void Stop(bool saveCapture);
 
-  // Close the pcap writer if it is opened
-  void CloseAnalyzer();
+  // Add a packet to the crash analyzer, the oldest ones are removed
+  void AddPacket(const PacketSlot& packet);
 
-  // Delete the logs files
-  void DeleteLogFiles();
+  //! Save the packets of the ring in <filename>.pcap, the packets received meanwhile are
+  //! not kept
+  bool SaveCapture();
 
-  // If a previous log exists it means that the
+  // If a previous crash capture exists it means that the
   // stream has been quit unproperly and has potentialy
-  // crashed. We will archieve the previous log in this
+  // crashed. We will archieve the previous capture in this
   // case
   void ArchivePreviousLogIfExist();
 
+  //! Save the packets of the ring in a file, only calls async-signal-safe functions
+  //! @param freeze true if no packet must be added afterwards
+  bool WriteCapture(const char* filename, bool freeze);
+
 private:
+  //! Copy bytes to the ring from a position, wrapping at its end
+  void CopyToRing(std::uint64_t position, const void* data, std::size_t size);
+  void CopyFromRing(std::uint64_t position, void* data, std::size_t size) const;
+
   // Export file information
   unsigned int NbrPacketsToStore = 5000;
+  double DurationToStore = 0;
   std::string Filename = "";
+  /*!< Computed by Start, the signal handler can not build strings */
+  std::string CrashFilename;
 
-  // Writer
-  vtkPacketFileWriter Writer;
-
-  // Internal parameters
+  /*!< Pcap records of the stored packets, between Begin and End */
+  std::vector<unsigned char> Ring;
+  /*!< Positions since Start, the index in the ring is the position modulo its size */
+  std::atomic<std::uint64_t> Begin{ 0 };
+  std::atomic<std::uint64_t> End{ 0 };
   unsigned int PacketCount = 0;
-  unsigned int FileToStore = 0;
 
-  void WriteLastPacket(const NetworkPacket& packet);
+  /*!< Set while AddPacket changes the ring, and by WriteCapture to stop it from doing so */
+  std::atomic<bool> IsAdding{ false };
+  std::atomic<bool> IsFrozen{ false };
+  bool IsStarted = false;
 };
 
 #endif // CRASH_ANALYSING_H
@@ -0,0 +1,98 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "FrameCache.h"
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> FrameCache::Get(int frameIndex, vtkMTimeType mtime)
+{
+  this->CheckModificationTime(mtime);
+  auto it = this->Index.find(frameIndex);
+  if (it == this->Index.end())
+  {
+    this->NumberOfMisses++;
+    return nullptr;
+  }
+  this->NumberOfHits++;
+  // move the frame to the front of the list
+  this->Frames.splice(this->Frames.begin(), this->Frames, it->second);
+  return it->second->Frame;
+}
+
+//-----------------------------------------------------------------------------
+void FrameCache::Insert(int frameIndex, vtkMTimeType mtime, vtkPolyData* frame)
+{
+  this->CheckModificationTime(mtime);
+  if (!frame || this->MemoryBudget == 0)
+  {
+    return;
+  }
+
+  auto it = this->Index.find(frameIndex);
+  if (it != this->Index.end())
+  {
+    this->MemorySize -= it->second->MemorySize;
+    this->Frames.erase(it->second);
+    this->Index.erase(it);
+  }
+
+  unsigned long memorySize = frame->GetActualMemorySize();
+  if (memorySize > this->MemoryBudget)
+  {
+    return;
+  }
+  this->Evict(this->MemoryBudget - memorySize);
+
+  this->Frames.push_front({ frameIndex, frame, memorySize });
+  this->Index[frameIndex] = this->Frames.begin();
+  this->MemorySize += memorySize;
+}
+
+//-----------------------------------------------------------------------------
+void FrameCache::Clear()
+{
+  this->Frames.clear();
+  this->Index.clear();
+  this->MemorySize = 0;
+}
+
+//-----------------------------------------------------------------------------
+void FrameCache::SetMemoryBudget(unsigned long budget)
+{
+  this->MemoryBudget = budget;
+  this->Evict(budget);
+}
+
+//-----------------------------------------------------------------------------
+void FrameCache::CheckModificationTime(vtkMTimeType mtime)
+{
+  if (mtime != this->ModificationTime)
+  {
+    this->Clear();
+    this->ModificationTime = mtime;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FrameCache::Evict(unsigned long budget)
+{
+  while (!this->Frames.empty() && this->MemorySize > budget)
+  {
+    const CachedFrame& leastRecentlyUsed = this->Frames.back();
+    this->MemorySize -= leastRecentlyUsed.MemorySize;
+    this->Index.erase(leastRecentlyUsed.FrameIndex);
+    this->Frames.pop_back();
+  }
+}
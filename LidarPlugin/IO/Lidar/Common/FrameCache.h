@@ -0,0 +1,110 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+/**
+ * \class FrameCache
+ * \brief Least recently used cache of decoded frames, bounded by a memory budget.
+ *
+ * The frames are identified by their index in the frame catalog. A frame depends on
+ * the interpreter settings (calibration, cropping, laser selection, ...), so the cache
+ * is also keyed by a modification time: all cached frames are dropped as soon as a
+ * lookup or an insertion is done with a different modification time.
+ *
+ * The cache keeps a reference on the frames, they must not be modified once inserted.
+ */
+class FrameCache
+{
+public:
+  /**
+   * @brief Get return the frame if it is in the cache, nullptr otherwise.
+   * The frame becomes the most recently used one.
+   * @param frameIndex index of the frame in the frame catalog
+   * @param mtime modification time of the settings used to decode the frame
+   */
+  vtkSmartPointer<vtkPolyData> Get(int frameIndex, vtkMTimeType mtime);
+
+  /**
+   * @brief Insert add a frame to the cache, the least recently used frames are
+   * removed until the memory budget is satisfied. A frame bigger than the budget
+   * is not cached.
+   */
+  void Insert(int frameIndex, vtkMTimeType mtime, vtkPolyData* frame);
+
+  /**
+   * @brief Clear remove all frames from the cache, the statistics are kept
+   */
+  void Clear();
+
+  /**
+   * @brief SetMemoryBudget set the maximum memory used by the cached frames in kibibytes,
+   * 0 disables the cache
+   */
+  void SetMemoryBudget(unsigned long budget);
+  unsigned long GetMemoryBudget() const { return this->MemoryBudget; }
+
+  //! Memory used by the cached frames in kibibytes
+  unsigned long GetMemorySize() const { return this->MemorySize; }
+
+  //! Number of frames currently cached
+  std::size_t GetNumberOfFrames() const { return this->Frames.size(); }
+
+  //! Number of Get calls which found the frame in the cache
+  uint64_t GetNumberOfHits() const { return this->NumberOfHits; }
+
+  //! Number of Get calls which did not find the frame in the cache
+  uint64_t GetNumberOfMisses() const { return this->NumberOfMisses; }
+
+  void ResetStatistics() { this->NumberOfHits = this->NumberOfMisses = 0; }
+
+private:
+  struct CachedFrame
+  {
+    int FrameIndex;
+    vtkSmartPointer<vtkPolyData> Frame;
+    unsigned long MemorySize;
+  };
+
+  //! Drop all frames if they were decoded with other settings
+  void CheckModificationTime(vtkMTimeType mtime);
+
+  //! Remove the least recently used frames until the memory used is below the budget
+  void Evict(unsigned long budget);
+
+  //! Cached frames, the most recently used first
+  std::list<CachedFrame> Frames;
+
+  //! Position of each cached frame in the list
+  std::unordered_map<int, std::list<CachedFrame>::iterator> Index;
+
+  //! Modification time of the settings used to decode the cached frames
+  vtkMTimeType ModificationTime = 0;
+
+  unsigned long MemoryBudget = 0;
+  unsigned long MemorySize = 0;
+  uint64_t NumberOfHits = 0;
+  uint64_t NumberOfMisses = 0;
+};
+
+#endif // FRAMECACHE_H
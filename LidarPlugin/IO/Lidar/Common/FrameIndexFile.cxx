@@ -0,0 +1,274 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "FrameIndexFile.h"
+
+// STD
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// BOOST
+#include <boost/filesystem.hpp>
+
+namespace
+{
+//! Magic number at the beginning of each sidecar file
+const char MagicNumber[8] = { 'L', 'V', 'F', 'R', 'M', 'I', 'D', 'X' };
+
+//! Number of bytes hashed at the beginning and at the end of the pcap.
+//! Hashing the whole file would cost as much as rebuilding the catalog,
+//! size + mtime + head/tail hash is enough to detect a pcap that has changed.
+const std::streamoff HashedBlockSize = 1 << 20;
+
+//-----------------------------------------------------------------------------
+// 64 bits FNV-1a hash
+uint64_t HashBytes(const char* data, std::size_t size, uint64_t hash)
+{
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//-----------------------------------------------------------------------------
+bool HashFileHeadAndTail(const std::string& filename, uint64_t fileSize, uint64_t& hash)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+  hash = 14695981039346656037ULL;
+  std::vector<char> buffer(HashedBlockSize);
+
+  std::streamoff headSize = std::min<std::streamoff>(HashedBlockSize, fileSize);
+  file.read(buffer.data(), headSize);
+  hash = HashBytes(buffer.data(), static_cast<std::size_t>(file.gcount()), hash);
+
+  std::streamoff tailStart = std::max<std::streamoff>(headSize, fileSize - HashedBlockSize);
+  if (tailStart < static_cast<std::streamoff>(fileSize))
+  {
+    file.seekg(tailStart);
+    file.read(buffer.data(), fileSize - tailStart);
+    hash = HashBytes(buffer.data(), static_cast<std::size_t>(file.gcount()), hash);
+  }
+  return !file.bad();
+}
+
+//-----------------------------------------------------------------------------
+template <typename T>
+void WriteValue(std::ostream& os, const T& value)
+{
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//-----------------------------------------------------------------------------
+template <typename T>
+bool ReadValue(std::istream& is, T& value)
+{
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return static_cast<bool>(is);
+}
+
+//-----------------------------------------------------------------------------
+void WriteString(std::ostream& os, const std::string& value)
+{
+  WriteValue(os, static_cast<uint32_t>(value.size()));
+  os.write(value.data(), value.size());
+}
+
+//-----------------------------------------------------------------------------
+bool ReadString(std::istream& is, std::string& value)
+{
+  uint32_t size = 0;
+  if (!ReadValue(is, size) || size > (1 << 16))
+  {
+    return false;
+  }
+  value.resize(size);
+  is.read(&value[0], size);
+  return static_cast<bool>(is);
+}
+}
+
+//-----------------------------------------------------------------------------
+const uint32_t FrameIndexFile::Version = 4;
+const char* FrameIndexFile::Extension = ".frameindex";
+
+//-----------------------------------------------------------------------------
+FrameIndexFile::FrameIndexFile(const std::string& pcapFileName, int lidarPort,
+                               const std::string& interpreterParameters)
+  : PcapFileName(pcapFileName)
+  , LidarPort(lidarPort)
+  , InterpreterParameters(interpreterParameters)
+{
+  boost::system::error_code ec;
+  this->FileSize = boost::filesystem::file_size(pcapFileName, ec);
+  if (ec)
+  {
+    return;
+  }
+  this->ModificationTime = static_cast<int64_t>(boost::filesystem::last_write_time(pcapFileName, ec));
+  if (ec)
+  {
+    return;
+  }
+  this->KeyValid = HashFileHeadAndTail(pcapFileName, this->FileSize, this->ContentHash);
+}
+
+//-----------------------------------------------------------------------------
+std::string FrameIndexFile::GetIndexFileName() const
+{
+  return this->PcapFileName + FrameIndexFile::Extension;
+}
+
+//-----------------------------------------------------------------------------
+bool FrameIndexFile::Load(const FrameInformation& prototype,
+                          std::vector<FrameInformation>& catalog) const
+{
+  if (!this->KeyValid)
+  {
+    return false;
+  }
+  std::ifstream file(this->GetIndexFileName(), std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  // header
+  char magic[sizeof(MagicNumber)];
+  file.read(magic, sizeof(magic));
+  if (!file || std::memcmp(magic, MagicNumber, sizeof(MagicNumber)) != 0)
+  {
+    return false;
+  }
+  uint32_t version = 0;
+  if (!ReadValue(file, version) || version != FrameIndexFile::Version)
+  {
+    return false;
+  }
+
+  // key
+  uint64_t fileSize = 0, contentHash = 0;
+  int64_t modificationTime = 0;
+  int32_t lidarPort = 0;
+  std::string interpreterParameters;
+  if (!ReadValue(file, fileSize) || fileSize != this->FileSize ||
+      !ReadValue(file, modificationTime) || modificationTime != this->ModificationTime ||
+      !ReadValue(file, contentHash) || contentHash != this->ContentHash ||
+      !ReadValue(file, lidarPort) || lidarPort != this->LidarPort ||
+      !ReadString(file, interpreterParameters) ||
+      interpreterParameters != this->InterpreterParameters)
+  {
+    return false;
+  }
+
+  // frames
+  uint64_t numberOfFrames = 0;
+  if (!ReadValue(file, numberOfFrames) || numberOfFrames > this->FileSize)
+  {
+    return false;
+  }
+  std::vector<FrameInformation> loadedCatalog;
+  loadedCatalog.reserve(static_cast<std::size_t>(numberOfFrames));
+  for (uint64_t i = 0; i < numberOfFrames; ++i)
+  {
+    FrameInformation frame(prototype);
+    uint8_t hasSpecificInformation = 0;
+    if (!ReadValue(file, frame.FilePosition) ||
+        !ReadValue(file, frame.FirstPacketNetworkTime) ||
+        !ReadValue(file, frame.FirstPacketDataTime) ||
+        !ReadValue(file, frame.FirstPacketDataTimeNs) ||
+        !ReadValue(file, hasSpecificInformation))
+    {
+      return false;
+    }
+    if (hasSpecificInformation)
+    {
+      if (!frame.SpecificInformation || !frame.SpecificInformation->read(file))
+      {
+        return false;
+      }
+    }
+    loadedCatalog.push_back(frame);
+  }
+
+  catalog.swap(loadedCatalog);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool FrameIndexFile::Save(const std::vector<FrameInformation>& catalog) const
+{
+  if (!this->KeyValid)
+  {
+    return false;
+  }
+  const std::string indexFileName = this->GetIndexFileName();
+  // the readers of the same pcap, in this process or others, each write their own file
+  const std::string temporaryFileName =
+    indexFileName + boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp").string();
+  {
+    std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+      // the pcap directory may be read only, this is not an error
+      return false;
+    }
+
+    file.write(MagicNumber, sizeof(MagicNumber));
+    WriteValue(file, FrameIndexFile::Version);
+
+    WriteValue(file, this->FileSize);
+    WriteValue(file, this->ModificationTime);
+    WriteValue(file, this->ContentHash);
+    WriteValue(file, this->LidarPort);
+    WriteString(file, this->InterpreterParameters);
+
+    WriteValue(file, static_cast<uint64_t>(catalog.size()));
+    for (const FrameInformation& frame : catalog)
+    {
+      WriteValue(file, frame.FilePosition);
+      WriteValue(file, frame.FirstPacketNetworkTime);
+      WriteValue(file, frame.FirstPacketDataTime);
+      WriteValue(file, frame.FirstPacketDataTimeNs);
+      WriteValue(file, static_cast<uint8_t>(frame.SpecificInformation != nullptr));
+      if (frame.SpecificInformation)
+      {
+        frame.SpecificInformation->write(file);
+      }
+    }
+    if (!file)
+    {
+      file.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove(temporaryFileName, ec);
+      return false;
+    }
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(temporaryFileName, indexFileName, ec);
+  if (ec)
+  {
+    boost::filesystem::remove(temporaryFileName, ec);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAMEINDEXFILE_H
+#define FRAMEINDEXFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FrameInformation.h"
+
+/**
+ * \class FrameIndexFile
+ * \brief Persistent frame catalog stored next to a pcap file.
+ *
+ * Building the frame catalog of a big pcap requires to read the whole file,
+ * which can take minutes. The catalog is therefore saved in a small binary
+ * "sidecar" file (<pcap>.frameindex) so that it can be reloaded instantly the
+ * next time the same pcap is opened with the same settings.
+ *
+ * The sidecar is identified by a key made of:
+ * - the size and the last modification time of the pcap
+ * - a hash of the first and last bytes of the pcap
+ * - the lidar port used to filter the packets
+ * - the interpreter parameters which have an influence on the catalog
+ *   (see vtkLidarPacketInterpreter::GetFrameCatalogParameters)
+ * If any of these does not match, the sidecar is considered stale and Load fails,
+ * so that the caller rebuilds the catalog and saves it again.
+ */
+class FrameIndexFile
+{
+public:
+  //! Version of the binary layout, to increase each time the layout changes
+  static const uint32_t Version;
+
+  //! Extension appended to the pcap file name to get the sidecar file name
+  static const char* Extension;
+
+  FrameIndexFile(const std::string& pcapFileName, int lidarPort,
+                 const std::string& interpreterParameters);
+
+  /**
+   * @brief IsKeyValid return false if the key of the pcap file could not be computed
+   * (file missing, not readable, ...), in which case no sidecar can be loaded or saved.
+   */
+  bool IsKeyValid() const { return this->KeyValid; }
+
+  /**
+   * @brief GetIndexFileName return the sidecar file name
+   */
+  std::string GetIndexFileName() const;
+
+  /**
+   * @brief Load read the frame catalog from the sidecar file.
+   * @param prototype frame information whose SpecificInformation is used to
+   *        instantiate the sensor specific part of each loaded frame
+   * @param catalog[out] loaded frame catalog, left untouched on failure
+   * @return false if the sidecar is missing, corrupted or stale
+   */
+  bool Load(const FrameInformation& prototype, std::vector<FrameInformation>& catalog) const;
+
+  /**
+   * @brief Save write the frame catalog to the sidecar file.
+   * The file is written under a temporary name then renamed, so that a reader
+   * never sees a partially written sidecar.
+   * @return false if the file could not be written (read only directory, ...)
+   */
+  bool Save(const std::vector<FrameInformation>& catalog) const;
+
+private:
+  //! Name of the pcap file indexed
+  std::string PcapFileName;
+
+  //! Key identifying the pcap and the settings used to build the catalog
+  bool KeyValid = false;
+  uint64_t FileSize = 0;
+  int64_t ModificationTime = 0;
+  uint64_t ContentHash = 0;
+  int32_t LidarPort = -1;
+  std::string InterpreterParameters;
+};
+
+#endif // FRAMEINDEXFILE_H
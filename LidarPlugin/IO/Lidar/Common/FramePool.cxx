@@ -0,0 +1,111 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "FramePool.h"
+
+// STD
+#include <algorithm>
+
+// VTK
+#include <vtkCellArray.h>
+#include <vtkFieldData.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+bool AreArraysReleased(vtkFieldData* fieldData)
+{
+  if (fieldData->GetReferenceCount() > 1)
+  {
+    return false;
+  }
+  for (int i = 0; i < fieldData->GetNumberOfArrays(); ++i)
+  {
+    vtkAbstractArray* array = fieldData->GetAbstractArray(i);
+    if (array && array->GetReferenceCount() > 1)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> FramePool::Acquire()
+{
+  for (auto it = this->Frames.begin(); it != this->Frames.end(); ++it)
+  {
+    if (FramePool::IsReleased(*it))
+    {
+      // the frame becomes the most recently used one
+      std::rotate(it, it + 1, this->Frames.end());
+      return this->Frames.back();
+    }
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void FramePool::Add(vtkPolyData* frame)
+{
+  if (!frame || this->MaximumNumberOfFrames == 0)
+  {
+    return;
+  }
+  if (this->Frames.size() >= this->MaximumNumberOfFrames)
+  {
+    this->Frames.erase(this->Frames.begin());
+  }
+  this->Frames.push_back(frame);
+}
+
+//-----------------------------------------------------------------------------
+void FramePool::SetMaximumNumberOfFrames(std::size_t maximum)
+{
+  this->MaximumNumberOfFrames = maximum;
+  if (this->Frames.size() > maximum)
+  {
+    this->Frames.erase(this->Frames.begin(), this->Frames.end() - maximum);
+  }
+  this->Frames.reserve(maximum);
+}
+
+//-----------------------------------------------------------------------------
+bool FramePool::IsReleased(vtkPolyData* frame)
+{
+  // the pool holds one reference on the frame, and the frame one on each of its data
+  if (frame->GetReferenceCount() > 1)
+  {
+    return false;
+  }
+  vtkPoints* points = frame->GetPoints();
+  if (points && (points->GetReferenceCount() > 1 || points->GetData()->GetReferenceCount() > 1))
+  {
+    return false;
+  }
+  // GetVerts returns a shared dummy cell array when the frame has no vertex
+  if (frame->GetNumberOfVerts() > 0)
+  {
+    vtkCellArray* verts = frame->GetVerts();
+    if (verts->GetReferenceCount() > 1 || verts->GetData()->GetReferenceCount() > 1)
+    {
+      return false;
+    }
+  }
+  return AreArraysReleased(frame->GetPointData()) && AreArraysReleased(frame->GetFieldData());
+}
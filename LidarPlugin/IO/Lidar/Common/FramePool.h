@@ -0,0 +1,73 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+/**
+ * \class FramePool
+ * \brief Keep track of the last frames created by an interpreter, so that their memory
+ * can be reused for a new frame once all their consumers have released them.
+ *
+ * A frame is released when nothing but the pool references it, nor its points, cells
+ * and arrays (a shallow copy of a frame shares its arrays). Frames kept by a consumer
+ * (FrameCache, FramePrefetcher, the output of a reader, ...) are never recycled.
+ *
+ * The pool is not thread safe, it must be used by the thread building the frames. The
+ * consumers can release the frames from any thread.
+ */
+class FramePool
+{
+public:
+  /**
+   * @brief Acquire return a frame released by its consumers, or nullptr if there is
+   * none. The frame keeps its arrays, which must be reinitialized by the caller.
+   */
+  vtkSmartPointer<vtkPolyData> Acquire();
+
+  /**
+   * @brief Add keep track of a new frame, so that it can be acquired once released.
+   * When the pool is full, the oldest frame is forgotten (but not deleted).
+   */
+  void Add(vtkPolyData* frame);
+
+  //! Forget all frames
+  void Clear() { this->Frames.clear(); }
+
+  /**
+   * @brief SetMaximumNumberOfFrames set the number of frames tracked by the pool,
+   * 0 disables the pool
+   */
+  void SetMaximumNumberOfFrames(std::size_t maximum);
+  std::size_t GetMaximumNumberOfFrames() const { return this->MaximumNumberOfFrames; }
+
+  //! Number of frames currently tracked by the pool, released or not
+  std::size_t GetNumberOfFrames() const { return this->Frames.size(); }
+
+  //! Return true if the frame and its data are not referenced by anything but the pool
+  static bool IsReleased(vtkPolyData* frame);
+
+private:
+  //! Tracked frames, the most recently created or acquired last
+  std::vector<vtkSmartPointer<vtkPolyData> > Frames;
+
+  std::size_t MaximumNumberOfFrames = 0;
+};
+
+#endif // FRAMEPOOL_H
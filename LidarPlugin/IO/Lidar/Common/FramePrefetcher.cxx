@@ -0,0 +1,153 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "FramePrefetcher.h"
+#include "vtkLidarPacketInterpreter.h"
+#include "vtkLidarReader.h"
+
+// STD
+#include <iterator>
+
+//-----------------------------------------------------------------------------
+FramePrefetcher::FramePrefetcher(const std::string& fileName, const std::string& filter,
+                                 vtkSmartPointer<vtkLidarPacketInterpreter> interpreter,
+                                 const std::vector<FrameInformation>& frameCatalog,
+                                 int queueSize)
+  : Interpreter(interpreter)
+  , FrameCatalog(frameCatalog)
+  , QueueSize(queueSize)
+{
+  if (!this->Reader.Open(fileName, filter))
+  {
+    return;
+  }
+  this->Thread = boost::shared_ptr<boost::thread>(
+    new boost::thread(boost::bind(&FramePrefetcher::ThreadLoop, this)));
+}
+
+//-----------------------------------------------------------------------------
+FramePrefetcher::~FramePrefetcher()
+{
+  if (this->Thread)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(this->Mutex);
+      this->ShouldStop = true;
+    }
+    this->Condition.notify_one();
+    this->Thread->join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> FramePrefetcher::Take(int frameIndex)
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  auto it = this->Frames.find(frameIndex);
+  if (it == this->Frames.end())
+  {
+    return nullptr;
+  }
+  vtkSmartPointer<vtkPolyData> frame = it->second;
+  this->Frames.erase(it);
+  return frame;
+}
+
+//-----------------------------------------------------------------------------
+void FramePrefetcher::SetPlaybackPosition(int frameIndex, int step)
+{
+  {
+    boost::lock_guard<boost::mutex> lock(this->Mutex);
+    this->Position = frameIndex;
+    if (step != 0)
+    {
+      this->Step = step;
+    }
+
+    // drop the frames which will not be requested
+    for (auto it = this->Frames.begin(); it != this->Frames.end();)
+    {
+      it = this->IsInWindow(it->first) ? std::next(it) : this->Frames.erase(it);
+    }
+  }
+  this->Condition.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+void FramePrefetcher::ThreadLoop()
+{
+  boost::unique_lock<boost::mutex> lock(this->Mutex);
+  while (!this->ShouldStop)
+  {
+    int frameIndex = this->GetNextFrameToDecode();
+    if (frameIndex < 0)
+    {
+      this->Condition.wait(lock);
+      continue;
+    }
+
+    // decode the frame without holding the mutex, so that the frames already
+    // decoded can be taken in the meantime
+    lock.unlock();
+    const bool isNextFrame = this->LastDecodedFrame >= 0 && frameIndex == this->LastDecodedFrame + 1;
+    vtkSmartPointer<vtkPolyData> frame = isNextFrame
+      ? vtkLidarReader::ReadNextFrame(&this->Reader, this->Interpreter)
+      : vtkLidarReader::ReadFrame(&this->Reader, this->Interpreter, this->FrameCatalog[frameIndex]);
+    this->LastDecodedFrame = frame ? frameIndex : -1;
+    lock.lock();
+
+    // the playback position may have changed during the decoding
+    if (frame && this->IsInWindow(frameIndex))
+    {
+      this->Frames[frameIndex] = frame;
+    }
+    else if (!frame)
+    {
+      // the frame could not be decoded, do not try again and again
+      this->Condition.wait(lock);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+int FramePrefetcher::GetNextFrameToDecode() const
+{
+  if (this->Position < 0)
+  {
+    return -1;
+  }
+  const int numberOfFrames = static_cast<int>(this->FrameCatalog.size());
+  for (int i = 1; i <= this->QueueSize; ++i)
+  {
+    int frameIndex = this->Position + i * this->Step;
+    if (frameIndex < 0 || frameIndex >= numberOfFrames)
+    {
+      return -1;
+    }
+    if (this->Frames.find(frameIndex) == this->Frames.end())
+    {
+      return frameIndex;
+    }
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+bool FramePrefetcher::IsInWindow(int frameIndex) const
+{
+  const int offset = frameIndex - this->Position;
+  return offset % this->Step == 0 && offset / this->Step >= 1 &&
+    offset / this->Step <= this->QueueSize;
+}
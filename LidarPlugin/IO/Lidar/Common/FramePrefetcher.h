@@ -0,0 +1,118 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAMEPREFETCHER_H
+#define FRAMEPREFETCHER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include "FrameInformation.h"
+#include "vtkPacketFileMappedReader.h"
+
+class vtkLidarPacketInterpreter;
+
+/**
+ * \class FramePrefetcher
+ * \brief Decode in a background thread the frames which are going to be requested
+ * during the playback of a pcap file.
+ *
+ * The thread has its own pcap reader and its own copy of the interpreter (see
+ * vtkLidarPacketInterpreter::Clone). Each time a frame is requested, the playback
+ * position and the playback step (1 when playing forward, -1 backward, 2 when
+ * skipping one frame out of two, ...) are given to the prefetcher, which then
+ * decodes the next QueueSize frames: position + step, position + 2 * step, ...
+ * Decoded frames which do not belong to this window anymore are dropped.
+ *
+ * The interpreter copy is not updated, the prefetcher must be recreated when the
+ * interpreter settings change: vtkLidarReader recreates it when its MTime, which
+ * includes the one of the interpreter, changes.
+ */
+class FramePrefetcher
+{
+public:
+  /**
+   * @brief FramePrefetcher open the pcap file and start the decoding thread
+   * @param fileName pcap file to read
+   * @param filter libpcap filter used to read the file, see vtkPacketFileReader::Open
+   * @param interpreter interpreter used by the thread, it must not be used elsewhere
+   * @param frameCatalog frame catalog of the pcap file
+   * @param queueSize maximum number of frames decoded in advance
+   */
+  FramePrefetcher(const std::string& fileName, const std::string& filter,
+                  vtkSmartPointer<vtkLidarPacketInterpreter> interpreter,
+                  const std::vector<FrameInformation>& frameCatalog, int queueSize);
+
+  //! Stop the decoding thread
+  ~FramePrefetcher();
+
+  //! Return false if the pcap file could not be opened, no frame is decoded then
+  bool IsRunning() const { return static_cast<bool>(this->Thread); }
+
+  /**
+   * @brief Take return the frame if it has already been decoded and remove it from
+   * the prefetcher, nullptr otherwise
+   */
+  vtkSmartPointer<vtkPolyData> Take(int frameIndex);
+
+  /**
+   * @brief SetPlaybackPosition indicate the last frame requested and the step between
+   * two consecutive requests, the following frames are decoded in advance
+   */
+  void SetPlaybackPosition(int frameIndex, int step);
+
+private:
+  void ThreadLoop();
+
+  //! Return the next frame of the window which is not decoded, -1 if there is none.
+  //! The mutex must be locked.
+  int GetNextFrameToDecode() const;
+
+  //! Return true if the frame is in the window of the frames to decode.
+  //! The mutex must be locked.
+  bool IsInWindow(int frameIndex) const;
+
+  vtkPacketFileMappedReader Reader;
+  vtkSmartPointer<vtkLidarPacketInterpreter> Interpreter;
+  const std::vector<FrameInformation> FrameCatalog;
+  const int QueueSize;
+
+  //! Last frame decoded by the thread, the following one is decoded without seeking.
+  //! Only used by the thread.
+  int LastDecodedFrame = -1;
+
+  //! Protect all members below
+  boost::mutex Mutex;
+  boost::condition_variable Condition;
+
+  //! Decoded frames, by frame index
+  std::map<int, vtkSmartPointer<vtkPolyData> > Frames;
+
+  //! Last frame requested and step between two requests
+  int Position = -1;
+  int Step = 1;
+
+  bool ShouldStop = false;
+
+  boost::shared_ptr<boost::thread> Thread;
+};
+
+#endif // FRAMEPREFETCHER_H
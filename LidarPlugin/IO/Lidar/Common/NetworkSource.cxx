@@ -22,62 +22,261 @@
 #include "PacketFileWriter.h"
 #include "PacketConsumer.h"
 
+// STD
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include <vtkSetGet.h>
+
 #define LIDAR_PACKET_TO_STORE_CRASH_ANALYSIS 5000
 #define GPS_PACKET_TO_STORE_CRASH_ANALYSIS 5000
 
+namespace
+{
+//-----------------------------------------------------------------------------
+std::uint32_t ParseSourceIp(const std::string& ipAddress)
+{
+  if (ipAddress.empty())
+  {
+    return 0;
+  }
+  boost::system::error_code errCode;
+  boost::asio::ip::address_v4 address = boost::asio::ip::address_v4::from_string(ipAddress, errCode);
+  if (errCode)
+  {
+    vtkGenericWarningMacro("Source ip address " << ipAddress << " not valid, packets from any source are accepted");
+    return 0;
+  }
+  // same byte order as in the packets
+  boost::asio::ip::address_v4::bytes_type bytes = address.to_bytes();
+  std::uint32_t sourceIp;
+  std::memcpy(&sourceIp, bytes.data(), sizeof(sourceIp));
+  return sourceIp;
+}
+}
+
 //-----------------------------------------------------------------------------
 NetworkSource::~NetworkSource()
 {
+  // joins the receive threads
   this->Stop();
 
   delete this->DummyWork;
+}
 
-  if (this->Thread)
+//-----------------------------------------------------------------------------
+void NetworkSource::RunIOService(size_t threadIndex, const ThreadSettings& settings)
+{
+  const ThreadSettings effectiveSettings = ApplyThreadSettings(settings, "receive");
   {
-    this->Thread->join();
+    boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+    this->EffectiveReceiveThreadSettings[threadIndex] = effectiveSettings;
   }
+  this->IOService.run();
 }
 
 //-----------------------------------------------------------------------------
-void NetworkSource::QueuePackets(NetworkPacket* packet)
+std::vector<ThreadSettings> NetworkSource::GetEffectiveReceiveThreadSettings()
 {
-  NetworkPacket* packet2 = nullptr;
+  boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+  return this->EffectiveReceiveThreadSettings;
+}
+
+//-----------------------------------------------------------------------------
+void NetworkSource::QueuePackets(const PacketSlot& packet, int port)
+{
+  std::uint32_t sourceIp;
+  std::memcpy(&sourceIp, packet.GetPacketData() + NetworkPacket::EthIPUDPHeader_SOURCEIP4, sizeof(sourceIp));
+  for (const Route& route : this->Routes)
+  {
+    if (route.Port == port && (route.SourceIp == 0 || route.SourceIp == sourceIp))
+    {
+      route.Consumer->Enqueue(packet);
+    }
+  }
+
   if (this->Writer)
   {
-    packet2 = new NetworkPacket(*packet);
+    this->Writer->Enqueue(packet);
   }
 
+  this->Forwarder->Enqueue(packet);
+}
+
+//-----------------------------------------------------------------------------
+void NetworkSource::AddSensor(int port, std::shared_ptr<PacketConsumer> consumer,
+                              const std::string& sourceIpAddress)
+{
+  this->Sensors.push_back(Sensor{ port, sourceIpAddress, consumer });
+}
+
+//-----------------------------------------------------------------------------
+void NetworkSource::CreateReceivers()
+{
+  this->Routes.clear();
   if (this->Consumer)
   {
-    this->Consumer->Enqueue(packet);
+    this->Routes.push_back(Route{ this->LidarPort, ParseSourceIp(this->SourceIpAddress), this->Consumer });
+  }
+  for (const Sensor& sensor : this->Sensors)
+  {
+    this->Routes.push_back(Route{ sensor.Port, ParseSourceIp(sensor.SourceIpAddress), sensor.Consumer });
   }
 
-  if (this->Writer)
+  // one receiver per port, the lidar one first
+  std::vector<int> ports(1, this->LidarPort);
+  for (const Sensor& sensor : this->Sensors)
+  {
+    if (std::find(ports.begin(), ports.end(), sensor.Port) == ports.end())
+    {
+      ports.push_back(sensor.Port);
+    }
+  }
+  for (int port : ports)
+  {
+    this->LidarPortReceivers.push_back(boost::shared_ptr<PacketReceiver>(new PacketReceiver(
+      this->IOService, port, this)));
+  }
+
+  if (this->ListenGPS)
+  {
+    // the position packets go to the lidar consumer, as with a single receiver
+    if (this->Consumer)
+    {
+      this->Routes.push_back(Route{ this->GPSPort, 0, this->Consumer });
+    }
+    this->PositionPortReceiver = boost::shared_ptr<PacketReceiver>(new PacketReceiver(
+      this->IOService, GPSPort, this));
+  }
+  this->SetForwardingDestinations(ports);
+
+  // The packet rings of the consumers, of the writer and of the forwarder accept a single producer. With
+  // several receive threads, the receivers which feed the same ring share a strand so
+  // that their handlers never run concurrently.
+  if (this->NumberOfReceiveThreads <= 1)
+  {
+    return;
+  }
+  std::vector<boost::shared_ptr<PacketReceiver> > receivers = this->LidarPortReceivers;
+  std::vector<int> receiverPorts = ports;
+  if (this->PositionPortReceiver)
+  {
+    receivers.push_back(this->PositionPortReceiver);
+    receiverPorts.push_back(this->GPSPort);
+  }
+  std::vector<std::set<PacketConsumer*> > destinations(receivers.size());
+  for (size_t i = 0; i < receivers.size(); ++i)
+  {
+    for (const Route& route : this->Routes)
+    {
+      if (route.Port == receiverPorts[i])
+      {
+        destinations[i].insert(route.Consumer.get());
+      }
+    }
+  }
+  std::vector<size_t> groups(receivers.size());
+  for (size_t i = 0; i < receivers.size(); ++i)
+  {
+    groups[i] = i;
+    for (size_t j = 0; j < i; ++j)
+    {
+      bool isSharingDestination = static_cast<bool>(this->Writer) || this->Forwarder->HasDestinations();
+      for (PacketConsumer* consumer : destinations[i])
+      {
+        isSharingDestination |= destinations[j].count(consumer) != 0;
+      }
+      if (isSharingDestination)
+      {
+        const size_t mergedGroup = groups[i];
+        const size_t group = groups[j];
+        std::replace(groups.begin(), groups.end(), mergedGroup, group);
+      }
+    }
+  }
+  std::map<size_t, boost::shared_ptr<boost::asio::io_service::strand> > strands;
+  for (size_t i = 0; i < receivers.size(); ++i)
+  {
+    boost::shared_ptr<boost::asio::io_service::strand>& strand = strands[groups[i]];
+    if (!strand)
+    {
+      strand.reset(new boost::asio::io_service::strand(this->IOService));
+    }
+    receivers[i]->SetStrand(strand);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void NetworkSource::SetForwardingDestinations(const std::vector<int>& lidarPorts)
+{
+  this->Forwarder->RemoveAllDestinations();
+  if (!this->IsForwarding)
+  {
+    return;
+  }
+
+  std::istringstream addresses(this->ForwardedIpAddress);
+  std::string address;
+  while (std::getline(addresses, address, ','))
   {
-    this->Writer->Enqueue(packet2);
+    address.erase(0, address.find_first_not_of(' '));
+    address.erase(address.find_last_not_of(' ') + 1);
+    bool isValid = true;
+    for (int port : lidarPorts)
+    {
+      isValid &= this->Forwarder->AddDestination(port, address, this->ForwardedLidarPort);
+    }
+    if (this->ListenGPS)
+    {
+      isValid &= this->Forwarder->AddDestination(this->GPSPort, address, this->ForwardedGPSPort);
+    }
+    if (!isValid)
+    {
+      vtkGenericWarningMacro("Forward ip address " << address << " not valid, packets won't be forwarded to it");
+    }
   }
 }
 
 //-----------------------------------------------------------------------------
 void NetworkSource::Start()
 {
-  if (!this->Thread)
+  const int numberOfThreads = std::max(this->NumberOfReceiveThreads, 1);
+  {
+    boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+    this->EffectiveReceiveThreadSettings.assign(numberOfThreads, ThreadSettings());
+  }
+  for (int i = static_cast<int>(this->Threads.size()); i < numberOfThreads; ++i)
+  {
+    ThreadSettings settings = this->ReceiveThreadSettings;
+    if (i < static_cast<int>(this->ReceiveThreadCPUs.size()) && this->ReceiveThreadCPUs[i] >= 0)
+    {
+      settings.CPUs.assign(1, this->ReceiveThreadCPUs[i]);
+    }
+    this->Threads.push_back(boost::shared_ptr<boost::thread>(
+      new boost::thread(boost::bind(&NetworkSource::RunIOService, this, i, settings))));
+  }
+  if (this->Threads.size() == 1)
   {
     std::cout << "Start listen" << std::endl;
-    this->Thread.reset(
-      new boost::thread(boost::bind(&boost::asio::io_service::run, &this->IOService)));
   }
 
   // Create work
-  this->LidarPortReceiver = boost::shared_ptr<PacketReceiver>(new PacketReceiver(
-    this->IOService, LidarPort, ForwardedLidarPort, ForwardedIpAddress, IsForwarding, this));
+  this->CreateReceivers();
 
+  for (const auto& receiver : this->LidarPortReceivers)
+  {
+    receiver->SetReceiveBufferSize(this->ReceiveBufferSize);
+    receiver->EnableBatchedReceive(this->UseBatchedReceive);
+  }
   if (this->ListenGPS)
   {
-    this->PositionPortReceiver = boost::shared_ptr<PacketReceiver>(new PacketReceiver(
-      this->IOService, GPSPort, ForwardedGPSPort, ForwardedIpAddress, IsForwarding, this));
+    this->PositionPortReceiver->SetReceiveBufferSize(this->ReceiveBufferSize);
+    this->PositionPortReceiver->EnableBatchedReceive(this->UseBatchedReceive);
   }
-
   if (this->IsCrashAnalysing)
   {
     std::string appDir;
@@ -108,29 +307,67 @@ void NetworkSource::Start()
       boost::filesystem::create_directory(appDirPath);
     }
 
-    this->LidarPortReceiver->EnableCrashAnalysing(
-      appDir + "LidarLastData", LIDAR_PACKET_TO_STORE_CRASH_ANALYSIS, this->IsCrashAnalysing);
+    for (size_t i = 0; i < this->LidarPortReceivers.size(); ++i)
+    {
+      // the lidar port keeps the historical file name
+      const std::string suffix = i == 0 ? "" : "_" + std::to_string(this->LidarPortReceivers[i]->GetPort());
+      this->LidarPortReceivers[i]->EnableCrashAnalysing(appDir + "LidarLastData" + suffix,
+        LIDAR_PACKET_TO_STORE_CRASH_ANALYSIS, this->CrashAnalysisDuration, this->SaveCrashAnalysisOnStop);
+    }
     if (this->ListenGPS)
     {
-      this->PositionPortReceiver->EnableCrashAnalysing(
-        appDir + "GPSLastData", GPS_PACKET_TO_STORE_CRASH_ANALYSIS, this->IsCrashAnalysing);
+      this->PositionPortReceiver->EnableCrashAnalysing(appDir + "GPSLastData",
+        GPS_PACKET_TO_STORE_CRASH_ANALYSIS, this->CrashAnalysisDuration, this->SaveCrashAnalysisOnStop);
     }
   }
 
-  this->LidarPortReceiver->StartReceive();
+  this->Forwarder->SetMetrics(this->Metrics);
+  this->Forwarder->Start();
+
+  for (const auto& receiver : this->LidarPortReceivers)
+  {
+    receiver->StartReceive();
+  }
   if (this->ListenGPS)
   {
       this->PositionPortReceiver->StartReceive();
   }
 }
 
+//-----------------------------------------------------------------------------
+int NetworkSource::SaveCrashAnalysis()
+{
+  int numberOfFiles = 0;
+  for (const auto& receiver : this->LidarPortReceivers)
+  {
+    numberOfFiles += receiver->SaveCrashAnalysis() ? 1 : 0;
+  }
+  if (this->PositionPortReceiver)
+  {
+    numberOfFiles += this->PositionPortReceiver->SaveCrashAnalysis() ? 1 : 0;
+  }
+  return numberOfFiles;
+}
+
 //-----------------------------------------------------------------------------
 void NetworkSource::Stop()
 {
   // Kill the receivers
-  this->LidarPortReceiver.reset();
-  if (this->ListenGPS)
+  this->LidarPortReceivers.clear();
+  this->PositionPortReceiver.reset();
+
+  // the threads are created again by Start, with the settings of that time
+  this->IOService.stop();
+  for (const auto& thread : this->Threads)
   {
-    this->PositionPortReceiver.reset();
+    thread->join();
   }
+  this->Threads.clear();
+  this->IOService.reset();
+  // no receive handler uses the routes anymore
+  this->Routes.clear();
+  // no receiver enqueues packets anymore
+  this->Forwarder->Stop();
+  boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+  this->EffectiveReceiveThreadSettings.clear();
 }
@@ -17,24 +17,33 @@
 
 #include <boost/asio.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
-#include "NetworkPacket.h"
+#include "PacketForwarder.h"
+#include "PacketRing.h"
+#include "ThreadSettings.h"
 
+#include <cstdint>
 #include <deque>
 #include <queue>
+#include <vector>
 
 class PacketConsumer;
 class PacketReceiver;
 class PacketFileWriter;
+struct StreamMetrics;
 /**
-* \class PacketReceiver
-* \brief This class is responsible for the IOService and  two PacketReceiver classes
+* \class NetworkSource
+* \brief This class is responsible for the IOService and the PacketReceiver classes.
+* Besides the lidar given to the constructor, other sensors can be received by the same
+* threads (see AddSensor): each received packet is dispatched to the consumers of the
+* sensors whose port and source IP address match.
 * @param _consumer boost::shared_ptr<PacketConsumer>
 * @param argLidarPort The used port to receive the LIDAR information
 * @param ForwardedLidarPort_ The port which will receive the lidar forwarded packets
-* @param ForwardedIpAddress_ The ip which will receive the forwarded packets
-* @param isForwarding_ Allow the forwarding
+* @param ForwardedIpAddress_ The ips which will receive the forwarded packets, separated by commas
+* @param isForwarding_ Allow the forwarding, done by the thread of a PacketForwarder
 */
 class NetworkSource
 {
@@ -48,10 +57,10 @@ public:
     , IsForwarding(isForwarding_)
     , IsCrashAnalysing(isCrashAnalysing_)
     , IOService()
-    , Thread()
-    , LidarPortReceiver()
+    , LidarPortReceivers()
     , Consumer(_consumer)
     , Writer()
+    , Forwarder(std::make_shared<PacketForwarder>())
     , DummyWork(new boost::asio::io_service::work(this->IOService))
   {
       this->ListenGPS = false;
@@ -59,35 +68,111 @@ public:
 
   ~NetworkSource();
 
-  void QueuePackets(NetworkPacket* packet);
+  /**
+   * @brief QueuePackets give a received packet to the consumers of the sensors it comes
+   * from and to the writer, which copy it
+   * @param port port on which the packet was received
+   */
+  void QueuePackets(const PacketSlot& packet, int port);
+
+  /**
+   * @brief AddSensor receive the packets of another sensor, applied at the next Start
+   * @param port port on which the sensor sends its packets, it may be the port of another
+   * sensor if their source IP addresses are different
+   * @param consumer consumer which interprets the packets, it must be started separately
+   * @param sourceIpAddress IPv4 address of the sensor, empty to accept any source
+   */
+  void AddSensor(int port, std::shared_ptr<PacketConsumer> consumer,
+                 const std::string& sourceIpAddress = "");
+
+  //! Remove the sensors added with AddSensor, applied at the next Start: until Stop, the
+  //! receive threads keep giving the packets to their consumers, which must not be stopped
+  void RemoveAllSensors() { this->Sensors.clear(); }
 
   void Start();
 
   void Stop();
 
+  //! True between Start and Stop
+  bool IsRunning() const { return !this->LidarPortReceivers.empty(); }
+
+  /**
+   * @brief SaveCrashAnalysis save the last packets kept by the crash analysis of each
+   * receiver in <name>.pcap, next to the crash captures
+   * @return the number of files saved
+   */
+  int SaveCrashAnalysis();
+
+  //! Scheduling in use by each receive thread, empty when the stream is stopped
+  std::vector<ThreadSettings> GetEffectiveReceiveThreadSettings();
+
   //! @todo currently evrything is public, but it should be private
   int LidarPort;                  /*!< The port to receive LIDAR information. Default is 2368 */
   bool ListenGPS;
   int GPSPort;                    /*!< The port to receive GPS information. Default is 8308 */
   int ForwardedLidarPort;         /*!< The port to send LIDAR forwarded packets*/
   int ForwardedGPSPort;           /*!< The port to send GPS forwarded packets*/
-  std::string ForwardedIpAddress; /*!< The ip to send forwarded packets*/
+  std::string ForwardedIpAddress; /*!< The ips to send forwarded packets, unicast or multicast, separated by commas*/
   bool IsForwarding;              /*!< Allowing the forwarding of the packets*/
-  bool IsCrashAnalysing;
+  bool IsCrashAnalysing;           /*!< Keep the last packets in memory, saved on a crash, see CrashAnalysisWriter*/
+  double CrashAnalysisDuration = 0; /*!< Only keep the packets of the last seconds for the crash analysis, 0 for no limit*/
+  bool SaveCrashAnalysisOnStop = false; /*!< Save the crash analysis packets when the stream stops*/
+  int ReceiveBufferSize = 0;      /*!< Size of the receive buffer of the sockets in bytes, 0 for the system default*/
+  bool UseBatchedReceive = true;  /*!< Receive several packets per system call, Linux only*/
+  std::string SourceIpAddress;    /*!< IPv4 address of the lidar, empty to accept any source*/
+  int NumberOfReceiveThreads = 1; /*!< Threads receiving the packets of all sensors, created by Start*/
+  ThreadSettings ReceiveThreadSettings; /*!< Scheduling of the receive threads, see ApplyThreadSettings*/
+  std::vector<int> ReceiveThreadCPUs; /*!< CPU each receive thread is pinned to instead of the CPUs of ReceiveThreadSettings, -1 or missing for none*/
 
   boost::asio::io_service IOService; /*!< The in/out service which will handle the Packets */
-  boost::shared_ptr<boost::thread> Thread;
+  std::vector<boost::shared_ptr<boost::thread> > Threads; /*!< Threads running IOService */
 
-  boost::shared_ptr<PacketReceiver>
-    LidarPortReceiver; /*!< The PacketReceiver configured to receive LIDAR information */
+  /*!< The PacketReceivers configured to receive LIDAR information, one per port */
+  std::vector<boost::shared_ptr<PacketReceiver> > LidarPortReceivers;
 
   boost::shared_ptr<PacketReceiver>
     PositionPortReceiver; /*!< The PacketReceiver configured to receive GPS information */
 
   std::shared_ptr<PacketConsumer> Consumer;
   std::shared_ptr<PacketFileWriter> Writer;
+  std::shared_ptr<PacketForwarder> Forwarder; /*!< Forwards the packets when IsForwarding, started by Start*/
+  std::shared_ptr<StreamMetrics> Metrics; /*!< Updated by the receivers if set */
 
   boost::asio::io_service::work* DummyWork;
+
+private:
+  struct Sensor
+  {
+    int Port;
+    std::string SourceIpAddress;
+    std::shared_ptr<PacketConsumer> Consumer;
+  };
+
+  //! Where the packets received on a port from a source go, built by Start
+  struct Route
+  {
+    int Port;
+    std::uint32_t SourceIp; /*!< In network order, 0 for any source */
+    std::shared_ptr<PacketConsumer> Consumer;
+  };
+
+  //! Create the receivers of all ports, and the strands which serialize the receivers
+  //! that feed the same consumer, writer or forwarder when there are several receive threads
+  void CreateReceivers();
+
+  //! Give the forwarder the destinations of the packets of each port
+  void SetForwardingDestinations(const std::vector<int>& lidarPorts);
+
+  //! Body of the receive threads
+  void RunIOService(size_t threadIndex, const ThreadSettings& settings);
+
+  std::vector<Sensor> Sensors;
+  /*!< Used by the receive threads between Start and Stop, only changed while they are stopped */
+  std::vector<Route> Routes;
+
+  /*!< Written by each receive thread when it starts, hold EffectiveSettingsMutex */
+  std::vector<ThreadSettings> EffectiveReceiveThreadSettings;
+  boost::mutex EffectiveSettingsMutex;
 };
 
 
@@ -1,51 +1,236 @@
 #include "PacketConsumer.h"
 
-#include "SynchronizedQueue.h"
+#include "PacketRing.h"
+#include "StreamMetrics.h"
+
+#include <algorithm>
+
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkSetGet.h>
 
 //----------------------------------------------------------------------------
 PacketConsumer::PacketConsumer()
+  : FrameSlot(nullptr)
+  , Policy(KEEP_LATEST)
+  , MaximumNumberOfFrames(1)
+  , NumberOfDroppedFrames(0)
+  , Interpreter(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------
+PacketConsumer::~PacketConsumer()
 {
-  this->Packets.reset(new SynchronizedQueue<NetworkPacket*>);
+  this->Stop();
+  this->ClearAllFrames();
 }
 
 //----------------------------------------------------------------------------
-void PacketConsumer::HandleSensorData(const unsigned char *data, unsigned int length)
+void PacketConsumer::HandleSensorData(const unsigned char *data, unsigned int length,
+                                      const struct timeval& receptionTime)
 {
+  if (!this->IsFrameStarted)
+  {
+    this->FrameFirstPacketTime = receptionTime;
+    this->IsFrameStarted = true;
+  }
+
   this->Interpreter->ProcessPacket(data, length);
-  if (this->Interpreter->IsNewFrameReady())
+  if (!this->Interpreter->IsNewFrameReady())
+  {
+    return;
+  }
+
+  // a packet completes several sectors when they are narrower than it, none must be lost
+  const std::vector<vtkSmartPointer<vtkPolyData> > frames =
+    this->Interpreter->GetFramesAvailable();
+  this->Interpreter->ClearAllFramesAvailable();
+
+  for (const vtkSmartPointer<vtkPolyData>& frame : frames)
   {
+    if (this->Metrics)
     {
-      boost::lock_guard<boost::mutex> lock(this->ConsumerMutex);
-      this->Frames.push_back(this->Interpreter->GetLastFrameAvailable());
+      struct timeval now;
+      NetworkPacket::GetTimeOfDay(&now);
+      this->Metrics->AssembledFrames++;
+      this->Metrics->ReceiveToFrameLatency.Add(this->FrameFirstPacketTime, now);
+
+      // packet loss detected by the interpreter, if it does
+      vtkFieldData* fieldData = frame->GetFieldData();
+      if (vtkDataArray* missingPackets = fieldData->GetArray("MissingPackets"))
+      {
+        this->Metrics->MissingPackets += static_cast<std::uint64_t>(missingPackets->GetTuple1(0));
+      }
+      if (vtkDataArray* angularGaps = fieldData->GetArray("AngularGaps"))
+      {
+        this->Metrics->AngularGaps += angularGaps->GetNumberOfTuples();
+      }
     }
-    this->Interpreter->ClearAllFramesAvailable();
+
+    {
+      boost::lock_guard<boost::mutex> lock(this->FrameObserversMutex);
+      for (const auto& observer : this->FrameObservers)
+      {
+        observer.second(frame);
+      }
+    }
+
+    this->DeliverFrame(frame);
+
+    // the packet which completes a frame starts the next one
+    this->FrameFirstPacketTime = receptionTime;
   }
 }
 
 //----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> PacketConsumer::GetLastAvailableFrame()
+void PacketConsumer::DeliverFrame(const vtkSmartPointer<vtkPolyData>& frame)
 {
-  return this->Frames.back();
+  if (this->Policy == OBSERVERS_ONLY)
+  {
+    return;
+  }
+  if (this->Policy == ATOMIC_SLOT)
+  {
+    AssembledFrame* assembledFrame = new AssembledFrame{ frame, this->FrameFirstPacketTime };
+    if (AssembledFrame* replacedFrame = this->FrameSlot.exchange(assembledFrame))
+    {
+      delete replacedFrame;
+      this->DropFrames(1);
+    }
+    return;
+  }
+
+  // the frames are released once the mutex is unlocked, the interpreter can then reuse them
+  std::deque<AssembledFrame> droppedFrames;
+  {
+    boost::lock_guard<boost::mutex> lock(this->FramesMutex);
+    this->Frames.push_back(AssembledFrame{ frame, this->FrameFirstPacketTime });
+    const std::size_t maximumNumberOfFrames =
+      this->Policy == KEEP_LAST_N ? std::max(this->MaximumNumberOfFrames.load(), 1) : 1;
+    while (this->Frames.size() > maximumNumberOfFrames)
+    {
+      droppedFrames.push_back(std::move(this->Frames.front()));
+      this->Frames.pop_front();
+    }
+  }
+  this->DropFrames(droppedFrames.size());
+}
+
+//----------------------------------------------------------------------------
+void PacketConsumer::DropFrames(std::uint64_t numberOfFrames)
+{
+  this->NumberOfDroppedFrames += numberOfFrames;
+  if (this->Metrics)
+  {
+    this->Metrics->DroppedFrames += numberOfFrames;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PacketConsumer::TakeFrame(vtkSmartPointer<vtkPolyData>& frame, struct timeval& firstPacketTime)
+{
+  // a frame may be left in the slot or in the queue if the policy has changed
+  if (std::unique_ptr<AssembledFrame> assembledFrame{ this->FrameSlot.exchange(nullptr) })
+  {
+    frame = assembledFrame->Frame;
+    firstPacketTime = assembledFrame->FirstPacketTime;
+    return true;
+  }
+
+  boost::lock_guard<boost::mutex> lock(this->FramesMutex);
+  if (this->Frames.empty())
+  {
+    return false;
+  }
+  frame = this->Frames.front().Frame;
+  firstPacketTime = this->Frames.front().FirstPacketTime;
+  this->Frames.pop_front();
+  return true;
 }
 
 //----------------------------------------------------------------------------
 int PacketConsumer::CheckForNewData()
 {
-  return this->Frames.size();
+  const int isFrameInSlot = this->FrameSlot.load() ? 1 : 0;
+  boost::lock_guard<boost::mutex> lock(this->FramesMutex);
+  return isFrameInSlot + static_cast<int>(this->Frames.size());
+}
+
+//----------------------------------------------------------------------------
+void PacketConsumer::ClearAllFrames()
+{
+  delete this->FrameSlot.exchange(nullptr);
+  boost::lock_guard<boost::mutex> lock(this->FramesMutex);
+  this->Frames.clear();
+}
+
+//----------------------------------------------------------------------------
+void PacketConsumer::SetDeliveryPolicy(int policy)
+{
+  if (policy < KEEP_LATEST || policy > OBSERVERS_ONLY)
+  {
+    vtkGenericWarningMacro("Unknown frame delivery policy " << policy);
+    return;
+  }
+  this->Policy = policy;
+}
+
+//----------------------------------------------------------------------------
+void PacketConsumer::SetMaximumNumberOfFrames(int numberOfFrames)
+{
+  this->MaximumNumberOfFrames = std::max(numberOfFrames, 1);
+}
+
+//----------------------------------------------------------------------------
+int PacketConsumer::AddFrameObserver(const FrameObserver& observer)
+{
+  boost::lock_guard<boost::mutex> lock(this->FrameObserversMutex);
+  this->FrameObservers.emplace_back(this->NextFrameObserverId, observer);
+  return this->NextFrameObserverId++;
+}
+
+//----------------------------------------------------------------------------
+void PacketConsumer::RemoveFrameObserver(int observerId)
+{
+  boost::lock_guard<boost::mutex> lock(this->FrameObserversMutex);
+  this->FrameObservers.erase(
+    std::remove_if(this->FrameObservers.begin(), this->FrameObservers.end(),
+                   [observerId](const std::pair<int, FrameObserver>& observer)
+                     { return observer.first == observerId; }),
+    this->FrameObservers.end());
 }
 
 //----------------------------------------------------------------------------
 void PacketConsumer::ThreadLoop()
 {
-  NetworkPacket* packet = nullptr;
+  ThreadSettings settings = this->Settings;
+  if (this->CPU >= 0)
+  {
+    settings.CPUs.assign(1, this->CPU);
+  }
+  const ThreadSettings effectiveSettings = ApplyThreadSettings(settings, "packet consumer");
+  {
+    boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+    this->EffectiveSettings = effectiveSettings;
+  }
   this->Interpreter->ResetCurrentFrame();
-  while (this->Packets->dequeue(packet))
+  this->IsFrameStarted = false;
+  // the packets are interpreted in place, their slot is given back to the receiver afterward
+  while (const PacketSlot* packet = this->Packets->GetReadSlot())
   {
-    this->HandleSensorData(packet->GetPayloadData(), packet->GetPayloadSize());
-    delete packet;
+    this->HandleSensorData(packet->GetPayloadData(), packet->GetPayloadSize(), packet->ReceptionTime);
+    this->Packets->Release();
   }
 }
 
+//----------------------------------------------------------------------------
+ThreadSettings PacketConsumer::GetEffectiveThreadSettings()
+{
+  boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+  return this->EffectiveSettings;
+}
+
 //----------------------------------------------------------------------------
 void PacketConsumer::Start()
 {
@@ -54,7 +239,8 @@ void PacketConsumer::Start()
     return;
   }
 
-  this->Packets.reset(new SynchronizedQueue<NetworkPacket*>);
+  this->Packets.reset(new PacketRing);
+  this->NumberOfDroppedFrames = 0;
   this->Thread = boost::shared_ptr<boost::thread>(
         new boost::thread(boost::bind(&PacketConsumer::ThreadLoop, this)));
 }
@@ -64,15 +250,32 @@ void PacketConsumer::Stop()
 {
   if (this->Thread)
   {
-    this->Packets->stopQueue();
+    this->Packets->Stop();
     this->Thread->join();
     this->Thread.reset();
+    if (this->Packets->GetNumberOfDroppedPackets() != 0)
+    {
+      vtkGenericWarningMacro(<< this->Packets->GetNumberOfDroppedPackets()
+                             << " packets were dropped because they could not be interpreted fast enough");
+    }
     this->Packets.reset();
   }
 }
 
 //----------------------------------------------------------------------------
-void PacketConsumer::Enqueue(NetworkPacket* packet)
+void PacketConsumer::Enqueue(const PacketSlot& packet)
 {
-  this->Packets->enqueue(packet);
+  if (this->Packets)
+  {
+    bool isQueued = this->Packets->Push(packet);
+    if (this->Metrics)
+    {
+      if (!isQueued)
+      {
+        this->Metrics->ConsumerDroppedPackets++;
+      }
+      StreamMetrics::UpdateMaximum(this->Metrics->ConsumerQueueHighWaterMark,
+                                   this->Packets->GetNumberOfPackets());
+    }
+  }
 }
@@ -17,49 +17,154 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <atomic>
 #include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "vtkSmartPointer.h"
 #include "vtkLidarPacketInterpreter.h"
-#include "NetworkPacket.h"
+#include "ThreadSettings.h"
 
-
-template<typename T>
-class SynchronizedQueue;
+class PacketRing;
+struct PacketSlot;
+struct StreamMetrics;
 
 class PacketConsumer
 {
 public:
+  //! How the assembled frames wait to be taken by TakeFrame
+  enum DeliveryPolicy
+  {
+    //! Only the latest frame is kept, the older one is dropped as soon as a new one is ready
+    KEEP_LATEST = 0,
+    //! The MaximumNumberOfFrames latest frames are kept and taken in order, the oldest one
+    //! is dropped when a new one is ready
+    KEEP_LAST_N = 1,
+    //! Like KEEP_LATEST, but the frame is handed over through an atomic slot, so that
+    //! neither the consumer thread nor the taker ever wait for each other
+    ATOMIC_SLOT = 2,
+    //! The frames are only given to the frame observers
+    OBSERVERS_ONLY = 3,
+  };
+
+  //! Called by the consumer thread with every assembled frame
+  using FrameObserver = std::function<void(vtkPolyData* frame)>;
+
   PacketConsumer();
+  ~PacketConsumer();
+
+  /**
+   * @brief HandleSensorData interpret a packet
+   * @param receptionTime time at which the packet was received, used to measure the
+   * latency of the frames
+   */
+  void HandleSensorData(const unsigned char* data, unsigned int length,
+                        const struct timeval& receptionTime);
+
+  /**
+   * @brief TakeFrame take the next frame to deliver according to the delivery policy
+   * @param frame[out] the frame, unchanged if there is none
+   * @param firstPacketTime[out] reception time of the first packet of the frame
+   * @return false if no frame is available
+   */
+  bool TakeFrame(vtkSmartPointer<vtkPolyData>& frame, struct timeval& firstPacketTime);
+
+  //! Return the number of frames waiting to be taken
+  int CheckForNewData();
 
-  void HandleSensorData(const unsigned char* data, unsigned int length);
+  //! Drop the frames waiting to be taken, without counting them
+  void ClearAllFrames();
 
-  vtkSmartPointer<vtkPolyData> GetLastAvailableFrame();
+  //! Number of frames dropped by the delivery policy since the last Start
+  std::uint64_t GetNumberOfDroppedFrames() const { return this->NumberOfDroppedFrames; }
 
-  int CheckForNewData();
+  int GetDeliveryPolicy() const { return this->Policy; }
+  void SetDeliveryPolicy(int policy);
 
-  void ClearAllFrames() { this->Frames.clear();}
+  int GetMaximumNumberOfFrames() const { return this->MaximumNumberOfFrames; }
+  void SetMaximumNumberOfFrames(int numberOfFrames);
+
+  /**
+   * @brief AddFrameObserver register a function called with every assembled frame, even
+   * the ones which are then dropped by the delivery policy. It is called by the consumer
+   * thread, which waits for it: it must be short or hand the frame over to its own thread.
+   * The frame can be kept, its memory is then not reused by the interpreter.
+   * @return an identifier for RemoveFrameObserver
+   */
+  int AddFrameObserver(const FrameObserver& observer);
+  void RemoveFrameObserver(int observerId);
 
   void Start();
 
   void Stop();
 
-  void Enqueue(NetworkPacket* packet);
+  //! Copy a packet in the queue of the packets to interpret, it is dropped if the queue is full
+  void Enqueue(const PacketSlot& packet);
 
   void SetInterpreter(vtkLidarPacketInterpreter* inter) { this->Interpreter = inter;}
 
-  // Hold this when modifying internals of reader
-  boost::mutex ConsumerMutex;
+  //! Set the metrics updated by the consumer, may be nullptr
+  void SetMetrics(std::shared_ptr<StreamMetrics> metrics) { this->Metrics = metrics; }
+
+  //! Scheduling of the consumer thread from the next Start, see ApplyThreadSettings
+  const ThreadSettings& GetThreadSettings() const { return this->Settings; }
+  void SetThreadSettings(const ThreadSettings& settings) { this->Settings = settings; }
+
+  //! CPU the consumer thread is pinned to from the next Start, instead of the CPUs of
+  //! the thread settings, -1 for none
+  int GetCPU() const { return this->CPU; }
+  void SetCPU(int cpu) { this->CPU = cpu; }
+
+  //! Scheduling in use by the consumer thread since it started
+  ThreadSettings GetEffectiveThreadSettings();
 
 protected:
+  struct AssembledFrame
+  {
+    vtkSmartPointer<vtkPolyData> Frame;
+    /*!< Reception time of the first packet of the frame */
+    struct timeval FirstPacketTime;
+  };
+
   void ThreadLoop();
 
-  void HandleNewData(vtkSmartPointer<vtkPolyData> polyData);
+  //! Hand a new frame over according to the delivery policy
+  void DeliverFrame(const vtkSmartPointer<vtkPolyData>& frame);
+
+  void DropFrames(std::uint64_t numberOfFrames);
+
+  /*!< Frames waiting to be taken with KEEP_LATEST and KEEP_LAST_N, hold FramesMutex */
+  std::deque<AssembledFrame> Frames;
+  boost::mutex FramesMutex;
+  /*!< Frame waiting to be taken with ATOMIC_SLOT, owned by the slot */
+  std::atomic<AssembledFrame*> FrameSlot;
+
+  std::atomic<int> Policy;
+  std::atomic<int> MaximumNumberOfFrames;
+  std::atomic<std::uint64_t> NumberOfDroppedFrames;
+
+  std::vector<std::pair<int, FrameObserver> > FrameObservers;
+  boost::mutex FrameObserversMutex;
+  int NextFrameObserverId = 0;
 
-  std::deque<vtkSmartPointer<vtkPolyData> > Frames;
   vtkLidarPacketInterpreter* Interpreter;
 
-  boost::shared_ptr<SynchronizedQueue<NetworkPacket*>> Packets;
+  boost::shared_ptr<PacketRing> Packets;
+
+  std::shared_ptr<StreamMetrics> Metrics;
+
+  /*!< Reception time of the first packet of the frame being assembled */
+  struct timeval FrameFirstPacketTime;
+  bool IsFrameStarted = false;
+
+  ThreadSettings Settings;
+  int CPU = -1;
+  /*!< Written by the consumer thread when it starts, hold EffectiveSettingsMutex */
+  ThreadSettings EffectiveSettings;
+  boost::mutex EffectiveSettingsMutex;
 
   boost::shared_ptr<boost::thread> Thread;
 };
@@ -1,42 +1,108 @@
 #include "PacketFileWriter.h"
+#include "FrameIndexFile.h"
+#include "StreamMetrics.h"
+#include "vtkLidarPacketInterpreter.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include <boost/filesystem.hpp>
 
 //! @todo this include is only for vtkGenericWarningMacro which is strange
 #include <vtkMath.h>
 
+namespace
+{
+//-----------------------------------------------------------------------------
+double GetSteadyTime()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+//-----------------------------------------------------------------------------
+PacketFileWriter::~PacketFileWriter()
+{
+  this->Close();
+}
+
 //-----------------------------------------------------------------------------
 void PacketFileWriter::ThreadLoop()
 {
-  NetworkPacket* packet = nullptr;
-  while (this->Packets->dequeue(packet))
+  const ThreadSettings effectiveSettings = ApplyThreadSettings(this->Settings, "packet writer");
   {
-    this->PacketWriter.WritePacket(*packet);
-    delete packet;
+    boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+    this->EffectiveSettings = effectiveSettings;
   }
+  this->LastSyncTime = GetSteadyTime();
+  while (const PacketSlot* packet = this->Packets->GetReadSlot())
+  {
+    if (this->IsRecording)
+    {
+      this->WritePacket(*packet);
+    }
+    this->Packets->Release();
+    if (this->Metrics)
+    {
+      this->Metrics->WriterQueueDepth = this->Packets->GetNumberOfPackets();
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+ThreadSettings PacketFileWriter::GetEffectiveThreadSettings()
+{
+  boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+  return this->EffectiveSettings;
 }
 
 //-----------------------------------------------------------------------------
-void PacketFileWriter::Start(const std::string &filename)
+void PacketFileWriter::Start(const std::string &filename,
+                             vtkLidarPacketInterpreter* indexingInterpreter)
 {
   if (this->Thread)
   {
     return;
   }
 
-  if (this->PacketWriter.GetFileName() != filename)
+  if (filename != this->RecordingName)
   {
-    this->PacketWriter.Close();
-  }
+    this->CloseFile();
+    this->RecordingName = filename;
+    this->FileIndex = 0;
+    this->IsRotating = this->MaximumFileSize > 0 || this->MaximumFileDuration > 0;
 
-  if (!this->PacketWriter.IsOpen())
-  {
-    if (!this->PacketWriter.Open(filename))
+    // PreProcessPacket changes the interpreter state, the writer thread needs its own one.
+    // The stream interpreter is calibrated, possibly by the packets themselves.
+    this->IndexingInterpreter = nullptr;
+    if (indexingInterpreter)
     {
-      vtkGenericWarningMacro("Failed to open packet file: " << filename);
-      return;
+      this->IndexingInterpreter = indexingInterpreter->Clone();
+      this->IndexingInterpreter->SetIsCalibrated(true);
     }
+    this->IsRecording = this->OpenFile();
+  }
+  else if (!this->IsRecording)
+  {
+    // the previous file could not be written, the recording goes on in a new one. Opening
+    // the same file again would truncate the packets already recorded.
+    this->FileIndex++;
+    this->IsRecording = this->OpenFile();
+  }
+  if (!this->IsRecording)
+  {
+    return;
   }
 
-  this->Packets.reset(new SynchronizedQueue<NetworkPacket*>);
+  std::shared_ptr<StreamMetrics> metrics = this->Metrics;
+  this->File.SetWriteObserver([metrics](std::size_t size, double duration) {
+    if (metrics)
+    {
+      metrics->WrittenBytes += size;
+      metrics->WriteDuration.Add(duration);
+    }
+  });
+  this->Packets.reset(new PacketRing);
   this->Thread = boost::shared_ptr<boost::thread>(
         new boost::thread(boost::bind(&PacketFileWriter::ThreadLoop, this)));
 }
@@ -46,25 +112,206 @@ void PacketFileWriter::Stop()
 {
   if (this->Thread)
   {
-    this->Packets->stopQueue();
+    this->Packets->Stop();
     this->Thread->join();
     this->Thread.reset();
+    if (this->Packets->GetNumberOfDroppedPackets() != 0)
+    {
+      vtkGenericWarningMacro(<< this->Packets->GetNumberOfDroppedPackets()
+                             << " packets were not recorded because they could not be written fast enough");
+    }
     this->Packets.reset();
+    if (this->IsRecording && !this->File.Flush())
+    {
+      this->StopRecording();
+    }
   }
 }
 
 //-----------------------------------------------------------------------------
-void PacketFileWriter::Enqueue(NetworkPacket* packet)
+void PacketFileWriter::Close()
+{
+  this->Stop();
+  this->CloseFile();
+  this->IsRecording = false;
+  this->RecordingName.clear();
+  this->IndexingInterpreter = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+std::string PacketFileWriter::GetCurrentFileName()
+{
+  boost::lock_guard<boost::mutex> lock(this->FileMutex);
+  return this->File.IsOpen() ? this->File.GetFileName() : std::string();
+}
+
+//-----------------------------------------------------------------------------
+void PacketFileWriter::Enqueue(const PacketSlot& packet)
 {
   // TODO
   // After capturing a stream and stoping the recording, Packets is NULL
   // and this loop continues until a new reader or stream is selected.
   if (this->Packets != NULL)
   {
-    this->Packets->enqueue(packet);
+    bool isQueued = this->Packets->Push(packet);
+    if (this->Metrics)
+    {
+      if (!isQueued)
+      {
+        this->Metrics->WriterDroppedPackets++;
+      }
+      StreamMetrics::UpdateMaximum(this->Metrics->WriterQueueHighWaterMark,
+                                   this->Packets->GetNumberOfPackets());
+    }
   }
   else
   {
     this->Stop();
   }
 }
+
+//-----------------------------------------------------------------------------
+std::string PacketFileWriter::GetFileName(int fileIndex) const
+{
+  if (!this->IsRotating && fileIndex == 0)
+  {
+    return this->RecordingName;
+  }
+  const boost::filesystem::path recording(this->RecordingName);
+  char suffix[16];
+  std::snprintf(suffix, sizeof(suffix), "_%04d", fileIndex);
+  return (recording.parent_path() /
+          (recording.stem().string() + suffix + recording.extension().string())).string();
+}
+
+//-----------------------------------------------------------------------------
+bool PacketFileWriter::OpenFile()
+{
+  const std::string filename = this->GetFileName(this->FileIndex);
+  {
+    boost::lock_guard<boost::mutex> lock(this->FileMutex);
+    if (!this->File.Open(filename, this->UseDirectIO))
+    {
+      vtkGenericWarningMacro("Failed to open packet file: " << filename << " ("
+                             << this->File.GetLastError() << ")");
+      return false;
+    }
+  }
+  if (this->Metrics)
+  {
+    this->Metrics->RecordedFiles++;
+  }
+  this->FileStartTime = -1;
+  this->FrameCatalog.clear();
+  if (this->IndexingInterpreter)
+  {
+    this->IndexingInterpreter->ResetParserMetaData();
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void PacketFileWriter::CloseFile()
+{
+  std::string filename;
+  {
+    boost::lock_guard<boost::mutex> lock(this->FileMutex);
+    if (!this->File.IsOpen())
+    {
+      return;
+    }
+    filename = this->File.GetFileName();
+    if (!this->File.Close())
+    {
+      vtkGenericWarningMacro("The packet file " << filename << " may be incomplete ("
+                             << this->File.GetLastError() << ")");
+      return;
+    }
+  }
+
+  // same key as the catalog built by a vtkLidarReader reading all the ports, see
+  // vtkLidarReader::ReadFrameInformation. A catalog with only one frame is not saved.
+  if (this->IndexingInterpreter && this->FrameCatalog.size() > 1)
+  {
+    FrameIndexFile indexFile(filename, -1, this->IndexingInterpreter->GetFrameCatalogParameters());
+    indexFile.Save(this->FrameCatalog);
+  }
+  this->FrameCatalog.clear();
+}
+
+//-----------------------------------------------------------------------------
+void PacketFileWriter::WritePacket(const PacketSlot& packet)
+{
+  const double receptionTime = packet.ReceptionTime.tv_sec + 1e-6 * packet.ReceptionTime.tv_usec;
+  const std::uint64_t recordEnd = this->File.GetFilePosition() + BufferedPcapWriter::RecordHeaderSize +
+    packet.GetPacketSize();
+  if (this->IsRotating && this->FileStartTime >= 0 &&
+      ((this->MaximumFileSize > 0 && recordEnd > this->MaximumFileSize) ||
+       (this->MaximumFileDuration > 0 && receptionTime - this->FileStartTime >= this->MaximumFileDuration)))
+  {
+    this->CloseFile();
+    this->FileIndex++;
+    if (!this->OpenFile())
+    {
+      this->IsRecording = false;
+      return;
+    }
+  }
+  if (this->FileStartTime < 0)
+  {
+    this->FileStartTime = receptionTime;
+  }
+
+  const std::int64_t filePosition = this->File.GetFilePosition();
+  if (!this->File.WritePacket(packet.GetPacketData(), packet.GetPacketSize(), packet.ReceptionTime))
+  {
+    this->StopRecording();
+    return;
+  }
+  if (this->Metrics)
+  {
+    this->Metrics->WrittenPackets++;
+  }
+  this->IndexPacket(packet, filePosition);
+
+  if (this->SyncInterval > 0)
+  {
+    const double now = GetSteadyTime();
+    if (now - this->LastSyncTime >= this->SyncInterval)
+    {
+      this->LastSyncTime = now;
+      if (!this->File.Sync())
+      {
+        this->StopRecording();
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PacketFileWriter::IndexPacket(const PacketSlot& packet, std::int64_t filePosition)
+{
+  if (!this->IndexingInterpreter ||
+      !this->IndexingInterpreter->IsLidarPacket(packet.GetPayloadData(), packet.GetPayloadSize()))
+  {
+    return;
+  }
+  // same as vtkLidarReader::BuildFrameCatalog, with the time vtkPacketFileReader reports
+  if (this->FrameCatalog.empty())
+  {
+    this->FrameCatalog.push_back(this->IndexingInterpreter->GetParserMetaData());
+  }
+  const double networkTime = packet.ReceptionTime.tv_sec + packet.ReceptionTime.tv_usec / 1000000.00;
+  this->IndexingInterpreter->PreProcessPacket(packet.GetPayloadData(), packet.GetPayloadSize(),
+                                              filePosition, networkTime, &this->FrameCatalog);
+}
+
+//-----------------------------------------------------------------------------
+void PacketFileWriter::StopRecording()
+{
+  vtkGenericWarningMacro("The recording stopped: " << this->File.GetLastError());
+  this->IsRecording = false;
+  // the catalog may point after the end of the file
+  this->FrameCatalog.clear();
+  this->CloseFile();
+}
@@ -15,33 +15,144 @@
 #ifndef PACKETWRITER_H
 #define PACKETWRITER_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <queue>
+#include <vector>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
-#include <boost/asio.hpp>
 
-#include "vtkPacketFileWriter.h"
-#include "SynchronizedQueue.h"
+#include <vtkSmartPointer.h>
 
+#include "BufferedPcapWriter.h"
+#include "FrameInformation.h"
+#include "PacketRing.h"
+#include "ThreadSettings.h"
+
+class vtkLidarPacketInterpreter;
+struct StreamMetrics;
+
+/**
+ * \class PacketFileWriter
+ * \brief Record the packets of a stream in pcap files, in a thread of its own.
+ *
+ * The packets are copied in a ring and dropped when it is full, so that a slow disk never
+ * slows the reception nor the interpretation of the packets down. They are written through
+ * the large aligned buffer of a BufferedPcapWriter.
+ *
+ * The recording can be split in several files by size or by duration. The files are then
+ * named after the recording with an index, e.g. record_0000.pcap, record_0001.pcap...
+ * A recording stopped by a write error goes on in the file of the next index when it is
+ * started again, e.g. record_0001.pcap after record.pcap, so that nothing is overwritten.
+ * When an interpreter is given, the frame catalog of each file is built while it is
+ * written and saved in its sidecar (see FrameIndexFile), so that vtkLidarReader opens it
+ * without reading the whole file.
+ */
 class PacketFileWriter
 {
 public:
+  PacketFileWriter() = default;
+  ~PacketFileWriter();
+
   void ThreadLoop();
 
-  void Start(const std::string& filename);
+  /**
+   * @brief Start recording in filename, the recording goes on in the current file if it
+   * has the same name, otherwise a new one is created
+   * @param indexingInterpreter calibrated interpreter of the lidar whose frame catalog is
+   * saved next to each file of a new recording, nullptr for none. A clone is used by the
+   * writer thread.
+   */
+  void Start(const std::string& filename, vtkLidarPacketInterpreter* indexingInterpreter = nullptr);
 
+  //! Stop the thread and write the buffered packets, the file is kept open
   void Stop();
 
-  void Enqueue(NetworkPacket* packet);
+  //! Copy a packet in the queue of the packets to write, it is dropped if the queue is full
+  void Enqueue(const PacketSlot& packet);
+
+  bool IsOpen() { return this->IsRecording; }
+
+  //! Stop and close the current file, and save its frame catalog
+  void Close();
+
+  //! Set the metrics updated by the writer, may be nullptr
+  void SetMetrics(std::shared_ptr<StreamMetrics> metrics) { this->Metrics = metrics; }
+
+  //! Scheduling of the writer thread from the next Start, see ApplyThreadSettings
+  const ThreadSettings& GetThreadSettings() const { return this->Settings; }
+  void SetThreadSettings(const ThreadSettings& settings) { this->Settings = settings; }
+
+  //! Scheduling in use by the writer thread since it started
+  ThreadSettings GetEffectiveThreadSettings();
+
+  //! Size in bytes after which a new file is started, 0 for no limit
+  std::uint64_t GetMaximumFileSize() const { return this->MaximumFileSize; }
+  void SetMaximumFileSize(std::uint64_t size) { this->MaximumFileSize = size; }
+
+  //! Duration in seconds after which a new file is started, 0 for no limit
+  double GetMaximumFileDuration() const { return this->MaximumFileDuration; }
+  void SetMaximumFileDuration(double duration) { this->MaximumFileDuration = duration; }
 
-  bool IsOpen() { return this->PacketWriter.IsOpen(); }
+  //! Interval in seconds between two flushes of the file to the disk, 0 to let the system
+  //! decide. See BufferedPcapWriter::Sync
+  double GetSyncInterval() const { return this->SyncInterval; }
+  void SetSyncInterval(double interval) { this->SyncInterval = interval; }
 
-  void Close() { this->PacketWriter.Close(); }
+  //! Bypass the page cache from the next file, see BufferedPcapWriter::Open
+  bool GetUseDirectIO() const { return this->UseDirectIO; }
+  void SetUseDirectIO(bool useDirectIO) { this->UseDirectIO = useDirectIO; }
+
+  //! Name of the file being written, empty if none
+  std::string GetCurrentFileName();
 
 private:
-  vtkPacketFileWriter PacketWriter;
+  //! Name of the file of the recording with the given index, the first file of a recording
+  //! which is not split has no index
+  std::string GetFileName(int fileIndex) const;
+
+  //! Open the file of the current index, and reset its frame catalog
+  bool OpenFile();
+
+  //! Close the current file and save its frame catalog
+  void CloseFile();
+
+  //! Write a packet in the current file, or in the next one if it is time to rotate
+  void WritePacket(const PacketSlot& packet);
+
+  //! Give a written packet to the interpreter which builds the frame catalog
+  void IndexPacket(const PacketSlot& packet, std::int64_t filePosition);
+
+  //! Called by the writer thread when a write or a sync fails
+  void StopRecording();
+
+  BufferedPcapWriter File;
+  std::string RecordingName;
+  int FileIndex = 0;
+  bool IsRotating = false;
+  /*!< Reception time of the first packet of the current file */
+  double FileStartTime = -1;
+  double LastSyncTime = 0;
+  std::atomic<bool> IsRecording{ false };
+  /*!< Hold to change the file, GetCurrentFileName is called from other threads */
+  boost::mutex FileMutex;
+
+  std::uint64_t MaximumFileSize = 0;
+  double MaximumFileDuration = 0;
+  double SyncInterval = 0;
+  bool UseDirectIO = false;
+
+  vtkSmartPointer<vtkLidarPacketInterpreter> IndexingInterpreter;
+  std::vector<FrameInformation> FrameCatalog;
+
   boost::shared_ptr<boost::thread> Thread;
-  boost::shared_ptr<SynchronizedQueue<NetworkPacket*>> Packets;
+  boost::shared_ptr<PacketRing> Packets;
+  std::shared_ptr<StreamMetrics> Metrics;
+  ThreadSettings Settings;
+  /*!< Written by the writer thread when it starts, hold EffectiveSettingsMutex */
+  ThreadSettings EffectiveSettings;
+  boost::mutex EffectiveSettingsMutex;
 };
 
 
@@ -0,0 +1,223 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "PacketForwarder.h"
+#include "StreamMetrics.h"
+
+#include <vtkSetGet.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#endif
+
+namespace
+{
+//! Packets taken from the ring at once
+const std::size_t FORWARD_BATCH_SIZE = 32;
+
+//! Datagrams sent by one system call at most, a packet is sent once per destination
+const int MAXIMUM_NUMBER_OF_MESSAGES = 64;
+
+//! Size of the send buffer of the socket, which absorbs the bursts
+const int SEND_BUFFER_SIZE = 4 << 20;
+}
+
+//-----------------------------------------------------------------------------
+PacketForwarder::PacketForwarder()
+  : Socket(IOService)
+{
+  this->Socket.open(boost::asio::ip::udp::v4());
+  // Allow to send the packet on the same machine
+  this->Socket.set_option(boost::asio::ip::multicast::enable_loopback(true));
+  boost::system::error_code errCode;
+  this->Socket.set_option(boost::asio::socket_base::send_buffer_size(SEND_BUFFER_SIZE), errCode);
+}
+
+//-----------------------------------------------------------------------------
+PacketForwarder::~PacketForwarder()
+{
+  this->Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool PacketForwarder::AddDestination(int receivePort, const std::string& ipAddress, int port)
+{
+  boost::system::error_code errCode;
+  boost::asio::ip::address_v4 address = boost::asio::ip::address_v4::from_string(ipAddress, errCode);
+  if (errCode)
+  {
+    return false;
+  }
+  this->Destinations.push_back(Destination{ receivePort, boost::asio::ip::udp::endpoint(address, port) });
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void PacketForwarder::Start()
+{
+  if (this->Thread || this->Destinations.empty())
+  {
+    return;
+  }
+  this->Packets.reset(new PacketRing);
+  this->Thread = boost::shared_ptr<boost::thread>(
+        new boost::thread(boost::bind(&PacketForwarder::ThreadLoop, this)));
+}
+
+//-----------------------------------------------------------------------------
+void PacketForwarder::Stop()
+{
+  if (this->Thread)
+  {
+    this->Packets->Stop();
+    this->Thread->join();
+    this->Thread.reset();
+    if (this->Packets->GetNumberOfDroppedPackets() != 0)
+    {
+      vtkGenericWarningMacro(<< this->Packets->GetNumberOfDroppedPackets()
+                             << " packets were not forwarded because they could not be sent fast enough");
+    }
+    this->Packets.reset();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PacketForwarder::Enqueue(const PacketSlot& packet)
+{
+  if (!this->Packets)
+  {
+    return;
+  }
+  bool isQueued = this->Packets->Push(packet);
+  if (this->Metrics)
+  {
+    if (!isQueued)
+    {
+      this->Metrics->ForwarderDroppedPackets++;
+    }
+    StreamMetrics::UpdateMaximum(this->Metrics->ForwarderQueueHighWaterMark,
+                                 this->Packets->GetNumberOfPackets());
+  }
+}
+
+//-----------------------------------------------------------------------------
+ThreadSettings PacketForwarder::GetEffectiveThreadSettings()
+{
+  boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+  return this->EffectiveSettings;
+}
+
+//-----------------------------------------------------------------------------
+void PacketForwarder::ThreadLoop()
+{
+  const ThreadSettings effectiveSettings = ApplyThreadSettings(this->Settings, "forwarding");
+  {
+    boost::lock_guard<boost::mutex> lock(this->EffectiveSettingsMutex);
+    this->EffectiveSettings = effectiveSettings;
+  }
+
+  const PacketSlot* packets[FORWARD_BATCH_SIZE];
+  while (std::size_t numberOfPackets = this->Packets->GetReadSlots(packets, FORWARD_BATCH_SIZE))
+  {
+    this->Forward(packets, numberOfPackets);
+    this->Packets->Release(numberOfPackets);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PacketForwarder::Forward(const PacketSlot* const* packets, std::size_t numberOfPackets)
+{
+  std::uint64_t forwardedPackets = 0;
+  std::uint64_t errors = 0;
+#ifdef __linux__
+  struct mmsghdr messages[MAXIMUM_NUMBER_OF_MESSAGES];
+  struct iovec buffers[MAXIMUM_NUMBER_OF_MESSAGES];
+  int numberOfMessages = 0;
+  auto sendMessages = [&]() {
+    int done = 0;
+    while (done < numberOfMessages)
+    {
+      const int result = sendmmsg(this->Socket.native_handle(), messages + done,
+                                  static_cast<unsigned int>(numberOfMessages - done), 0);
+      if (result < 0)
+      {
+        if (errno != EINTR)
+        {
+          // the first datagram could not be sent (unreachable destination...), the next
+          // ones are tried
+          errors++;
+          done++;
+        }
+        continue;
+      }
+      forwardedPackets += result;
+      done += result;
+    }
+    numberOfMessages = 0;
+  };
+#endif
+
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    const PacketSlot& packet = *packets[i];
+    // the header written by the receiver holds the port on which the packet was received
+    const unsigned char* receivePortData = packet.GetPacketData() + NetworkPacket::EthIPUDPHeader_DESTPORT;
+    const int receivePort = (receivePortData[0] << 8) | receivePortData[1];
+    for (Destination& destination : this->Destinations)
+    {
+      if (destination.ReceivePort != receivePort)
+      {
+        continue;
+      }
+#ifdef __linux__
+      struct mmsghdr& message = messages[numberOfMessages];
+      std::memset(&message, 0, sizeof(message));
+      buffers[numberOfMessages].iov_base = const_cast<unsigned char*>(packet.GetPayloadData());
+      buffers[numberOfMessages].iov_len = packet.GetPayloadSize();
+      message.msg_hdr.msg_iov = &buffers[numberOfMessages];
+      message.msg_hdr.msg_iovlen = 1;
+      message.msg_hdr.msg_name = destination.Endpoint.data();
+      message.msg_hdr.msg_namelen = static_cast<socklen_t>(destination.Endpoint.size());
+      if (++numberOfMessages == MAXIMUM_NUMBER_OF_MESSAGES)
+      {
+        sendMessages();
+      }
+#else
+      boost::system::error_code errCode;
+      this->Socket.send_to(boost::asio::buffer(packet.GetPayloadData(), packet.GetPayloadSize()),
+                           destination.Endpoint, 0, errCode);
+      if (errCode)
+      {
+        errors++;
+      }
+      else
+      {
+        forwardedPackets++;
+      }
+#endif
+    }
+  }
+#ifdef __linux__
+  sendMessages();
+#endif
+
+  if (this->Metrics)
+  {
+    this->Metrics->ForwardedPackets += forwardedPackets;
+    this->Metrics->ForwardErrors += errors;
+  }
+}
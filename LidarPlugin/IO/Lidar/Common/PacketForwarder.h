@@ -0,0 +1,111 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PACKETFORWARDER_H
+#define PACKETFORWARDER_H
+
+// LOCAL
+#include "PacketRing.h"
+#include "ThreadSettings.h"
+
+// STD
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// BOOST
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+struct StreamMetrics;
+
+/**
+ * \class PacketForwarder
+ * \brief Forward the received packets to other hosts, in a thread of its own.
+ *
+ * The receivers copy each packet in a ring, as for the writer, and never wait for the
+ * network: when the forwarding falls behind, the ring fills up and the new packets are
+ * dropped and counted. The forwarding thread sends the packets directly from the slots
+ * of the ring, by batches (sendmmsg on Linux), to every destination of the port they
+ * were received on. A destination can be a unicast or a multicast address.
+ */
+class PacketForwarder
+{
+public:
+  PacketForwarder();
+  ~PacketForwarder();
+
+  PacketForwarder(const PacketForwarder&) = delete;
+  PacketForwarder& operator=(const PacketForwarder&) = delete;
+
+  /**
+   * @brief AddDestination forward the packets received on a port to an address
+   * @param receivePort port on which the packets are received
+   * @param ipAddress IPv4 unicast or multicast address to forward to
+   * @param port port to forward to
+   * @return false if the address is not valid
+   */
+  bool AddDestination(int receivePort, const std::string& ipAddress, int port);
+
+  void RemoveAllDestinations() { this->Destinations.clear(); }
+
+  bool HasDestinations() const { return !this->Destinations.empty(); }
+
+  void Start();
+
+  //! Stop the thread, the packets which are not forwarded yet are discarded
+  void Stop();
+
+  //! Copy a packet in the queue of the packets to forward, it is dropped if the queue is full
+  void Enqueue(const PacketSlot& packet);
+
+  //! Set the metrics updated by the forwarder, may be nullptr
+  void SetMetrics(std::shared_ptr<StreamMetrics> metrics) { this->Metrics = metrics; }
+
+  //! Scheduling of the forwarding thread from the next Start, see ApplyThreadSettings
+  const ThreadSettings& GetThreadSettings() const { return this->Settings; }
+  void SetThreadSettings(const ThreadSettings& settings) { this->Settings = settings; }
+
+  //! Scheduling in use by the forwarding thread since it started
+  ThreadSettings GetEffectiveThreadSettings();
+
+private:
+  struct Destination
+  {
+    int ReceivePort;
+    boost::asio::ip::udp::endpoint Endpoint;
+  };
+
+  void ThreadLoop();
+
+  //! Send some packets to all their destinations
+  void Forward(const PacketSlot* const* packets, std::size_t numberOfPackets);
+
+  std::vector<Destination> Destinations;
+
+  boost::asio::io_service IOService;
+  boost::asio::ip::udp::socket Socket;
+
+  boost::shared_ptr<boost::thread> Thread;
+  std::unique_ptr<PacketRing> Packets;
+  std::shared_ptr<StreamMetrics> Metrics;
+  ThreadSettings Settings;
+  /*!< Written by the forwarding thread when it starts, hold EffectiveSettingsMutex */
+  ThreadSettings EffectiveSettings;
+  boost::mutex EffectiveSettingsMutex;
+};
+
+#endif // PACKETFORWARDER_H
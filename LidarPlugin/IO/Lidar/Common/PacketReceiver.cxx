@@ -18,18 +18,21 @@
 // LOCAL
 #include "PacketReceiver.h"
 #include "NetworkSource.h"
-#include "NetworkPacket.h"
+#include "StreamMetrics.h"
 
 #include <vtkMath.h>
 
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
 
 //-----------------------------------------------------------------------------
-PacketReceiver::PacketReceiver(boost::asio::io_service &io, int port, int forwardport, std::string forwarddestinationIp, bool isforwarding, NetworkSource *parent)
-  : isForwarding(isforwarding)
-  , Port(port)
-  , PacketCounter(0)
+PacketReceiver::PacketReceiver(boost::asio::io_service &io, int port, NetworkSource *parent)
+  : Port(port)
   , Socket(io)
-  , ForwardedSocket(io)
   , Parent(parent)
   , IsReceiving(true)
   , ShouldStop(false)
@@ -39,39 +42,12 @@ PacketReceiver::PacketReceiver(boost::asio::io_service &io, int port, int forwar
                       true)); // Tell the OS we accept to re-use the port address for an other app
   this->Socket.bind(boost::asio::ip::udp::endpoint(
                 boost::asio::ip::udp::v4(), port)); // Bind the socket to the right address
-
-  // Check that the provided ipadress is valid
-  boost::system::error_code errCode;
-  boost::asio::ip::address ipAddressForwarding = boost::asio::ip::address_v4::from_string(forwarddestinationIp, errCode);
-
-  // If the ip address is not valid we replace it by a generic
-  // 0.0.0.0 ip address. This is due to the application
-  // crashes on windows if a not valid ip address is provided
-  // with error message:
-  // Qt has caught an exception from an event handler. This
-  // is not supported in Qt.
-  if (errCode)
-  {
-    ipAddressForwarding = boost::asio::ip::address_v4::from_string("0.0.0.0");
-    if (this->isForwarding)
-    {
-      vtkGenericWarningMacro("Forward ip address not valid, packets won't be forwarded");
-      this->isForwarding = false;
-    }
-  }
-
-  this->ForwardEndpoint = boost::asio::ip::udp::endpoint(ipAddressForwarding, forwardport);
-  this->ForwardedSocket.open(ForwardEndpoint.protocol()); // Opening the socket with an UDP v4 protocol
-  // toward the forwarded ip address and port
-  this->ForwardedSocket.set_option(boost::asio::ip::multicast::enable_loopback(
-                                true)); // Allow to send the packet on the same machine
 }
 
 //-----------------------------------------------------------------------------
 PacketReceiver::~PacketReceiver()
 {
   this->Socket.cancel();
-  this->ForwardedSocket.cancel();
   {
     boost::unique_lock<boost::mutex> guard(this->IsReceivingMtx);
     this->ShouldStop = true;
@@ -81,14 +57,13 @@ PacketReceiver::~PacketReceiver()
     }
   }
 
-  // Close and delete the logs files. So that,
-  // if a log file is present in the next session
-  // it means that the software has been closed
+  // Nothing is left on the disk unless asked. So that,
+  // if a crash capture is present in the next session
+  // it means that the software has not been closed
   // properly (potentially a crash)
   if (this->IsCrashAnalysing)
   {
-    this->CrashAnalysis.CloseAnalyzer();
-    this->CrashAnalysis.DeleteLogFiles();
+    this->CrashAnalysis.Stop(this->SaveCrashAnalysisOnStop);
   }
 }
 
@@ -100,31 +75,104 @@ void PacketReceiver::StartReceive()
     this->IsReceiving = true;
   }
 
+  if (this->UseBatchedReceive)
+  {
+    // only wait for the socket to be readable, the packets are read by BatchCallback
+    auto callback = boost::bind(&PacketReceiver::BatchCallback, this, boost::asio::placeholders::error);
+    if (this->Strand)
+    {
+      this->Socket.async_receive(boost::asio::null_buffers(), this->Strand->wrap(callback));
+    }
+    else
+    {
+      this->Socket.async_receive(boost::asio::null_buffers(), callback);
+    }
+    return;
+  }
+
   // expecting exactly 1206 bytes, using a larger buffer so that if a
   // larger packet arrives unexpectedly we'll notice it.
-  this->Socket.async_receive_from(boost::asio::buffer(this->RXBuffer, BUFFER_SIZE),
-                                  this->SenderEndpoint,
-                                  boost::bind(&PacketReceiver::SocketCallback, this, boost::asio::placeholders::error,
-                                              boost::asio::placeholders::bytes_transferred));
+  auto buffer = boost::asio::buffer(this->RXPacket.GetPayloadBuffer(), PacketSlot::MaximumPayloadSize);
+  auto callback = boost::bind(&PacketReceiver::SocketCallback, this, boost::asio::placeholders::error,
+                              boost::asio::placeholders::bytes_transferred);
+  if (this->Strand)
+  {
+    this->Socket.async_receive_from(buffer, this->SenderEndpoint, this->Strand->wrap(callback));
+  }
+  else
+  {
+    this->Socket.async_receive_from(buffer, this->SenderEndpoint, callback);
+  }
 }
 
 //-----------------------------------------------------------------------------
-void PacketReceiver::EnableCrashAnalysing(std::string filenameCrashAnalysis_, unsigned int nbrPacketToStore_, bool isCrashAnalysing_)
+void PacketReceiver::EnableCrashAnalysing(std::string filenameCrashAnalysis_, unsigned int nbrPacketToStore_,
+                                          double durationToStore_, bool saveOnStop_)
 {
-  this->IsCrashAnalysing = isCrashAnalysing_;
+  this->IsCrashAnalysing = true;
+  this->SaveCrashAnalysisOnStop = saveOnStop_;
 
-  // Opening crash analysis file
-  if (this->IsCrashAnalysing)
+  // Archive the capture of a previous crash and allocate the ring
+  this->CrashAnalysis.SetNbrPacketsToStore(nbrPacketToStore_);
+  this->CrashAnalysis.SetDurationToStore(durationToStore_);
+  this->CrashAnalysis.SetFilename(filenameCrashAnalysis_);
+  this->CrashAnalysis.ArchivePreviousLogIfExist();
+  this->CrashAnalysis.Start();
+}
+
+//-----------------------------------------------------------------------------
+bool PacketReceiver::SaveCrashAnalysis()
+{
+  return this->IsCrashAnalysing && this->CrashAnalysis.SaveCapture();
+}
+
+//-----------------------------------------------------------------------------
+void PacketReceiver::SetReceiveBufferSize(int size)
+{
+  if (size <= 0)
   {
-    this->CrashAnalysis.SetNbrPacketsToStore(nbrPacketToStore_);
-    this->CrashAnalysis.SetFilename(filenameCrashAnalysis_);
-    this->CrashAnalysis.ArchivePreviousLogIfExist();
+    return;
+  }
+
+  boost::system::error_code errCode;
+  this->Socket.set_option(boost::asio::socket_base::receive_buffer_size(size), errCode);
+  boost::asio::socket_base::receive_buffer_size obtainedSize;
+  this->Socket.get_option(obtainedSize, errCode);
+  // the system may limit the size, (e.g. net.core.rmem_max on Linux)
+  if (errCode || obtainedSize.value() < size)
+  {
+    vtkGenericWarningMacro("The receive buffer of port " << this->Port << " could only be set to "
+                           << obtainedSize.value() << " bytes instead of " << size);
   }
 }
 
 //-----------------------------------------------------------------------------
-void PacketReceiver::SocketCallback(
-  const boost::system::error_code& error, std::size_t numberOfBytes)
+void PacketReceiver::EnableBatchedReceive(bool enable)
+{
+#ifdef __linux__
+  this->UseBatchedReceive = enable;
+  if (enable)
+  {
+    this->RXBatch.resize(RECEIVE_BATCH_SIZE);
+    // ask the kernel to give the time at which it received each packet
+    int on = 1;
+    if (setsockopt(this->Socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) != 0)
+    {
+      vtkGenericWarningMacro("The reception time of the packets will not be given by the kernel: "
+                             << std::strerror(errno));
+    }
+    // and the number of packets it dropped because the socket buffer was full
+    setsockopt(this->Socket.native_handle(), SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    // the packets are read without blocking by BatchCallback
+    this->Socket.non_blocking(true);
+  }
+#else
+  (void)enable;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+bool PacketReceiver::StopReceiving(const boost::system::error_code& error)
 {
   if (error || this->ShouldStop)
   {
@@ -136,6 +184,112 @@ void PacketReceiver::SocketCallback(
     }
     this->IsReceivingCond.notify_one();
 
+    return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void PacketReceiver::BatchCallback(const boost::system::error_code& error)
+{
+  if (this->StopReceiving(error))
+  {
+    return;
+  }
+
+#ifdef __linux__
+  unsigned short ourPort = static_cast<unsigned short>(this->Port);
+  struct mmsghdr messages[RECEIVE_BATCH_SIZE];
+  struct iovec buffers[RECEIVE_BATCH_SIZE];
+  struct sockaddr_in senders[RECEIVE_BATCH_SIZE];
+  char controls[RECEIVE_BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+
+  // read until the socket is empty, a full batch means more packets may be waiting
+  int numberOfMessages = RECEIVE_BATCH_SIZE;
+  while (numberOfMessages == RECEIVE_BATCH_SIZE && !this->ShouldStop)
+  {
+    std::memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < RECEIVE_BATCH_SIZE; ++i)
+    {
+      buffers[i].iov_base = this->RXBatch[i].GetPayloadBuffer();
+      buffers[i].iov_len = PacketSlot::MaximumPayloadSize;
+      messages[i].msg_hdr.msg_iov = &buffers[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+      messages[i].msg_hdr.msg_name = &senders[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+      messages[i].msg_hdr.msg_control = controls[i];
+      messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
+
+    numberOfMessages = recvmmsg(this->Socket.native_handle(), messages, RECEIVE_BATCH_SIZE,
+                                MSG_DONTWAIT, nullptr);
+    if (numberOfMessages < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        vtkGenericWarningMacro("Batched receive failed on port " << this->Port << " ("
+                               << std::strerror(errno) << "), the packets will be received one at a time");
+        this->UseBatchedReceive = false;
+        this->Socket.non_blocking(false);
+      }
+      break;
+    }
+
+    for (int i = 0; i < numberOfMessages; ++i)
+    {
+      // sin_addr has network endianess, like the header
+      unsigned char sourceIP[4] = {192, 168, 0, 200};
+      unsigned short sourcePort = 0;
+      if (senders[i].sin_family == AF_INET)
+      {
+        std::memcpy(sourceIP, &senders[i].sin_addr.s_addr, sizeof(sourceIP));
+        sourcePort = ntohs(senders[i].sin_port);
+      }
+
+      // use the kernel reception time if available, and get the packets dropped by the kernel
+      struct timeval receptionTime;
+      struct timeval* kernelTime = nullptr;
+      uint32_t socketDroppedPackets = this->SocketDroppedPackets;
+      for (struct cmsghdr* control = CMSG_FIRSTHDR(&messages[i].msg_hdr); control != nullptr;
+           control = CMSG_NXTHDR(&messages[i].msg_hdr, control))
+      {
+        if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          struct timespec time;
+          std::memcpy(&time, CMSG_DATA(control), sizeof(time));
+          receptionTime.tv_sec = time.tv_sec;
+          receptionTime.tv_usec = time.tv_nsec / 1000;
+          kernelTime = &receptionTime;
+        }
+        else if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SO_RXQ_OVFL)
+        {
+          std::memcpy(&socketDroppedPackets, CMSG_DATA(control), sizeof(socketDroppedPackets));
+        }
+      }
+      // the kernel gives the number of packets dropped since the socket was opened
+      StreamMetrics* metrics = this->Parent->Metrics.get();
+      if (metrics && socketDroppedPackets != this->SocketDroppedPackets)
+      {
+        metrics->SocketDroppedPackets += socketDroppedPackets - this->SocketDroppedPackets;
+      }
+      this->SocketDroppedPackets = socketDroppedPackets;
+
+      PacketSlot& packet = this->RXBatch[i];
+      packet.SetPayload(messages[i].msg_len, sourceIP, sourcePort, ourPort, kernelTime);
+      this->HandlePacket(packet);
+    }
+  }
+#endif
+
+  this->StartReceive();
+}
+
+//-----------------------------------------------------------------------------
+void PacketReceiver::SocketCallback(
+  const boost::system::error_code& error, std::size_t numberOfBytes)
+{
+  if (this->StopReceiving(error))
+  {
     return;
   }
 
@@ -153,11 +307,8 @@ void PacketReceiver::SocketCallback(
     }
   }
   // TODO: IPV6 is recorded as fake ipv4 packet -> create BuildEthernetIP6UDP
-  NetworkPacket* packet = NetworkPacket::BuildEthernetIP4UDP(this->RXBuffer,
-                                                       numberOfBytes,
-                                                       sourceIP,
-                                                       sourcePort,
-                                                       ourPort);
+  // the header is written in front of the received data, no copy nor allocation is done
+  this->RXPacket.SetPayload(static_cast<unsigned int>(numberOfBytes), sourceIP, sourcePort, ourPort);
 
   // std::cout << this->Socket.remote_endpoint().address() << std::endl;
 
@@ -165,23 +316,25 @@ void PacketReceiver::SocketCallback(
   // other data than ip source and port source is provided (which is normal,
   // we are working at the application level).
 
-  if (this->isForwarding)
+  this->HandlePacket(this->RXPacket);
+
+  this->StartReceive();
+}
+
+//-----------------------------------------------------------------------------
+void PacketReceiver::HandlePacket(const PacketSlot& packet)
+{
+  StreamMetrics* metrics = this->Parent->Metrics.get();
+  if (metrics)
   {
-    ForwardedSocket.send_to(boost::asio::buffer(packet->GetPayloadData(), packet->GetPayloadSize()), ForwardEndpoint);
+    metrics->ReceivedPackets++;
   }
 
   if (this->IsCrashAnalysing)
   {
-    this->CrashAnalysis.AddPacket(*packet);
+    this->CrashAnalysis.AddPacket(packet);
   }
 
-  this->Parent->QueuePackets(packet);
-
-  this->StartReceive();
-
-  if ((++this->PacketCounter % 5000) == 0)
-  {
-    std::cout << "RECV packets: " << this->PacketCounter << " on " << this->Port << std::endl;
-  }
+  this->Parent->QueuePackets(packet, this->Port);
 }
 
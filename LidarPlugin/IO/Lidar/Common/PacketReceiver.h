@@ -25,11 +25,12 @@
 // STD
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 class NetworkSource;
 
-/*!< Size of the buffer used to store the data received */
-#define BUFFER_SIZE 1500
+/*!< Maximum number of packets received by a single system call when the receive is batched */
+#define RECEIVE_BATCH_SIZE 32
 
 /*!< Number of packed save when the option CrashAnalysing is set */
 #define NBR_PACKETS_SAVED  1500
@@ -38,7 +39,7 @@ class NetworkSource;
  * \class PacketReceiver
  * \brief This classs is reponsbale for listening on a socket and each time a packet is received,
  * it will enqueue the packet on a specific Queue. Here it is used to setup an UDP multicast protocol.
- * The packet receiver can forward the received packets and/or store them in a output bin file
+ * The received packets are forwarded and/or stored in a output bin file by the NetworkSource
 */
 class PacketReceiver
 {
@@ -47,13 +48,9 @@ public:
    * @brief PacketReceiver
    * @param io The in/out service used to handle the reception of the packets
    * @param port The port address which will receive the packet
-   * @param forwardport The port adress which will receive the forwarded packets
-   * @param forwarddestinationIp The IP adress of the computer which will receive the forwarded packets
-   * @param isforwarding Allow or not the forwarding of the packets
    * @param parent @todo to replace by a synchronizedQueue
    */
-  PacketReceiver(boost::asio::io_service& io, int port, int forwardport,
-    std::string forwarddestinationIp, bool isforwarding, NetworkSource* parent);
+  PacketReceiver(boost::asio::io_service& io, int port, NetworkSource* parent);
 
   ~PacketReceiver();
 
@@ -64,43 +61,93 @@ public:
   void StartReceive();
 
   /**
-   * @brief EnableCrashAnalysing
-   * @param filenameCrashAnalysis_ the name of the output file
+   * @brief EnableCrashAnalysing keep the last packets received in memory, see CrashAnalysisWriter
+   * @param filenameCrashAnalysis_ the name of the output file, without extension
    * @param nbrPacketToStore the number of packets to store
-   * @param isCrashAnalysing_ Enable the crash analysing
+   * @param durationToStore_ only store the packets of the last seconds, 0 for no limit
+   * @param saveOnStop_ save the packets stored when the receiver is destroyed
    */
-  void EnableCrashAnalysing(std::string filenameCrashAnalysis_, unsigned int nbrPacketToStore_, bool isCrashAnalysing_);
+  void EnableCrashAnalysing(std::string filenameCrashAnalysis_, unsigned int nbrPacketToStore_,
+                            double durationToStore_, bool saveOnStop_);
+
+  /**
+   * @brief SaveCrashAnalysis save the packets stored by the crash analysis in a pcap file
+   * @return false if the crash analysis is disabled or the file could not be written
+   */
+  bool SaveCrashAnalysis();
+
+  /**
+   * @brief SetReceiveBufferSize set the size of the receive buffer of the socket (SO_RCVBUF),
+   * which absorbs the bursts of packets while the receiver is busy
+   * @param size size in bytes, 0 keeps the default of the system
+   */
+  void SetReceiveBufferSize(int size);
+
+  /**
+   * @brief EnableBatchedReceive receive up to RECEIVE_BATCH_SIZE packets per system call
+   * with recvmmsg, and use the time at which the kernel received them as reception time.
+   * Only available on Linux, elsewhere the packets are received one at a time.
+   * Must be called before StartReceive.
+   */
+  void EnableBatchedReceive(bool enable);
+
+  /**
+   * @brief SetStrand run the callbacks of the receiver through a strand, so that they never
+   * run concurrently with the ones of the other receivers of the strand even if several
+   * threads run the io_service. Must be called before StartReceive.
+   */
+  void SetStrand(boost::shared_ptr<boost::asio::io_service::strand> strand) { this->Strand = strand; }
+
+  int GetPort() const { return this->Port; }
 
   void SocketCallback(const boost::system::error_code& error, std::size_t numberOfBytes);
 
+  /**
+   * @brief BatchCallback receive all the packets waiting on the socket, called once the
+   * socket is readable when the receive is batched
+   */
+  void BatchCallback(const boost::system::error_code& error);
+
 private:
-  /*!< Allow or not the forwarding of the packets */
-  bool isForwarding;
+  /**
+   * @brief StopReceiving notify the destructor that the reception is over if the socket was
+   * cancelled or is in error
+   * @return true if the reception is over
+   */
+  bool StopReceiving(const boost::system::error_code& error);
+
+  //! Save and enqueue a received packet
+  void HandlePacket(const PacketSlot& packet);
 
   /*!< EndPoint of the sender, contains only sender ip, sender port */
   boost::asio::ip::udp::endpoint SenderEndpoint;
 
-  /*!< EndPoint to forward to, contain information such as forward ip, forward port */
-  boost::asio::ip::udp::endpoint ForwardEndpoint;
-  
+
   /*!< Port address which will receive the packet */
   int Port;                
-  
-  /*!< Number of packets received */
-  int PacketCounter;
 
   /*!< Socket : determines the protocol used and the address used for the reception of the packets */
   boost::asio::ip::udp::socket Socket;
 
-  /*!< Socket : determines the protocol used and the address used for the reception of the forwarded packets */
-  boost::asio::ip::udp::socket ForwardedSocket;
-
   /*!< Network Shouce where the packet will be enqueue */
   NetworkSource* Parent;
 
-  /*!< Buffer which will saved the data. Expecting exactly 1206 bytes, using a larger buffer
-   *  so that if a larger packet arrives unexpectedly we'll notice it. */
-  unsigned char RXBuffer[BUFFER_SIZE];
+  /*!< Strand shared with the receivers which feed the same consumers, may be null */
+  boost::shared_ptr<boost::asio::io_service::strand> Strand;
+
+  /*!< Packet in which the data are received, before being copied to the consumers.
+   *  Expecting exactly 1206 bytes, using a larger buffer so that if a larger packet
+   *  arrives unexpectedly we'll notice it. */
+  PacketSlot RXPacket;
+
+  /*!< Receive up to RECEIVE_BATCH_SIZE packets per system call, see EnableBatchedReceive */
+  bool UseBatchedReceive = false;
+
+  /*!< Packets received by a single system call when the receive is batched */
+  std::vector<PacketSlot> RXBatch;
+
+  /*!< Number of packets dropped by the system on the socket, given with the batched receive */
+  unsigned int SocketDroppedPackets = 0;
 
   bool IsReceiving; /*!< Flag indicating if the socket is receiving packets */
   bool ShouldStop;  /*!< Flag indicating if we should stop the listening */
@@ -108,6 +155,7 @@ private:
   boost::condition_variable IsReceivingCond;
   boost::mutex IsWriting;
   bool IsCrashAnalysing = false;
+  bool SaveCrashAnalysisOnStop = false;
   CrashAnalysisWriter CrashAnalysis;
 };
 
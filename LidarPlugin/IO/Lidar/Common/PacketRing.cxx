@@ -0,0 +1,238 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "PacketRing.h"
+
+// STD
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define PACKET_RING_CPU_PAUSE() _mm_pause()
+#else
+#define PACKET_RING_CPU_PAUSE()
+#endif
+
+namespace
+{
+/*!< Number of times a waiting consumer checks the ring before yielding, a few microseconds */
+const int NUMBER_OF_SPINS = 2000;
+
+/*!< Number of times a waiting consumer yields before parking */
+const int NUMBER_OF_YIELDS = 50;
+}
+
+//-----------------------------------------------------------------------------
+void PacketSlot::SetPayload(unsigned int payloadSize, const unsigned char* sourceIPv4BigEndian,
+                            unsigned short sourcePort, unsigned short destinationPort,
+                            const struct timeval* receptionTime)
+{
+  // std::min would odr-use the static member
+  this->PayloadSize = payloadSize < MaximumPayloadSize ? payloadSize : MaximumPayloadSize;
+  NetworkPacket::WriteEthernetIP4UDPHeader(
+    this->Data, this->PayloadSize, sourceIPv4BigEndian, sourcePort, destinationPort);
+  if (receptionTime)
+  {
+    this->ReceptionTime = *receptionTime;
+  }
+  else
+  {
+    NetworkPacket::GetTimeOfDay(&this->ReceptionTime);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PacketSlot::CopyFrom(const PacketSlot& other)
+{
+  this->ReceptionTime = other.ReceptionTime;
+  this->PayloadSize = other.PayloadSize;
+  std::memcpy(this->Data, other.Data, other.GetPacketSize());
+}
+
+//-----------------------------------------------------------------------------
+PacketRing::PacketRing(std::size_t capacity)
+  : Head(0)
+  , Tail(0)
+  , DroppedPackets(0)
+  , Stopped(false)
+  , ConsumerParked(false)
+{
+  std::size_t size = 1;
+  while (size < capacity)
+  {
+    size <<= 1;
+  }
+  this->Mask = size - 1;
+
+  // round the slots up to a whole number of cache lines, so that the producer and the
+  // consumer never write in the same cache line
+  this->SlotStride = (sizeof(PacketSlot) + PACKET_RING_CACHE_LINE_SIZE - 1)
+    / PACKET_RING_CACHE_LINE_SIZE * PACKET_RING_CACHE_LINE_SIZE;
+  this->Memory.reset(new unsigned char[size * this->SlotStride + PACKET_RING_CACHE_LINE_SIZE]);
+  std::size_t address = reinterpret_cast<std::size_t>(this->Memory.get());
+  std::size_t offset = (PACKET_RING_CACHE_LINE_SIZE - address % PACKET_RING_CACHE_LINE_SIZE)
+    % PACKET_RING_CACHE_LINE_SIZE;
+  this->AlignedMemory = this->Memory.get() + offset;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    new (this->AlignedMemory + i * this->SlotStride) PacketSlot();
+  }
+}
+
+//-----------------------------------------------------------------------------
+PacketSlot* PacketRing::GetSlot(std::size_t index) const
+{
+  return reinterpret_cast<PacketSlot*>(this->AlignedMemory + (index & this->Mask) * this->SlotStride);
+}
+
+//-----------------------------------------------------------------------------
+PacketSlot* PacketRing::GetWriteSlot()
+{
+  if (this->Stopped.load(std::memory_order_relaxed))
+  {
+    return nullptr;
+  }
+  const std::size_t head = this->Head.load(std::memory_order_relaxed);
+  if (head - this->Tail.load(std::memory_order_acquire) > this->Mask)
+  {
+    this->DroppedPackets.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return this->GetSlot(head);
+}
+
+//-----------------------------------------------------------------------------
+void PacketRing::Publish()
+{
+  // sequentially consistent so that either the producer sees the consumer parked, or
+  // the consumer sees the packet before parking
+  this->Head.fetch_add(1, std::memory_order_seq_cst);
+  if (this->ConsumerParked.load(std::memory_order_seq_cst))
+  {
+    boost::lock_guard<boost::mutex> lock(this->Mutex);
+    this->Condition.notify_one();
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool PacketRing::Push(const PacketSlot& packet)
+{
+  PacketSlot* slot = this->GetWriteSlot();
+  if (!slot)
+  {
+    return false;
+  }
+  slot->CopyFrom(packet);
+  this->Publish();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+const PacketSlot* PacketRing::GetReadSlot()
+{
+  if (!this->WaitForPacket())
+  {
+    return nullptr;
+  }
+  return this->GetSlot(this->Tail.load(std::memory_order_relaxed));
+}
+
+//-----------------------------------------------------------------------------
+void PacketRing::Release()
+{
+  this->Tail.fetch_add(1, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+std::size_t PacketRing::GetReadSlots(const PacketSlot** slots, std::size_t maximumNumberOfSlots)
+{
+  if (maximumNumberOfSlots == 0 || !this->WaitForPacket())
+  {
+    return 0;
+  }
+  const std::size_t tail = this->Tail.load(std::memory_order_relaxed);
+  const std::size_t available = this->Head.load(std::memory_order_acquire) - tail;
+  const std::size_t count = std::min(available, maximumNumberOfSlots);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    slots[i] = this->GetSlot(tail + i);
+  }
+  return count;
+}
+
+//-----------------------------------------------------------------------------
+void PacketRing::Release(std::size_t count)
+{
+  this->Tail.fetch_add(count, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+bool PacketRing::WaitForPacket()
+{
+  const std::size_t tail = this->Tail.load(std::memory_order_relaxed);
+  auto isPacketAvailable = [this, tail]() {
+    return this->Head.load(std::memory_order_acquire) != tail;
+  };
+
+  for (int i = 0; i < NUMBER_OF_SPINS; ++i)
+  {
+    if (this->Stopped.load(std::memory_order_relaxed))
+    {
+      return false;
+    }
+    if (isPacketAvailable())
+    {
+      return true;
+    }
+    PACKET_RING_CPU_PAUSE();
+  }
+  for (int i = 0; i < NUMBER_OF_YIELDS; ++i)
+  {
+    if (this->Stopped.load(std::memory_order_relaxed))
+    {
+      return false;
+    }
+    if (isPacketAvailable())
+    {
+      return true;
+    }
+    std::this_thread::yield();
+  }
+
+  boost::unique_lock<boost::mutex> lock(this->Mutex);
+  this->ConsumerParked.store(true, std::memory_order_seq_cst);
+  while (!this->Stopped.load() && this->Head.load(std::memory_order_seq_cst) == tail)
+  {
+    this->Condition.wait(lock);
+  }
+  this->ConsumerParked.store(false, std::memory_order_relaxed);
+  return !this->Stopped.load();
+}
+
+//-----------------------------------------------------------------------------
+void PacketRing::Stop()
+{
+  this->Stopped.store(true);
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  this->Condition.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+std::size_t PacketRing::GetNumberOfPackets() const
+{
+  return this->Head.load(std::memory_order_acquire) - this->Tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,178 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PACKETRING_H
+#define PACKETRING_H
+
+// LOCAL
+#include "NetworkPacket.h"
+
+// BOOST
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*!< Size of a cache line, used to keep the data of the producer and of the consumer apart */
+#define PACKET_RING_CACHE_LINE_SIZE 64
+
+/*!< Default number of packets a PacketRing can hold, about 0.7s of a VLS-128 */
+#define PACKET_RING_DEFAULT_CAPACITY 8192
+
+/**
+ * \struct PacketSlot
+ * \brief A network packet stored in a fixed size buffer: a synthetic Ethernet/IPv4/UDP
+ * header (see NetworkPacket) followed by the UDP payload.
+ */
+struct PacketSlot
+{
+  /*!< Size of the header written in front of the payload */
+  static const unsigned int HeaderSize = NetworkPacket::EthIP4UDPHeaderSize;
+
+  /*!< Size of the largest payload, larger payloads are truncated */
+  static const unsigned int MaximumPayloadSize = 1500;
+
+  const unsigned char* GetPacketData() const { return this->Data; }
+  unsigned int GetPacketSize() const { return HeaderSize + this->PayloadSize; }
+  const unsigned char* GetPayloadData() const { return this->Data + HeaderSize; }
+  unsigned int GetPayloadSize() const { return this->PayloadSize; }
+
+  //! Buffer where the payload must be written, before calling SetPayload
+  unsigned char* GetPayloadBuffer() { return this->Data + HeaderSize; }
+
+  //! Set the size of the payload written in GetPayloadBuffer, build the header and
+  //! set the reception time, to now if receptionTime is nullptr
+  void SetPayload(unsigned int payloadSize, const unsigned char* sourceIPv4BigEndian,
+                  unsigned short sourcePort, unsigned short destinationPort,
+                  const struct timeval* receptionTime = nullptr);
+
+  //! Copy the header, the payload and the reception time of another packet
+  void CopyFrom(const PacketSlot& other);
+
+  struct timeval ReceptionTime;
+  unsigned int PayloadSize = 0;
+  unsigned char Data[HeaderSize + MaximumPayloadSize];
+};
+
+/**
+ * \class PacketRing
+ * \brief Single producer / single consumer queue of packets, used to pass the packets
+ * received by a PacketReceiver to a PacketConsumer or a PacketFileWriter.
+ *
+ * All slots are allocated once, aligned on cache lines, and the packets are copied in
+ * them: no memory is allocated per packet, and the producer and the consumer never
+ * take a lock while packets are flowing. When the ring is full, the new packets are
+ * dropped and counted, so that a slow consumer does not make the memory nor the latency
+ * grow without bound.
+ *
+ * A consumer waiting for a packet first spins for a short while, as a packet usually
+ * arrives within a few microseconds when a sensor is streaming, then yields, and then
+ * parks on a condition variable which the producer only notifies when the consumer is
+ * parked.
+ */
+class PacketRing
+{
+public:
+  /**
+   * @brief PacketRing allocate the slots
+   * @param capacity number of packets the ring can hold, rounded up to a power of 2
+   */
+  explicit PacketRing(std::size_t capacity = PACKET_RING_DEFAULT_CAPACITY);
+
+  PacketRing(const PacketRing&) = delete;
+  PacketRing& operator=(const PacketRing&) = delete;
+
+  // Producer side
+
+  /**
+   * @brief GetWriteSlot return the slot where the next packet must be written, or
+   * nullptr if the ring is stopped or full, in which case the packet is counted as
+   * dropped. The packet is given to the consumer by Publish.
+   */
+  PacketSlot* GetWriteSlot();
+
+  //! Give the packet written in the slot returned by GetWriteSlot to the consumer
+  void Publish();
+
+  //! Copy a packet in the ring, return false if it was dropped
+  bool Push(const PacketSlot& packet);
+
+  // Consumer side
+
+  /**
+   * @brief GetReadSlot wait for the oldest packet of the ring and return it, or return
+   * nullptr once the ring is stopped. The slot is given back to the producer by Release.
+   */
+  const PacketSlot* GetReadSlot();
+
+  //! Give the slot returned by GetReadSlot back to the producer
+  void Release();
+
+  /**
+   * @brief GetReadSlots wait for the oldest packets of the ring and return up to
+   * maximumNumberOfSlots of them, or return 0 once the ring is stopped. The packets are
+   * read in place, the slots are given back to the producer by Release(count).
+   */
+  std::size_t GetReadSlots(const PacketSlot** slots, std::size_t maximumNumberOfSlots);
+
+  //! Give the first count slots returned by GetReadSlots back to the producer
+  void Release(std::size_t count);
+
+  //! Wake up the consumer and make GetReadSlot return nullptr, the packets left are discarded
+  void Stop();
+
+  std::size_t GetCapacity() const { return this->Mask + 1; }
+
+  //! Number of packets waiting to be consumed
+  std::size_t GetNumberOfPackets() const;
+
+  //! Number of packets dropped because the ring was full
+  std::uint64_t GetNumberOfDroppedPackets() const { return this->DroppedPackets.load(); }
+
+private:
+  PacketSlot* GetSlot(std::size_t index) const;
+
+  //! Wait until a packet is available or the ring is stopped, return false if stopped
+  bool WaitForPacket();
+
+  /*!< Memory of the slots, the first slot is aligned on a cache line */
+  std::unique_ptr<unsigned char[]> Memory;
+  unsigned char* AlignedMemory = nullptr;
+  std::size_t SlotStride = 0;
+  std::size_t Mask = 0;
+
+  // The indices grow forever, the slot of an index is index & Mask.
+  // Each one is on its own cache line.
+  char Padding0[PACKET_RING_CACHE_LINE_SIZE];
+  /*!< Index of the next packet to publish, written by the producer */
+  std::atomic<std::size_t> Head;
+  char Padding1[PACKET_RING_CACHE_LINE_SIZE - sizeof(std::atomic<std::size_t>)];
+  /*!< Index of the next packet to consume, written by the consumer */
+  std::atomic<std::size_t> Tail;
+  char Padding2[PACKET_RING_CACHE_LINE_SIZE - sizeof(std::atomic<std::size_t>)];
+
+  /*!< Packets dropped because the ring was full, written by the producer */
+  std::atomic<std::uint64_t> DroppedPackets;
+  std::atomic<bool> Stopped;
+
+  /*!< Set by the consumer while it is parked on Condition */
+  std::atomic<bool> ConsumerParked;
+  boost::mutex Mutex;
+  boost::condition_variable Condition;
+};
+
+#endif // PACKETRING_H
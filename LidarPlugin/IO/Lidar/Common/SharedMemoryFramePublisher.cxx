@@ -0,0 +1,170 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "SharedMemoryFramePublisher.h"
+
+// VTK
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+// Type of the shared memory array holding the values of a VTK array, 0 if none
+template<typename T>
+std::uint32_t GetIntegerType()
+{
+  const bool isSigned = static_cast<T>(-1) < static_cast<T>(0);
+  switch (sizeof(T))
+  {
+    case 1:
+      return isSigned ? SHARED_MEMORY_INT8 : SHARED_MEMORY_UINT8;
+    case 2:
+      return isSigned ? SHARED_MEMORY_INT16 : SHARED_MEMORY_UINT16;
+    case 4:
+      return isSigned ? SHARED_MEMORY_INT32 : SHARED_MEMORY_UINT32;
+    default:
+      return isSigned ? SHARED_MEMORY_INT64 : SHARED_MEMORY_UINT64;
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::uint32_t GetSharedMemoryType(int vtkType)
+{
+  switch (vtkType)
+  {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:
+      return SHARED_MEMORY_INT8;
+    case VTK_UNSIGNED_CHAR:
+      return SHARED_MEMORY_UINT8;
+    case VTK_SHORT:
+      return SHARED_MEMORY_INT16;
+    case VTK_UNSIGNED_SHORT:
+      return SHARED_MEMORY_UINT16;
+    case VTK_INT:
+      return SHARED_MEMORY_INT32;
+    case VTK_UNSIGNED_INT:
+      return SHARED_MEMORY_UINT32;
+    case VTK_LONG:
+      return GetIntegerType<long>();
+    case VTK_UNSIGNED_LONG:
+      return GetIntegerType<unsigned long>();
+    case VTK_LONG_LONG:
+      return SHARED_MEMORY_INT64;
+    case VTK_UNSIGNED_LONG_LONG:
+      return SHARED_MEMORY_UINT64;
+    case VTK_ID_TYPE:
+      return GetIntegerType<vtkIdType>();
+    case VTK_FLOAT:
+      return SHARED_MEMORY_FLOAT32;
+    case VTK_DOUBLE:
+      return SHARED_MEMORY_FLOAT64;
+    default:
+      return 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Return false if the array could not be added, unnamed or non numeric arrays are ignored
+bool AddArray(SharedMemoryFrameWriter& writer, const char* name, vtkDataArray* array,
+              std::uint32_t association)
+{
+  const std::uint32_t type = GetSharedMemoryType(array->GetDataType());
+  if (!name || type == 0)
+  {
+    return true;
+  }
+  return writer.AddArray(name, type, association,
+                         static_cast<std::uint32_t>(array->GetNumberOfComponents()),
+                         static_cast<std::uint64_t>(array->GetNumberOfTuples()),
+                         array->GetVoidPointer(0));
+}
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFramePublisher::Open(const std::string& name, std::uint32_t numberOfSlots,
+                                      std::uint64_t slotSize)
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  this->PublishedFrames = 0;
+  this->TruncatedFrames = 0;
+  return this->Writer.Open(name, numberOfSlots, slotSize);
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryFramePublisher::Close()
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  this->Writer.Close();
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFramePublisher::IsOpen()
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  return this->Writer.IsOpen();
+}
+
+//-----------------------------------------------------------------------------
+std::string SharedMemoryFramePublisher::GetLastError()
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  return this->Writer.GetLastError();
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryFramePublisher::Publish(vtkPolyData* frame, double time)
+{
+  boost::lock_guard<boost::mutex> lock(this->Mutex);
+  if (!this->Writer.IsOpen() || !frame)
+  {
+    return false;
+  }
+
+  bool isComplete = true;
+  this->Writer.BeginFrame(time, static_cast<std::uint64_t>(frame->GetNumberOfPoints()));
+  if (vtkPoints* points = frame->GetPoints())
+  {
+    isComplete &= AddArray(this->Writer, "Points", points->GetData(), SHARED_MEMORY_POINTS);
+  }
+  vtkPointData* pointData = frame->GetPointData();
+  for (int i = 0; i < pointData->GetNumberOfArrays(); ++i)
+  {
+    if (vtkDataArray* array = pointData->GetArray(i))
+    {
+      isComplete &= AddArray(this->Writer, array->GetName(), array, SHARED_MEMORY_POINT_DATA);
+    }
+  }
+  vtkFieldData* fieldData = frame->GetFieldData();
+  for (int i = 0; i < fieldData->GetNumberOfArrays(); ++i)
+  {
+    if (vtkDataArray* array = fieldData->GetArray(i))
+    {
+      isComplete &= AddArray(this->Writer, array->GetName(), array, SHARED_MEMORY_FIELD_DATA);
+    }
+  }
+  this->Writer.EndFrame();
+
+  this->PublishedFrames++;
+  if (!isComplete)
+  {
+    this->TruncatedFrames++;
+  }
+  return isComplete;
+}
@@ -0,0 +1,75 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAREDMEMORYFRAMEPUBLISHER_H
+#define SHAREDMEMORYFRAMEPUBLISHER_H
+
+// LOCAL
+#include "SharedMemoryFrameRing.h"
+
+// BOOST
+#include <boost/thread/mutex.hpp>
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class vtkPolyData;
+
+/**
+ * \class SharedMemoryFramePublisher
+ * \brief Publish frames in a shared memory ring, so that other processes of the host
+ * can read them without decoding the packets again, see SharedMemoryFrameRing.h.
+ *
+ * Each frame is published with its points ("Points", float or double), its point data
+ * arrays and its numeric field data arrays (e.g. "FrameId"), under their VTK names.
+ * The arrays which do not fit in a slot are skipped and the frame is counted as
+ * truncated. Publish and Close can be called from different threads.
+ */
+class SharedMemoryFramePublisher
+{
+public:
+  /**
+   * @brief Open create the shared memory, see SharedMemoryFrameWriter::Open
+   * @param slotSize bytes of a slot, which limits the size of the frames
+   */
+  bool Open(const std::string& name, std::uint32_t numberOfSlots, std::uint64_t slotSize);
+
+  void Close();
+
+  bool IsOpen();
+
+  /**
+   * @brief Publish copy a frame in the next slot of the ring
+   * @param time time of the frame, NaN if unknown
+   * @return false if the publisher is not open or the frame was truncated
+   */
+  bool Publish(vtkPolyData* frame, double time);
+
+  std::uint64_t GetNumberOfPublishedFrames() const { return this->PublishedFrames; }
+  std::uint64_t GetNumberOfTruncatedFrames() const { return this->TruncatedFrames; }
+
+  std::string GetLastError();
+
+private:
+  /*!< Protects Writer, which is used by the thread publishing and the one closing */
+  boost::mutex Mutex;
+  SharedMemoryFrameWriter Writer;
+
+  std::atomic<std::uint64_t> PublishedFrames{ 0 };
+  std::atomic<std::uint64_t> TruncatedFrames{ 0 };
+};
+
+#endif // SHAREDMEMORYFRAMEPUBLISHER_H
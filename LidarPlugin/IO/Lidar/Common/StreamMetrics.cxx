@@ -0,0 +1,219 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "StreamMetrics.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+// VTK
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkNew.h>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+void AddMetric(vtkFieldData* metrics, const char* name, std::uint64_t value)
+{
+  vtkNew<vtkDoubleArray> array;
+  array->SetName(name);
+  array->InsertNextValue(static_cast<double>(value));
+  metrics->AddArray(array.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void AddHistogram(vtkFieldData* metrics, const char* name, const LatencyHistogram& histogram)
+{
+  vtkNew<vtkDoubleArray> array;
+  array->SetName(name);
+  array->SetNumberOfValues(LatencyHistogram::NumberOfBins);
+  for (int bin = 0; bin < LatencyHistogram::NumberOfBins; ++bin)
+  {
+    array->SetValue(bin, static_cast<double>(histogram.GetBinCount(bin)));
+  }
+  metrics->AddArray(array.GetPointer());
+
+  vtkNew<vtkDoubleArray> summary;
+  summary->SetName((std::string(name) + "Summary").c_str());
+  summary->SetNumberOfComponents(4);
+  summary->SetComponentName(0, "Mean");
+  summary->SetComponentName(1, "P50");
+  summary->SetComponentName(2, "P99");
+  summary->SetComponentName(3, "Maximum");
+  double values[4] = { histogram.GetMean(), histogram.GetPercentile(50),
+                       histogram.GetPercentile(99), histogram.GetMaximum() };
+  summary->InsertNextTuple(values);
+  metrics->AddArray(summary.GetPointer());
+}
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Add(double latency)
+{
+  // the clocks of the packets and of the frames may step back
+  const std::uint64_t microseconds = latency > 0 ? static_cast<std::uint64_t>(latency * 1e6) : 0;
+  int bin = 0;
+  std::uint64_t upperBound = 1000;
+  while (bin < NumberOfBins - 1 && microseconds >= upperBound)
+  {
+    bin++;
+    upperBound *= 2;
+  }
+  this->Bins[bin].fetch_add(1, std::memory_order_relaxed);
+  this->Count.fetch_add(1, std::memory_order_relaxed);
+  this->Sum.fetch_add(microseconds, std::memory_order_relaxed);
+  StreamMetrics::UpdateMaximum(this->Maximum, microseconds);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Add(const struct timeval& start, const struct timeval& end)
+{
+  this->Add((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1e-6);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Reset()
+{
+  for (int bin = 0; bin < NumberOfBins; ++bin)
+  {
+    this->Bins[bin] = 0;
+  }
+  this->Count = 0;
+  this->Sum = 0;
+  this->Maximum = 0;
+}
+
+//-----------------------------------------------------------------------------
+double LatencyHistogram::GetBinUpperBound(int bin)
+{
+  if (bin >= NumberOfBins - 1)
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::pow(2.0, bin);
+}
+
+//-----------------------------------------------------------------------------
+double LatencyHistogram::GetMean() const
+{
+  const std::uint64_t count = this->GetCount();
+  return count ? this->Sum.load(std::memory_order_relaxed) / 1e3 / count : 0.;
+}
+
+//-----------------------------------------------------------------------------
+double LatencyHistogram::GetMaximum() const
+{
+  return this->Maximum.load(std::memory_order_relaxed) / 1e3;
+}
+
+//-----------------------------------------------------------------------------
+double LatencyHistogram::GetPercentile(double percentile) const
+{
+  const std::uint64_t count = this->GetCount();
+  if (count == 0)
+  {
+    return 0.;
+  }
+  const double rank = percentile / 100. * count;
+  std::uint64_t cumulatedCount = 0;
+  for (int bin = 0; bin < NumberOfBins - 1; ++bin)
+  {
+    cumulatedCount += this->GetBinCount(bin);
+    if (cumulatedCount >= rank)
+    {
+      return std::min(GetBinUpperBound(bin), this->GetMaximum());
+    }
+  }
+  return this->GetMaximum();
+}
+
+//-----------------------------------------------------------------------------
+void StreamMetrics::Reset()
+{
+  this->ReceivedPackets = 0;
+  this->SocketDroppedPackets = 0;
+  this->ConsumerQueueHighWaterMark = 0;
+  this->ConsumerDroppedPackets = 0;
+  this->WriterQueueHighWaterMark = 0;
+  this->WriterDroppedPackets = 0;
+  this->WriterQueueDepth = 0;
+  this->ForwarderQueueHighWaterMark = 0;
+  this->ForwarderDroppedPackets = 0;
+  this->ForwardedPackets = 0;
+  this->ForwardErrors = 0;
+  this->WrittenPackets = 0;
+  this->WrittenBytes = 0;
+  this->RecordedFiles = 0;
+  this->AssembledFrames = 0;
+  this->DroppedFrames = 0;
+  this->DeliveredFrames = 0;
+  this->MissingPackets = 0;
+  this->AngularGaps = 0;
+  this->ReceiveToFrameLatency.Reset();
+  this->ReceiveToDeliveryLatency.Reset();
+  this->WriteDuration.Reset();
+}
+
+//-----------------------------------------------------------------------------
+void StreamMetrics::UpdateMaximum(std::atomic<std::uint64_t>& mark, std::uint64_t value)
+{
+  // the receive threads raise the same marks, a plain store could lower them
+  std::uint64_t current = mark.load(std::memory_order_relaxed);
+  while (value > current &&
+         !mark.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+//-----------------------------------------------------------------------------
+void StreamMetrics::Export(vtkFieldData* metrics) const
+{
+  metrics->Initialize();
+  AddMetric(metrics, "ReceivedPackets", this->ReceivedPackets);
+  AddMetric(metrics, "SocketDroppedPackets", this->SocketDroppedPackets);
+  AddMetric(metrics, "ConsumerQueueHighWaterMark", this->ConsumerQueueHighWaterMark);
+  AddMetric(metrics, "ConsumerDroppedPackets", this->ConsumerDroppedPackets);
+  AddMetric(metrics, "WriterQueueHighWaterMark", this->WriterQueueHighWaterMark);
+  AddMetric(metrics, "WriterDroppedPackets", this->WriterDroppedPackets);
+  AddMetric(metrics, "WriterQueueDepth", this->WriterQueueDepth);
+  AddMetric(metrics, "ForwarderQueueHighWaterMark", this->ForwarderQueueHighWaterMark);
+  AddMetric(metrics, "ForwarderDroppedPackets", this->ForwarderDroppedPackets);
+  AddMetric(metrics, "ForwardedPackets", this->ForwardedPackets);
+  AddMetric(metrics, "ForwardErrors", this->ForwardErrors);
+  AddMetric(metrics, "WrittenPackets", this->WrittenPackets);
+  AddMetric(metrics, "WrittenBytes", this->WrittenBytes);
+  AddMetric(metrics, "RecordedFiles", this->RecordedFiles);
+  AddMetric(metrics, "AssembledFrames", this->AssembledFrames);
+  AddMetric(metrics, "DroppedFrames", this->DroppedFrames);
+  AddMetric(metrics, "DeliveredFrames", this->DeliveredFrames);
+  AddMetric(metrics, "MissingPackets", this->MissingPackets);
+  AddMetric(metrics, "AngularGaps", this->AngularGaps);
+  AddHistogram(metrics, "ReceiveToFrameLatency", this->ReceiveToFrameLatency);
+  AddHistogram(metrics, "ReceiveToDeliveryLatency", this->ReceiveToDeliveryLatency);
+  AddHistogram(metrics, "WriteDuration", this->WriteDuration);
+
+  vtkNew<vtkDoubleArray> upperBounds;
+  upperBounds->SetName("LatencyBinUpperBound");
+  upperBounds->SetNumberOfValues(LatencyHistogram::NumberOfBins);
+  for (int bin = 0; bin < LatencyHistogram::NumberOfBins; ++bin)
+  {
+    upperBounds->SetValue(bin, LatencyHistogram::GetBinUpperBound(bin));
+  }
+  metrics->AddArray(upperBounds.GetPointer());
+}
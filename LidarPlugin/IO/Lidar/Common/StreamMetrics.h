@@ -0,0 +1,143 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STREAMMETRICS_H
+#define STREAMMETRICS_H
+
+// LOCAL
+#include "NetworkPacket.h"
+
+// STD
+#include <atomic>
+#include <cstdint>
+
+class vtkFieldData;
+
+/**
+ * \class LatencyHistogram
+ * \brief Distribution of latencies, in bins whose upper bounds are powers of 2 milliseconds.
+ *
+ * The latencies can be added and read from any thread at the same time.
+ */
+class LatencyHistogram
+{
+public:
+  /*!< Bin 0 counts the latencies under 1ms, bin i in [2^(i-1), 2^i[ ms, the last bin all
+   *   the latencies above 2^(NumberOfBins-2) ms */
+  static const int NumberOfBins = 16;
+
+  LatencyHistogram() { this->Reset(); }
+
+  //! Add a latency, in seconds
+  void Add(double latency);
+
+  //! Add the latency between two times of day, see NetworkPacket::GetTimeOfDay
+  void Add(const struct timeval& start, const struct timeval& end);
+
+  void Reset();
+
+  std::uint64_t GetCount() const { return this->Count.load(std::memory_order_relaxed); }
+  std::uint64_t GetBinCount(int bin) const { return this->Bins[bin].load(std::memory_order_relaxed); }
+
+  //! Upper bound of a bin in ms, the last bin has no upper bound
+  static double GetBinUpperBound(int bin);
+
+  //! Mean and maximum latency in ms, 0 if no latency was added
+  double GetMean() const;
+  double GetMaximum() const;
+
+  /**
+   * @brief GetPercentile return the upper bound in ms of the bin which contains the given
+   * percentile, or the maximum latency if it is in the last bin
+   * @param percentile within [0, 100]
+   */
+  double GetPercentile(double percentile) const;
+
+private:
+  std::atomic<std::uint64_t> Bins[NumberOfBins];
+  std::atomic<std::uint64_t> Count;
+  /*!< Sum and maximum in microseconds */
+  std::atomic<std::uint64_t> Sum;
+  std::atomic<std::uint64_t> Maximum;
+};
+
+/**
+ * \struct StreamMetrics
+ * \brief Counters updated by the threads of a vtkLidarStream (receivers, consumer, writer,
+ * forwarder and the pipeline), to see where packets and time are lost without a debugger.
+ *
+ * Each counter is updated by a single thread and can be read from any thread.
+ */
+struct StreamMetrics
+{
+  StreamMetrics() { this->Reset(); }
+
+  void Reset();
+
+  //! Raise a high-water mark to value if it is higher, from any thread
+  static void UpdateMaximum(std::atomic<std::uint64_t>& mark, std::uint64_t value);
+
+  /**
+   * @brief Export all metrics in a field data, one array per metric: a single value for
+   * the counters, NumberOfBins values for the histograms (see LatencyHistogram), and
+   * "LatencyBinUpperBound" for the upper bounds of their bins in ms.
+   */
+  void Export(vtkFieldData* metrics) const;
+
+  // Receivers
+  std::atomic<std::uint64_t> ReceivedPackets;
+  /*!< Packets dropped by the system because the socket buffer was full, only known when
+   *   the receive is batched (see PacketReceiver::EnableBatchedReceive) */
+  std::atomic<std::uint64_t> SocketDroppedPackets;
+
+  // Queues between the receivers and the consumer/writer, see PacketRing
+  std::atomic<std::uint64_t> ConsumerQueueHighWaterMark;
+  std::atomic<std::uint64_t> ConsumerDroppedPackets;
+  std::atomic<std::uint64_t> WriterQueueHighWaterMark;
+  std::atomic<std::uint64_t> WriterDroppedPackets;
+  /*!< Packets waiting to be written, sampled by the writer */
+  std::atomic<std::uint64_t> WriterQueueDepth;
+
+  // Forwarding, see PacketForwarder
+  std::atomic<std::uint64_t> ForwarderQueueHighWaterMark;
+  std::atomic<std::uint64_t> ForwarderDroppedPackets;
+  /*!< Datagrams sent, a packet is sent once per destination of its port */
+  std::atomic<std::uint64_t> ForwardedPackets;
+  /*!< Datagrams the system refused to send (unreachable destination...) */
+  std::atomic<std::uint64_t> ForwardErrors;
+
+  // Recording, see PacketFileWriter
+  std::atomic<std::uint64_t> WrittenPackets;
+  std::atomic<std::uint64_t> WrittenBytes;
+  std::atomic<std::uint64_t> RecordedFiles;
+
+  // Frames
+  std::atomic<std::uint64_t> AssembledFrames;
+  /*!< Frames assembled but replaced by a newer one before being delivered */
+  std::atomic<std::uint64_t> DroppedFrames;
+  std::atomic<std::uint64_t> DeliveredFrames;
+  /*!< Packets lost before reaching us and azimuth ranges they left uncovered, according to
+   *   the "MissingPackets" and "AngularGaps" field data of the assembled frames */
+  std::atomic<std::uint64_t> MissingPackets;
+  std::atomic<std::uint64_t> AngularGaps;
+
+  /*!< From the reception of the first packet of a frame to the frame being available */
+  LatencyHistogram ReceiveToFrameLatency;
+  /*!< From the reception of the first packet of a frame to its delivery by RequestData */
+  LatencyHistogram ReceiveToDeliveryLatency;
+  /*!< Duration of each write and sync of the recorded files, a slow disk shows here first */
+  LatencyHistogram WriteDuration;
+};
+
+#endif // STREAMMETRICS_H
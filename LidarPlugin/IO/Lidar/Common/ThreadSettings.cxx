@@ -0,0 +1,243 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "ThreadSettings.h"
+
+// STD
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <vtkSetGet.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+//-----------------------------------------------------------------------------
+bool ParseCPU(const std::string& text, int& cpu)
+{
+  const size_t begin = text.find_first_not_of(' ');
+  const size_t end = text.find_last_not_of(' ');
+  if (begin == std::string::npos)
+  {
+    return false;
+  }
+  const std::string digits = text.substr(begin, end - begin + 1);
+  if (digits.size() > 4 || digits.find_first_not_of("0123456789") != std::string::npos)
+  {
+    return false;
+  }
+  cpu = std::stoi(digits);
+  return true;
+}
+}
+
+//-----------------------------------------------------------------------------
+std::string ThreadSettings::ToString() const
+{
+  std::ostringstream description;
+  if (this->RealTimePriority > 0)
+  {
+    description << "SCHED_FIFO " << this->RealTimePriority;
+  }
+  else
+  {
+    description << "nice " << this->Nice;
+  }
+  if (this->CPUs.empty())
+  {
+    description << ", all CPUs";
+  }
+  else
+  {
+    description << ", CPUs " << FormatCPUList(this->CPUs);
+  }
+  return description.str();
+}
+
+//-----------------------------------------------------------------------------
+bool ParseCPUList(const std::string& list, std::vector<int>& cpus)
+{
+  std::vector<int> parsedCpus;
+  if (list.find_first_not_of(' ') != std::string::npos)
+  {
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+      const size_t dash = item.find('-');
+      int first, last;
+      if (dash == std::string::npos)
+      {
+        if (!ParseCPU(item, first))
+        {
+          return false;
+        }
+        last = first;
+      }
+      else if (!ParseCPU(item.substr(0, dash), first) || !ParseCPU(item.substr(dash + 1), last) ||
+               last < first)
+      {
+        return false;
+      }
+      for (int cpu = first; cpu <= last; ++cpu)
+      {
+        parsedCpus.push_back(cpu);
+      }
+    }
+    if (parsedCpus.empty())
+    {
+      return false;
+    }
+  }
+  std::sort(parsedCpus.begin(), parsedCpus.end());
+  parsedCpus.erase(std::unique(parsedCpus.begin(), parsedCpus.end()), parsedCpus.end());
+  cpus = parsedCpus;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::string FormatCPUList(const std::vector<int>& cpus)
+{
+  std::vector<int> sortedCpus(cpus);
+  std::sort(sortedCpus.begin(), sortedCpus.end());
+  sortedCpus.erase(std::unique(sortedCpus.begin(), sortedCpus.end()), sortedCpus.end());
+  std::ostringstream list;
+  for (size_t i = 0; i < sortedCpus.size();)
+  {
+    size_t last = i;
+    while (last + 1 < sortedCpus.size() && sortedCpus[last + 1] == sortedCpus[last] + 1)
+    {
+      last++;
+    }
+    list << (i ? "," : "") << sortedCpus[i];
+    if (last > i)
+    {
+      list << "-" << sortedCpus[last];
+    }
+    i = last + 1;
+  }
+  return list.str();
+}
+
+//-----------------------------------------------------------------------------
+ThreadSettings ApplyThreadSettings(const ThreadSettings& settings, const std::string& threadName)
+{
+  ThreadSettings effectiveSettings;
+#ifdef __linux__
+  // the nice value is per thread on Linux, and is set with the id of the thread
+  const pid_t threadId = static_cast<pid_t>(syscall(SYS_gettid));
+
+  bool useNice = true;
+  int policy;
+  sched_param parameters;
+  if (settings.RealTimePriority > 0)
+  {
+    parameters.sched_priority = std::min(std::max(settings.RealTimePriority, sched_get_priority_min(SCHED_FIFO)),
+                                         sched_get_priority_max(SCHED_FIFO));
+    const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    if (error)
+    {
+      vtkGenericWarningMacro("The " << threadName << " thread can not use the real-time priority "
+                             << parameters.sched_priority << " (" << std::strerror(error)
+                             << "), it falls back to the nice value " << settings.Nice);
+    }
+    useNice = error != 0;
+  }
+  else if (pthread_getschedparam(pthread_self(), &policy, &parameters) == 0 && policy != SCHED_OTHER)
+  {
+    // the thread inherited the real-time policy of the thread which created it
+    parameters.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &parameters);
+  }
+  if (useNice && settings.Nice != 0 && setpriority(PRIO_PROCESS, threadId, settings.Nice) != 0)
+  {
+    vtkGenericWarningMacro("The " << threadName << " thread can not use the nice value "
+                           << settings.Nice << " (" << std::strerror(errno) << "), it is left unchanged");
+  }
+
+  cpu_set_t cpus;
+  if (!settings.CPUs.empty() && sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+  {
+    // only the CPUs allowed to the process can be used
+    cpu_set_t requestedCpus;
+    CPU_ZERO(&requestedCpus);
+    std::vector<int> unavailableCpus;
+    for (int cpu : settings.CPUs)
+    {
+      if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &cpus))
+      {
+        CPU_SET(cpu, &requestedCpus);
+      }
+      else
+      {
+        unavailableCpus.push_back(cpu);
+      }
+    }
+    if (!unavailableCpus.empty())
+    {
+      vtkGenericWarningMacro("The " << threadName << " thread ignores the unavailable CPUs "
+                             << FormatCPUList(unavailableCpus));
+    }
+    if (CPU_COUNT(&requestedCpus) == 0)
+    {
+      vtkGenericWarningMacro("None of the CPUs requested is available to the " << threadName
+                             << " thread, it may run on any CPU");
+    }
+    else if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(requestedCpus), &requestedCpus))
+    {
+      vtkGenericWarningMacro("The " << threadName << " thread can not be restricted to the CPUs "
+                             << FormatCPUList(settings.CPUs) << " (" << std::strerror(error) << ")");
+    }
+  }
+
+  // read back what is in use
+  if (pthread_getschedparam(pthread_self(), &policy, &parameters) == 0 && policy == SCHED_FIFO)
+  {
+    effectiveSettings.RealTimePriority = parameters.sched_priority;
+  }
+  errno = 0;
+  const int nice = getpriority(PRIO_PROCESS, threadId);
+  if (errno == 0)
+  {
+    effectiveSettings.Nice = nice;
+  }
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &cpus))
+      {
+        effectiveSettings.CPUs.push_back(cpu);
+      }
+    }
+  }
+#else
+  if (!(settings == effectiveSettings))
+  {
+    vtkGenericWarningMacro("The priority and the CPUs of the " << threadName
+                           << " thread can only be set on Linux, they are left unchanged");
+  }
+#endif
+  return effectiveSettings;
+}
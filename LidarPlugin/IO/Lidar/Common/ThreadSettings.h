@@ -0,0 +1,70 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THREADSETTINGS_H
+#define THREADSETTINGS_H
+
+// STD
+#include <string>
+#include <vector>
+
+/**
+ * @brief ThreadSettings scheduling of a thread of the stream: real-time or time-sharing
+ * priority, and the CPUs it may run on. Only applied on Linux.
+ */
+struct ThreadSettings
+{
+  //! Priority of the SCHED_FIFO policy from 1 to 99, 0 keeps the time-sharing policy
+  int RealTimePriority = 0;
+
+  //! Nice value of the time-sharing policy from -20 to 19, also used when the
+  //! real-time priority is not permitted. 0 keeps the nice value of the process
+  int Nice = 0;
+
+  //! CPUs the thread may run on, empty for all
+  std::vector<int> CPUs;
+
+  bool operator==(const ThreadSettings& other) const
+  {
+    return this->RealTimePriority == other.RealTimePriority && this->Nice == other.Nice &&
+      this->CPUs == other.CPUs;
+  }
+
+  //! Readable description, e.g. "SCHED_FIFO 50, CPUs 0-3"
+  std::string ToString() const;
+};
+
+/**
+ * @brief ParseCPUList read a list of CPUs such as "0-3,6"
+ * @param list CPUs and ranges of CPUs separated by commas, empty for all CPUs
+ * @param cpus filled with the sorted CPUs, left unchanged if the list is not valid
+ * @return false if the list is not valid
+ */
+bool ParseCPUList(const std::string& list, std::vector<int>& cpus);
+
+//! Write a list of CPUs the way ParseCPUList reads it
+std::string FormatCPUList(const std::vector<int>& cpus);
+
+/**
+ * @brief ApplyThreadSettings apply as many settings as permitted to the calling thread.
+ * A real-time priority refused by the system (CAP_SYS_NICE or RLIMIT_RTPRIO missing)
+ * falls back to the nice value, a nice value refused is ignored, and the CPUs which are
+ * not available are ignored. Each fallback is reported by a warning.
+ * @param settings settings requested
+ * @param threadName name of the thread in the warnings
+ * @return settings in use by the thread, as read back from the system, with all its CPUs listed
+ */
+ThreadSettings ApplyThreadSettings(const ThreadSettings& settings, const std::string& threadName);
+
+#endif // THREADSETTINGS_H
@@ -1,7 +1,11 @@
 #include "vtkLidarPacketInterpreter.h"
 
+#include <vtkCellArray.h>
 #include <vtkTransform.h>
 
+#include <algorithm>
+#include <sstream>
+
 namespace {
 //-----------------------------------------------------------------------------
 vtkSmartPointer<vtkCellArray> NewVertexCells(vtkIdType numberOfVerts)
@@ -20,6 +24,31 @@ vtkSmartPointer<vtkCellArray> NewVertexCells(vtkIdType numberOfVerts)
   return cellArray;
 }
 
+//-----------------------------------------------------------------------------
+// Create one vertex per point. The cells of a frame recycled by the FramePool are
+// overwritten instead of being allocated again.
+void SetVertexCells(vtkPolyData* polyData, vtkIdType numberOfVerts)
+{
+  // GetVerts returns a shared dummy cell array when the frame has no vertex
+  if (numberOfVerts == 0 || polyData->GetNumberOfVerts() == 0)
+  {
+    polyData->SetVerts(NewVertexCells(numberOfVerts));
+    return;
+  }
+
+  vtkCellArray* verts = polyData->GetVerts();
+  vtkIdType* ids = verts->WritePointer(numberOfVerts, numberOfVerts * 2);
+  // WritePointer never shrinks the array
+  verts->GetData()->SetNumberOfValues(numberOfVerts * 2);
+  for (vtkIdType i = 0; i < numberOfVerts; ++i)
+  {
+    ids[i * 2] = 1;
+    ids[i * 2 + 1] = i;
+  }
+  verts->Modified();
+  polyData->Modified();
+}
+
 //-----------------------------------------------------------------------------
 // Returns the value that is equal to x modulo mod, and that is inside to (0, mod(
 // mod must be > 0.0
@@ -64,7 +93,7 @@ bool vtkLidarPacketInterpreter::SplitFrame(bool force)
   }
 
   // add vertex to the polydata
-  this->CurrentFrame->SetVerts(NewVertexCells(this->CurrentFrame->GetNumberOfPoints()));
+  SetVertexCells(this->CurrentFrame, this->CurrentFrame->GetNumberOfPoints());
   // split the frame
   this->Frames.push_back(this->CurrentFrame);
   // create a new frame
@@ -74,6 +103,70 @@ bool vtkLidarPacketInterpreter::SplitFrame(bool force)
 }
 
 
+//-----------------------------------------------------------------------------
+vtkLidarPacketInterpreter::vtkLidarPacketInterpreter()
+{
+  this->Pool.SetMaximumNumberOfFrames(this->FramePoolSize);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarPacketInterpreter::SetFramePoolSize(int size)
+{
+  // the pool does not change the frames, there is no need to call Modified
+  this->FramePoolSize = std::max(size, 0);
+  this->Pool.SetMaximumNumberOfFrames(this->FramePoolSize);
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkLidarPacketInterpreter> vtkLidarPacketInterpreter::Clone()
+{
+  vtkSmartPointer<vtkLidarPacketInterpreter> clone;
+  clone.TakeReference(this->NewInstance());
+  clone->CopySettings(this);
+  return clone;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarPacketInterpreter::CopySettings(vtkLidarPacketInterpreter* source)
+{
+  this->CalibrationFileName = source->CalibrationFileName;
+  this->CalibrationData->DeepCopy(source->CalibrationData.Get());
+  this->CalibrationReportedNumLasers = source->CalibrationReportedNumLasers;
+  this->IsCalibrated = source->IsCalibrated;
+  this->TimeOffset = source->TimeOffset;
+  this->LaserSelection = source->LaserSelection;
+  this->DistanceResolutionM = source->DistanceResolutionM;
+  this->Frequency = source->Frequency;
+  this->IgnoreZeroDistances = source->IgnoreZeroDistances;
+  this->IgnoreEmptyFrames = source->IgnoreEmptyFrames;
+  this->ApplyTransform = source->ApplyTransform;
+  this->OutputArrays = source->OutputArrays;
+  this->UseDoublePrecision = source->UseDoublePrecision;
+  this->SetFramePoolSize(source->FramePoolSize);
+  this->SectorSize = source->SectorSize;
+  if (source->SensorTransform)
+  {
+    // the transform is copied as it is not safe to use it from several threads
+    vtkNew<vtkTransform> sensorTransform;
+    sensorTransform->DeepCopy(source->SensorTransform);
+    this->SetSensorTransform(sensorTransform.Get());
+  }
+  this->CropMode = source->CropMode;
+  this->CropOutside = source->CropOutside;
+  std::copy(source->CropRegion, source->CropRegion + 6, this->CropRegion);
+  this->ParserMetaData = source->ParserMetaData;
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarPacketInterpreter::GetFrameCatalogParameters()
+{
+  std::stringstream parameters;
+  parameters << this->GetClassName()
+             << " IgnoreZeroDistances=" << this->IgnoreZeroDistances
+             << " IgnoreEmptyFrames=" << this->IgnoreEmptyFrames;
+  return parameters.str();
+}
+
 //-----------------------------------------------------------------------------
 bool vtkLidarPacketInterpreter::shouldBeCroppedOut(double pos[3])
 {
@@ -23,6 +23,7 @@
 #include <vtkAlgorithm.h>
 
 #include "FrameInformation.h"
+#include "FramePool.h"
 
 class vtkTransform;
 
@@ -43,6 +44,28 @@ public:
     Cylindric = 3,  /*!< 3 */
   };
 
+  /**
+   * @brief The OUTPUT_ARRAYS enum to select the point data arrays of the frames.
+   * The points (float coordinates) are always computed. The interpreters skip the
+   * computation of the arrays which are not selected.
+   */
+  enum OUTPUT_ARRAYS
+  {
+    OUTPUT_XYZ = 0x1,            /*!< X, Y and Z arrays, copies of the point coordinates */
+    OUTPUT_INTENSITY = 0x2,      /*!< intensity of the return */
+    OUTPUT_LASER_ID = 0x4,       /*!< laser which measured the point */
+    OUTPUT_AZIMUTH = 0x8,        /*!< azimuth of the laser when it fired */
+    OUTPUT_DISTANCE = 0x10,      /*!< corrected distance in meters */
+    OUTPUT_RAW_DISTANCE = 0x20,  /*!< distance as given by the sensor */
+    OUTPUT_TIME = 0x40,          /*!< timestamp adjusted by the interpreter */
+    OUTPUT_RAW_TIME = 0x80,      /*!< timestamp as given by the sensor */
+    OUTPUT_VERTICAL_ANGLE = 0x100, /*!< vertical angle of the laser */
+    OUTPUT_DUAL_RETURN = 0x200,  /*!< dual return flags and matching */
+    OUTPUT_TIME_OFFSET = 0x400,  /*!< time in microseconds from the frame base time (int32) */
+    OUTPUT_ALL = 0x7FF,
+    OUTPUT_DEFAULT = 0x3FF,      /*!< all the arrays but the time offset */
+  };
+
   /**
    * @brief LoadCalibration read a provided calibration file to initialize the sensor's
    * calibration parameters (angles corrections, distances corrections, ...) which will be
@@ -78,6 +101,7 @@ public:
   /**
    * @brief CreateNewEmptyFrame construct a empty polyData with the right DataArray and allocate some
    * space. No CellArray should be created as it can be create once the frame is ready.
+   * A frame released by its consumers can be taken from Pool instead of creating a new one.
    * @param numberOfPoints indicate the space to allocate @todo change the meaning
    */
   virtual vtkSmartPointer<vtkPolyData> CreateNewEmptyFrame(vtkIdType numberOfPoints, vtkIdType prereservedNumberOfPoints = 0) = 0;
@@ -91,9 +115,48 @@ public:
    * @param packetInfo[out] Miscellaneous information about the packet
    */
   virtual bool PreProcessPacket(unsigned char const * data, unsigned int dataLength,
-                                fpos_t filePosition = fpos_t(), double packetNetworkTime = 0,
+                                int64_t filePosition = 0, double packetNetworkTime = 0,
                                 std::vector<FrameInformation>* frameCatalog = nullptr) = 0;
 
+  /**
+   * @brief GetFrameCatalogParameters return a description of the interpreter parameters
+   * which have an influence on the frame catalog built with PreProcessPacket. It is used
+   * to detect that a frame catalog saved on disk can not be reused.
+   * Subclasses must extend it if PreProcessPacket depends on other parameters.
+   */
+  virtual std::string GetFrameCatalogParameters();
+
+  /**
+   * @brief RebaseFrameInformation is used when the frame catalog is built by several
+   * parsers, each one starting at a different place of the file. A parser which does
+   * not start at the beginning of the file ignores what happened before its start
+   * (ex: timestamp rollings). Both parsers have seen the same frame at the junction,
+   * described by localReference for the late parser and reference for the other one.
+   * This function must convert a frame found by the late parser as if it was found
+   * by a parser which started at the beginning of the file.
+   * @param frame[in,out] frame information found by the late parser
+   * @param localReference junction frame information found by the late parser
+   * @param reference junction frame information found by the other parser
+   */
+  virtual void RebaseFrameInformation(FrameInformation& vtkNotUsed(frame),
+                                      const FrameInformation& vtkNotUsed(localReference),
+                                      const FrameInformation& vtkNotUsed(reference)) {}
+
+  /**
+   * @brief GetNumberOfMissingPackets return the number of lidar packets that PreProcessPacket
+   * found missing from the beginning of the file up to the given frame of the catalog, or 0
+   * if the interpreter can not detect them
+   * @param frame frame information of the catalog
+   */
+  virtual int GetNumberOfMissingPackets(const FrameInformation& vtkNotUsed(frame)) { return 0; }
+
+  /**
+   * @brief Clone create a new interpreter of the same type with the same calibration and
+   * the same settings, which can then be used independently (ex: in another thread).
+   * The frames under construction are not copied.
+   */
+  vtkSmartPointer<vtkLidarPacketInterpreter> Clone();
+
   /**
    * @brief IsLidarPacket check if the given packet is really a lidar packet
    * @param data raw data packet
@@ -118,6 +181,16 @@ public:
    */
   vtkSmartPointer<vtkPolyData> GetLastFrameAvailable() { return this->Frames.back(); }
 
+  /**
+   * @brief GetFramesAvailable return the frames that have been process completely, in the
+   * order of their completion. A packet may complete several of them when the sectors are
+   * narrower than the packet, see SectorSize
+   */
+  const std::vector<vtkSmartPointer<vtkPolyData> >& GetFramesAvailable() const
+  {
+    return this->Frames;
+  }
+
   /**
    * @brief ClearAllFramesAvailable delete all frames that have been process
    */
@@ -169,9 +242,17 @@ public:
   /**
    * @copydoc LidarPacketInterpreter::LaserSelection
    */
-  virtual void SetLaserSelection(const bool* v) { this->LaserSelection = std::vector<bool>(v, v + this->CalibrationReportedNumLasers); }
+  virtual void SetLaserSelection(const bool* v) { this->SetLaserSelection(std::vector<bool>(v, v + this->CalibrationReportedNumLasers)); }
   virtual void GetLaserSelection(bool* v) { std::copy(this->LaserSelection.begin(), this->LaserSelection.end(), v);}
-  virtual void SetLaserSelection(const std::vector<bool>& v) { this->LaserSelection = v; }
+  //! The frames decoded with another selection are outdated, see vtkLidarProvider::GetMTime
+  virtual void SetLaserSelection(const std::vector<bool>& v)
+  {
+    if (v != this->LaserSelection)
+    {
+      this->LaserSelection = v;
+      this->Modified();
+    }
+  }
   virtual std::vector<bool> GetLaserSelection() const { return this->LaserSelection; }
 
   vtkGetMacro(DistanceResolutionM, double)
@@ -200,9 +281,28 @@ public:
 
   vtkSetVector6Macro(CropRegion, double)
 
+  vtkGetMacro(OutputArrays, int)
+  vtkSetMacro(OutputArrays, int)
+
+  vtkGetMacro(UseDoublePrecision, bool)
+  vtkSetMacro(UseDoublePrecision, bool)
+
+  vtkGetMacro(FramePoolSize, int)
+  virtual void SetFramePoolSize(int size);
+
+  vtkGetMacro(SectorSize, double)
+  vtkSetClampMacro(SectorSize, double, 0., 360.)
+
   vtkMTimeType GetMTime() override;
 
 protected:
+  /**
+   * @brief CopySettings copy the calibration and the settings of another interpreter of
+   * the same type, used by Clone. Subclasses must extend it with their own calibration
+   * and settings.
+   */
+  virtual void CopySettings(vtkLidarPacketInterpreter* source);
+
   /**
    * @brief shouldBeCroppedOut Returns true if a point should be removed,
    * i.e. if it lays *outside* the cropping volume.
@@ -224,6 +324,19 @@ protected:
   //! Frame under construction
   vtkSmartPointer<vtkPolyData> CurrentFrame;
 
+  //! Last frames created, reused by CreateNewEmptyFrame once released by their consumers
+  FramePool Pool;
+
+  //! Number of frames tracked by Pool, 0 disables the reuse of the frames
+  int FramePoolSize = 4;
+
+  //! Angular size in degrees of the sectors in which ProcessPacket splits the frames as
+  //! soon as the sensor has swept them, to hand the points over without waiting for the
+  //! end of the rotation. The frames are then tagged with their "SectorIndex" and the
+  //! "FrameId" of their rotation. 0 splits the frames at the end of the rotations only.
+  //! The frame catalog built by PreProcessPacket does not depend on it.
+  double SectorSize = 0;
+
   //! File containing all calibration information
   std::string CalibrationFileName = "";
 
@@ -264,6 +377,16 @@ protected:
   //! Fixed transform to apply to the Lidar points.
   vtkTransform* SensorTransform = nullptr;
 
+  //! Combination of OUTPUT_ARRAYS flags, the point data arrays of the frames. The frames
+  //! also have the "FrameBaseTime" field data (int64), time in nanoseconds of their first
+  //! packet on a timeline which keeps increasing when the sensor time rolls over: the time
+  //! of a point is FrameBaseTime + 1000 * time_offset
+  int OutputArrays = OUTPUT_DEFAULT;
+
+  //! Store the real valued arrays (coordinates, distances, angles) as double instead of
+  //! float. The timestamps are always stored as double.
+  bool UseDoublePrecision = true;
+
   //! Indicate which cropping mode should be used.
   int CropMode = CROP_MODE::None;
 
@@ -286,7 +409,7 @@ protected:
   //! all distances are in meters and all angles are in degrees
   double CropRegion[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
 
-  vtkLidarPacketInterpreter() = default;
+  vtkLidarPacketInterpreter();
   virtual ~vtkLidarPacketInterpreter() = default;
 
 private:
@@ -1,18 +1,180 @@
 #include "vtkLidarReader.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
 #include <sstream>
 
+#include <boost/thread/thread.hpp>
+
+#include "FrameIndexFile.h"
+#include "FramePrefetcher.h"
 #include "vtkLidarPacketInterpreter.h"
 #include "vtkPacketFileWriter.h"
-#include "vtkPacketFileReader.h"
+#include "vtkPacketFileMappedReader.h"
 #include "statistics.h"
 
 #include <vtkInformationVector.h>
 #include <vtkInformation.h>
 #include <vtkStreamingDemandDrivenPipeline.h>
 
+namespace
+{
+//! Minimum number of bytes read by each thread when the frame catalog is built
+//! in parallel, smaller files are read sequentially
+constexpr int64_t MinimumChunkSize = int64_t(64) << 20;
+
+//! A chunk is stitched to the previous one on the first frame which starts at least
+//! this number of bytes after the beginning of the chunk. Before that, the parser of
+//! the chunk may not be in the same state as a parser which started at the beginning
+//! of the file (it has just started to follow the azimuths, ...)
+constexpr int64_t StitchingMargin = int64_t(1) << 20;
+
+//! Number of consecutive frames decoded by a thread when the frames are decoded in
+//! parallel. Only the first frame of a block requires a seek, the next ones are decoded
+//! by carrying on the reading
+constexpr int DecodingBlockSize = 8;
+
+//! Maximum number of blocks decoded in advance by each thread when the frames are
+//! decoded in parallel, to bound the memory used by the frames waiting for the callback
+constexpr int DecodingBlocksPerThread = 2;
+
+/**
+ * @brief FrameCatalogChunk part of the pcap file indexed by one thread
+ */
+struct FrameCatalogChunk
+{
+  //! Offset of the first record of the chunk
+  int64_t Begin = 0;
+
+  //! Offset of the first record of the next chunk, -1 for the last chunk
+  int64_t End = -1;
+
+  //! Frames found from Begin until the first frame which starts after End + StitchingMargin
+  //! (included), this last frame is also found by the parser of the next chunk
+  std::vector<FrameInformation> Catalog;
+
+  //! True if the end of the file was reached before End + StitchingMargin
+  bool ReachedEndOfFile = false;
+};
+
+//-----------------------------------------------------------------------------
+std::string GetPcapFilter(int lidarPort)
+{
+  std::string filterPCAP = "udp";
+  if (lidarPort != -1)
+  {
+    filterPCAP += " port " + std::to_string(lidarPort);
+  }
+  return filterPCAP;
+}
+
+//-----------------------------------------------------------------------------
+void BuildChunkFrameCatalog(vtkPacketFileReader* reader, vtkLidarPacketInterpreter* interpreter,
+                            FrameCatalogChunk& chunk, bool isFirstChunk,
+                            const std::function<void()>& progress)
+{
+  const unsigned char* data = 0;
+  unsigned int dataLength = 0;
+  bool firstIteration = isFirstChunk;
+  int64_t lastFilePosition = chunk.Begin;
+  double lastPacketNetworkTime = 0;
+  const int64_t stitchingPosition = chunk.End + StitchingMargin;
+  reader->SetFilePosition(&lastFilePosition);
+
+  while (reader->NextPacket(data, dataLength, lastPacketNetworkTime))
+  {
+    if (progress)
+    {
+      progress();
+    }
+
+    if (!interpreter->IsLidarPacket(data, dataLength))
+    {
+      reader->GetFilePosition(&lastFilePosition);
+      continue;
+    }
+
+    // see vtkLidarReader::BuildFrameCatalog
+    if (firstIteration)
+    {
+      chunk.Catalog.push_back(interpreter->GetParserMetaData());
+      firstIteration = false;
+    }
+
+    bool isNewFrame = interpreter->PreProcessPacket(data, dataLength, lastFilePosition,
+                                                    lastPacketNetworkTime, &chunk.Catalog);
+
+    // stop once the frame used to stitch the next chunk has been found
+    if (chunk.End >= 0 && isNewFrame && lastFilePosition >= stitchingPosition)
+    {
+      return;
+    }
+    reader->GetFilePosition(&lastFilePosition);
+  }
+  chunk.ReachedEndOfFile = true;
+}
+}
+
 //-----------------------------------------------------------------------------
 int vtkLidarReader::ReadFrameInformation()
+{
+  FrameIndexFile indexFile(this->FileName, this->LidarPort,
+                           this->Interpreter->GetFrameCatalogParameters());
+
+  // reset the interpreter parser meta data
+  this->Interpreter->ResetParserMetaData();
+  this->Cache.Clear();
+  this->Prefetcher.reset();
+  this->LiveFrameIndex = -1;
+
+  this->FrameCatalogLoadedFromFile = this->UseFrameIndexFile &&
+    indexFile.Load(this->Interpreter->GetParserMetaData(), this->FrameCatalog);
+  if (this->FrameCatalogLoadedFromFile)
+  {
+    if (!this->Interpreter->GetIsCalibrated())
+    {
+      this->ReadCalibrationFromFile();
+    }
+  }
+  else
+  {
+    if (!this->BuildFrameCatalogInParallel())
+    {
+      this->Interpreter->ResetParserMetaData();
+      this->BuildFrameCatalog();
+    }
+    // a catalog with only one frame means that the pcap could not be parsed
+    if (this->UseFrameIndexFile && this->FrameCatalog.size() > 1)
+    {
+      indexFile.Save(this->FrameCatalog);
+    }
+  }
+
+  if (this->FrameCatalog.size() == 1)
+  {
+    vtkErrorMacro("The reader could not parse the pcap file")
+  }
+
+  this->NetworkTimeToDataTime = 0.0; // default value if no frames seen
+  if (this->FrameCatalog.size() > 0)
+  {
+      std::vector<double> diffs(this->FrameCatalog.size());
+      for (size_t i = 0; i < this->FrameCatalog.size(); i++)
+      {
+          diffs[i] = this->FrameCatalog[i].FirstPacketDataTime - this->FrameCatalog[i].FirstPacketNetworkTime;
+      }
+      this->NetworkTimeToDataTime = ComputeMedian(diffs);
+  }
+
+  return this->GetNumberOfFrames();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarReader::BuildFrameCatalog()
 {
   this->Open();
   const unsigned char* data = 0;
@@ -22,13 +184,10 @@ int vtkLidarReader::ReadFrameInformation()
   // reset the frame catalog to build a new one
   this->FrameCatalog.clear();
 
-  // reset the interpreter parser meta data
-  this->Interpreter->ResetParserMetaData();
-
   // keep track of the file position
   // and the network timestamp of the
   // current udp packet to process
-  fpos_t lastFilePosition;
+  int64_t lastFilePosition = 0;
   double lastPacketNetworkTime = 0;
   this->Reader->GetFilePosition(&lastFilePosition);
 
@@ -65,24 +224,166 @@ int vtkLidarReader::ReadFrameInformation()
 
     this->Reader->GetFilePosition(&lastFilePosition);
   }
+}
 
-  if (this->FrameCatalog.size() == 1)
+//-----------------------------------------------------------------------------
+bool vtkLidarReader::BuildFrameCatalogInParallel()
+{
+  int numberOfThreads = this->NumberOfIndexingThreads > 0
+    ? this->NumberOfIndexingThreads
+    : static_cast<int>(boost::thread::hardware_concurrency());
+  if (numberOfThreads <= 1)
   {
-    vtkErrorMacro("The reader could not parse the pcap file")
+    return false;
   }
 
-  this->NetworkTimeToDataTime = 0.0; // default value if no frames seen
-  if (this->FrameCatalog.size() > 0)
+  // the chunks are found thanks to the memory mapping of the file
+  this->Open();
+  vtkPacketFileMappedReader* mappedReader = dynamic_cast<vtkPacketFileMappedReader*>(this->Reader);
+  if (!mappedReader || !mappedReader->IsMapped())
   {
-      std::vector<double> diffs(this->FrameCatalog.size());
-      for (size_t i = 0; i < this->FrameCatalog.size(); i++)
-      {
-          diffs[i] = this->FrameCatalog[i].FirstPacketDataTime - this->FrameCatalog[i].FirstPacketNetworkTime;
-      }
-      this->NetworkTimeToDataTime = ComputeMedian(diffs);
+    return false;
+  }
+  const int64_t fileSize = mappedReader->GetFileSize();
+  numberOfThreads =
+    static_cast<int>(std::min<int64_t>(numberOfThreads, fileSize / MinimumChunkSize));
+  if (numberOfThreads <= 1)
+  {
+    return false;
   }
 
-  return this->GetNumberOfFrames();
+  // split the file in chunks starting on a pcap record
+  std::vector<FrameCatalogChunk> chunks(1);
+  this->Reader->GetFilePosition(&chunks[0].Begin);
+  for (int i = 1; i < numberOfThreads; ++i)
+  {
+    int64_t begin = mappedReader->FindNextRecord(fileSize / numberOfThreads * i);
+    if (begin < 0)
+    {
+      break;
+    }
+    if (begin <= chunks.back().Begin)
+    {
+      continue;
+    }
+    chunks.back().End = begin;
+    chunks.emplace_back();
+    chunks.back().Begin = begin;
+  }
+  if (chunks.size() < 2)
+  {
+    return false;
+  }
+
+  // each thread needs its own reader and its own interpreter, as PreProcessPacket
+  // changes the interpreter state. The calibration contained in the pcap (if any) is
+  // only read by the reader interpreter, hence the clones are marked as calibrated.
+  const std::string filterPCAP = GetPcapFilter(this->LidarPort);
+  std::vector<std::unique_ptr<vtkPacketFileMappedReader> > readers;
+  std::vector<vtkSmartPointer<vtkLidarPacketInterpreter> > interpreters;
+  for (size_t i = 1; i < chunks.size(); ++i)
+  {
+    readers.emplace_back(new vtkPacketFileMappedReader);
+    if (!readers.back()->Open(this->FileName, filterPCAP) || !readers.back()->IsMapped())
+    {
+      return false;
+    }
+    vtkSmartPointer<vtkLidarPacketInterpreter> interpreter = this->Interpreter->Clone();
+    interpreter->SetIsCalibrated(true);
+    interpreter->ResetParserMetaData();
+    interpreters.push_back(interpreter);
+  }
+
+  std::vector<boost::thread> threads;
+  for (size_t i = 1; i < chunks.size(); ++i)
+  {
+    vtkPacketFileReader* reader = readers[i - 1].get();
+    vtkLidarPacketInterpreter* interpreter = interpreters[i - 1];
+    FrameCatalogChunk& chunk = chunks[i];
+    threads.emplace_back([reader, interpreter, &chunk]() {
+      BuildChunkFrameCatalog(reader, interpreter, chunk, false, std::function<void()>());
+    });
+  }
+
+  // The first chunk is read by the main thread with the reader interpreter, so that
+  // the calibration contained in the pcap (if any) is read as usual
+  BuildChunkFrameCatalog(this->Reader, this->Interpreter, chunks[0], true,
+                         [this]() { this->UpdateProgress(0.0); });
+  for (boost::thread& thread : threads)
+  {
+    while (!thread.try_join_for(boost::chrono::milliseconds(100)))
+    {
+      this->UpdateProgress(0.0);
+    }
+  }
+
+  // Stitch the chunks: the last frame found in a chunk is the first frame found in
+  // the next one after the stitching margin. Both parsers must agree on it,
+  // otherwise the file is read again sequentially.
+  std::vector<FrameInformation> catalog = chunks[0].Catalog;
+  for (size_t i = 1; i < chunks.size() && !chunks[i - 1].ReachedEndOfFile; ++i)
+  {
+    if (catalog.empty())
+    {
+      return false;
+    }
+    const FrameInformation reference = catalog.back();
+    const std::vector<FrameInformation>& chunkCatalog = chunks[i].Catalog;
+    const int64_t stitchingPosition = chunks[i].Begin + StitchingMargin;
+    auto localReference = std::find_if(chunkCatalog.begin(), chunkCatalog.end(),
+      [stitchingPosition](const FrameInformation& frame)
+        { return frame.FilePosition >= stitchingPosition; });
+    if (localReference == chunkCatalog.end() ||
+        localReference->FilePosition != reference.FilePosition ||
+        localReference->FirstPacketNetworkTime != reference.FirstPacketNetworkTime ||
+        localReference->FirstPacketDataTime != reference.FirstPacketDataTime)
+    {
+      return false;
+    }
+    for (auto it = localReference + 1; it != chunkCatalog.end(); ++it)
+    {
+      FrameInformation frame = *it;
+      this->Interpreter->RebaseFrameInformation(frame, *localReference, reference);
+      catalog.push_back(frame);
+    }
+  }
+
+  this->FrameCatalog.swap(catalog);
+  if (!this->Interpreter->GetIsCalibrated())
+  {
+    this->ReadCalibrationFromFile();
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarReader::ReadCalibrationFromFile()
+{
+  this->Open();
+  if (!this->Reader)
+  {
+    return;
+  }
+  const unsigned char* data = 0;
+  unsigned int dataLength = 0;
+  double timeSinceStart = 0;
+
+  // Since the PreProcessPacket method of the interpreter can change
+  // its internal state, we store and then restore the contained meta
+  // data
+  FrameInformation storedMetaData = this->Interpreter->GetParserMetaData();
+
+  while (!this->Interpreter->GetIsCalibrated() &&
+         this->Reader->NextPacket(data, dataLength, timeSinceStart))
+  {
+    this->UpdateProgress(0.0);
+    if (this->Interpreter->IsLidarPacket(data, dataLength))
+    {
+      this->Interpreter->PreProcessPacket(data, dataLength);
+    }
+  }
+  this->Interpreter->SetParserMetaData(storedMetaData);
+  this->Close();
 }
 
 //-----------------------------------------------------------------------------
@@ -128,6 +429,54 @@ void vtkLidarReader::SetTimestepInformation(vtkInformation *info)
 //-----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkLidarReader)
 
+//-----------------------------------------------------------------------------
+vtkLidarReader::vtkLidarReader()
+{
+  this->Cache.SetMemoryBudget(static_cast<unsigned long>(this->FrameCacheMemoryBudget) << 10);
+}
+
+//-----------------------------------------------------------------------------
+vtkLidarReader::~vtkLidarReader()
+{
+  // stop the prefetching thread before the interpreter is released
+  this->Prefetcher.reset();
+  this->Close();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarReader::SetFrameCacheMemoryBudget(int budget)
+{
+  budget = std::max(budget, 0);
+  // the output does not depend on the cache, so the reader is not modified
+  this->FrameCacheMemoryBudget = budget;
+  this->Cache.SetMemoryBudget(static_cast<unsigned long>(budget) << 10);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarReader::SetNumberOfPrefetchedFrames(int numberOfFrames)
+{
+  numberOfFrames = std::max(numberOfFrames, 0);
+  if (numberOfFrames != this->NumberOfPrefetchedFrames)
+  {
+    // the output does not depend on the prefetching, so the reader is not modified
+    this->NumberOfPrefetchedFrames = numberOfFrames;
+    this->Prefetcher.reset();
+  }
+}
+
+//-----------------------------------------------------------------------------
+FramePrefetcher* vtkLidarReader::GetPrefetcher()
+{
+  if (!this->Prefetcher || this->PrefetcherMTime != this->GetMTime())
+  {
+    this->Prefetcher.reset();
+    this->PrefetcherMTime = this->GetMTime();
+    this->Prefetcher.reset(new FramePrefetcher(this->FileName, GetPcapFilter(this->LidarPort),
+      this->Interpreter->Clone(), this->FrameCatalog, this->NumberOfPrefetchedFrames));
+  }
+  return this->Prefetcher->IsRunning() ? this->Prefetcher.get() : nullptr;
+}
+
 //-----------------------------------------------------------------------------
 void vtkLidarReader::SetFileName(const std::string &filename)
 {
@@ -138,15 +487,15 @@ void vtkLidarReader::SetFileName(const std::string &filename)
 
   this->FileName = filename;
   this->FrameCatalog.clear();
+  this->Cache.Clear();
+  this->Prefetcher.reset();
+  this->Close();
   this->Modified();
 }
 
 //-----------------------------------------------------------------------------
 vtkSmartPointer<vtkPolyData> vtkLidarReader::GetFrame(int frameNumber)
 {
-  this->Interpreter->ResetCurrentFrame();
-  this->Interpreter->ClearAllFramesAvailable();
-
   if (!this->Reader)
   {
     vtkErrorMacro("GetFrame() called but packet file reader is not open.");
@@ -158,35 +507,233 @@ vtkSmartPointer<vtkPolyData> vtkLidarReader::GetFrame(int frameNumber)
     return 0;
   }
 
+  vtkSmartPointer<vtkPolyData> frame = vtkLidarReader::ReadFrame(this->Reader, this->Interpreter,
+                                                                 this->FrameCatalog[frameNumber]);
+  this->LiveFrameIndex = frameNumber;
+  this->LiveFrameMTime = this->GetMTime();
+  return frame;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> vtkLidarReader::ReadFrame(vtkPacketFileReader* reader,
+                                                       vtkLidarPacketInterpreter* interpreter,
+                                                       const FrameInformation& frameInformation)
+{
+  interpreter->ResetCurrentFrame();
+
+  // Update the interpreter meta data according to the requested frame
+  FrameInformation currInfo = frameInformation;
+  interpreter->SetParserMetaData(frameInformation);
+  reader->SetFilePosition(&currInfo.FilePosition);
+
+  return vtkLidarReader::ReadNextFrame(reader, interpreter);
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> vtkLidarReader::ReadNextFrame(vtkPacketFileReader* reader,
+                                                           vtkLidarPacketInterpreter* interpreter)
+{
+  interpreter->ClearAllFramesAvailable();
+
   const unsigned char* data = 0;
   unsigned int dataLength = 0;
   double timeSinceStart;
 
-  // Update the interpreter meta data according to the requested frame
-  FrameInformation currInfo= this->FrameCatalog[frameNumber];
-  this->Interpreter->SetParserMetaData(this->FrameCatalog[frameNumber]);
-  this->Reader->SetFilePosition(&currInfo.FilePosition);
-
-  while (this->Reader->NextPacket(data, dataLength, timeSinceStart))
+  while (reader->NextPacket(data, dataLength, timeSinceStart))
   {
     // If the current packet is not a lidar packet,
     // skip it and update the file position
-    if (!this->Interpreter->IsLidarPacket(data, dataLength))
+    if (!interpreter->IsLidarPacket(data, dataLength))
     {
       continue;
     }
 
     // Process the lidar packet and check
     // if the required frame is ready
-    this->Interpreter->ProcessPacket(data, dataLength);
-    if (this->Interpreter->IsNewFrameReady())
+    interpreter->ProcessPacket(data, dataLength);
+    if (interpreter->IsNewFrameReady())
     {
-      return this->Interpreter->GetLastFrameAvailable();
+      return interpreter->GetLastFrameAvailable();
     }
   }
 
-  this->Interpreter->SplitFrame(true);
-  return this->Interpreter->GetLastFrameAvailable();
+  interpreter->SplitFrame(true);
+  return interpreter->GetLastFrameAvailable();
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarReader::ForEachFrame(int first, int last, int stride,
+                                 const std::function<bool(int, vtkPolyData*)>& callback)
+{
+  if (first < 0 || first > last || last >= this->GetNumberOfFrames() || stride < 1)
+  {
+    vtkErrorMacro("Invalid frame range requested: [" << first << ", " << last
+                  << "] with a stride of " << stride << ". Have "
+                  << this->GetNumberOfFrames() << " frames.");
+    return 0;
+  }
+
+  int numberOfFrames = this->ForEachFrameInParallel(first, last, stride, callback);
+  if (numberOfFrames >= 0)
+  {
+    return numberOfFrames;
+  }
+
+  numberOfFrames = 0;
+  for (int frameIndex = first; frameIndex <= last; frameIndex += stride)
+  {
+    vtkSmartPointer<vtkPolyData> frame = this->DecodeFrame(frameIndex);
+    if (!frame)
+    {
+      break;
+    }
+    numberOfFrames++;
+    if (!callback(frameIndex, frame))
+    {
+      break;
+    }
+  }
+  return numberOfFrames;
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarReader::ForEachFrameInParallel(int first, int last, int stride,
+                                           const std::function<bool(int, vtkPolyData*)>& callback)
+{
+  int numberOfThreads = this->NumberOfDecodingThreads > 0
+    ? this->NumberOfDecodingThreads
+    : static_cast<int>(boost::thread::hardware_concurrency());
+  const int numberOfFramesToDecode = (last - first) / stride + 1;
+  const int numberOfBlocks = (numberOfFramesToDecode + DecodingBlockSize - 1) / DecodingBlockSize;
+  numberOfThreads = std::min(numberOfThreads, numberOfBlocks);
+  if (numberOfThreads <= 1 || !this->Interpreter->GetIsCalibrated())
+  {
+    return -1;
+  }
+
+  // each thread needs its own reader and its own interpreter, as the decoding
+  // changes the interpreter state
+  const std::string filterPCAP = GetPcapFilter(this->LidarPort);
+  std::vector<std::unique_ptr<vtkPacketFileMappedReader> > readers;
+  std::vector<vtkSmartPointer<vtkLidarPacketInterpreter> > interpreters;
+  for (int i = 0; i < numberOfThreads; ++i)
+  {
+    readers.emplace_back(new vtkPacketFileMappedReader);
+    if (!readers.back()->Open(this->FileName, filterPCAP))
+    {
+      return -1;
+    }
+    interpreters.push_back(this->Interpreter->Clone());
+  }
+
+  // The blocks of consecutive frames are taken in order by the threads, and the frames
+  // are given to the callback in order by the calling thread. The frames are indexed
+  // by their position in the range.
+  boost::mutex mutex;
+  boost::condition_variable condition;
+  std::map<int, vtkSmartPointer<vtkPolyData> > decodedFrames;
+  int nextBlock = 0;
+  int nextFrameToDeliver = 0;
+  bool shouldStop = false;
+  const int maximumFramesInAdvance = numberOfThreads * DecodingBlocksPerThread * DecodingBlockSize;
+
+  auto decodeBlocks = [&](vtkPacketFileReader* reader, vtkLidarPacketInterpreter* interpreter) {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!shouldStop && nextBlock < numberOfBlocks)
+    {
+      const int begin = nextBlock * DecodingBlockSize;
+      if (begin >= nextFrameToDeliver + maximumFramesInAdvance)
+      {
+        condition.wait(lock);
+        continue;
+      }
+      nextBlock++;
+      const int end = std::min(begin + DecodingBlockSize, numberOfFramesToDecode);
+
+      for (int i = begin; i < end && !shouldStop; ++i)
+      {
+        lock.unlock();
+        const int frameIndex = first + i * stride;
+        vtkSmartPointer<vtkPolyData> frame = (i == begin || stride != 1)
+          ? vtkLidarReader::ReadFrame(reader, interpreter, this->FrameCatalog[frameIndex])
+          : vtkLidarReader::ReadNextFrame(reader, interpreter);
+        lock.lock();
+        decodedFrames[i] = frame;
+        condition.notify_all();
+      }
+    }
+  };
+
+  std::vector<boost::thread> threads;
+  for (int i = 0; i < numberOfThreads; ++i)
+  {
+    vtkPacketFileReader* reader = readers[i].get();
+    vtkLidarPacketInterpreter* interpreter = interpreters[i];
+    threads.emplace_back([&decodeBlocks, reader, interpreter]() {
+      decodeBlocks(reader, interpreter);
+    });
+  }
+
+  int numberOfFrames = 0;
+  for (int i = 0; i < numberOfFramesToDecode; ++i)
+  {
+    vtkSmartPointer<vtkPolyData> frame;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      auto it = decodedFrames.find(i);
+      while (it == decodedFrames.end())
+      {
+        condition.wait(lock);
+        it = decodedFrames.find(i);
+      }
+      frame = it->second;
+      decodedFrames.erase(it);
+      nextFrameToDeliver = i + 1;
+    }
+    condition.notify_all();
+
+    if (!frame)
+    {
+      break;
+    }
+    numberOfFrames++;
+    if (!callback(first + i * stride, frame))
+    {
+      break;
+    }
+  }
+
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    shouldStop = true;
+  }
+  condition.notify_all();
+  for (boost::thread& thread : threads)
+  {
+    thread.join();
+  }
+  return numberOfFrames;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> vtkLidarReader::DecodeFrame(int frameIndex)
+{
+  // the next frame is already being decoded by the interpreter
+  if (this->Reader && this->LiveFrameIndex >= 0 && frameIndex == this->LiveFrameIndex + 1 &&
+      this->LiveFrameMTime == this->GetMTime())
+  {
+    vtkSmartPointer<vtkPolyData> frame =
+      vtkLidarReader::ReadNextFrame(this->Reader, this->Interpreter);
+    this->LiveFrameIndex = frameIndex;
+    this->LiveFrameMTime = this->GetMTime();
+    return frame;
+  }
+
+  if (!this->Reader)
+  {
+    this->Open();
+  }
+  return this->GetFrame(frameIndex);
 }
 
 //-----------------------------------------------------------------------------
@@ -217,27 +764,50 @@ int vtkLidarReader::GetFrameIndexForPacketTime(double packetTime)
 //-----------------------------------------------------------------------------
 int vtkLidarReader::GetFrameIndexForDataTime(double dataTime)
 {
-  // iterating over all timesteps until finding the first one with a greater time value
+  return this->GetFrameIndexForDataTimeNs(static_cast<vtkTypeInt64>(std::llround(dataTime * 1e9)));
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarReader::GetFrameIndexForDataTimeNs(vtkTypeInt64 dataTime)
+{
+  // the frames are sorted by data time, as it keeps increasing when the sensor time rolls over
   auto idx = std::lower_bound(this->FrameCatalog.begin(),
                               this->FrameCatalog.end(),
                               dataTime,
-                              [](FrameInformation& fp, double d)
-                                { return fp.FirstPacketDataTime < d; });
+                              [](const FrameInformation& fp, vtkTypeInt64 t)
+                                { return fp.FirstPacketDataTimeNs < t; });
   auto frameRequested = std::distance(this->FrameCatalog.begin(), idx);
   return static_cast<int>(frameRequested);
 }
 
 //-----------------------------------------------------------------------------
-void vtkLidarReader::Open()
+int vtkLidarReader::GetNumberOfMissingPackets()
 {
-  this->Close();
-  this->Reader = new vtkPacketFileReader;
+  if (this->FrameCatalog.empty())
+  {
+    return 0;
+  }
+  return this->Interpreter->GetNumberOfMissingPackets(this->FrameCatalog.back());
+}
 
-  std::string filterPCAP = "udp";
-  if (this->LidarPort != -1)
+//-----------------------------------------------------------------------------
+int vtkLidarReader::GetNumberOfMissingPacketsInFrame(int frameNumber)
+{
+  if (frameNumber < 0 || frameNumber + 1 >= this->GetNumberOfFrames())
   {
-    filterPCAP += " port " + std::to_string(this->LidarPort);
+    return 0;
   }
+  return this->Interpreter->GetNumberOfMissingPackets(this->FrameCatalog[frameNumber + 1])
+    - this->Interpreter->GetNumberOfMissingPackets(this->FrameCatalog[frameNumber]);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarReader::Open()
+{
+  this->Close();
+  this->Reader = new vtkPacketFileMappedReader;
+
+  std::string filterPCAP = GetPcapFilter(this->LidarPort);
   if (!this->Reader->Open(this->FileName, filterPCAP.c_str()))
   {
     vtkErrorMacro(<< "Failed to open packet file: " << this->FileName << "!\n"
@@ -251,6 +821,7 @@ void vtkLidarReader::Close()
 {
   delete this->Reader;
   this->Reader = 0;
+  this->LiveFrameIndex = -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -261,6 +832,8 @@ void vtkLidarReader::SaveFrame(int startFrame, int endFrame, const std::string &
     vtkErrorMacro("SaveFrame() called but packet file reader is not open.")
     return;
   }
+  // the reader is moved, the next frame decoded will need a seek
+  this->LiveFrameIndex = -1;
 
   vtkPacketFileWriter writer;
   if (!writer.Open(filename))
@@ -279,8 +852,8 @@ void vtkLidarReader::SaveFrame(int startFrame, int endFrame, const std::string &
     endFrame++;
   }
 
-  // because fpos_t is plateform specific and should not be used for comparaison
-  // it's not possible to simply interate from FiePositions[start] to FilePositions[end]
+  // the first packet of a frame can also contain the end of the previous one,
+  // so it's not possible to simply interate from FilePositions[start] to FilePositions[end]
   // we need to detect new frame in the pcap directly once again
   pcap_pkthdr* header = 0;
   const unsigned char* data = 0;
@@ -343,6 +916,9 @@ void vtkLidarReader::SetLidarPort(int _arg)
   {
     this->LidarPort = _arg;
     this->FrameCatalog.clear();
+    this->Cache.Clear();
+    this->Prefetcher.reset();
+    this->Close();
     this->Modified();
   }
 }
@@ -405,10 +981,12 @@ int vtkLidarReader::RequestData(vtkInformation *vtkNotUsed(request),
     return 0;
   }
 
+  // step between the two last requests, used to guess the next frame requested
+  int step = frameRequested - this->LastFrameProcessed;
+
   // detect frame dropping
   if (this->DetectFrameDropping)
   {
-    int step = frameRequested - this->LastFrameProcessed;
     if (step > 1)
     {
       std::stringstream text;
@@ -419,10 +997,30 @@ int vtkLidarReader::RequestData(vtkInformation *vtkNotUsed(request),
   }
   this->LastFrameProcessed = frameRequested;
 
-  //! @todo we should no open the pcap file everytime a frame is requested !!!
-  this->Open();
-  output->ShallowCopy(this->GetFrame(frameRequested));
-  this->Close();
+  // a frame already decoded with the same settings is taken from the cache,
+  // or from the frames decoded in advance by the prefetcher
+  FramePrefetcher* prefetcher =
+    this->NumberOfPrefetchedFrames > 0 ? this->GetPrefetcher() : nullptr;
+  vtkSmartPointer<vtkPolyData> frame = this->Cache.Get(frameRequested, this->GetMTime());
+  if (!frame && prefetcher)
+  {
+    frame = prefetcher->Take(frameRequested);
+  }
+  if (!frame)
+  {
+    // the pcap file is kept open between two requests, so that consecutive frames
+    // are decoded without seeking
+    frame = this->DecodeFrame(frameRequested);
+  }
+  this->Cache.Insert(frameRequested, this->GetMTime(), frame);
+  output->ShallowCopy(frame);
+
+  // a jump bigger than the number of prefetched frames is a seek, not a playback
+  if (prefetcher)
+  {
+    prefetcher->SetPlaybackPosition(frameRequested,
+      std::abs(step) <= this->NumberOfPrefetchedFrames ? step : 0);
+  }
 
   return 1;
 }
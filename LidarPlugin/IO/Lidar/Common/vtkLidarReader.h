@@ -17,7 +17,12 @@
 #define VTKLIDARREADER_H
 
 #include "vtkLidarProvider.h"
+#include "FrameCache.h"
 
+#include <functional>
+#include <memory>
+
+class FramePrefetcher;
 class vtkPacketFileReader;
 
 //! @todo a decition should be made if the opening/closing of the pcap should be handle by
@@ -30,6 +35,9 @@ public:
 
   int GetNumberOfFrames() override { return this->FrameCatalog.size(); }
 
+  //! Information of each frame of the pcap file, see ReadFrameInformation
+  const std::vector<FrameInformation>& GetFrameCatalog() const { return this->FrameCatalog; }
+
   /**
    * @copydoc FileName
    */
@@ -41,12 +49,64 @@ public:
    */
   vtkGetMacro(NetworkTimeToDataTime, double)
 
+  /**
+   * @brief GetNumberOfMissingPackets return the number of lidar packets found missing while
+   * building the frame catalog, see vtkLidarPacketInterpreter::GetNumberOfMissingPackets.
+   * The packets missing after the start of the last frame are not counted.
+   */
+  virtual int GetNumberOfMissingPackets();
+
+  /**
+   * @brief GetNumberOfMissingPacketsInFrame return the number of lidar packets missing in
+   * a frame of the catalog, 0 for the last frame as its end is unknown
+   * @param frameNumber beteween 0 and vtkLidarReader::GetNumberOfFrames()
+   */
+  virtual int GetNumberOfMissingPacketsInFrame(int frameNumber);
+
   /**
    * @brief GetFrame returns the requested frame
    * @param frameNumber beteween 0 and vtkLidarReader::GetNumberOfFrames()
    */
   virtual vtkSmartPointer<vtkPolyData> GetFrame(int frameNumber);
 
+  /**
+   * @brief ReadFrame decode a frame from a pcap file
+   * @param reader opened pcap reader
+   * @param interpreter calibrated interpreter
+   * @param frameInformation information about the frame taken from the frame catalog
+   */
+  static vtkSmartPointer<vtkPolyData> ReadFrame(vtkPacketFileReader* reader,
+                                                vtkLidarPacketInterpreter* interpreter,
+                                                const FrameInformation& frameInformation);
+
+  /**
+   * @brief ReadNextFrame carry on the decoding of the pcap file until the next frame is
+   * ready, without seeking nor resetting the interpreter
+   * @param reader pcap reader left by a previous call to ReadFrame or ReadNextFrame
+   * @param interpreter interpreter left by the same call
+   */
+  static vtkSmartPointer<vtkPolyData> ReadNextFrame(vtkPacketFileReader* reader,
+                                                    vtkLidarPacketInterpreter* interpreter);
+
+  /**
+   * @brief ForEachFrame decode the frames first, first + stride, ... up to last and give
+   * them to the callback. Consecutive frames are decoded in one forward pass over the pcap
+   * file: the file stays open and the interpreter state is kept between two frames instead
+   * of seeking to each frame. Frames skipped by the stride are not decoded.
+   * The pcap file is opened if required and left open, so that a following call or
+   * pipeline request which continues the range does not seek either.
+   * Long ranges are decoded by several threads (see NumberOfDecodingThreads), the
+   * callback is still called by the calling thread, in the frame order.
+   * @param first first frame to decode
+   * @param last last frame to decode, this frame is included
+   * @param stride step between two decoded frames, greater than zero
+   * @param callback called with the frame index and the frame, the iteration stops
+   * when it returns false
+   * @return the number of frames given to the callback
+   */
+  virtual int ForEachFrame(int first, int last, int stride,
+                           const std::function<bool(int, vtkPolyData*)>& callback);
+
   /**
    * @brief GetFrameForPacketTime returns the requested frame
    * @param packetTime udp packet time requested
@@ -68,11 +128,20 @@ public:
 
   /**
    * @brief GetFrameIndexForDataTime returns the frame index
-   *        corresponding to the packet time asked
-   * @param packetTime udp packet time requested
+   *        corresponding to the data time asked
+   * @param dataTime data time requested in seconds, see GetFrameIndexForDataTimeNs
    */
   virtual int GetFrameIndexForDataTime(double dataTime);
 
+  /**
+   * @brief GetFrameIndexForDataTimeNs returns the index of the first frame whose first
+   *        packet data time is not before the given time, or the number of frames
+   * @param dataTime data time requested in nanoseconds, on the timeline which keeps
+   *        increasing when the sensor time rolls over, see FrameInformation::FirstPacketDataTimeNs
+   *        and the FrameBaseTime field data of the frames
+   */
+  virtual int GetFrameIndexForDataTimeNs(vtkTypeInt64 dataTime);
+
   /**
    * @brief Open open the pcap file
    * @todo a decition should be made if the opening/closing of the pcap should be handle by
@@ -99,12 +168,55 @@ public:
   vtkGetMacro(ShowFirstAndLastFrame, bool)
   vtkSetMacro(ShowFirstAndLastFrame, bool)
 
+  vtkGetMacro(UseFrameIndexFile, bool)
+  vtkSetMacro(UseFrameIndexFile, bool)
+
+  //! True if the last frame catalog was loaded from the frame index file instead of being built
+  vtkGetMacro(FrameCatalogLoadedFromFile, bool)
+
+  vtkGetMacro(NumberOfIndexingThreads, int)
+  vtkSetMacro(NumberOfIndexingThreads, int)
+
+  vtkGetMacro(NumberOfDecodingThreads, int)
+  vtkSetMacro(NumberOfDecodingThreads, int)
+
+  /**
+   * @copydoc FrameCacheMemoryBudget
+   */
+  vtkGetMacro(FrameCacheMemoryBudget, int)
+  virtual void SetFrameCacheMemoryBudget(int budget);
+
+  /**
+   * @brief GetFrameCacheHits return the number of frames requested to the pipeline
+   * that were already decoded and have been taken from the cache
+   */
+  vtkTypeUInt64 GetFrameCacheHits() { return this->Cache.GetNumberOfHits(); }
+
+  /**
+   * @brief GetFrameCacheMisses return the number of frames requested to the pipeline
+   * that had to be decoded from the pcap file
+   */
+  vtkTypeUInt64 GetFrameCacheMisses() { return this->Cache.GetNumberOfMisses(); }
+
+  /**
+   * @brief GetFrameCacheMemorySize return the memory used by the cached frames in kibibytes
+   */
+  unsigned long GetFrameCacheMemorySize() { return this->Cache.GetMemorySize(); }
+
+  void ResetFrameCacheStatistics() { this->Cache.ResetStatistics(); }
+
+  /**
+   * @copydoc NumberOfPrefetchedFrames
+   */
+  vtkGetMacro(NumberOfPrefetchedFrames, int)
+  virtual void SetNumberOfPrefetchedFrames(int numberOfFrames);
+
   int GetLidarPort() override { return this->LidarPort; }
   void SetLidarPort(int _arg) override;
 
 protected:
-  vtkLidarReader() = default;
-  ~vtkLidarReader() = default;
+  vtkLidarReader();
+  ~vtkLidarReader();
 
   int RequestData(vtkInformation* request,
                   vtkInformationVector** inputVector,
@@ -131,12 +243,99 @@ protected:
   //! To read all packet use -1
   int LidarPort = -1;
 
+  //! Save/Load the frame catalog to/from a sidecar file next to the pcap file,
+  //! to avoid reading the whole pcap each time it is opened. See FrameIndexFile
+  bool UseFrameIndexFile = true;
+
+  //! Set by ReadFrameInformation when the frame catalog is loaded from the frame index file
+  bool FrameCatalogLoadedFromFile = false;
+
+  //! Number of threads used to build the frame catalog of big pcap files,
+  //! 0 to use one thread per core, 1 to read the file sequentially
+  int NumberOfIndexingThreads = 0;
+
+  //! Number of threads used by ForEachFrame to decode long frame ranges,
+  //! 0 to use one thread per core, 1 to decode the frames sequentially
+  int NumberOfDecodingThreads = 0;
+
+  //! Maximum memory used to keep the last decoded frames, in mebibytes (0 disables the cache).
+  //! A frame already decoded is then returned without reading the pcap file again.
+  int FrameCacheMemoryBudget = 512;
+
+  //! Last decoded frames, keyed by frame index and by the reader/interpreter modification time
+  FrameCache Cache;
+
+  //! Number of frames decoded in advance by a background thread during the playback,
+  //! in the playback direction (0 disables the prefetching)
+  int NumberOfPrefetchedFrames = 0;
+
+  //! Background decoding of the next frames, created on the first frame request
+  std::unique_ptr<FramePrefetcher> Prefetcher;
+
+  //! Modification time of the reader/interpreter when the prefetcher has been created
+  vtkMTimeType PrefetcherMTime = 0;
+
+  //! Index of the last frame decoded with Reader, while the interpreter state still allows
+  //! to decode the next one without seeking (-1 if there is none)
+  int LiveFrameIndex = -1;
+
+  //! Modification time of the reader/interpreter when LiveFrameIndex has been decoded
+  vtkMTimeType LiveFrameMTime = 0;
+
 private:
   /**
-   * @brief ReadFrameInformation read the whole pcap and create a frame index.
+   * @brief ReadFrameInformation create the frame index, either by loading it from the
+   * sidecar file or by reading the whole pcap (the sidecar file is then updated).
    * In case the calibration is contained in the pcap file, this will also read it
    */
   int ReadFrameInformation();
+
+  /**
+   * @brief BuildFrameCatalog read the whole pcap and create a frame index.
+   * In case the calibration is contained in the pcap file, this will also read it
+   */
+  void BuildFrameCatalog();
+
+  /**
+   * @brief BuildFrameCatalogInParallel split the pcap in chunks which are read at the
+   * same time by several threads, then stitch the partial catalogs together.
+   * The result is identical to BuildFrameCatalog.
+   * @return false if the catalog could not be built this way (file too small, not
+   * memory mapped, partial catalogs which do not match, ...), in which case
+   * BuildFrameCatalog must be used
+   */
+  bool BuildFrameCatalogInParallel();
+
+  /**
+   * @brief ReadCalibrationFromFile read the beginning of the pcap until the interpreter
+   * is calibrated. This is required when the frame index is loaded from a sidecar file
+   * and the calibration is contained in the pcap file.
+   */
+  void ReadCalibrationFromFile();
+
+  /**
+   * @brief GetPrefetcher return the prefetcher, which is (re)created if the reader or
+   * the interpreter have been modified since its creation
+   */
+  FramePrefetcher* GetPrefetcher();
+
+  /**
+   * @brief ForEachFrameInParallel decode the frames of ForEachFrame by blocks of consecutive
+   * frames on several threads, each thread having its own reader and its own copy of the
+   * interpreter. The frames are given to the callback in order by the calling thread.
+   * @return the number of frames given to the callback, or -1 if the range is too short
+   * to be split or the threads could not be set up, in which case the frames must be
+   * decoded sequentially
+   */
+  int ForEachFrameInParallel(int first, int last, int stride,
+                             const std::function<bool(int, vtkPolyData*)>& callback);
+
+  /**
+   * @brief DecodeFrame decode a frame with Reader, which is opened if required. When the
+   * frame follows the last one decoded, the decoding is carried on without seeking.
+   */
+  vtkSmartPointer<vtkPolyData> DecodeFrame(int frameIndex);
+
   /**
    * @brief SetTimestepInformation Set the timestep available
    * @param info
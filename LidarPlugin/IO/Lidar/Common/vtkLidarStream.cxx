@@ -17,11 +17,16 @@
 
 #include "vtkLidarStream.h"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
 #include "NetworkSource.h"
 #include "PacketConsumer.h"
 #include "PacketFileWriter.h"
+#include "SharedMemoryFramePublisher.h"
+#include "StreamMetrics.h"
+#include "ThreadSettings.h"
 
 #include <vtkInformationVector.h>
 #include <vtkInformation.h>
@@ -34,13 +39,19 @@ vtkLidarStream::vtkLidarStream()
 {
   this->Consumer = std::make_shared<PacketConsumer>();
   this->Writer = std::make_shared<PacketFileWriter>();
+  this->Publisher = std::make_shared<SharedMemoryFramePublisher>();
   this->Network = std::make_unique<NetworkSource>(this->Consumer, 2368, 2369, "127.0.0.1", false, false);
+  this->Metrics = std::make_shared<StreamMetrics>();
+  this->Consumer->SetMetrics(this->Metrics);
+  this->Writer->SetMetrics(this->Metrics);
+  this->Network->Metrics = this->Metrics;
 }
 
 //-----------------------------------------------------------------------------
 vtkLidarStream::~vtkLidarStream()
 {
   this->Stop();
+  this->Publisher->Close();
 }
 
 //-----------------------------------------------------------------------------
@@ -62,6 +73,60 @@ void vtkLidarStream::SetOutputFile(const std::string &filename)
   this->OutputFileName  = filename;
 }
 
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetRecordingMaximumFileSize()
+{
+  return static_cast<int>(this->Writer->GetMaximumFileSize() >> 20);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetRecordingMaximumFileSize(int size)
+{
+  this->Writer->SetMaximumFileSize(static_cast<std::uint64_t>(std::max(size, 0)) << 20);
+}
+
+//-----------------------------------------------------------------------------
+double vtkLidarStream::GetRecordingMaximumFileDuration()
+{
+  return this->Writer->GetMaximumFileDuration();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetRecordingMaximumFileDuration(double duration)
+{
+  this->Writer->SetMaximumFileDuration(std::max(duration, 0.));
+}
+
+//-----------------------------------------------------------------------------
+double vtkLidarStream::GetRecordingSyncInterval()
+{
+  return this->Writer->GetSyncInterval();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetRecordingSyncInterval(double interval)
+{
+  this->Writer->SetSyncInterval(std::max(interval, 0.));
+}
+
+//-----------------------------------------------------------------------------
+bool vtkLidarStream::GetRecordingUseDirectIO()
+{
+  return this->Writer->GetUseDirectIO();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetRecordingUseDirectIO(bool useDirectIO)
+{
+  this->Writer->SetUseDirectIO(useDirectIO);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetRecordingFileName()
+{
+  return this->Writer->GetCurrentFileName();
+}
+
 //-----------------------------------------------------------------------------
 std::string vtkLidarStream::GetForwardedIpAddress()
 {
@@ -85,9 +150,7 @@ void vtkLidarStream::SetLidarPort(int value)
 {
   if (this->Network->LidarPort != value)
   {
-    bool wasRunning = this->Network != nullptr
-        && this->Network->Thread != nullptr && this->Network->Thread->joinable()
-        && this->Network->LidarPortReceiver != nullptr;
+    bool wasRunning = this->Network->IsRunning();
     this->Stop();
     this->Network->LidarPort = value;
     if (wasRunning)
@@ -164,10 +227,476 @@ void vtkLidarStream::SetIsCrashAnalysing(bool value)
   this->Network->IsCrashAnalysing = value;
 }
 
+//-----------------------------------------------------------------------------
+double vtkLidarStream::GetCrashAnalysisDuration()
+{
+  return this->Network->CrashAnalysisDuration;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetCrashAnalysisDuration(double value)
+{
+  this->Network->CrashAnalysisDuration = value;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkLidarStream::GetSaveCrashAnalysisOnStop()
+{
+  return this->Network->SaveCrashAnalysisOnStop;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSaveCrashAnalysisOnStop(bool value)
+{
+  this->Network->SaveCrashAnalysisOnStop = value;
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::SaveCrashAnalysis()
+{
+  return this->Network->SaveCrashAnalysis();
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetReceiveBufferSize()
+{
+  return this->Network->ReceiveBufferSize;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetReceiveBufferSize(int value)
+{
+  this->Network->ReceiveBufferSize = value;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkLidarStream::GetUseBatchedReceive()
+{
+  return this->Network->UseBatchedReceive;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetUseBatchedReceive(bool value)
+{
+  this->Network->UseBatchedReceive = value;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::GetMetrics(vtkFieldData* metrics)
+{
+  if (metrics)
+  {
+    this->Metrics->Export(metrics);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::ResetMetrics()
+{
+  this->Metrics->Reset();
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetFrameDeliveryPolicy()
+{
+  return this->Consumer->GetDeliveryPolicy();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetFrameDeliveryPolicy(int policy)
+{
+  if (policy != this->Consumer->GetDeliveryPolicy())
+  {
+    this->Consumer->SetDeliveryPolicy(policy);
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+double vtkLidarStream::GetSectorSize()
+{
+  return this->SectorSize;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSectorSize(double size)
+{
+  size = std::min(std::max(size, 0.), 360.);
+  if (size != this->SectorSize)
+  {
+    this->SectorSize = size;
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetSharedMemoryName()
+{
+  return this->SharedMemoryName;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSharedMemoryName(const std::string& name)
+{
+  if (name != this->SharedMemoryName)
+  {
+    this->SharedMemoryName = name;
+    this->Publisher->Close();
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetSharedMemoryNumberOfSlots()
+{
+  return this->SharedMemoryNumberOfSlots;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSharedMemoryNumberOfSlots(int numberOfSlots)
+{
+  numberOfSlots = std::max(numberOfSlots, 1);
+  if (numberOfSlots != this->SharedMemoryNumberOfSlots)
+  {
+    this->SharedMemoryNumberOfSlots = numberOfSlots;
+    this->Publisher->Close();
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetSharedMemorySlotSize()
+{
+  return this->SharedMemorySlotSize;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSharedMemorySlotSize(int size)
+{
+  size = std::max(size, 1);
+  if (size != this->SharedMemorySlotSize)
+  {
+    this->SharedMemorySlotSize = size;
+    this->Publisher->Close();
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetMaximumNumberOfQueuedFrames()
+{
+  return this->Consumer->GetMaximumNumberOfFrames();
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetMaximumNumberOfQueuedFrames(int numberOfFrames)
+{
+  if (numberOfFrames != this->Consumer->GetMaximumNumberOfFrames())
+  {
+    this->Consumer->SetMaximumNumberOfFrames(numberOfFrames);
+    this->Modified();
+  }
+}
+
+//-----------------------------------------------------------------------------
+PacketConsumer* vtkLidarStream::GetSensorConsumer(int sensor)
+{
+  if (sensor == 0)
+  {
+    return this->Consumer.get();
+  }
+  if (sensor < 0 || sensor > static_cast<int>(this->Sensors.size()))
+  {
+    vtkErrorMacro("There is no sensor " << sensor);
+    return nullptr;
+  }
+  return this->Sensors[sensor - 1].Consumer.get();
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::AddFrameObserver(const std::function<void(vtkPolyData*)>& observer, int sensor)
+{
+  PacketConsumer* consumer = this->GetSensorConsumer(sensor);
+  return consumer ? consumer->AddFrameObserver(observer) : -1;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::RemoveFrameObserver(int observerId, int sensor)
+{
+  if (PacketConsumer* consumer = this->GetSensorConsumer(sensor))
+  {
+    consumer->RemoveFrameObserver(observerId);
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::AddSensor(int port, vtkLidarPacketInterpreter* interpreter,
+                              const std::string& sourceIpAddress)
+{
+  if (!interpreter)
+  {
+    vtkErrorMacro("no interpreter is given for the sensor on port " << port);
+    return -1;
+  }
+  Sensor sensor;
+  sensor.Interpreter = interpreter;
+  sensor.Consumer = std::make_shared<PacketConsumer>();
+  sensor.Consumer->SetInterpreter(interpreter);
+  sensor.Consumer->SetDeliveryPolicy(PacketConsumer::OBSERVERS_ONLY);
+  sensor.Metrics = std::make_shared<StreamMetrics>();
+  sensor.Consumer->SetMetrics(sensor.Metrics);
+  this->Network->AddSensor(port, sensor.Consumer, sourceIpAddress);
+  this->Sensors.push_back(sensor);
+  return static_cast<int>(this->Sensors.size());
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::RemoveAllSensors()
+{
+  // the receive threads give the packets to the consumers of the sensors until the
+  // network is stopped, the consumers can only be stopped and released afterward
+  bool wasRunning = this->Network->IsRunning();
+  this->Stop();
+  this->Network->RemoveAllSensors();
+  this->Sensors.clear();
+  if (wasRunning)
+  {
+    this->Start();
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetNumberOfSensors()
+{
+  return 1 + static_cast<int>(this->Sensors.size());
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::GetSensorMetrics(int sensor, vtkFieldData* metrics)
+{
+  if (sensor < 1 || sensor > static_cast<int>(this->Sensors.size()))
+  {
+    vtkErrorMacro("There is no added sensor " << sensor);
+    return;
+  }
+  if (metrics)
+  {
+    this->Sensors[sensor - 1].Metrics->Export(metrics);
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetSourceIpAddress()
+{
+  return this->Network->SourceIpAddress;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSourceIpAddress(const std::string& ipAddress)
+{
+  this->Network->SourceIpAddress = ipAddress;
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetNumberOfReceiveThreads()
+{
+  return this->Network->NumberOfReceiveThreads;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetNumberOfReceiveThreads(int numberOfThreads)
+{
+  this->Network->NumberOfReceiveThreads = std::max(numberOfThreads, 1);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetReceiveThreadCPU(int thread, int cpu)
+{
+  if (thread < 0)
+  {
+    return;
+  }
+  std::vector<int>& cpus = this->Network->ReceiveThreadCPUs;
+  if (thread >= static_cast<int>(cpus.size()))
+  {
+    cpus.resize(thread + 1, -1);
+  }
+  cpus[thread] = cpu;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetSensorCPU(int sensor, int cpu)
+{
+  if (PacketConsumer* consumer = this->GetSensorConsumer(sensor))
+  {
+    consumer->SetCPU(cpu);
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetReceiveThreadPriority()
+{
+  return this->Network->ReceiveThreadSettings.RealTimePriority;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetReceiveThreadPriority(int priority)
+{
+  this->Network->ReceiveThreadSettings.RealTimePriority = priority;
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetReceiveThreadNice()
+{
+  return this->Network->ReceiveThreadSettings.Nice;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetReceiveThreadNice(int nice)
+{
+  this->Network->ReceiveThreadSettings.Nice = nice;
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetReceiveThreadCPUs()
+{
+  return FormatCPUList(this->Network->ReceiveThreadSettings.CPUs);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetReceiveThreadCPUs(const std::string& cpus)
+{
+  if (!ParseCPUList(cpus, this->Network->ReceiveThreadSettings.CPUs))
+  {
+    vtkErrorMacro("The CPUs of the receive threads are not a valid list: " << cpus);
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetDecodeThreadPriority()
+{
+  return this->Consumer->GetThreadSettings().RealTimePriority;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetDecodeThreadPriority(int priority)
+{
+  ThreadSettings settings = this->Consumer->GetThreadSettings();
+  settings.RealTimePriority = priority;
+  this->Consumer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetDecodeThreadNice()
+{
+  return this->Consumer->GetThreadSettings().Nice;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetDecodeThreadNice(int nice)
+{
+  ThreadSettings settings = this->Consumer->GetThreadSettings();
+  settings.Nice = nice;
+  this->Consumer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetDecodeThreadCPUs()
+{
+  return FormatCPUList(this->Consumer->GetThreadSettings().CPUs);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetDecodeThreadCPUs(const std::string& cpus)
+{
+  ThreadSettings settings = this->Consumer->GetThreadSettings();
+  if (!ParseCPUList(cpus, settings.CPUs))
+  {
+    vtkErrorMacro("The CPUs of the decode threads are not a valid list: " << cpus);
+    return;
+  }
+  this->Consumer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetWriterThreadPriority()
+{
+  return this->Writer->GetThreadSettings().RealTimePriority;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetWriterThreadPriority(int priority)
+{
+  ThreadSettings settings = this->Writer->GetThreadSettings();
+  settings.RealTimePriority = priority;
+  this->Writer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+int vtkLidarStream::GetWriterThreadNice()
+{
+  return this->Writer->GetThreadSettings().Nice;
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetWriterThreadNice(int nice)
+{
+  ThreadSettings settings = this->Writer->GetThreadSettings();
+  settings.Nice = nice;
+  this->Writer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetWriterThreadCPUs()
+{
+  return FormatCPUList(this->Writer->GetThreadSettings().CPUs);
+}
+
+//-----------------------------------------------------------------------------
+void vtkLidarStream::SetWriterThreadCPUs(const std::string& cpus)
+{
+  ThreadSettings settings = this->Writer->GetThreadSettings();
+  if (!ParseCPUList(cpus, settings.CPUs))
+  {
+    vtkErrorMacro("The CPUs of the writer thread are not a valid list: " << cpus);
+    return;
+  }
+  this->Writer->SetThreadSettings(settings);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkLidarStream::GetEffectiveThreadSettings()
+{
+  std::ostringstream description;
+  if (!this->Network->IsRunning())
+  {
+    return description.str();
+  }
+  const std::vector<ThreadSettings> receiveSettings = this->Network->GetEffectiveReceiveThreadSettings();
+  for (size_t i = 0; i < receiveSettings.size(); ++i)
+  {
+    description << "receive " << i << ": " << receiveSettings[i].ToString() << "\n";
+  }
+  description << "decode 0: " << this->Consumer->GetEffectiveThreadSettings().ToString() << "\n";
+  for (size_t i = 0; i < this->Sensors.size(); ++i)
+  {
+    description << "decode " << i + 1 << ": "
+                << this->Sensors[i].Consumer->GetEffectiveThreadSettings().ToString() << "\n";
+  }
+  if (this->Network->Writer)
+  {
+    description << "writer: " << this->Writer->GetEffectiveThreadSettings().ToString() << "\n";
+  }
+  if (this->Network->Forwarder->HasDestinations())
+  {
+    description << "forwarder: " << this->Network->Forwarder->GetEffectiveThreadSettings().ToString() << "\n";
+  }
+  return description.str();
+}
+
 //-----------------------------------------------------------------------------
 bool vtkLidarStream::GetNeedsUpdate()
 {
-  boost::lock_guard<boost::mutex> lock(this->Consumer->ConsumerMutex);
   if (this->Consumer->CheckForNewData())
   {
     this->Modified();
@@ -182,11 +711,19 @@ void vtkLidarStream::Start()
   if (!this->Interpreter)
   {
     vtkErrorMacro("no interpreter is set")
+    return;
   }
+  this->NumberOfDroppedFrames = 0;
+  this->Interpreter->SetSectorSize(this->SectorSize);
   this->Consumer->SetInterpreter(this->Interpreter);
   if (this->OutputFileName.length())
   {
-    this->Writer->Start(this->OutputFileName);
+    this->Writer->Start(this->OutputFileName, this->Interpreter);
+  }
+  else
+  {
+    // the recording is over, the last file gets its frame catalog
+    this->Writer->Close();
   }
 
   this->Network->Writer.reset();
@@ -196,7 +733,29 @@ void vtkLidarStream::Start()
     this->Network->Writer = this->Writer;
   }
 
+  // the frames are published by the consumer thread as soon as they are assembled
+  if (!this->SharedMemoryName.empty() && !this->Publisher->IsOpen() &&
+      !this->Publisher->Open(this->SharedMemoryName,
+                             static_cast<std::uint32_t>(this->SharedMemoryNumberOfSlots),
+                             static_cast<std::uint64_t>(this->SharedMemorySlotSize) << 20))
+  {
+    vtkErrorMacro("The frames can not be published in shared memory: " << this->Publisher->GetLastError());
+  }
+  if (this->Publisher->IsOpen() && this->PublisherObserverId == -1)
+  {
+    std::shared_ptr<SharedMemoryFramePublisher> publisher = this->Publisher;
+    this->PublisherObserverId = this->Consumer->AddFrameObserver([publisher](vtkPolyData* frame) {
+      publisher->Publish(frame, std::numeric_limits<double>::quiet_NaN());
+    });
+  }
+
   this->Consumer->Start();
+  for (const Sensor& sensor : this->Sensors)
+  {
+    sensor.Interpreter->SetSectorSize(this->SectorSize);
+    sensor.Consumer->SetThreadSettings(this->Consumer->GetThreadSettings());
+    sensor.Consumer->Start();
+  }
 
   this->Network->Start();
 }
@@ -206,6 +765,20 @@ void vtkLidarStream::Stop()
 {
   this->Network->Stop();
   this->Consumer->Stop();
+  if (this->PublisherObserverId != -1)
+  {
+    this->Consumer->RemoveFrameObserver(this->PublisherObserverId);
+    this->PublisherObserverId = -1;
+    if (this->Publisher->GetNumberOfTruncatedFrames() != 0)
+    {
+      vtkWarningMacro(<< this->Publisher->GetNumberOfTruncatedFrames()
+                      << " frames did not fit in the slots of the shared memory, some of their arrays were skipped");
+    }
+  }
+  for (const Sensor& sensor : this->Sensors)
+  {
+    sensor.Consumer->Stop();
+  }
   this->Writer->Stop();
 }
 
@@ -216,26 +789,29 @@ int vtkLidarStream::RequestData(vtkInformation* vtkNotUsed(request),
 {
   vtkPolyData* output = vtkPolyData::GetData(outputVector);
 
-  int numberOfFrameAvailable = 0;
-  {
-    boost::lock_guard<boost::mutex> lock(this->Consumer->ConsumerMutex);
-    numberOfFrameAvailable = this->Consumer->CheckForNewData();
-    if (numberOfFrameAvailable != 0)
-    {
-      vtkSmartPointer<vtkPolyData> polyData = this->Consumer->GetLastAvailableFrame();
-      output->ShallowCopy(polyData);
-      this->Consumer->ClearAllFrames();
-      this->LastFrameProcessed += numberOfFrameAvailable;
-    }
-  }
+  // the frames dropped by the consumer since the last delivery
+  const std::uint64_t numberOfDroppedFrames = this->Consumer->GetNumberOfDroppedFrames();
+  const int numberOfFramesDroppedSinceLastDelivery =
+    static_cast<int>(numberOfDroppedFrames - this->NumberOfDroppedFrames);
 
-  if (this->DetectFrameDropping)
+  vtkSmartPointer<vtkPolyData> polyData;
+  struct timeval firstPacketTime;
+  if (this->Consumer->TakeFrame(polyData, firstPacketTime))
   {
-    if (numberOfFrameAvailable > 1)
+    output->ShallowCopy(polyData);
+    this->LastFrameProcessed += 1 + numberOfFramesDroppedSinceLastDelivery;
+    this->NumberOfDroppedFrames = numberOfDroppedFrames;
+
+    struct timeval now;
+    NetworkPacket::GetTimeOfDay(&now);
+    this->Metrics->DeliveredFrames++;
+    this->Metrics->ReceiveToDeliveryLatency.Add(firstPacketTime, now);
+
+    if (this->DetectFrameDropping && numberOfFramesDroppedSinceLastDelivery > 0)
     {
       std::stringstream text;
       text << "WARNING : At frame " << std::right << std::setw(6) << this->LastFrameProcessed
-           << " Drop " << std::right << std::setw(2) << numberOfFrameAvailable-1 << " frame(s)\n";
+           << " Drop " << std::right << std::setw(2) << numberOfFramesDroppedSinceLastDelivery << " frame(s)\n";
       vtkWarningMacro( << text.str() )
     }
   }
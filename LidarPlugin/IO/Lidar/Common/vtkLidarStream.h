@@ -16,12 +16,19 @@
 #ifndef VTKLIDARSTREAM_H
 #define VTKLIDARSTREAM_H
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include "vtkLidarProvider.h"
 
 class PacketConsumer;
 class PacketFileWriter;
 class NetworkSource;
+class SharedMemoryFramePublisher;
+struct StreamMetrics;
+class vtkFieldData;
 
 class VTK_EXPORT vtkLidarStream : public vtkLidarProvider
 {
@@ -40,6 +47,36 @@ public:
   std::string GetOutputFile();
   void SetOutputFile(const std::string& filename);
 
+  /**
+   * @copydoc PacketFileWriter::GetMaximumFileSize
+   * In megabytes, applied when a recording starts.
+   */
+  int GetRecordingMaximumFileSize();
+  void SetRecordingMaximumFileSize(int size);
+
+  /**
+   * @copydoc PacketFileWriter::GetMaximumFileDuration
+   * Applied when a recording starts.
+   */
+  double GetRecordingMaximumFileDuration();
+  void SetRecordingMaximumFileDuration(double duration);
+
+  /**
+   * @copydoc PacketFileWriter::GetSyncInterval
+   */
+  double GetRecordingSyncInterval();
+  void SetRecordingSyncInterval(double interval);
+
+  /**
+   * @copydoc PacketFileWriter::GetUseDirectIO
+   */
+  bool GetRecordingUseDirectIO();
+  void SetRecordingUseDirectIO(bool useDirectIO);
+
+  //! Name of the file being recorded, which differs from the output file when the
+  //! recording is split in several files. Empty if none
+  std::string GetRecordingFileName();
+
   /**
    * @copydoc NetworkSource::LidarPort
    */
@@ -84,6 +121,175 @@ public:
   bool GetIsCrashAnalysing();
   void SetIsCrashAnalysing(bool value);
 
+  /**
+   * @copydoc NetworkSource::CrashAnalysisDuration
+   */
+  double GetCrashAnalysisDuration();
+  void SetCrashAnalysisDuration(double value);
+
+  /**
+   * @copydoc NetworkSource::SaveCrashAnalysisOnStop
+   */
+  bool GetSaveCrashAnalysisOnStop();
+  void SetSaveCrashAnalysisOnStop(bool value);
+
+  /**
+   * @copydoc NetworkSource::SaveCrashAnalysis
+   */
+  int SaveCrashAnalysis();
+
+  /**
+   * @copydoc NetworkSource::ReceiveBufferSize
+   */
+  int GetReceiveBufferSize();
+  void SetReceiveBufferSize(int value);
+
+  /**
+   * @copydoc NetworkSource::UseBatchedReceive
+   */
+  bool GetUseBatchedReceive();
+  void SetUseBatchedReceive(bool value);
+
+  /**
+   * @brief GetMetrics export the metrics of the stream: packets received, forwarded,
+   * written and dropped, high-water marks of the packet queues, frames assembled,
+   * dropped and delivered, and latency histograms, see StreamMetrics::Export
+   * @param metrics field data replaced by one array per metric
+   */
+  void GetMetrics(vtkFieldData* metrics);
+
+  //! Set all metrics to 0
+  void ResetMetrics();
+
+  /**
+   * @copydoc PacketConsumer::DeliveryPolicy
+   */
+  int GetFrameDeliveryPolicy();
+  void SetFrameDeliveryPolicy(int policy);
+
+  /**
+   * @brief Number of frames kept until they are delivered with the KEEP_LAST_N policy,
+   * each update delivers the oldest one. See PacketConsumer::MaximumNumberOfFrames
+   */
+  int GetMaximumNumberOfQueuedFrames();
+  void SetMaximumNumberOfQueuedFrames(int numberOfFrames);
+
+  /**
+   * @brief Angular size in degrees of the sectors in which the frames are split, to
+   * deliver the points as soon as the sensor has swept them instead of at the end of the
+   * rotation. Each output is then a sector, tagged with its "SectorIndex" and the
+   * "FrameId" of its rotation in the field data. 0 delivers full frames. Applied to the
+   * interpreters of all the sensors when the stream starts, see
+   * vtkLidarPacketInterpreter::SectorSize
+   */
+  double GetSectorSize();
+  void SetSectorSize(double size);
+
+  /**
+   * @brief Name of the shared memory in which every frame of the main sensor is
+   * published for the other processes of the host, e.g. "lidarview" (/dev/shm/lidarview
+   * on Linux), see SharedMemoryFramePublisher. Empty to publish none. The shared memory
+   * is created when the stream starts and kept until one of its settings changes, in
+   * which case the readers must open it again. POSIX only.
+   */
+  std::string GetSharedMemoryName();
+  void SetSharedMemoryName(const std::string& name);
+
+  //! Number of frames kept in the shared memory for the readers
+  int GetSharedMemoryNumberOfSlots();
+  void SetSharedMemoryNumberOfSlots(int numberOfSlots);
+
+  //! Megabytes of a frame in the shared memory, the arrays of the larger frames are skipped
+  int GetSharedMemorySlotSize();
+  void SetSharedMemorySlotSize(int size);
+
+  /**
+   * @brief AddFrameObserver register a function called with every frame of a sensor,
+   * see PacketConsumer::AddFrameObserver
+   * @param sensor index of the sensor, 0 for the main one, see AddSensor
+   * @return an identifier for RemoveFrameObserver, or -1 if the sensor does not exist
+   */
+  int AddFrameObserver(const std::function<void(vtkPolyData*)>& observer, int sensor = 0);
+  void RemoveFrameObserver(int observerId, int sensor = 0);
+
+  /**
+   * @brief AddSensor receive another sensor with the receive threads of this stream. Its
+   * packets are interpreted by a consumer thread of its own, and its frames are only given
+   * to its frame observers: the output of the stream shows the frames of the main sensor.
+   * Applied at the next Start.
+   * @param port port on which the sensor sends its packets, it may be the port of another
+   * sensor if their source IP addresses are different
+   * @param interpreter calibrated interpreter of the sensor
+   * @param sourceIpAddress IPv4 address of the sensor, empty to accept any source
+   * @return index of the sensor, the main sensor being 0
+   */
+  int AddSensor(int port, vtkLidarPacketInterpreter* interpreter, const std::string& sourceIpAddress);
+
+  //! Remove the sensors added with AddSensor, a running stream is restarted without them
+  void RemoveAllSensors();
+  int GetNumberOfSensors();
+
+  /**
+   * @brief GetSensorMetrics export the metrics of a sensor added with AddSensor: frames
+   * assembled, missing packets and latency, see StreamMetrics::Export. The packets
+   * received by all sensors are counted in GetMetrics.
+   */
+  void GetSensorMetrics(int sensor, vtkFieldData* metrics);
+
+  /**
+   * @copydoc NetworkSource::SourceIpAddress
+   */
+  std::string GetSourceIpAddress();
+  void SetSourceIpAddress(const std::string& ipAddress);
+
+  /**
+   * @copydoc NetworkSource::NumberOfReceiveThreads
+   */
+  int GetNumberOfReceiveThreads();
+  void SetNumberOfReceiveThreads(int numberOfThreads);
+
+  //! CPU a receive thread is pinned to when it is created, -1 for none
+  void SetReceiveThreadCPU(int thread, int cpu);
+
+  //! CPU the consumer thread of a sensor is pinned to from the next Start, -1 for none
+  void SetSensorCPU(int sensor, int cpu);
+
+  /**
+   * @brief Scheduling of the threads of each stage: the receive threads, the decode
+   * threads which interpret the packets of each sensor, and the writer thread which
+   * records them. A real-time priority from 1 to 99 uses the SCHED_FIFO policy, 0 keeps
+   * the time-sharing policy with the nice value (0 keeps the nice value of the process).
+   * The CPUs are a list such as "0-3,6", empty for all. Whatever the system does not
+   * permit is skipped with a warning, see ApplyThreadSettings. Linux only, applied when
+   * the stream starts.
+   */
+  int GetReceiveThreadPriority();
+  void SetReceiveThreadPriority(int priority);
+  int GetReceiveThreadNice();
+  void SetReceiveThreadNice(int nice);
+  std::string GetReceiveThreadCPUs();
+  void SetReceiveThreadCPUs(const std::string& cpus);
+
+  int GetDecodeThreadPriority();
+  void SetDecodeThreadPriority(int priority);
+  int GetDecodeThreadNice();
+  void SetDecodeThreadNice(int nice);
+  std::string GetDecodeThreadCPUs();
+  void SetDecodeThreadCPUs(const std::string& cpus);
+
+  int GetWriterThreadPriority();
+  void SetWriterThreadPriority(int priority);
+  int GetWriterThreadNice();
+  void SetWriterThreadNice(int nice);
+  std::string GetWriterThreadCPUs();
+  void SetWriterThreadCPUs(const std::string& cpus);
+
+  /**
+   * @brief GetEffectiveThreadSettings describe the scheduling in use by the running
+   * threads of the stream, one line per thread, e.g. "receive 0: SCHED_FIFO 50, CPUs 2-3"
+   */
+  std::string GetEffectiveThreadSettings();
+
   /**
    * @brief GetNeedsUpdate
    * @return true if a new frame is ready
@@ -103,6 +309,31 @@ protected:
   std::shared_ptr<PacketConsumer> Consumer;
   std::shared_ptr<PacketFileWriter> Writer;
   std::unique_ptr<NetworkSource> Network;
+  std::shared_ptr<StreamMetrics> Metrics;
+  //! Sectors delivered instead of full frames, see GetSectorSize
+  double SectorSize = 0;
+
+  //! Publisher of the frames in shared memory, see GetSharedMemoryName
+  std::shared_ptr<SharedMemoryFramePublisher> Publisher;
+  std::string SharedMemoryName;
+  int SharedMemoryNumberOfSlots = 4;
+  int SharedMemorySlotSize = 32;
+  //! Frame observer of the main consumer which publishes the frames, -1 if none
+  int PublisherObserverId = -1;
+  //! Number of frames dropped by the consumer at the last delivery
+  std::uint64_t NumberOfDroppedFrames = 0;
+
+  //! Sensors added with AddSensor
+  struct Sensor
+  {
+    vtkSmartPointer<vtkLidarPacketInterpreter> Interpreter;
+    std::shared_ptr<PacketConsumer> Consumer;
+    std::shared_ptr<StreamMetrics> Metrics;
+  };
+  std::vector<Sensor> Sensors;
+
+  //! Return the consumer of a sensor, 0 being the main one, or nullptr
+  PacketConsumer* GetSensorConsumer(int sensor);
 private:
   vtkLidarStream(const vtkLidarStream&) = delete;
   void operator=(const vtkLidarStream&) = delete;
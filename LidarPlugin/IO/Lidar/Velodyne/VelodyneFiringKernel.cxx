@@ -0,0 +1,208 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "VelodyneFiringKernel.h"
+
+// The AVX2 implementation is compiled for x86 only, with the target attribute on
+// gcc/clang so that the rest of the plugin does not require AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIRING_KERNEL_HAS_AVX2
+#define FIRING_KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define FIRING_KERNEL_HAS_AVX2
+#define FIRING_KERNEL_TARGET_AVX2
+#include <intrin.h>
+#endif
+
+#ifdef FIRING_KERNEL_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace DataPacketFixedLength;
+
+namespace
+{
+//-----------------------------------------------------------------------------
+void ComputePositionsScalar(const int azimuths[HDL_LASER_PER_FIRING],
+                            const int distances[HDL_LASER_PER_FIRING], int laserOffset,
+                            const FiringCorrections& corrections, double distanceResolution,
+                            const double* cosTable, const double* sinTable,
+                            FiringPositions& positions)
+{
+  for (int i = 0; i < HDL_LASER_PER_FIRING; ++i)
+  {
+    const int laser = laserOffset + i;
+    const double cosTableAzimuth = cosTable[azimuths[i]];
+    const double sinTableAzimuth = sinTable[azimuths[i]];
+
+    // realAzimuth = azimuth/100 - rotationalCorrection
+    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
+    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
+    // this is exact when there is no rotational correction (cos(b) = 1, sin(b) = 0)
+    const double cosAzimuth = cosTableAzimuth * corrections.CosRotational[laser] +
+      sinTableAzimuth * corrections.SinRotational[laser];
+    const double sinAzimuth = sinTableAzimuth * corrections.CosRotational[laser] -
+      cosTableAzimuth * corrections.SinRotational[laser];
+
+    const double distanceMRaw = distances[i] * distanceResolution;
+    const double distanceM = distanceMRaw + corrections.Distance[laser];
+    const double xyDistance =
+      distanceM * corrections.CosVertical[laser] - corrections.SinVerticalOffset[laser];
+
+    positions.X[i] =
+      xyDistance * sinAzimuth - corrections.HorizontalOffset[laser] * cosAzimuth;
+    positions.Y[i] =
+      xyDistance * cosAzimuth + corrections.HorizontalOffset[laser] * sinAzimuth;
+    positions.Z[i] =
+      distanceM * corrections.SinVertical[laser] + corrections.VerticalOffset[laser];
+    positions.Distance[i] = distanceM;
+  }
+}
+
+#ifdef FIRING_KERNEL_HAS_AVX2
+//-----------------------------------------------------------------------------
+FIRING_KERNEL_TARGET_AVX2
+void ComputePositionsAVX2(const int azimuths[HDL_LASER_PER_FIRING],
+                          const int distances[HDL_LASER_PER_FIRING], int laserOffset,
+                          const FiringCorrections& corrections, double distanceResolution,
+                          const double* cosTable, const double* sinTable,
+                          FiringPositions& positions)
+{
+  const __m256d resolution = _mm256_set1_pd(distanceResolution);
+  // the masked gather is used with all lanes enabled, as the unmasked one makes gcc warn
+  // about an uninitialized source
+  const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  for (int i = 0; i < HDL_LASER_PER_FIRING; i += 4)
+  {
+    const int laser = laserOffset + i;
+    const __m128i azimuth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(azimuths + i));
+    const __m256d cosTableAzimuth =
+      _mm256_mask_i32gather_pd(_mm256_setzero_pd(), cosTable, azimuth, allLanes, 8);
+    const __m256d sinTableAzimuth =
+      _mm256_mask_i32gather_pd(_mm256_setzero_pd(), sinTable, azimuth, allLanes, 8);
+
+    const __m256d cosRotational = _mm256_loadu_pd(corrections.CosRotational + laser);
+    const __m256d sinRotational = _mm256_loadu_pd(corrections.SinRotational + laser);
+    const __m256d cosAzimuth = _mm256_add_pd(_mm256_mul_pd(cosTableAzimuth, cosRotational),
+                                             _mm256_mul_pd(sinTableAzimuth, sinRotational));
+    const __m256d sinAzimuth = _mm256_sub_pd(_mm256_mul_pd(sinTableAzimuth, cosRotational),
+                                             _mm256_mul_pd(cosTableAzimuth, sinRotational));
+
+    const __m256d distanceMRaw = _mm256_mul_pd(
+      _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(distances + i))),
+      resolution);
+    const __m256d distanceM =
+      _mm256_add_pd(distanceMRaw, _mm256_loadu_pd(corrections.Distance + laser));
+    const __m256d xyDistance =
+      _mm256_sub_pd(_mm256_mul_pd(distanceM, _mm256_loadu_pd(corrections.CosVertical + laser)),
+                    _mm256_loadu_pd(corrections.SinVerticalOffset + laser));
+
+    const __m256d horizontalOffset = _mm256_loadu_pd(corrections.HorizontalOffset + laser);
+    _mm256_storeu_pd(positions.X + i,
+      _mm256_sub_pd(_mm256_mul_pd(xyDistance, sinAzimuth),
+                    _mm256_mul_pd(horizontalOffset, cosAzimuth)));
+    _mm256_storeu_pd(positions.Y + i,
+      _mm256_add_pd(_mm256_mul_pd(xyDistance, cosAzimuth),
+                    _mm256_mul_pd(horizontalOffset, sinAzimuth)));
+    _mm256_storeu_pd(positions.Z + i,
+      _mm256_add_pd(_mm256_mul_pd(distanceM, _mm256_loadu_pd(corrections.SinVertical + laser)),
+                    _mm256_loadu_pd(corrections.VerticalOffset + laser)));
+    _mm256_storeu_pd(positions.Distance + i, distanceM);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool IsAVX2SupportedByCPU()
+{
+#if defined(_MSC_VER)
+  // AVX2 is given by the leaf 7, and the OS must save the AVX registers
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+  __cpuid(info, 1);
+  const bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+    ((_xgetbv(0) & 0x6) == 0x6);
+  __cpuidex(info, 7, 0);
+  return osSavesAVX && (info[1] & (1 << 5));
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void FiringCorrections::Set(const HDLLaserCorrection* corrections)
+{
+  for (int i = 0; i < HDL_MAX_NUM_LASERS; ++i)
+  {
+    this->CosRotational[i] = corrections[i].cosRotationalCorrection;
+    this->SinRotational[i] = corrections[i].sinRotationalCorrection;
+    this->Distance[i] = corrections[i].distanceCorrection;
+    this->CosVertical[i] = corrections[i].cosVertCorrection;
+    this->SinVertical[i] = corrections[i].sinVertCorrection;
+    this->SinVerticalOffset[i] = corrections[i].sinVertOffsetCorrection;
+    this->VerticalOffset[i] = corrections[i].verticalOffsetCorrection;
+    this->HorizontalOffset[i] = corrections[i].horizontalOffsetCorrection;
+  }
+}
+
+//-----------------------------------------------------------------------------
+VelodyneFiringKernel::Implementation VelodyneFiringKernel::GetBestImplementation()
+{
+  static const Implementation best = IsSupported(AVX2) ? AVX2 : SCALAR;
+  return best;
+}
+
+//-----------------------------------------------------------------------------
+bool VelodyneFiringKernel::IsSupported(Implementation implementation)
+{
+  switch (implementation)
+  {
+    case SCALAR:
+      return true;
+    case AVX2:
+#ifdef FIRING_KERNEL_HAS_AVX2
+      return IsAVX2SupportedByCPU();
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void VelodyneFiringKernel::ComputePositions(const int azimuths[HDL_LASER_PER_FIRING],
+                                            const int distances[HDL_LASER_PER_FIRING],
+                                            int laserOffset, const FiringCorrections& corrections,
+                                            double distanceResolution, const double* cosTable,
+                                            const double* sinTable, FiringPositions& positions,
+                                            Implementation implementation)
+{
+#ifdef FIRING_KERNEL_HAS_AVX2
+  if (implementation == AVX2)
+  {
+    ComputePositionsAVX2(azimuths, distances, laserOffset, corrections, distanceResolution,
+                         cosTable, sinTable, positions);
+    return;
+  }
+#endif
+  ComputePositionsScalar(azimuths, distances, laserOffset, corrections, distanceResolution,
+                         cosTable, sinTable, positions);
+}
@@ -0,0 +1,96 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VELODYNEFIRINGKERNEL_H
+#define VELODYNEFIRINGKERNEL_H
+
+#include "vtkDataPacket.h"
+
+/**
+ * \struct FiringCorrections
+ * \brief Per-laser corrections used to compute the positions of a firing block, stored
+ * as a structure of arrays so that several lasers can be corrected at once.
+ */
+struct FiringCorrections
+{
+  //! Copy the corrections of all lasers, the precomputed cos/sin must be up to date
+  void Set(const DataPacketFixedLength::HDLLaserCorrection* corrections);
+
+  double CosRotational[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double SinRotational[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double Distance[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double CosVertical[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double SinVertical[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double SinVerticalOffset[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double VerticalOffset[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+  double HorizontalOffset[DataPacketFixedLength::HDL_MAX_NUM_LASERS];
+};
+
+/**
+ * \struct FiringPositions
+ * \brief Positions and corrected distances of the returns of a firing block
+ */
+struct FiringPositions
+{
+  alignas(32) double X[DataPacketFixedLength::HDL_LASER_PER_FIRING];
+  alignas(32) double Y[DataPacketFixedLength::HDL_LASER_PER_FIRING];
+  alignas(32) double Z[DataPacketFixedLength::HDL_LASER_PER_FIRING];
+  alignas(32) double Distance[DataPacketFixedLength::HDL_LASER_PER_FIRING];
+};
+
+/**
+ * \class VelodyneFiringKernel
+ * \brief Compute the positions of all the returns of a firing block at once.
+ *
+ * The computation is vectorized with AVX2 when the CPU supports it, and done one return
+ * at a time otherwise. Both implementations do the same operations in the same order,
+ * without fused multiply-add, so that they give the same results.
+ */
+class VelodyneFiringKernel
+{
+public:
+  enum Implementation
+  {
+    SCALAR = 0,
+    AVX2 = 1,
+  };
+
+  //! Return the fastest implementation supported by the CPU, detected on the first call
+  static Implementation GetBestImplementation();
+
+  //! Return true if the implementation is compiled in and supported by the CPU
+  static bool IsSupported(Implementation implementation);
+
+  /**
+   * @brief ComputePositions compute the position of the HDL_LASER_PER_FIRING returns of
+   * a firing block, see vtkVelodynePacketInterpreter::ProcessFiring
+   * @param azimuths azimuth of each return in hundredths of degree, within [0, 36000[
+   * @param distances raw distance of each return
+   * @param laserOffset index of the laser of the first return in the corrections
+   * @param corrections per-laser corrections
+   * @param distanceResolution size of a raw distance unit, in meters
+   * @param cosTable cos of the azimuths in hundredths of degree
+   * @param sinTable sin of the azimuths in hundredths of degree
+   * @param positions computed positions and distances
+   * @param implementation implementation to use, it must be supported
+   */
+  static void ComputePositions(const int azimuths[DataPacketFixedLength::HDL_LASER_PER_FIRING],
+                               const int distances[DataPacketFixedLength::HDL_LASER_PER_FIRING],
+                               int laserOffset, const FiringCorrections& corrections,
+                               double distanceResolution, const double* cosTable,
+                               const double* sinTable, FiringPositions& positions,
+                               Implementation implementation);
+};
+
+#endif // VELODYNEFIRINGKERNEL_H
@@ -0,0 +1,376 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LOCAL
+#include "VelodynePacketGenerator.h"
+#include "PacketRing.h"
+#include "vtkDataPacket.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+using namespace DataPacketFixedLength;
+
+namespace
+{
+//! Azimuths of the scene tables, every tenth of degree
+const int SCENE_AZIMUTHS = 3600;
+
+//! Bytes of the rolling calibration of the HDL-64, see vtkRollingDataAccumulator
+const int ROLLING_CALIBRATION_SIZE = 4160;
+
+//! Microseconds in an hour, the gpsTimestamp rolls over every hour
+const std::int64_t MICROSECONDS_PER_HOUR = 3600000000LL;
+
+//! Type of the status bytes of the HDL-64, a cycle of 16 bytes (9 status bytes and 7
+//! calibration bytes), see HDLLaserCorrectionByte
+const char ROLLING_STATUS_TYPES[] = "HMSDNYGTV1234567";
+
+//! Identifier of the firing blocks of the lasers 0-31, 32-63, 64-95 and 96-127
+const std::uint16_t BANK_IDENTIFIERS[4] = { BLOCK_0_TO_31, BLOCK_32_TO_63, BLOCK_64_TO_95,
+                                            BLOCK_96_TO_127 };
+
+const unsigned char SOURCE_IP[4] = { 192, 168, 1, 201 };
+
+const double PI = 3.14159265358979323846;
+
+struct ModelDescription
+{
+  const char* Name;
+  SensorType Type;
+  int NumberOfLasers;
+  //! Firing blocks of 32 lasers fired at the same azimuth
+  int BanksPerFiring;
+  //! Time between two firings of all the lasers, in nanoseconds. The VLP-16 fires its
+  //! lasers twice per firing block.
+  std::int64_t FiringDuration;
+  //! Size of a raw distance unit in meters
+  double DistanceResolution;
+  //! Vertical field of view in degrees
+  double MinimumElevation;
+  double MaximumElevation;
+};
+
+// clang-format off
+const ModelDescription MODELS[] = {
+  { "HDL32",  HDL32E, 32,  1, 46080,  0.002, -30.67, 10.67 },
+  { "VLP16",  VLP16,  16,  1, 110592, 0.002, -15.0,  15.0  },
+  { "VLP32",  VLP32C, 32,  1, 55296,  0.004, -25.0,  15.0  },
+  { "HDL64",  HDL64,  64,  2, 48000,  0.002, -24.9,  2.0   },
+  { "VLS128", VLS128, 128, 4, 53300,  0.004, -25.0,  15.0  },
+};
+// clang-format on
+
+//-----------------------------------------------------------------------------
+template<typename T>
+void WriteLittleEndian(unsigned char* data, T value)
+{
+  typedef typename std::make_unsigned<T>::type UnsignedT;
+  const UnsignedT bits = static_cast<UnsignedT>(value);
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+  {
+    data[i] = static_cast<unsigned char>(bits >> (8 * i));
+  }
+}
+}
+
+//-----------------------------------------------------------------------------
+VelodynePacketGenerator::VelodynePacketGenerator(Model model, bool isDualReturn, double rpm)
+  : SensorModel(model)
+  , IsDualReturn(isDualReturn)
+  , Rpm(rpm)
+{
+  this->ComputeScene();
+  if (model == HDL64)
+  {
+    this->ComputeRollingCalibration();
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool VelodynePacketGenerator::GetModelFromString(const std::string& name, Model& model)
+{
+  for (int i = 0; i <= VLS128; ++i)
+  {
+    if (name == MODELS[i].Name)
+    {
+      model = static_cast<Model>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+std::string VelodynePacketGenerator::GetModelName(Model model)
+{
+  return MODELS[model].Name;
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::SetScene(const Scene& scene)
+{
+  this->SceneDescription = scene;
+  this->ComputeScene();
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::SetStartTime(double secondsPastTheHour)
+{
+  this->StartTime = static_cast<std::int64_t>(std::llround(secondsPastTheHour * 1e9));
+  this->ElapsedTime = 0;
+  this->Azimuth = 0;
+  this->NumberOfPackets = 0;
+}
+
+//-----------------------------------------------------------------------------
+int VelodynePacketGenerator::GetNumberOfLasers() const
+{
+  return MODELS[this->SensorModel].NumberOfLasers;
+}
+
+//-----------------------------------------------------------------------------
+int VelodynePacketGenerator::GetNumberOfFiringsPerPacket() const
+{
+  const int blocksPerFiring = MODELS[this->SensorModel].BanksPerFiring * (this->IsDualReturn ? 2 : 1);
+  // the VLS-128 dual return packets hold a single firing and 4 dummy blocks
+  return std::max(1, HDL_FIRING_PER_PKT / blocksPerFiring);
+}
+
+//-----------------------------------------------------------------------------
+std::int64_t VelodynePacketGenerator::GetFiringDuration() const
+{
+  return MODELS[this->SensorModel].FiringDuration;
+}
+
+//-----------------------------------------------------------------------------
+double VelodynePacketGenerator::GetPacketRate() const
+{
+  return 1e9 / (this->GetNumberOfFiringsPerPacket() * this->GetFiringDuration());
+}
+
+//-----------------------------------------------------------------------------
+double VelodynePacketGenerator::GetNumberOfPacketsPerRotation() const
+{
+  return this->GetPacketRate() * 60. / this->Rpm;
+}
+
+//-----------------------------------------------------------------------------
+double VelodynePacketGenerator::GetElevation(int laser) const
+{
+  const ModelDescription& model = MODELS[this->SensorModel];
+  return model.MinimumElevation + (model.MaximumElevation - model.MinimumElevation) * laser /
+    (model.NumberOfLasers - 1);
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::ComputeScene()
+{
+  const ModelDescription& model = MODELS[this->SensorModel];
+  const Scene& scene = this->SceneDescription;
+  const std::size_t size = static_cast<std::size_t>(model.NumberOfLasers) * SCENE_AZIMUTHS;
+  this->NearestDistances.resize(size);
+  this->FarthestDistances.resize(size);
+  this->NearestIntensities.resize(size);
+  this->FarthestIntensities.resize(size);
+
+  const unsigned char groundIntensity = 30;
+  const unsigned char wallIntensity = 80;
+  const unsigned char pillarIntensity = 200;
+  auto toRawDistance = [&](double distance) {
+    const double raw = std::round(distance / model.DistanceResolution);
+    return static_cast<std::uint16_t>(std::min(raw, 65535.));
+  };
+
+  for (int azimuthIndex = 0; azimuthIndex < SCENE_AZIMUTHS; ++azimuthIndex)
+  {
+    const double azimuth = azimuthIndex * 2 * PI / SCENE_AZIMUTHS;
+
+    // horizontal distance to the nearest pillar, if it is in front of the wall
+    double pillarDistance = std::numeric_limits<double>::infinity();
+    for (int pillar = 0; pillar < scene.NumberOfPillars; ++pillar)
+    {
+      const double difference = azimuth - 2 * PI * (pillar + 0.5) / scene.NumberOfPillars;
+      const double along = scene.PillarDistance * std::cos(difference);
+      const double across = scene.PillarDistance * std::sin(difference);
+      if (along > 0 && std::abs(across) < scene.PillarRadius)
+      {
+        const double hit = along - std::sqrt(scene.PillarRadius * scene.PillarRadius - across * across);
+        pillarDistance = std::min(pillarDistance, hit);
+      }
+    }
+
+    for (int laser = 0; laser < model.NumberOfLasers; ++laser)
+    {
+      const double elevation = this->GetElevation(laser) * PI / 180.;
+      const double groundDistance = elevation < 0
+        ? scene.SensorHeight / std::tan(-elevation)
+        : std::numeric_limits<double>::infinity();
+
+      auto hit = [&](double horizontalDistance, unsigned char intensity, std::uint16_t& rawDistance,
+                     std::uint8_t& rawIntensity) {
+        if (groundDistance < horizontalDistance)
+        {
+          rawDistance = toRawDistance(scene.SensorHeight / std::sin(-elevation));
+          rawIntensity = groundIntensity;
+        }
+        else
+        {
+          rawDistance = toRawDistance(horizontalDistance / std::cos(elevation));
+          rawIntensity = intensity;
+        }
+      };
+
+      const std::size_t index = static_cast<std::size_t>(laser) * SCENE_AZIMUTHS + azimuthIndex;
+      hit(scene.WallRadius, wallIntensity, this->FarthestDistances[index],
+          this->FarthestIntensities[index]);
+      if (pillarDistance < scene.WallRadius)
+      {
+        hit(pillarDistance, pillarIntensity, this->NearestDistances[index],
+            this->NearestIntensities[index]);
+      }
+      else
+      {
+        this->NearestDistances[index] = this->FarthestDistances[index];
+        this->NearestIntensities[index] = this->FarthestIntensities[index];
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::ComputeRollingCalibration()
+{
+  // The 64 lasers then the last 4 cycles, each one is 4 cycles of 16 bytes starting with
+  // the 9 status bytes, see HDL64LoadCorrectionsFromStreamData
+  this->RollingCalibration.assign(ROLLING_CALIBRATION_SIZE, 0);
+  const int numberOfLasers = 64;
+  for (int cycle = 0; cycle < ROLLING_CALIBRATION_SIZE / 16; ++cycle)
+  {
+    // 12:00:00 on 2019-01-01, GPS not synchronized, 40 degrees Celsius, firmware 1
+    const unsigned char status[9] = { 12, 0, 0, 1, 1, 19, 0, 40, 1 };
+    std::memcpy(&this->RollingCalibration[16 * cycle], status, sizeof(status));
+  }
+
+  for (int laser = 0; laser < numberOfLasers; ++laser)
+  {
+    unsigned char* data = &this->RollingCalibration[64 * laser];
+    HDLLaserCorrectionByte& correction = *reinterpret_cast<HDLLaserCorrectionByte*>(data);
+    correction.channel = static_cast<unsigned char>(laser);
+    WriteLittleEndian(reinterpret_cast<unsigned char*>(&correction.verticalCorrection),
+                      static_cast<std::int16_t>(std::lround(this->GetElevation(laser) * 100)));
+    WriteLittleEndian(reinterpret_cast<unsigned char*>(&correction.focalDistance),
+                      static_cast<std::int16_t>(10000));
+    correction.minIntensity = 0;
+    correction.maxIntensity = 255;
+  }
+  // the marker found by vtkRollingDataAccumulator
+  HDLLaserCorrectionByte& first = *reinterpret_cast<HDLLaserCorrectionByte*>(&this->RollingCalibration[0]);
+  first.warningBit = 'U';
+  first.reserved1 = 'N';
+  first.reserved2 = 'I';
+  first.reserved3 = 'T';
+  first.reserved4 = '#';
+
+  last4cyclesByte& last = *reinterpret_cast<last4cyclesByte*>(&this->RollingCalibration[64 * numberOfLasers]);
+  WriteLittleEndian(reinterpret_cast<unsigned char*>(&last.motorRPM),
+                    static_cast<std::int16_t>(std::lround(this->Rpm)));
+  WriteLittleEndian(reinterpret_cast<unsigned char*>(&last.fovEndAngle),
+                    static_cast<std::uint16_t>(36000));
+  std::copy(SOURCE_IP, SOURCE_IP + 4, &last.sourceIPByte1);
+  last.multipleReturnStatus = this->IsDualReturn ? 2 : 0;
+  last.powerLevelStatus = CorrectionOn;
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::Generate(unsigned char* data)
+{
+  const ModelDescription& model = MODELS[this->SensorModel];
+  HDLDataPacket& packet = *reinterpret_cast<HDLDataPacket*>(data);
+
+  const int returns = this->IsDualReturn ? 2 : 1;
+  const int firings = this->GetNumberOfFiringsPerPacket();
+  // hundredths of degree per firing
+  const double azimuthStep = this->Rpm * 6. * 100. * this->GetFiringDuration() * 1e-9;
+
+  int block = 0;
+  for (int firing = 0; firing < firings; ++firing)
+  {
+    const int azimuth = static_cast<int>(this->Azimuth);
+    // The HDL-64 sends the lower and upper blocks of the strongest returns, then the ones
+    // of the last returns. The others send the two returns of a bank one after the other.
+    for (int i = 0; i < model.BanksPerFiring * returns; ++i, ++block)
+    {
+      const int bank = this->SensorModel == HDL64 ? i % model.BanksPerFiring : i / returns;
+      const int returnIndex = this->SensorModel == HDL64 ? i / model.BanksPerFiring : i % returns;
+      const std::vector<std::uint16_t>& distances =
+        returnIndex == 0 ? this->NearestDistances : this->FarthestDistances;
+      const std::vector<std::uint8_t>& intensities =
+        returnIndex == 0 ? this->NearestIntensities : this->FarthestIntensities;
+
+      HDLFiringData& firingData = packet.firingData[block];
+      firingData.blockIdentifier = BANK_IDENTIFIERS[bank];
+      firingData.rotationalPosition = static_cast<std::uint16_t>(azimuth);
+      for (int dsr = 0; dsr < HDL_LASER_PER_FIRING; ++dsr)
+      {
+        int laser = bank * HDL_LASER_PER_FIRING + dsr;
+        int laserAzimuth = azimuth;
+        // the VLP-16 fires its lasers twice per block
+        if (this->SensorModel == VLP16)
+        {
+          laser = dsr % 16;
+          laserAzimuth += dsr < 16 ? 0 : static_cast<int>(azimuthStep / 2);
+        }
+        const std::size_t index =
+          static_cast<std::size_t>(laser) * SCENE_AZIMUTHS + (laserAzimuth % 36000) / 10;
+        firingData.laserReturns[dsr].distance = distances[index];
+        firingData.laserReturns[dsr].intensity = intensities[index];
+      }
+    }
+    this->Azimuth = std::fmod(this->Azimuth + azimuthStep, 36000.);
+  }
+  // dummy blocks of the VLS-128 dual return packets
+  for (; block < HDL_FIRING_PER_PKT; ++block)
+  {
+    std::memset(&packet.firingData[block], 0xff, sizeof(HDLFiringData));
+  }
+
+  packet.gpsTimestamp =
+    static_cast<std::uint32_t>(((this->StartTime + this->ElapsedTime) / 1000) % MICROSECONDS_PER_HOUR);
+  if (this->SensorModel == HDL64)
+  {
+    const std::size_t rollingIndex = this->NumberOfPackets % ROLLING_CALIBRATION_SIZE;
+    packet.factoryField1 = static_cast<std::uint8_t>(ROLLING_STATUS_TYPES[rollingIndex % 16]);
+    packet.factoryField2 = this->RollingCalibration[rollingIndex];
+  }
+  else
+  {
+    packet.factoryField1 = static_cast<std::uint8_t>(this->IsDualReturn ? DUAL_RETURN : STRONGEST_RETURN);
+    packet.factoryField2 = static_cast<std::uint8_t>(model.Type);
+  }
+
+  this->ElapsedTime += firings * this->GetFiringDuration();
+  this->NumberOfPackets++;
+}
+
+//-----------------------------------------------------------------------------
+void VelodynePacketGenerator::Generate(PacketSlot& slot, unsigned short port)
+{
+  this->Generate(slot.GetPayloadBuffer());
+  slot.SetPayload(HDLDataPacket::getDataByteLength(), SOURCE_IP, port, port);
+}
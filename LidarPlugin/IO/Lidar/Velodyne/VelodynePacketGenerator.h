@@ -0,0 +1,148 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VELODYNEPACKETGENERATOR_H
+#define VELODYNEPACKETGENERATOR_H
+
+// STD
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// VTK
+#include <vtkSystemIncludes.h>
+
+struct PacketSlot;
+
+/**
+ * \class VelodynePacketGenerator
+ * \brief Synthesize the data packets of a Velodyne sensor looking at a parametric scene,
+ * to load test the decoding and the streaming without sensor nor recorded pcap.
+ *
+ * The packets follow the layout of the real sensors (firing blocks, dual return blocks,
+ * factory bytes), with the timing of the firings: the azimuth advances with the rpm and
+ * the gpsTimestamp with the firing period of the model, rolling over every hour. The
+ * HDL-64 packets carry the rolling calibration in their status bytes, so they can be
+ * decoded without calibration file.
+ *
+ * The scene is a ground plane, a cylindrical wall around the sensor and vertical pillars
+ * between them. The elevations of the lasers are spread evenly over the vertical field of
+ * view of the model, they do not match the calibration files of the real sensors.
+ */
+class VTK_EXPORT VelodynePacketGenerator
+{
+public:
+  enum Model
+  {
+    HDL32,
+    VLP16,
+    VLP32,
+    HDL64,
+    VLS128,
+  };
+
+  struct Scene
+  {
+    //! Height of the sensor above the ground, in meters
+    double SensorHeight = 1.8;
+    //! Radius of the wall around the sensor, in meters
+    double WallRadius = 30;
+    //! Pillars evenly spread around the sensor, 0 for none
+    int NumberOfPillars = 8;
+    //! Distance between the sensor and the axis of the pillars, in meters
+    double PillarDistance = 8;
+    double PillarRadius = 0.5;
+  };
+
+  /**
+   * @brief VelodynePacketGenerator
+   * @param model sensor to synthesize
+   * @param isDualReturn synthesize dual return packets, the strongest return is the
+   * nearest object and the last one is the scene behind the pillars
+   * @param rpm rotation speed of the sensor
+   */
+  VelodynePacketGenerator(Model model, bool isDualReturn = false, double rpm = 600);
+
+  //! Parse "HDL32", "VLP16", "VLP32", "HDL64" or "VLS128", return false if unknown
+  static bool GetModelFromString(const std::string& name, Model& model);
+  static std::string GetModelName(Model model);
+
+  void SetScene(const Scene& scene);
+  const Scene& GetScene() const { return this->SceneDescription; }
+
+  //! Time of the first packet, in seconds past the hour, to test the rollover of the
+  //! gpsTimestamp. It restarts the generation.
+  void SetStartTime(double secondsPastTheHour);
+
+  Model GetModel() const { return this->SensorModel; }
+  bool GetIsDualReturn() const { return this->IsDualReturn; }
+  int GetNumberOfLasers() const;
+
+  //! Number of packets the sensor sends per second
+  double GetPacketRate() const;
+
+  //! Number of packets of a full rotation
+  double GetNumberOfPacketsPerRotation() const;
+
+  //! Time of the next packet in seconds since the start of the generation
+  double GetTime() const { return this->ElapsedTime * 1e-9; }
+
+  //! Number of packets generated since the start of the generation
+  std::uint64_t GetNumberOfPackets() const { return this->NumberOfPackets; }
+
+  //! Write the next packet, of HDLDataPacket::getDataByteLength() bytes
+  void Generate(unsigned char* packet);
+
+  //! Write the next packet in a slot, as a PacketReceiver would for a packet received
+  //! on the port
+  void Generate(PacketSlot& slot, unsigned short port = 2368);
+
+private:
+  //! Fill the distance and intensity tables of the scene
+  void ComputeScene();
+
+  //! Fill the 4160 bytes sent in the status bytes of the HDL-64 packets
+  void ComputeRollingCalibration();
+
+  double GetElevation(int laser) const;
+
+  //! Firings of all the lasers in a packet
+  int GetNumberOfFiringsPerPacket() const;
+
+  //! Time between two firings of all the lasers, in nanoseconds
+  std::int64_t GetFiringDuration() const;
+
+  Model SensorModel;
+  bool IsDualReturn;
+  double Rpm;
+  Scene SceneDescription;
+
+  /*!< Raw distance and intensity of each laser every tenth of degree, the nearest
+   *   object first, then the scene without the pillars for the last return */
+  std::vector<std::uint16_t> NearestDistances;
+  std::vector<std::uint16_t> FarthestDistances;
+  std::vector<std::uint8_t> NearestIntensities;
+  std::vector<std::uint8_t> FarthestIntensities;
+
+  std::vector<unsigned char> RollingCalibration;
+
+  std::int64_t StartTime = 0;
+  /*!< Nanoseconds since the start of the generation */
+  std::int64_t ElapsedTime = 0;
+  /*!< Azimuth of the next firing in hundredths of degree */
+  double Azimuth = 0;
+  std::uint64_t NumberOfPackets = 0;
+};
+
+#endif // VELODYNEPACKETGENERATOR_H
@@ -309,6 +309,158 @@ struct HDLLaserCorrection // Internal representation of per-laser correction
   }
 };
 
+// Following struct are direct mapping from the manual
+//      "Velodyne, Inc. ©2013  63‐HDL64ES3 REV G" Appendix E. Pages 31-42
+struct HDLLaserCorrectionByte
+{
+  // This is the per laser 64-byte struct in the rolling data
+  // It corresponds to 4 cycles of (9 HW status bytes + 7 calibration bytes)
+  // WARNING data in packets are little-endian, which enables direct casting
+  //  in short ONLY on little-endian machines (Intel & Co are fine)
+
+  // Cycle n+0
+  unsigned char hour_cycle0;
+  unsigned char minutes_cycle0;
+  unsigned char seconds_cycle0;
+  unsigned char day_cycle0;
+  unsigned char month_cycle0;
+  unsigned char year_cycle0;
+  unsigned char gpsSignalStatus_cycle0;
+  unsigned char temperature_cycle0;
+  unsigned char firmwareVersion_cycle0;
+  unsigned char warningBit;          // 'U' in very first cycle (laser #0)
+  unsigned char reserved1;           // 'N' in very first cycle (laser #0)
+  unsigned char reserved2;           // 'I' in very first cycle (laser #0)
+  unsigned char reserved3;           // 'T' in very first cycle (laser #0)
+  unsigned char reserved4;           // '#' in very first cycle (laser #0)
+  unsigned char upperBlockThreshold; // only in very first cycle (laser #0)
+  unsigned char lowerBlockThreshold; // only in very first cycle (laser #0)
+
+  // Cycle n+1
+  unsigned char hour_cycle1;
+  unsigned char minutes_cycle1;
+  unsigned char seconds_cycle1;
+  unsigned char day_cycle1;
+  unsigned char month_cycle1;
+  unsigned char year_cycle1;
+  unsigned char gpsSignalStatus_cycle1;
+  unsigned char temperature_cycle1;
+  unsigned char firmwareVersion_cycle1;
+
+  unsigned char channel;
+  signed short verticalCorrection;    // This is in 100th of degree
+  signed short rotationalCorrection;  // This is in 100th of degree
+  signed short farDistanceCorrection; // This is in millimeter
+  // Cycle n+2
+  unsigned char hour_cycle2;
+  unsigned char minutes_cycle2;
+  unsigned char seconds_cycle2;
+  unsigned char day_cycle2;
+  unsigned char month_cycle2;
+  unsigned char year_cycle2;
+  unsigned char gpsSignalStatus_cycle2;
+  unsigned char temperature_cycle2;
+  unsigned char firmwareVersion_cycle2;
+
+  signed short distanceCorrectionX;
+  signed short distanceCorrectionV;
+  signed short verticalOffset;
+
+  unsigned char horizontalOffsetByte1;
+  // Cycle n+3
+  unsigned char hour_cycle3;
+  unsigned char minutes_cycle3;
+  unsigned char seconds_cycle3;
+  unsigned char day_cycle3;
+  unsigned char month_cycle3;
+  unsigned char year_cycle3;
+  unsigned char gpsSignalStatus_cycle3;
+  unsigned char temperature_cycle3;
+  unsigned char firmwareVersion_cycle3;
+
+  unsigned char horizontalOffsetByte2;
+
+  signed short focalDistance;
+  signed short focalSlope;
+
+  unsigned char minIntensity;
+  unsigned char maxIntensity;
+};
+
+struct last4cyclesByte
+{
+  // Cycle n+0
+  unsigned char hour_cycle0;
+  unsigned char minutes_cycle0;
+  unsigned char seconds_cycle0;
+  unsigned char day_cycle0;
+  unsigned char month_cycle0;
+  unsigned char year_cycle0;
+  unsigned char gpsSignalStatus_cycle0;
+  unsigned char temperature_cycle0;
+  unsigned char firmwareVersion_cycle0;
+
+  unsigned char calibration_year;
+  unsigned char calibration_month;
+  unsigned char calibration_day;
+  unsigned char calibration_hour;
+  unsigned char calibration_minutes;
+  unsigned char calibration_seconds;
+  unsigned char humidity;
+  // Cycle n+1
+  unsigned char hour_cycle1;
+  unsigned char minutes_cycle1;
+  unsigned char seconds_cycle1;
+  unsigned char day_cycle1;
+  unsigned char month_cycle1;
+  unsigned char year_cycle1;
+  unsigned char gpsSignalStatus_cycle1;
+  unsigned char temperature_cycle1;
+  unsigned char firmwareVersion_cycle1;
+
+  signed short motorRPM;
+  unsigned short fovStartAngle; // in 100th of degree
+  unsigned short fovEndAngle;   // in 100th of degree
+  unsigned char realLifeTimeByte1;
+  // Cycle n+2
+  unsigned char hour_cycle2;
+  unsigned char minutes_cycle2;
+  unsigned char seconds_cycle2;
+  unsigned char day_cycle2;
+  unsigned char month_cycle2;
+  unsigned char year_cycle2;
+  unsigned char gpsSignalStatus_cycle2;
+  unsigned char temperature_cycle2;
+  unsigned char firmwareVersion_cycle2;
+
+  unsigned char realLifeTimeByte2;
+
+  unsigned char sourceIPByte1;
+  unsigned char sourceIPByte2;
+  unsigned char sourceIPByte3;
+  unsigned char sourceIPByte4;
+
+  unsigned char destinationIPByte1;
+  unsigned char destinationIPByte2;
+  // Cycle n+3
+  unsigned char hour_cycle3;
+  unsigned char minutes_cycle3;
+  unsigned char seconds_cycle3;
+  unsigned char day_cycle3;
+  unsigned char month_cycle3;
+  unsigned char year_cycle3;
+  unsigned char gpsSignalStatus_cycle3;
+  unsigned char temperature_cycle3;
+  unsigned char firmwareVersion_cycle3;
+
+  unsigned char destinationIPByte3;
+  unsigned char destinationIPByte4;
+  unsigned char multipleReturnStatus; // 0= Strongest, 1= Last, 2= Both
+  unsigned char reserved3;
+  unsigned char powerLevelStatus;
+  unsigned short calibrationDataCRC;
+};
+
 struct HDLRGB
 {
   uint8_t r;
@@ -3,6 +3,8 @@
 #include <vtkPoints.h>
 #include <vtkPointData.h>
 #include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkTypeInt64Array.h>
 #include <vtkTransform.h>
 
 #include <boost/property_tree/xml_parser.hpp>
@@ -23,25 +25,89 @@ using namespace DataPacketFixedLength;
 
 //namespace
 //{
+//! Microseconds between two rollings of the timestamps of the sensor
+const vtkTypeInt64 MICROSECONDS_PER_HOUR = 3600LL * 1000000LL;
+
+//! Return true if the timestamps of the sensor rolled over between two packets. A packet
+//! received slightly out of order has a smaller timestamp without any rollover.
+bool HasRolledOver(double previousTimestamp, unsigned int timestamp)
+{
+  return previousTimestamp - timestamp > MICROSECONDS_PER_HOUR / 2;
+}
+
+//! How an array of the frame under construction is used
+enum ArrayUsage
+{
+  UNUSED_ARRAY,   // not computed
+  INTERNAL_ARRAY, // computed but not added to the frame
+  OUTPUT_ARRAY,   // computed and added to the frame
+};
+
 //! @todo this method are actually usefull for every Interpreter and should go to the top
-template<typename T>
-vtkSmartPointer<T> CreateDataArray(const char* name, vtkIdType np, vtkIdType prereserved_np, vtkPolyData* pd)
+//! Return the array of a frame recycled by the FramePool, or create it. The arrays which
+//! are not attached to the frames (current) are reused when nothing else references them.
+//! Unused arrays are removed from the frame and nullptr is returned.
+vtkSmartPointer<vtkDataArray> GetFrameArray(const vtkSmartPointer<vtkDataArray>& current, const char* name,
+                                            int dataType, vtkPolyData* pd, ArrayUsage usage)
 {
-  vtkSmartPointer<T> array = vtkSmartPointer<T>::New();
-  array->Allocate(prereserved_np);
-  array->SetName(name);
-  if (np > 0)
+  vtkSmartPointer<vtkDataArray> array = pd->GetPointData()->GetArray(name);
+  if (array && (usage != OUTPUT_ARRAY || array->GetDataType() != dataType))
   {
-    array->SetNumberOfTuples(np);
+    pd->GetPointData()->RemoveArray(name);
   }
-  if (pd)
+  if (usage == UNUSED_ARRAY)
   {
-    pd->GetPointData()->AddArray(array);
+    return nullptr;
+  }
+  if (array && array->GetDataType() == dataType)
+  {
+    return array;
   }
 
+  if (current && current->GetReferenceCount() == 1 && current->GetDataType() == dataType)
+  {
+    array = current;
+  }
+  else
+  {
+    array.TakeReference(vtkDataArray::CreateDataArray(dataType));
+    array->SetName(name);
+  }
+  if (usage == OUTPUT_ARRAY)
+  {
+    pd->GetPointData()->AddArray(array);
+  }
   return array;
 }
 
+//-----------------------------------------------------------------------------
+template<typename T>
+T* GetBuffer(vtkDataArray* array)
+{
+  return array ? static_cast<T*>(array->GetVoidPointer(0)) : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Real valued arrays are float or double arrays depending on the output precision
+void SetRealValue(void* buffer, vtkIdType index, double value, bool isDoublePrecision)
+{
+  if (isDoublePrecision)
+  {
+    static_cast<double*>(buffer)[index] = value;
+  }
+  else
+  {
+    static_cast<float*>(buffer)[index] = static_cast<float>(value);
+  }
+}
+
+//-----------------------------------------------------------------------------
+double GetRealValue(const void* buffer, vtkIdType index, bool isDoublePrecision)
+{
+  return isDoublePrecision ? static_cast<const double*>(buffer)[index]
+                           : static_cast<const float*>(buffer)[index];
+}
+
 // Structure to compute RPM and handle degenerated cases
 struct RPMCalculator
 {
@@ -281,160 +347,143 @@ public:
   }
 };
 
-#pragma pack(push, 1)
-// Following struct are direct mapping from the manual
-//      "Velodyne, Inc. ©2013  63‐HDL64ES3 REV G" Appendix E. Pages 31-42
-struct HDLLaserCorrectionByte
+//-----------------------------------------------------------------------------
+// Detect the data packets lost between two consecutive ones. The sensor sends its
+// packets at a fixed period which depends on its model and return mode, so the
+// period is estimated as the median of the last gpsTimestamp increments, and an
+// increment of several periods means that packets were lost. The azimuths swept
+// between the two packets are reported as an angular gap, as well as an azimuth
+// jump without missing packet which means that the sensor did not fire. A packet older
+// than the previous one, reordered or after a resynchronization of the clock, is not a
+// loss: the steps to it and from it are ignored, and a reordered packet which was counted
+// as missing before it arrived is not missing anymore.
+class PacketLossDetector
 {
-  // This is the per laser 64-byte struct in the rolling data
-  // It corresponds to 4 cycles of (9 HW status bytes + 7 calibration bytes)
-  // WARNING data in packets are little-endian, which enables direct casting
-  //  in short ONLY on little-endian machines (Intel & Co are fine)
-
-  // Cycle n+0
-  unsigned char hour_cycle0;
-  unsigned char minutes_cycle0;
-  unsigned char seconds_cycle0;
-  unsigned char day_cycle0;
-  unsigned char month_cycle0;
-  unsigned char year_cycle0;
-  unsigned char gpsSignalStatus_cycle0;
-  unsigned char temperature_cycle0;
-  unsigned char firmwareVersion_cycle0;
-  unsigned char warningBit;          // 'U' in very first cycle (laser #0)
-  unsigned char reserved1;           // 'N' in very first cycle (laser #0)
-  unsigned char reserved2;           // 'I' in very first cycle (laser #0)
-  unsigned char reserved3;           // 'T' in very first cycle (laser #0)
-  unsigned char reserved4;           // '#' in very first cycle (laser #0)
-  unsigned char upperBlockThreshold; // only in very first cycle (laser #0)
-  unsigned char lowerBlockThreshold; // only in very first cycle (laser #0)
-
-  // Cycle n+1
-  unsigned char hour_cycle1;
-  unsigned char minutes_cycle1;
-  unsigned char seconds_cycle1;
-  unsigned char day_cycle1;
-  unsigned char month_cycle1;
-  unsigned char year_cycle1;
-  unsigned char gpsSignalStatus_cycle1;
-  unsigned char temperature_cycle1;
-  unsigned char firmwareVersion_cycle1;
-
-  unsigned char channel;
-  signed short verticalCorrection;    // This is in 100th of degree
-  signed short rotationalCorrection;  // This is in 100th of degree
-  signed short farDistanceCorrection; // This is in millimeter
-  // Cycle n+2
-  unsigned char hour_cycle2;
-  unsigned char minutes_cycle2;
-  unsigned char seconds_cycle2;
-  unsigned char day_cycle2;
-  unsigned char month_cycle2;
-  unsigned char year_cycle2;
-  unsigned char gpsSignalStatus_cycle2;
-  unsigned char temperature_cycle2;
-  unsigned char firmwareVersion_cycle2;
-
-  signed short distanceCorrectionX;
-  signed short distanceCorrectionV;
-  signed short verticalOffset;
-
-  unsigned char horizontalOffsetByte1;
-  // Cycle n+3
-  unsigned char hour_cycle3;
-  unsigned char minutes_cycle3;
-  unsigned char seconds_cycle3;
-  unsigned char day_cycle3;
-  unsigned char month_cycle3;
-  unsigned char year_cycle3;
-  unsigned char gpsSignalStatus_cycle3;
-  unsigned char temperature_cycle3;
-  unsigned char firmwareVersion_cycle3;
-
-  unsigned char horizontalOffsetByte2;
-
-  signed short focalDistance;
-  signed short focalSlope;
-
-  unsigned char minIntensity;
-  unsigned char maxIntensity;
-};
+  static const int NumberOfIncrements = 16;
 
-struct last4cyclesByte
-{
-  // Cycle n+0
-  unsigned char hour_cycle0;
-  unsigned char minutes_cycle0;
-  unsigned char seconds_cycle0;
-  unsigned char day_cycle0;
-  unsigned char month_cycle0;
-  unsigned char year_cycle0;
-  unsigned char gpsSignalStatus_cycle0;
-  unsigned char temperature_cycle0;
-  unsigned char firmwareVersion_cycle0;
-
-  unsigned char calibration_year;
-  unsigned char calibration_month;
-  unsigned char calibration_day;
-  unsigned char calibration_hour;
-  unsigned char calibration_minutes;
-  unsigned char calibration_seconds;
-  unsigned char humidity;
-  // Cycle n+1
-  unsigned char hour_cycle1;
-  unsigned char minutes_cycle1;
-  unsigned char seconds_cycle1;
-  unsigned char day_cycle1;
-  unsigned char month_cycle1;
-  unsigned char year_cycle1;
-  unsigned char gpsSignalStatus_cycle1;
-  unsigned char temperature_cycle1;
-  unsigned char firmwareVersion_cycle1;
-
-  signed short motorRPM;
-  unsigned short fovStartAngle; // in 100th of degree
-  unsigned short fovEndAngle;   // in 100th of degree
-  unsigned char realLifeTimeByte1;
-  // Cycle n+2
-  unsigned char hour_cycle2;
-  unsigned char minutes_cycle2;
-  unsigned char seconds_cycle2;
-  unsigned char day_cycle2;
-  unsigned char month_cycle2;
-  unsigned char year_cycle2;
-  unsigned char gpsSignalStatus_cycle2;
-  unsigned char temperature_cycle2;
-  unsigned char firmwareVersion_cycle2;
-
-  unsigned char realLifeTimeByte2;
-
-  unsigned char sourceIPByte1;
-  unsigned char sourceIPByte2;
-  unsigned char sourceIPByte3;
-  unsigned char sourceIPByte4;
-
-  unsigned char destinationIPByte1;
-  unsigned char destinationIPByte2;
-  // Cycle n+3
-  unsigned char hour_cycle3;
-  unsigned char minutes_cycle3;
-  unsigned char seconds_cycle3;
-  unsigned char day_cycle3;
-  unsigned char month_cycle3;
-  unsigned char year_cycle3;
-  unsigned char gpsSignalStatus_cycle3;
-  unsigned char temperature_cycle3;
-  unsigned char firmwareVersion_cycle3;
-
-  unsigned char destinationIPByte3;
-  unsigned char destinationIPByte4;
-  unsigned char multipleReturnStatus; // 0= Strongest, 1= Last, 2= Both
-  unsigned char reserved3;
-  unsigned char powerLevelStatus;
-  unsigned short calibrationDataCRC;
+  unsigned int Increments[NumberOfIncrements];
+  int NumberOfKnownIncrements;
+  int NextIncrement;
+  unsigned int LastTimestamp;
+  int LastAzimuth;
+  bool IsAfterBackwardStep;
+  //! Timestamp before LastTimestamp, and number of packets missing between them
+  unsigned int PreviousTimestamp;
+  int LastMissingPackets;
+
+public:
+  PacketLossDetector() { reset(); }
+  void reset()
+  {
+    NumberOfKnownIncrements = 0;
+    NextIncrement = 0;
+    LastTimestamp = 0;
+    LastAzimuth = -1;
+    IsAfterBackwardStep = false;
+    PreviousTimestamp = 0;
+    LastMissingPackets = 0;
+  }
+
+  // Return the number of packets missing before this packet, -1 if this packet was
+  // reordered and counted as missing before it arrived. angularGap is set to
+  // the start and end azimuths (in hundredths of degree) not covered before this
+  // packet, or to -1 if there is no gap.
+  int addPacket(const HDLDataPacket& packet, int angularGap[2])
+  {
+    angularGap[0] = angularGap[1] = -1;
+
+    // azimuths of the first and last firings, and the greatest advance between two firings
+    int firstAzimuth = -1;
+    int lastAzimuth = -1;
+    int azimuthStep = 0;
+    for (int i = 0; i < HDL_FIRING_PER_PKT; ++i)
+    {
+      const HDLFiringData& firingData = packet.firingData[i];
+      // Skip dummy blocks of VLS-128 dual mode last 4 blocks
+      if (packet.isVLS128() && (firingData.blockIdentifier == 0 || firingData.blockIdentifier == 0xFFFF))
+      {
+        continue;
+      }
+      if (firstAzimuth == -1)
+      {
+        firstAzimuth = firingData.rotationalPosition;
+      }
+      else
+      {
+        azimuthStep = std::max(azimuthStep, AzimuthDifference(lastAzimuth, firingData.rotationalPosition));
+      }
+      lastAzimuth = firingData.rotationalPosition;
+    }
+
+    int missingPackets = 0;
+    const bool isFirstPacket = LastAzimuth == -1;
+    const vtkTypeInt64 step = TimestampDifference(LastTimestamp, packet.gpsTimestamp);
+    const bool isBackwardStep = !isFirstPacket && step < 0;
+    if (isBackwardStep && LastMissingPackets > 0 &&
+        TimestampDifference(PreviousTimestamp, packet.gpsTimestamp) > 0)
+    {
+      LastMissingPackets--;
+      missingPackets = -1;
+    }
+    else if (!isFirstPacket && !isBackwardStep && !IsAfterBackwardStep)
+    {
+      const unsigned int increment = static_cast<unsigned int>(step);
+      if (NumberOfKnownIncrements >= NumberOfIncrements / 4)
+      {
+        unsigned int increments[NumberOfIncrements];
+        std::copy(Increments, Increments + NumberOfKnownIncrements, increments);
+        std::nth_element(increments, increments + NumberOfKnownIncrements / 2,
+                         increments + NumberOfKnownIncrements);
+        const double period = increments[NumberOfKnownIncrements / 2];
+        if (period > 0 && increment > 1.5 * period)
+        {
+          missingPackets = static_cast<int>(std::floor(increment / period + 0.5)) - 1;
+        }
+      }
+      Increments[NextIncrement] = increment;
+      NextIncrement = (NextIncrement + 1) % NumberOfIncrements;
+      if (NumberOfKnownIncrements < NumberOfIncrements)
+      {
+        NumberOfKnownIncrements++;
+      }
+
+      const int advance = AzimuthDifference(LastAzimuth, firstAzimuth);
+      if (missingPackets > 0 || (azimuthStep > 0 && advance > 2 * azimuthStep))
+      {
+        angularGap[0] = LastAzimuth;
+        angularGap[1] = firstAzimuth;
+      }
+    }
+
+    if (!isBackwardStep)
+    {
+      PreviousTimestamp = LastTimestamp;
+      LastMissingPackets = missingPackets;
+    }
+    LastTimestamp = packet.gpsTimestamp;
+    LastAzimuth = lastAzimuth;
+    IsAfterBackwardStep = isBackwardStep;
+    return missingPackets;
+  }
+
+  // Signed difference in ]-18000, 18000] between two azimuths in hundredths of degree
+  static int AzimuthDifference(int from, int to)
+  {
+    return (36000 + 18000 + to - from) % 36000 - 18000;
+  }
+
+  // Signed difference in microseconds between two timestamps, which are the microseconds
+  // since the top of the hour. As for HasRolledOver, a step of more than half an hour
+  // backward is a rollover, so a step of more than half an hour forward is a step back
+  // across the rollover.
+  static vtkTypeInt64 TimestampDifference(unsigned int from, unsigned int to)
+  {
+    const vtkTypeInt64 halfHour = MICROSECONDS_PER_HOUR / 2;
+    return (MICROSECONDS_PER_HOUR + halfHour + to - static_cast<vtkTypeInt64>(from)) %
+      MICROSECONDS_PER_HOUR - halfHour;
+  }
 };
 
-#pragma pack(pop)
 //} // End namespace
 
 //-----------------------------------------------------------------------------
@@ -449,8 +498,12 @@ vtkVelodynePacketInterpreter::vtkVelodynePacketInterpreter()
   this->OutputPacketProcessingDebugInfo = false;
   this->SensorPowerMode = 0;
   this->CurrentFrameState = new FramingState;
+  this->PreProcessingFrameState = new FramingState;
+  this->CurrentLossDetector = new PacketLossDetector;
+  this->PreProcessingLossDetector = new PacketLossDetector;
   this->LastTimestamp = std::numeric_limits<unsigned int>::max();
   this->TimeAdjust = std::numeric_limits<double>::quiet_NaN();
+  this->CurrentFrameBaseTime = std::numeric_limits<vtkTypeInt64>::min();
   this->FiringsSkip = 0;
   this->ShouldCheckSensor = true;
 
@@ -477,6 +530,49 @@ vtkVelodynePacketInterpreter::~vtkVelodynePacketInterpreter()
     delete this->rollingCalibrationData;
   }
   delete this->CurrentFrameState;
+  delete this->PreProcessingFrameState;
+  delete this->CurrentLossDetector;
+  delete this->PreProcessingLossDetector;
+}
+
+//-----------------------------------------------------------------------------
+void vtkVelodynePacketInterpreter::CopySettings(vtkLidarPacketInterpreter* source)
+{
+  this->Superclass::CopySettings(source);
+  vtkVelodynePacketInterpreter* velSource = vtkVelodynePacketInterpreter::SafeDownCast(source);
+  if (!velSource)
+  {
+    return;
+  }
+
+  // calibration, which can come from a file or from the live stream (HDL64)
+  std::copy(velSource->laser_corrections_, velSource->laser_corrections_ + HDL_MAX_NUM_LASERS,
+            this->laser_corrections_);
+  std::copy(&velSource->XMLColorTable[0][0], &velSource->XMLColorTable[0][0] + HDL_MAX_NUM_LASERS * 3,
+            &this->XMLColorTable[0][0]);
+  this->KernelCorrections = velSource->KernelCorrections;
+  this->cos_lookup_table_ = velSource->cos_lookup_table_;
+  this->sin_lookup_table_ = velSource->sin_lookup_table_;
+  this->IsCorrectionFromLiveStream = velSource->IsCorrectionFromLiveStream;
+
+  // sensor information
+  this->HasDualReturn = velSource->HasDualReturn;
+  this->ReportedSensor = velSource->ReportedSensor;
+  this->ReportedSensorReturnMode = velSource->ReportedSensorReturnMode;
+  this->IsHDL64Data = velSource->IsHDL64Data;
+  this->IsVLS128 = velSource->IsVLS128;
+  this->ReportedFactoryField1 = velSource->ReportedFactoryField1;
+  this->ReportedFactoryField2 = velSource->ReportedFactoryField2;
+  // the intensities of the HDL64 are corrected depending on it
+  this->SensorPowerMode = velSource->SensorPowerMode;
+
+  // user settings
+  this->OutputPacketProcessingDebugInfo = velSource->OutputPacketProcessingDebugInfo;
+  this->WantIntensityCorrection = velSource->WantIntensityCorrection;
+  this->FiringsSkip = velSource->FiringsSkip;
+  this->UseIntraFiringAdjustment = velSource->UseIntraFiringAdjustment;
+  this->UseVectorizedDecoding = velSource->UseVectorizedDecoding;
+  this->DualReturnFilter = velSource->DualReturnFilter;
 }
 
 //-----------------------------------------------------------------------------
@@ -742,7 +838,7 @@ void vtkVelodynePacketInterpreter::ProcessPacket(unsigned char const * data, uns
   }
 
   // Check if the time has rolled during this packet
-  if (dataPacket->gpsTimestamp < this->ParserMetaData.FirstPacketDataTime)
+  if (HasRolledOver(this->ParserMetaData.FirstPacketDataTime, dataPacket->gpsTimestamp))
   {
     reinterpret_cast<VelodyneSpecificFrameInformation*>
         (this->ParserMetaData.SpecificInformation.get())->NbrOfRollingTime++;
@@ -750,7 +846,22 @@ void vtkVelodynePacketInterpreter::ProcessPacket(unsigned char const * data, uns
   this->ParserMetaData.FirstPacketDataTime = dataPacket->gpsTimestamp;
 
   const unsigned int rawtime = dataPacket->gpsTimestamp;
-  const double timestamp = this->ComputeTimestamp(dataPacket->gpsTimestamp, this->ParserMetaData);
+  const vtkTypeInt64 timestamp = this->ComputeTimestamp(dataPacket->gpsTimestamp, this->ParserMetaData);
+
+  // The packets lost before this one are accounted to the current frame
+  int angularGap[2];
+  const int missingPackets = this->CurrentLossDetector->addPacket(*dataPacket, angularGap);
+  if (missingPackets != 0)
+  {
+    // a late packet may have been counted as missing in the previous frame
+    vtkDataArray* missingPacketsData = this->CurrentFrame->GetFieldData()->GetArray("MissingPackets");
+    missingPacketsData->SetTuple1(0, std::max(0., missingPacketsData->GetTuple1(0) + missingPackets));
+  }
+  if (angularGap[0] != -1)
+  {
+    this->CurrentFrame->GetFieldData()->GetArray("AngularGaps")
+      ->InsertNextTuple2(angularGap[0] / 100.0, angularGap[1] / 100.0);
+  }
 
   // Update the rpm computation (by packets)
   this->RpmCalculator_->AddData(dataPacket, rawtime);
@@ -800,9 +911,12 @@ void vtkVelodynePacketInterpreter::ProcessPacket(unsigned char const * data, uns
   if (dataPacket->isDualModeReturn() && !this->HasDualReturn)
   {
     this->HasDualReturn = true;
-    this->CurrentFrame->GetPointData()->AddArray(this->DistanceFlag.GetPointer());
-    this->CurrentFrame->GetPointData()->AddArray(this->IntensityFlag.GetPointer());
-    this->CurrentFrame->GetPointData()->AddArray(this->DualReturnMatching.GetPointer());
+    if (this->OutputArrays & OUTPUT_DUAL_RETURN)
+    {
+      this->CurrentFrame->GetPointData()->AddArray(this->DistanceFlag.GetPointer());
+      this->CurrentFrame->GetPointData()->AddArray(this->IntensityFlag.GetPointer());
+      this->CurrentFrame->GetPointData()->AddArray(this->DualReturnMatching.GetPointer());
+    }
   }
 
   for (; firingBlock < HDL_FIRING_PER_PKT; ++firingBlock)
@@ -828,6 +942,23 @@ void vtkVelodynePacketInterpreter::ProcessPacket(unsigned char const * data, uns
     {
       this->SplitFrame();
       this->LastTimestamp = std::numeric_limits<unsigned int>::max();
+      this->CurrentFrameId++;
+      this->CurrentSectorIndex = this->GetSectorIndex(firingData->rotationalPosition);
+    }
+    else if (this->SectorSize > 0)
+    {
+      // the sector is split between two firings, once the sensor has swept it
+      const int sectorIndex = this->GetSectorIndex(firingData->rotationalPosition);
+      if (sectorIndex != this->CurrentSectorIndex)
+      {
+        if (this->CurrentSectorIndex != -1)
+        {
+          this->IsSplittingSector = true;
+          this->SplitFrame();
+          this->IsSplittingSector = false;
+        }
+        this->CurrentSectorIndex = sectorIndex;
+      }
     }
 
     if (isVLS128)
@@ -835,6 +966,12 @@ void vtkVelodynePacketInterpreter::ProcessPacket(unsigned char const * data, uns
       azimuthDiff = dataPacket->getRotationalDiffForVLS128(firingBlock);
     }
 
+    // the frame starts with this packet, the time of its points is relative to it
+    if (this->CurrentFrameBaseTime == std::numeric_limits<vtkTypeInt64>::min())
+    {
+      this->CurrentFrameBaseTime = timestamp;
+    }
+
     // Skip this firing every PointSkip
     if (this->FiringsSkip == 0 || firingBlock % (this->FiringsSkip + 1) == 0)
     {
@@ -858,15 +995,33 @@ bool vtkVelodynePacketInterpreter::IsLidarPacket(unsigned char const * data, uns
 }
 
 //-----------------------------------------------------------------------------
-void vtkVelodynePacketInterpreter::ProcessFiring(const HDLFiringData *firingData, int firingBlockLaserOffset, int firingBlock, int azimuthDiff, double timestamp, unsigned int rawtime, bool isThisFiringDualReturnData, bool isDualReturnPacket)
+void vtkVelodynePacketInterpreter::ProcessFiring(const HDLFiringData *firingData, int firingBlockLaserOffset, int firingBlock, int azimuthDiff, vtkTypeInt64 timestamp, unsigned int rawtime, bool isThisFiringDualReturnData, bool isDualReturnPacket)
 {
   // First return block of a dual return packet: init last point of laser
   if (!isThisFiringDualReturnData &&
     (!this->IsHDL64Data || (this->IsHDL64Data && ((firingBlock % 4) == 0))))
   {
-    this->FirstPointIdOfDualReturnPair = this->Points->GetNumberOfPoints();
+    this->FirstPointIdOfDualReturnPair = this->NumberOfPointsInCurrentFrame;
+  }
+
+  if (this->CalibrationReportedNumLasers == 16 && firingBlockLaserOffset != 0)
+  {
+    if (!this->alreadyWarnedForIgnoredHDL64FiringPacket)
+    {
+      vtkGenericWarningMacro("Error: Received a HDL-64 UPPERBLOCK firing packet "
+                             "with a VLP-16 calibration file. Ignoring the firing.");
+      this->alreadyWarnedForIgnoredHDL64FiringPacket = true;
+    }
+    return;
   }
 
+  // The laser id, azimuth and timestamp of each return are computed first, then the
+  // positions of all the returns are computed at once by the firing kernel
+  unsigned char laserIds[HDL_LASER_PER_FIRING];
+  double timestampAdjustments[HDL_LASER_PER_FIRING];
+  int azimuths[HDL_LASER_PER_FIRING];
+  int distances[HDL_LASER_PER_FIRING];
+  bool shouldPush[HDL_LASER_PER_FIRING];
   for (int dsr = 0; dsr < HDL_LASER_PER_FIRING; dsr++)
   {
     const unsigned char rawLaserId = static_cast<unsigned char>(dsr + firingBlockLaserOffset);
@@ -878,16 +1033,6 @@ void vtkVelodynePacketInterpreter::ProcessFiring(const HDLFiringData *firingData
 
     if (this->CalibrationReportedNumLasers == 16)
     {
-      if (firingBlockLaserOffset != 0)
-      {
-        if (!this->alreadyWarnedForIgnoredHDL64FiringPacket)
-        {
-          vtkGenericWarningMacro("Error: Received a HDL-64 UPPERBLOCK firing packet "
-                                 "with a VLP-16 calibration file. Ignoring the firing.");
-          this->alreadyWarnedForIgnoredHDL64FiringPacket = true;
-        }
-        return;
-      }
       if (laserId >= 16)
       {
         laserId -= 16;
@@ -957,34 +1102,50 @@ void vtkVelodynePacketInterpreter::ProcessFiring(const HDLFiringData *firingData
         azimuthDiff * ((timestampadjustment - blockdsr0) / (nextblockdsr0 - blockdsr0)));
       timestampadjustment = vtkMath::Round(timestampadjustment);
     }
-    if ((!this->IgnoreZeroDistances || firingData->laserReturns[dsr].distance != 0.0) &&
-      this->LaserSelection[laserId])
+    laserIds[dsr] = laserId;
+    timestampAdjustments[dsr] = timestampadjustment;
+    azimuths[dsr] = static_cast<unsigned short>(azimuth + azimuthadjustment) % 36000;
+    distances[dsr] = firingData->laserReturns[dsr].distance;
+    shouldPush[dsr] = (!this->IgnoreZeroDistances || firingData->laserReturns[dsr].distance != 0.0) &&
+      this->LaserSelection[laserId];
+  }
+
+  FiringPositions positions;
+  VelodyneFiringKernel::ComputePositions(azimuths, distances, firingBlockLaserOffset,
+    this->KernelCorrections, this->DistanceResolutionM, this->cos_lookup_table_.data(),
+    this->sin_lookup_table_.data(), positions,
+    this->UseVectorizedDecoding ? VelodyneFiringKernel::GetBestImplementation()
+                                : VelodyneFiringKernel::SCALAR);
+
+  for (int dsr = 0; dsr < HDL_LASER_PER_FIRING; dsr++)
+  {
+    if (shouldPush[dsr])
     {
-      this->PushFiringData(laserId, rawLaserId, azimuth + azimuthadjustment,
-        timestamp + timestampadjustment, rawtime + static_cast<unsigned int>(timestampadjustment),
+      const double pos[3] = { positions.X[dsr], positions.Y[dsr], positions.Z[dsr] };
+      this->PushFiringData(laserIds[dsr], static_cast<unsigned char>(dsr + firingBlockLaserOffset),
+        azimuths[dsr], timestamp + static_cast<vtkTypeInt64>(timestampAdjustments[dsr]),
+        rawtime + static_cast<unsigned int>(timestampAdjustments[dsr]),
         &(firingData->laserReturns[dsr]), &(laser_corrections_[dsr + firingBlockLaserOffset]),
-        isThisFiringDualReturnData);
+        pos, positions.Distance[dsr], isThisFiringDualReturnData);
     }
   }
 }
 
 //-----------------------------------------------------------------------------
 void vtkVelodynePacketInterpreter::PushFiringData(unsigned char laserId, unsigned char rawLaserId,
-                                                  unsigned short azimuth, double timestamp,
+                                                  unsigned short azimuth, vtkTypeInt64 timestamp,
                                                   unsigned int rawtime, const HDLLaserReturn *laserReturn,
-                                                  const HDLLaserCorrection *correction, bool isFiringDualReturnData)
+                                                  const HDLLaserCorrection *correction, const double position[3],
+                                                  double distanceM, bool isFiringDualReturnData)
 {
-  azimuth %= 36000;
-  const vtkIdType thisPointId = this->Points->GetNumberOfPoints();
+  const vtkIdType thisPointId = this->NumberOfPointsInCurrentFrame;
   short intensity = laserReturn->intensity;
+  if (this->WantIntensityCorrection && this->IsHDL64Data && !(this->SensorPowerMode == CorrectionOn))
+  {
+    intensity = this->ComputeCorrectedIntensity(laserReturn, correction);
+  }
 
-  // Compute raw position
-  double distanceM;
-  double pos[3];
-  bool applyIntensityCorrection =
-    this->WantIntensityCorrection && this->IsHDL64Data && !(this->SensorPowerMode == CorrectionOn);
-  ComputeCorrectedValues(
-    azimuth, laserReturn, correction, pos, distanceM, intensity, applyIntensityCorrection);
+  double pos[3] = { position[0], position[1], position[2] };
 
   // Apply sensor transform
   if (SensorTransform) this->SensorTransform->InternalTransformPoint(pos, pos);
@@ -992,6 +1153,24 @@ void vtkVelodynePacketInterpreter::PushFiringData(unsigned char laserId, unsigne
   if (this->shouldBeCroppedOut(pos))
     return;
 
+  if (thisPointId >= this->CurrentFrameCapacity)
+  {
+    this->CurrentFrameCapacity = std::max(static_cast<vtkIdType>(this->CurrentFrameCapacity * 1.5), thisPointId + 1);
+    this->SetCurrentFrameArraysSize(this->CurrentFrameCapacity);
+  }
+  FrameBuffers& buffers = this->CurrentFrameBuffers;
+  const bool isDouble = buffers.IsDoublePrecision;
+  // the dual return arrays are only computed when they are part of the output
+  const bool hasDualReturnArrays = buffers.DualReturnMatching != nullptr;
+  auto setFlags = [&buffers, hasDualReturnArrays](vtkIdType pointId, unsigned int flags) {
+    buffers.Flags[pointId] = flags;
+    if (hasDualReturnArrays)
+    {
+      buffers.DistanceFlag[pointId] = MapDistanceFlag(flags);
+      buffers.IntensityFlag[pointId] = MapIntensityFlag(flags);
+    }
+  };
+
   // Do not add any data before here as this might short-circuit
   if (isFiringDualReturnData)
   {
@@ -999,19 +1178,24 @@ void vtkVelodynePacketInterpreter::PushFiringData(unsigned char laserId, unsigne
     if (dualPointId < this->FirstPointIdOfDualReturnPair)
     {
       // No matching point from first set (skipped?)
-      this->Flags->InsertNextValue(DUAL_DOUBLED);
-      this->DistanceFlag->InsertNextValue(0);
-      this->DualReturnMatching->InsertNextValue(-1); // std::numeric_limits<vtkIdType>::quiet_NaN()
-      this->IntensityFlag->InsertNextValue(0);
+      buffers.Flags[thisPointId] = DUAL_DOUBLED;
+      if (hasDualReturnArrays)
+      {
+        buffers.DistanceFlag[thisPointId] = 0;
+        buffers.DualReturnMatching[thisPointId] = -1; // std::numeric_limits<vtkIdType>::quiet_NaN()
+        buffers.IntensityFlag[thisPointId] = 0;
+      }
     }
     else
     {
-      const short dualIntensity = this->Intensity->GetValue(dualPointId);
-      const double dualDistance = this->Distance->GetValue(dualPointId);
-      unsigned int firstFlags = this->Flags->GetValue(dualPointId);
+      const short dualIntensity = buffers.Intensity[dualPointId];
+      const double dualDistance = GetRealValue(buffers.Distance, dualPointId, isDouble);
+      // compare with the distance as it would be stored
+      const double storedDistanceM = isDouble ? distanceM : static_cast<float>(distanceM);
+      unsigned int firstFlags = buffers.Flags[dualPointId];
       unsigned int secondFlags = 0;
 
-      if (dualDistance == distanceM && intensity == dualIntensity)
+      if (dualDistance == storedDistanceM && intensity == dualIntensity)
       {
         // ignore duplicate point and leave first with original flags
         return;
@@ -1028,7 +1212,7 @@ void vtkVelodynePacketInterpreter::PushFiringData(unsigned char laserId, unsigne
         secondFlags |= DUAL_INTENSITY_LOW;
       }
 
-      if (dualDistance < distanceM)
+      if (dualDistance < storedDistanceM)
       {
         firstFlags &= ~DUAL_DISTANCE_FAR;
         secondFlags |= DUAL_DISTANCE_FAR;
@@ -1045,60 +1229,98 @@ void vtkVelodynePacketInterpreter::PushFiringData(unsigned char laserId, unsigne
         if (!(secondFlags & this->DualReturnFilter))
         {
           // second return does not match filter; skip
-          this->Flags->SetValue(dualPointId, firstFlags);
-          this->DistanceFlag->SetValue(dualPointId, MapDistanceFlag(firstFlags));
-          this->IntensityFlag->SetValue(dualPointId, MapIntensityFlag(firstFlags));
+          setFlags(dualPointId, firstFlags);
           return;
         }
         if (!(firstFlags & this->DualReturnFilter))
         {
           // first return does not match filter; replace with second return
-          this->Points->SetPoint(dualPointId, pos);
-          this->Distance->SetValue(dualPointId, distanceM);
-          this->DistanceRaw->SetValue(dualPointId, laserReturn->distance);
-          this->Intensity->SetValue(dualPointId, intensity);
-          this->Timestamp->SetValue(dualPointId, timestamp);
-          this->RawTime->SetValue(dualPointId, rawtime);
-          this->Flags->SetValue(dualPointId, secondFlags);
-          this->DistanceFlag->SetValue(dualPointId, MapDistanceFlag(secondFlags));
-          this->IntensityFlag->SetValue(dualPointId, MapIntensityFlag(secondFlags));
+          std::copy(pos, pos + 3, buffers.Points + dualPointId * 3);
+          SetRealValue(buffers.Distance, dualPointId, distanceM, isDouble);
+          buffers.Intensity[dualPointId] = intensity;
+          if (buffers.DistanceRaw)
+          {
+            buffers.DistanceRaw[dualPointId] = laserReturn->distance;
+          }
+          if (buffers.Timestamp)
+          {
+            buffers.Timestamp[dualPointId] = static_cast<double>(timestamp);
+          }
+          if (buffers.TimeOffset)
+          {
+            buffers.TimeOffset[dualPointId] = static_cast<int>(timestamp - this->CurrentFrameBaseTime);
+          }
+          if (buffers.RawTime)
+          {
+            buffers.RawTime[dualPointId] = rawtime;
+          }
+          setFlags(dualPointId, secondFlags);
           return;
         }
       }
 
-      this->Flags->SetValue(dualPointId, firstFlags);
-      this->DistanceFlag->SetValue(dualPointId, MapDistanceFlag(firstFlags));
-      this->IntensityFlag->SetValue(dualPointId, MapIntensityFlag(firstFlags));
-      this->Flags->InsertNextValue(secondFlags);
-      this->DistanceFlag->InsertNextValue(MapDistanceFlag(secondFlags));
-      this->IntensityFlag->InsertNextValue(MapIntensityFlag(secondFlags));
-      // The first return indicates the dual return
-      // and the dual return indicates the first return
-      this->DualReturnMatching->InsertNextValue(dualPointId);
-      this->DualReturnMatching->SetValue(dualPointId, thisPointId);
+      setFlags(dualPointId, firstFlags);
+      setFlags(thisPointId, secondFlags);
+      if (hasDualReturnArrays)
+      {
+        // The first return indicates the dual return
+        // and the dual return indicates the first return
+        buffers.DualReturnMatching[thisPointId] = dualPointId;
+        buffers.DualReturnMatching[dualPointId] = thisPointId;
+      }
     }
   }
   else
   {
-    this->Flags->InsertNextValue(DUAL_DOUBLED);
-    this->DistanceFlag->InsertNextValue(0);
-    this->IntensityFlag->InsertNextValue(0);
-    this->DualReturnMatching->InsertNextValue(-1); // std::numeric_limits<vtkIdType>::quiet_NaN()
-  }
-
-  this->Points->InsertNextPoint(pos);
-  this->PointsX->InsertNextValue(pos[0]);
-  this->PointsY->InsertNextValue(pos[1]);
-  this->PointsZ->InsertNextValue(pos[2]);
-  this->Azimuth->InsertNextValue(azimuth);
-  this->Intensity->InsertNextValue(intensity);
-  this->LaserId->InsertNextValue(laserId);
-  this->Timestamp->InsertNextValue(timestamp);
-  this->RawTime->InsertNextValue(rawtime);
-  this->Distance->InsertNextValue(distanceM);
-  this->DistanceRaw->InsertNextValue(laserReturn->distance);
+    buffers.Flags[thisPointId] = DUAL_DOUBLED;
+    if (hasDualReturnArrays)
+    {
+      buffers.DistanceFlag[thisPointId] = 0;
+      buffers.IntensityFlag[thisPointId] = 0;
+      buffers.DualReturnMatching[thisPointId] = -1; // std::numeric_limits<vtkIdType>::quiet_NaN()
+    }
+  }
+
+  std::copy(pos, pos + 3, buffers.Points + thisPointId * 3);
+  buffers.Intensity[thisPointId] = intensity;
+  SetRealValue(buffers.Distance, thisPointId, distanceM, isDouble);
+  if (buffers.PointsX)
+  {
+    SetRealValue(buffers.PointsX, thisPointId, pos[0], isDouble);
+    SetRealValue(buffers.PointsY, thisPointId, pos[1], isDouble);
+    SetRealValue(buffers.PointsZ, thisPointId, pos[2], isDouble);
+  }
+  if (buffers.Azimuth)
+  {
+    buffers.Azimuth[thisPointId] = azimuth;
+  }
+  if (buffers.LaserId)
+  {
+    buffers.LaserId[thisPointId] = laserId;
+  }
+  if (buffers.Timestamp)
+  {
+    buffers.Timestamp[thisPointId] = static_cast<double>(timestamp);
+  }
+  if (buffers.TimeOffset)
+  {
+    buffers.TimeOffset[thisPointId] = static_cast<int>(timestamp - this->CurrentFrameBaseTime);
+  }
+  if (buffers.RawTime)
+  {
+    buffers.RawTime[thisPointId] = rawtime;
+  }
+  if (buffers.DistanceRaw)
+  {
+    buffers.DistanceRaw[thisPointId] = laserReturn->distance;
+  }
+  if (buffers.VerticalAngle)
+  {
+    SetRealValue(buffers.VerticalAngle, thisPointId,
+      this->laser_corrections_[laserId].verticalCorrection, isDouble);
+  }
   this->LastPointId[rawLaserId] = thisPointId;
-  this->VerticalAngle->InsertNextValue(this->laser_corrections_[laserId].verticalCorrection);
+  this->NumberOfPointsInCurrentFrame++;
 }
 
 //-----------------------------------------------------------------------------
@@ -1135,6 +1357,7 @@ void vtkVelodynePacketInterpreter::PrecomputeCorrectionCosSin()
     correction.cosVertOffsetCorrection =
       correction.verticalOffsetCorrection * correction.cosVertCorrection;
   }
+  this->KernelCorrections.Set(this->laser_corrections_);
 }
 
 //-----------------------------------------------------------------------------
@@ -1145,49 +1368,17 @@ void vtkVelodynePacketInterpreter::Init()
 }
 
 //-----------------------------------------------------------------------------
-double vtkVelodynePacketInterpreter::ComputeTimestamp(unsigned int tohTime, const FrameInformation& frameInfo)
+vtkTypeInt64 vtkVelodynePacketInterpreter::ComputeTimestamp(unsigned int tohTime, const FrameInformation& frameInfo)
 {
   VelodyneSpecificFrameInformation* velInfo = reinterpret_cast<VelodyneSpecificFrameInformation*>(frameInfo.SpecificInformation.get());
-  static const double hourInMilliseconds = 3600.0 * 1e6;
-  return tohTime + velInfo->NbrOfRollingTime * hourInMilliseconds;
+  return static_cast<vtkTypeInt64>(tohTime) + velInfo->NbrOfRollingTime * MICROSECONDS_PER_HOUR;
 }
 
 //-----------------------------------------------------------------------------
-void vtkVelodynePacketInterpreter::ComputeCorrectedValues(const unsigned short azimuth, const HDLLaserReturn *laserReturn, const HDLLaserCorrection *correction, double pos[], double &distanceM, short &intensity, bool correctIntensity)
+short vtkVelodynePacketInterpreter::ComputeCorrectedIntensity(const HDLLaserReturn *laserReturn, const HDLLaserCorrection *correction)
 {
-  intensity = laserReturn->intensity;
-
-  double cosAzimuth, sinAzimuth;
-  if (correction->rotationalCorrection == 0)
-  {
-    cosAzimuth = this->cos_lookup_table_[azimuth];
-    sinAzimuth = this->sin_lookup_table_[azimuth];
-  }
-  else
-  {
-    // realAzimuth = azimuth/100 - rotationalCorrection
-    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-    cosAzimuth = this->cos_lookup_table_[azimuth] * correction->cosRotationalCorrection +
-      this->sin_lookup_table_[azimuth] * correction->sinRotationalCorrection;
-    sinAzimuth = this->sin_lookup_table_[azimuth] * correction->cosRotationalCorrection -
-      this->cos_lookup_table_[azimuth] * correction->sinRotationalCorrection;
-  }
-  // Compute the distance in the xy plane (w/o accounting for rotation)
-  /**the new term of 'vert_offset * sin_vert_angle'
-   * was added to the expression due to the mathemathical
-   * model we used.
-   */
-  double distanceMRaw = laserReturn->distance * this->DistanceResolutionM;
-  distanceM = distanceMRaw + correction->distanceCorrection;
-  double xyDistance =
-    distanceM * correction->cosVertCorrection - correction->sinVertOffsetCorrection;
-
-  pos[0] = xyDistance * sinAzimuth - correction->horizontalOffsetCorrection * cosAzimuth;
-  pos[1] = xyDistance * cosAzimuth + correction->horizontalOffsetCorrection * sinAzimuth;
-  pos[2] = distanceM * correction->sinVertCorrection + correction->verticalOffsetCorrection;
-
-  if (correctIntensity && (correction->minIntensity < correction->maxIntensity))
+  short intensity = laserReturn->intensity;
+  if (correction->minIntensity < correction->maxIntensity)
   {
     // Compute corrected intensity
 
@@ -1227,6 +1418,7 @@ void vtkVelodynePacketInterpreter::ComputeCorrectedValues(const unsigned short a
 
     intensity = static_cast<short>(computedIntensity);
   }
+  return intensity;
 }
 
 //-----------------------------------------------------------------------------
@@ -1292,71 +1484,213 @@ vtkSmartPointer<vtkPolyData> vtkVelodynePacketInterpreter::CreateNewEmptyFrame(v
   const int defaultPrereservedNumberOfPointsPerFrame = 60000;
   // prereserve for 50% points more than actually received in previous frame
   prereservedNumberOfPoints = std::max(static_cast<int>(prereservedNumberOfPoints * 1.5), defaultPrereservedNumberOfPointsPerFrame);
+  prereservedNumberOfPoints = std::max(prereservedNumberOfPoints, numberOfPoints);
 
-  vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
-
-  // points
-  vtkNew<vtkPoints> points;
-  points->SetDataTypeToFloat();
-  points->Allocate(prereservedNumberOfPoints);
-  if (numberOfPoints > 0 )
-  {
-    points->SetNumberOfPoints(numberOfPoints);
-  }
-  points->GetData()->SetName("Points_m_XYZ");
-  polyData->SetPoints(points.GetPointer());
-//  polyData->SetVerts(NewVertexCells(numberOfPoints));
-
-  // intensity
-  this->Points = points.GetPointer();
-  this->PointsX = CreateDataArray<vtkDoubleArray>("X", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->PointsY = CreateDataArray<vtkDoubleArray>("Y", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->PointsZ = CreateDataArray<vtkDoubleArray>("Z", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->Intensity = CreateDataArray<vtkUnsignedCharArray>("intensity", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->LaserId = CreateDataArray<vtkUnsignedCharArray>("laser_id", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->Azimuth = CreateDataArray<vtkUnsignedShortArray>("azimuth", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->Distance = CreateDataArray<vtkDoubleArray>("distance_m", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->DistanceRaw =
-    CreateDataArray<vtkUnsignedShortArray>("distance_raw", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->Timestamp = CreateDataArray<vtkDoubleArray>("adjustedtime", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->RawTime = CreateDataArray<vtkUnsignedIntArray>("timestamp", numberOfPoints, prereservedNumberOfPoints, polyData);
-  this->DistanceFlag = CreateDataArray<vtkIntArray>("dual_distance", numberOfPoints, prereservedNumberOfPoints, nullptr);
-  this->IntensityFlag = CreateDataArray<vtkIntArray>("dual_intensity", numberOfPoints, prereservedNumberOfPoints, nullptr);
-  this->Flags = CreateDataArray<vtkUnsignedIntArray>("dual_flags", numberOfPoints, prereservedNumberOfPoints, nullptr);
-  this->DualReturnMatching =
-    CreateDataArray<vtkIdTypeArray>("dual_return_matching", numberOfPoints, prereservedNumberOfPoints, nullptr);
-  this->VerticalAngle = CreateDataArray<vtkDoubleArray>("vertical_angle", numberOfPoints, prereservedNumberOfPoints, polyData);
-
-  // FieldData : RPM
-  vtkSmartPointer<vtkDoubleArray> rpmData = vtkSmartPointer<vtkDoubleArray>::New();
-  rpmData->SetNumberOfTuples(1);     // One tuple
-  rpmData->SetNumberOfComponents(1); // One value per tuple, the scalar
-  rpmData->SetName("RotationPerMinute");
-  rpmData->SetTuple1(0, this->Frequency);
-  polyData->GetFieldData()->AddArray(rpmData);
-
-  if (this->HasDualReturn)
-  {
-    polyData->GetPointData()->AddArray(this->DistanceFlag.GetPointer());
-    polyData->GetPointData()->AddArray(this->IntensityFlag.GetPointer());
-    polyData->GetPointData()->AddArray(this->DualReturnMatching.GetPointer());
+  // reuse the memory of a frame released by its consumers if possible
+  vtkSmartPointer<vtkPolyData> polyData = this->Pool.Acquire();
+  if (polyData)
+  {
+    // the cells are rebuilt when the frame is split
+    polyData->DeleteCells();
   }
+  else
+  {
+    polyData = vtkSmartPointer<vtkPolyData>::New();
+
+    // points
+    vtkNew<vtkPoints> points;
+    points->SetDataTypeToFloat();
+    points->GetData()->SetName("Points_m_XYZ");
+    polyData->SetPoints(points.GetPointer());
+
+    // FieldData : RPM
+    vtkSmartPointer<vtkDoubleArray> rpmData = vtkSmartPointer<vtkDoubleArray>::New();
+    rpmData->SetNumberOfTuples(1);     // One tuple
+    rpmData->SetNumberOfComponents(1); // One value per tuple, the scalar
+    rpmData->SetName("RotationPerMinute");
+    polyData->GetFieldData()->AddArray(rpmData);
+
+    // FieldData : packet loss, see PacketLossDetector
+    vtkNew<vtkIntArray> missingPacketsData;
+    missingPacketsData->SetNumberOfTuples(1);
+    missingPacketsData->SetName("MissingPackets");
+    polyData->GetFieldData()->AddArray(missingPacketsData.GetPointer());
+
+    vtkNew<vtkDoubleArray> angularGapsData;
+    angularGapsData->SetNumberOfComponents(2); // start and end azimuths in degrees
+    angularGapsData->SetComponentName(0, "Start");
+    angularGapsData->SetComponentName(1, "End");
+    angularGapsData->SetName("AngularGaps");
+    polyData->GetFieldData()->AddArray(angularGapsData.GetPointer());
+
+    // FieldData : time of the first packet, see OutputArrays
+    vtkNew<vtkTypeInt64Array> frameBaseTimeData;
+    frameBaseTimeData->SetNumberOfTuples(1);
+    frameBaseTimeData->SetName("FrameBaseTime");
+    polyData->GetFieldData()->AddArray(frameBaseTimeData.GetPointer());
+
+    this->Pool.Add(polyData);
+  }
+  polyData->GetFieldData()->GetArray("RotationPerMinute")->SetTuple1(0, this->Frequency);
+  polyData->GetFieldData()->GetArray("MissingPackets")->SetTuple1(0, 0);
+  polyData->GetFieldData()->GetArray("AngularGaps")->SetNumberOfTuples(0);
+
+  // point data, see OutputArrays
+  auto usage = [this](int outputArray, bool isNeeded) {
+    return (this->OutputArrays & outputArray) ? OUTPUT_ARRAY : isNeeded ? INTERNAL_ARRAY : UNUSED_ARRAY;
+  };
+  const int realType = this->UseDoublePrecision ? VTK_DOUBLE : VTK_FLOAT;
+  // the dual return arrays are added to the frame once a dual return packet is received
+  const ArrayUsage dualReturnUsage = !(this->OutputArrays & OUTPUT_DUAL_RETURN) ? UNUSED_ARRAY
+    : this->HasDualReturn ? OUTPUT_ARRAY : INTERNAL_ARRAY;
+
+  this->Points = polyData->GetPoints();
+  this->PointsX = GetFrameArray(this->PointsX, "X", realType, polyData, usage(OUTPUT_XYZ, false));
+  this->PointsY = GetFrameArray(this->PointsY, "Y", realType, polyData, usage(OUTPUT_XYZ, false));
+  this->PointsZ = GetFrameArray(this->PointsZ, "Z", realType, polyData, usage(OUTPUT_XYZ, false));
+  this->Intensity = GetFrameArray(this->Intensity, "intensity", VTK_UNSIGNED_CHAR, polyData,
+    usage(OUTPUT_INTENSITY, true));
+  this->LaserId = GetFrameArray(this->LaserId, "laser_id", VTK_UNSIGNED_CHAR, polyData,
+    usage(OUTPUT_LASER_ID, false));
+  this->Azimuth = GetFrameArray(this->Azimuth, "azimuth", VTK_UNSIGNED_SHORT, polyData,
+    usage(OUTPUT_AZIMUTH, false));
+  this->Distance = GetFrameArray(this->Distance, "distance_m", realType, polyData,
+    usage(OUTPUT_DISTANCE, true));
+  this->DistanceRaw = GetFrameArray(this->DistanceRaw, "distance_raw", VTK_UNSIGNED_SHORT, polyData,
+    usage(OUTPUT_RAW_DISTANCE, false));
+  this->Timestamp = GetFrameArray(this->Timestamp, "adjustedtime", VTK_DOUBLE, polyData,
+    usage(OUTPUT_TIME, false));
+  this->RawTime = GetFrameArray(this->RawTime, "timestamp", VTK_UNSIGNED_INT, polyData,
+    usage(OUTPUT_RAW_TIME, false));
+  this->TimeOffset = GetFrameArray(this->TimeOffset, "time_offset", VTK_INT, polyData,
+    usage(OUTPUT_TIME_OFFSET, false));
+  this->VerticalAngle = GetFrameArray(this->VerticalAngle, "vertical_angle", realType, polyData,
+    usage(OUTPUT_VERTICAL_ANGLE, false));
+  this->DistanceFlag = GetFrameArray(this->DistanceFlag, "dual_distance", VTK_INT, polyData, dualReturnUsage);
+  this->IntensityFlag = GetFrameArray(this->IntensityFlag, "dual_intensity", VTK_INT, polyData, dualReturnUsage);
+  this->DualReturnMatching = GetFrameArray(this->DualReturnMatching, "dual_return_matching", VTK_ID_TYPE,
+    polyData, dualReturnUsage);
+  this->Flags = GetFrameArray(this->Flags, "dual_flags", VTK_UNSIGNED_INT, polyData, INTERNAL_ARRAY);
+
+  this->NumberOfPointsInCurrentFrame = numberOfPoints;
+  this->CurrentFrameCapacity = prereservedNumberOfPoints;
+  this->SetCurrentFrameArraysSize(this->CurrentFrameCapacity);
 
   return polyData;
 }
 
+//-----------------------------------------------------------------------------
+void vtkVelodynePacketInterpreter::SetCurrentFrameArraysSize(vtkIdType numberOfPoints)
+{
+  vtkDataArray* arrays[] = { this->Points->GetData(), this->PointsX, this->PointsY,
+    this->PointsZ, this->Intensity, this->LaserId, this->Azimuth, this->Distance,
+    this->DistanceRaw, this->Timestamp, this->VerticalAngle, this->RawTime, this->TimeOffset,
+    this->IntensityFlag, this->DistanceFlag, this->Flags, this->DualReturnMatching };
+  for (vtkDataArray* array : arrays)
+  {
+    if (!array)
+    {
+      continue;
+    }
+    // SetNumberOfTuples does not keep the values when it allocates memory
+    if (numberOfPoints * array->GetNumberOfComponents() > array->GetSize())
+    {
+      array->Resize(numberOfPoints);
+    }
+    // SetNumberOfTuples(0) would free the memory
+    if (numberOfPoints > 0)
+    {
+      array->SetNumberOfTuples(numberOfPoints);
+    }
+    else
+    {
+      array->Reset();
+    }
+    array->Modified();
+  }
+  this->Points->Modified();
+
+  FrameBuffers& buffers = this->CurrentFrameBuffers;
+  buffers.Points = static_cast<float*>(this->Points->GetVoidPointer(0));
+  buffers.PointsX = GetBuffer<void>(this->PointsX);
+  buffers.PointsY = GetBuffer<void>(this->PointsY);
+  buffers.PointsZ = GetBuffer<void>(this->PointsZ);
+  buffers.Intensity = GetBuffer<unsigned char>(this->Intensity);
+  buffers.LaserId = GetBuffer<unsigned char>(this->LaserId);
+  buffers.Azimuth = GetBuffer<unsigned short>(this->Azimuth);
+  buffers.Distance = GetBuffer<void>(this->Distance);
+  buffers.DistanceRaw = GetBuffer<unsigned short>(this->DistanceRaw);
+  buffers.Timestamp = GetBuffer<double>(this->Timestamp);
+  buffers.VerticalAngle = GetBuffer<void>(this->VerticalAngle);
+  buffers.RawTime = GetBuffer<unsigned int>(this->RawTime);
+  buffers.TimeOffset = GetBuffer<int>(this->TimeOffset);
+  buffers.IntensityFlag = GetBuffer<int>(this->IntensityFlag);
+  buffers.DistanceFlag = GetBuffer<int>(this->DistanceFlag);
+  buffers.Flags = GetBuffer<unsigned int>(this->Flags);
+  buffers.DualReturnMatching = GetBuffer<vtkIdType>(this->DualReturnMatching);
+  buffers.IsDoublePrecision = this->Distance->GetDataType() == VTK_DOUBLE;
+}
+
+//-----------------------------------------------------------------------------
+int vtkVelodynePacketInterpreter::GetSectorIndex(unsigned short azimuth) const
+{
+  if (this->SectorSize <= 0)
+  {
+    return 0;
+  }
+  return static_cast<int>(std::floor((azimuth % 36000) / (100. * this->SectorSize)));
+}
+
 //-----------------------------------------------------------------------------
 bool vtkVelodynePacketInterpreter::SplitFrame(bool force)
 {
+  // tag the sectors with their place in the rotation, the arrays are kept by the frames
+  // of the pool and removed when the frames are not split in sectors anymore
+  vtkFieldData* fieldData = this->CurrentFrame->GetFieldData();
+  if (this->SectorSize > 0)
+  {
+    const char* names[] = { "SectorIndex", "FrameId" };
+    const int values[] = { this->CurrentSectorIndex, this->CurrentFrameId };
+    for (int i = 0; i < 2; ++i)
+    {
+      vtkDataArray* array = fieldData->GetArray(names[i]);
+      if (!array)
+      {
+        vtkNew<vtkIntArray> newArray;
+        newArray->SetNumberOfTuples(1);
+        newArray->SetName(names[i]);
+        fieldData->AddArray(newArray.GetPointer());
+        array = newArray.GetPointer();
+      }
+      array->SetTuple1(0, values[i]);
+    }
+  }
+  else if (fieldData->GetArray("SectorIndex"))
+  {
+    fieldData->RemoveArray("SectorIndex");
+    fieldData->RemoveArray("FrameId");
+  }
+  // in nanoseconds, as FrameInformation::FirstPacketDataTimeNs
+  const bool hasBaseTime = this->CurrentFrameBaseTime != std::numeric_limits<vtkTypeInt64>::min();
+  vtkTypeInt64Array::SafeDownCast(fieldData->GetArray("FrameBaseTime"))
+    ->SetValue(0, hasBaseTime ? this->CurrentFrameBaseTime * 1000 : 0);
+
+  // give the arrays their real size before the frame is handed over
+  this->SetCurrentFrameArraysSize(this->NumberOfPointsInCurrentFrame);
   if (this->vtkLidarPacketInterpreter::SplitFrame(force))
   {
     for (size_t n = 0; n < HDL_MAX_NUM_LASERS; ++n)
     {
       this->LastPointId[n] = -1;
     }
-    // compute th rpm and add it to the splited frame
-    this->Frequency = this->RpmCalculator_->GetRPM();
-    this->RpmCalculator_->Reset();
+    this->CurrentFrameBaseTime = std::numeric_limits<vtkTypeInt64>::min();
+    // compute th rpm and add it to the splited frame, the sectors get the one of the last
+    // rotation: a sector may be narrower than the azimuths of a single packet
+    if (!this->IsSplittingSector)
+    {
+      this->Frequency = this->RpmCalculator_->GetRPM();
+      this->RpmCalculator_->Reset();
+    }
     this->Frames.back()->GetFieldData()
       ->GetArray("RotationPerMinute")
       ->SetTuple1(0, this->Frequency);
@@ -1364,6 +1698,8 @@ bool vtkVelodynePacketInterpreter::SplitFrame(bool force)
     return true;
   }
 
+  // the frame is kept, the next points will still be added to it
+  this->SetCurrentFrameArraysSize(this->CurrentFrameCapacity);
   return false;
 }
 
@@ -1372,6 +1708,10 @@ void vtkVelodynePacketInterpreter::ResetCurrentFrame()
 {
   std::fill(this->LastPointId, this->LastPointId + HDL_MAX_NUM_LASERS, -1);
   this->CurrentFrameState->reset();
+  this->CurrentLossDetector->reset();
+  this->CurrentFrameId = 0;
+  this->CurrentSectorIndex = -1;
+  this->CurrentFrameBaseTime = std::numeric_limits<vtkTypeInt64>::min();
   this->LastTimestamp = std::numeric_limits<unsigned int>::max();
   this->TimeAdjust = std::numeric_limits<double>::quiet_NaN();
 
@@ -1385,20 +1725,55 @@ void vtkVelodynePacketInterpreter::ResetCurrentFrame()
   this->ShouldCheckSensor = true;
 }
 
+//-----------------------------------------------------------------------------
+void vtkVelodynePacketInterpreter::ResetParserMetaData()
+{
+  this->Superclass::ResetParserMetaData();
+  this->PreProcessingFrameState->reset();
+  this->PreProcessingLossDetector->reset();
+  this->PreProcessingIsEmptyFrame = true;
+  this->PreProcessingNumberOfFiringPackets = 0;
+  this->PreProcessingLastNumberOfFiringPackets = 0;
+  this->PreProcessingFrameNumber = 0;
+  this->lastGpsTimestamp = 0;
+}
+
+//-----------------------------------------------------------------------------
+void vtkVelodynePacketInterpreter::RebaseFrameInformation(FrameInformation& frame,
+                                                          const FrameInformation& localReference,
+                                                          const FrameInformation& reference)
+{
+  // The number of rollings counted by a parser which started in the middle of
+  // the file is shifted by the number of rollings that occured before its start
+  auto velFrameInfo =
+    reinterpret_cast<VelodyneSpecificFrameInformation*>(frame.SpecificInformation.get());
+  auto localVelReference =
+    reinterpret_cast<VelodyneSpecificFrameInformation*>(localReference.SpecificInformation.get());
+  auto velReference =
+    reinterpret_cast<VelodyneSpecificFrameInformation*>(reference.SpecificInformation.get());
+  const int missedRollings = velReference->NbrOfRollingTime - localVelReference->NbrOfRollingTime;
+  velFrameInfo->NbrOfRollingTime += missedRollings;
+  frame.FirstPacketDataTimeNs += missedRollings * MICROSECONDS_PER_HOUR * 1000;
+  velFrameInfo->NbrOfMissingPackets +=
+    velReference->NbrOfMissingPackets - localVelReference->NbrOfMissingPackets;
+}
+
+//-----------------------------------------------------------------------------
+int vtkVelodynePacketInterpreter::GetNumberOfMissingPackets(const FrameInformation& frame)
+{
+  auto velFrameInfo =
+    reinterpret_cast<VelodyneSpecificFrameInformation*>(frame.SpecificInformation.get());
+  return velFrameInfo ? velFrameInfo->NbrOfMissingPackets : 0;
+}
+
 //-----------------------------------------------------------------------------
 bool vtkVelodynePacketInterpreter::PreProcessPacket(unsigned char const * data, unsigned int dataLength,
-                                                    fpos_t filePosition, double packetNetworkTime,
+                                                    int64_t filePosition, double packetNetworkTime,
                                                     std::vector<FrameInformation>* frameCatalog)
 {
   const HDLDataPacket* dataPacket = reinterpret_cast<const HDLDataPacket*>(data);
-  //! @todo don't use static value here this is ugly...
-  static bool isEmptyFrame = true;
-  static FramingState currentFrameState;
-  static int numberOfFiringPackets = 0;
-  static int lastnumberOfFiringPackets = 0;
-  static int frameNumber;
-
-  numberOfFiringPackets++;
+
+  this->PreProcessingNumberOfFiringPackets++;
   bool isNewFrame = false;
 
   //! @todo this could be useful at a higher level
@@ -1408,27 +1783,28 @@ bool vtkVelodynePacketInterpreter::PreProcessPacket(unsigned char const * data,
     this->ShouldCheckSensor = false;
   }
 
-  //    unsigned int timeDiff = dataPacket->gpsTimestamp - lastTimestamp;
-  //    if (timeDiff > 600 && lastTimestamp != 0)
-  //      {
-  //      printf("missed %d packets\n",  static_cast<int>(floor((timeDiff/553.0) + 0.5)));
-  //      }
-
   // Check if the time has rolled between this packet and
   // the previous one. There is only one timestamp per packet
   // this is why the check is not performed per firing or per laser
   VelodyneSpecificFrameInformation* velFrameInfo =
       reinterpret_cast<VelodyneSpecificFrameInformation*>(this->ParserMetaData.SpecificInformation.get());
-  if (dataPacket->gpsTimestamp < this->lastGpsTimestamp)
+  if (HasRolledOver(this->lastGpsTimestamp, dataPacket->gpsTimestamp))
   {
     velFrameInfo->NbrOfRollingTime++;
   }
   this->lastGpsTimestamp = dataPacket->gpsTimestamp;
 
+  // Count the packets lost since the beginning of the file
+  int angularGap[2];
+  velFrameInfo->NbrOfMissingPackets +=
+    this->PreProcessingLossDetector->addPacket(*dataPacket, angularGap);
+
   this->ParserMetaData.FilePosition = filePosition;
 
   // update the timestamps information
   this->ParserMetaData.FirstPacketDataTime = 1e-6 * dataPacket->gpsTimestamp;
+  this->ParserMetaData.FirstPacketDataTimeNs =
+    this->ComputeTimestamp(dataPacket->gpsTimestamp, this->ParserMetaData) * 1000;
   this->ParserMetaData.FirstPacketNetworkTime = packetNetworkTime;
 
   this->IsHDL64Data |= dataPacket->isHDL64();
@@ -1452,20 +1828,20 @@ bool vtkVelodynePacketInterpreter::PreProcessPacket(unsigned char const * data,
       {
         if (firingData.laserReturns[laserID].distance != 0)
         {
-          isEmptyFrame = false;
+          this->PreProcessingIsEmptyFrame = false;
           break;
         }
       }
     }
     else
     {
-      isEmptyFrame = false;
+      this->PreProcessingIsEmptyFrame = false;
     }
 
-    if (currentFrameState.hasChangedWithValue(firingData))
+    if (this->PreProcessingFrameState->hasChangedWithValue(firingData))
     {
       // Add file position if the frame is not empty
-      if (!isEmptyFrame || !this->IgnoreEmptyFrames)
+      if (!this->PreProcessingIsEmptyFrame || !this->IgnoreEmptyFrames)
       {
         // update the firing to skip information
         // and add the current frame information
@@ -1477,15 +1853,16 @@ bool vtkVelodynePacketInterpreter::PreProcessPacket(unsigned char const * data,
         }
         isNewFrame = true;
 
-        frameNumber++;
+        this->PreProcessingFrameNumber++;
         PacketProcessingDebugMacro(
-          << "\n\nEnd of frame #" << frameNumber
-          << ". #packets: " << numberOfFiringPackets - lastnumberOfFiringPackets << "\n\n"
+          << "\n\nEnd of frame #" << this->PreProcessingFrameNumber << ". #packets: "
+          << this->PreProcessingNumberOfFiringPackets - this->PreProcessingLastNumberOfFiringPackets
+          << "\n\n"
           << "RotationalPositions: ");
-        lastnumberOfFiringPackets = numberOfFiringPackets;
+        this->PreProcessingLastNumberOfFiringPackets = this->PreProcessingNumberOfFiringPackets;
       }
       // We start a new frame, reinitialize the boolean
-      isEmptyFrame = true;
+      this->PreProcessingIsEmptyFrame = true;
     }
     PacketProcessingDebugMacro(<< firingData.rotationalPosition << ", ");
   }
@@ -3,6 +3,7 @@
 
 #include "vtkLidarPacketInterpreter.h"
 #include "vtkDataPacket.h"
+#include "VelodyneFiringKernel.h"
 #include <vtkUnsignedCharArray.h>
 #include <vtkUnsignedIntArray.h>
 #include <vtkUnsignedShortArray.h>
@@ -12,6 +13,7 @@ using namespace DataPacketFixedLength;
 
 class RPMCalculator;
 class FramingState;
+class PacketLossDetector;
 class vtkRollingDataAccumulator;
 
 
@@ -45,9 +47,16 @@ public:
   void ResetCurrentFrame() override;
 
   bool PreProcessPacket(unsigned char const * data, unsigned int dataLength,
-                        fpos_t filePosition = fpos_t(), double packetNetworkTime = 0,
+                        int64_t filePosition = 0, double packetNetworkTime = 0,
                         std::vector<FrameInformation>* frameCatalog = nullptr) override;
 
+  void ResetParserMetaData() override;
+
+  void RebaseFrameInformation(FrameInformation& frame, const FrameInformation& localReference,
+                              const FrameInformation& reference) override;
+
+  int GetNumberOfMissingPackets(const FrameInformation& frame) override;
+
   std::string GetSensorInformation() override;
 
   void GetXMLColorTable(double XMLColorTable[]);
@@ -70,24 +79,32 @@ public:
   vtkGetMacro(UseIntraFiringAdjustment, bool)
   vtkSetMacro(UseIntraFiringAdjustment, bool)
 
+  vtkGetMacro(UseVectorizedDecoding, bool)
+  vtkSetMacro(UseVectorizedDecoding, bool)
+
   vtkSetMacro(DualReturnFilter, unsigned int)
 
 protected:
+  void CopySettings(vtkLidarPacketInterpreter* source) override;
+
   // Process the laser return from the firing data
   // firingData - one of HDL_FIRING_PER_PKT from the packet
   // hdl64offset - either 0 or 32 to support 64-laser systems
   // firingBlock - block of packet for firing [0-11]
   // azimuthDiff - average azimuth change between firings
-  // timestamp - the timestamp of the packet
+  // timestamp - the timestamp of the packet, see ComputeTimestamp
   // geotransform - georeferencing transform
   void ProcessFiring(const HDLFiringData* firingData,
-    int firingBlockLaserOffset, int firingBlock, int azimuthDiff, double timestamp,
+    int firingBlockLaserOffset, int firingBlock, int azimuthDiff, vtkTypeInt64 timestamp,
     unsigned int rawtime, bool isThisFiringDualReturnData, bool isDualReturnPacket);
 
+  // Add a laser return to the current frame
+  // position, distanceM - corrected position and distance, see VelodyneFiringKernel
   void PushFiringData(unsigned char laserId, unsigned char rawLaserId,
-                      unsigned short azimuth, double timestamp,
+                      unsigned short azimuth, vtkTypeInt64 timestamp,
                       unsigned int rawtime, const HDLLaserReturn* laserReturn,
-                      const HDLLaserCorrection* correction, bool isFiringDualReturnData);
+                      const HDLLaserCorrection* correction, const double position[3],
+                      double distanceM, bool isFiringDualReturnData);
 
   void InitTrigonometricTables();
 
@@ -95,32 +112,76 @@ protected:
 
   void Init();
 
-  double ComputeTimestamp(unsigned int tohTime, const FrameInformation& frameInfo);
+  // Time in microseconds of a timestamp of the sensor (microseconds since the top of the
+  // hour), on a timeline which keeps increasing when the timestamps roll over
+  vtkTypeInt64 ComputeTimestamp(unsigned int tohTime, const FrameInformation& frameInfo);
 
-  void ComputeCorrectedValues(const unsigned short azimuth,
-                              const HDLLaserReturn* laserReturn, const HDLLaserCorrection* correction, double pos[3],
-                              double& distanceM, short& intensity, bool correctIntensity);
+  short ComputeCorrectedIntensity(const HDLLaserReturn* laserReturn,
+                                  const HDLLaserCorrection* correction);
 
   bool HDL64LoadCorrectionsFromStreamData();
 
   bool CheckReportedSensorAndCalibrationFileConsistent(const HDLDataPacket* dataPacket);
 
+  // Arrays of the frame under construction, nullptr for the arrays which are not part of
+  // OutputArrays. Intensity, Distance and Flags are always computed as they are needed to
+  // match the dual returns, they are not added to the frame if they are not part of it.
+  // PointsX, PointsY, PointsZ, Distance and VerticalAngle are float arrays if
+  // UseDoublePrecision is false.
   vtkSmartPointer<vtkPoints> Points;
-  vtkSmartPointer<vtkDoubleArray> PointsX;
-  vtkSmartPointer<vtkDoubleArray> PointsY;
-  vtkSmartPointer<vtkDoubleArray> PointsZ;
-  vtkSmartPointer<vtkUnsignedCharArray> Intensity;
-  vtkSmartPointer<vtkUnsignedCharArray> LaserId;
-  vtkSmartPointer<vtkUnsignedShortArray> Azimuth;
-  vtkSmartPointer<vtkDoubleArray> Distance;
-  vtkSmartPointer<vtkUnsignedShortArray> DistanceRaw;
-  vtkSmartPointer<vtkDoubleArray> Timestamp;
-  vtkSmartPointer<vtkDoubleArray> VerticalAngle;
-  vtkSmartPointer<vtkUnsignedIntArray> RawTime;
-  vtkSmartPointer<vtkIntArray> IntensityFlag;
-  vtkSmartPointer<vtkIntArray> DistanceFlag;
-  vtkSmartPointer<vtkUnsignedIntArray> Flags;
-  vtkSmartPointer<vtkIdTypeArray> DualReturnMatching;
+  vtkSmartPointer<vtkDataArray> PointsX;
+  vtkSmartPointer<vtkDataArray> PointsY;
+  vtkSmartPointer<vtkDataArray> PointsZ;
+  vtkSmartPointer<vtkDataArray> Intensity;
+  vtkSmartPointer<vtkDataArray> LaserId;
+  vtkSmartPointer<vtkDataArray> Azimuth;
+  vtkSmartPointer<vtkDataArray> Distance;
+  vtkSmartPointer<vtkDataArray> DistanceRaw;
+  vtkSmartPointer<vtkDataArray> Timestamp;
+  vtkSmartPointer<vtkDataArray> VerticalAngle;
+  vtkSmartPointer<vtkDataArray> RawTime;
+  vtkSmartPointer<vtkDataArray> TimeOffset;
+  vtkSmartPointer<vtkDataArray> IntensityFlag;
+  vtkSmartPointer<vtkDataArray> DistanceFlag;
+  vtkSmartPointer<vtkDataArray> Flags;
+  vtkSmartPointer<vtkDataArray> DualReturnMatching;
+
+  // Values of the arrays above. While the frame is under construction, the arrays have room
+  // for CurrentFrameCapacity points and are written directly; they are given their real size
+  // when the frame is split. The real valued arrays are float or double arrays depending on
+  // IsDoublePrecision.
+  struct FrameBuffers
+  {
+    float* Points;
+    void* PointsX;
+    void* PointsY;
+    void* PointsZ;
+    unsigned char* Intensity;
+    unsigned char* LaserId;
+    unsigned short* Azimuth;
+    void* Distance;
+    unsigned short* DistanceRaw;
+    double* Timestamp;
+    void* VerticalAngle;
+    unsigned int* RawTime;
+    int* TimeOffset;
+    int* IntensityFlag;
+    int* DistanceFlag;
+    unsigned int* Flags;
+    vtkIdType* DualReturnMatching;
+    bool IsDoublePrecision;
+  };
+  FrameBuffers CurrentFrameBuffers;
+  vtkIdType NumberOfPointsInCurrentFrame = 0;
+  vtkIdType CurrentFrameCapacity = 0;
+  // Time in microseconds of the first packet of the current frame, see ComputeTimestamp,
+  // from which the time offsets of its points are computed. The minimum value until the
+  // first firing of the frame is processed.
+  vtkTypeInt64 CurrentFrameBaseTime;
+
+  // Set the number of points of all the arrays of the current frame, keeping their values,
+  // and update CurrentFrameBuffers. No memory is allocated if the arrays are big enough.
+  void SetCurrentFrameArraysSize(vtkIdType numberOfPoints);
 
   // sensor information
   bool HasDualReturn;
@@ -151,6 +212,19 @@ protected:
   RPMCalculator* RpmCalculator_;
 
   FramingState* CurrentFrameState;
+  // Rotations started since ResetCurrentFrame, and sector of the current frame when the
+  // frames are split in sectors (-1 before the first firing), see SectorSize
+  int CurrentFrameId = 0;
+  int CurrentSectorIndex = -1;
+  // True while a sector which does not end the rotation is split, the rpm is then not
+  // measured: it is measured over whole rotations and copied in their sectors
+  bool IsSplittingSector = false;
+
+  // Sector of SectorSize degrees containing an azimuth in hundredths of degree
+  int GetSectorIndex(unsigned short azimuth) const;
+  // Packets lost before the current packet, added to the field data of the frames as
+  // "MissingPackets" (count) and "AngularGaps" (start and end azimuths in degrees)
+  PacketLossDetector* CurrentLossDetector;
   unsigned int LastTimestamp;
   std::vector<double> RpmByFrames;
   double TimeAdjust;
@@ -163,6 +237,8 @@ protected:
   std::vector<double> cos_lookup_table_;
   std::vector<double> sin_lookup_table_;
   HDLLaserCorrection laser_corrections_[HDL_MAX_NUM_LASERS];
+  // Same corrections as laser_corrections_, in the layout used by VelodyneFiringKernel
+  FiringCorrections KernelCorrections;
   double XMLColorTable[HDL_MAX_NUM_LASERS][3];
   bool IsCorrectionFromLiveStream = true;
 
@@ -174,9 +250,22 @@ protected:
 
   bool UseIntraFiringAdjustment;
 
+  // Compute the positions of a firing block with the vectorized kernel, if the CPU
+  // supports it. The positions are the same as with the scalar kernel.
+  bool UseVectorizedDecoding = true;
+
   bool ShouldCheckSensor;
   uint32_t lastGpsTimestamp = 0;
 
+  // State of the frame splitting done by PreProcessPacket, independent from the
+  // one used by ProcessPacket so that the catalog can be built while decoding
+  FramingState* PreProcessingFrameState;
+  PacketLossDetector* PreProcessingLossDetector;
+  bool PreProcessingIsEmptyFrame = true;
+  int PreProcessingNumberOfFiringPackets = 0;
+  int PreProcessingLastNumberOfFiringPackets = 0;
+  int PreProcessingFrameNumber = 0;
+
   unsigned int DualReturnFilter;
 
   vtkVelodynePacketInterpreter();
@@ -203,8 +292,28 @@ struct VelodyneSpecificFrameInformation : public SpecificFrameInformation
   //! timestamp NbrOfRollingTime * MaxTimeBeforeRolling
   int NbrOfRollingTime = 0;
 
+  //! Number of packets missing since the beginning of the
+  //! .pcap file, up to the first packet of the frame. The
+  //! packets missing in a frame are the difference with the
+  //! next frame of the catalog
+  int NbrOfMissingPackets = 0;
+
   void reset() { *this = VelodyneSpecificFrameInformation(); }
   std::unique_ptr<SpecificFrameInformation> clone() { return std::make_unique<VelodyneSpecificFrameInformation>(*this); }
+
+  void write(std::ostream& os) const
+  {
+    os.write(reinterpret_cast<const char*>(&this->FiringToSkip), sizeof(this->FiringToSkip));
+    os.write(reinterpret_cast<const char*>(&this->NbrOfRollingTime), sizeof(this->NbrOfRollingTime));
+    os.write(reinterpret_cast<const char*>(&this->NbrOfMissingPackets), sizeof(this->NbrOfMissingPackets));
+  }
+  bool read(std::istream& is)
+  {
+    is.read(reinterpret_cast<char*>(&this->FiringToSkip), sizeof(this->FiringToSkip));
+    is.read(reinterpret_cast<char*>(&this->NbrOfRollingTime), sizeof(this->NbrOfRollingTime));
+    is.read(reinterpret_cast<char*>(&this->NbrOfMissingPackets), sizeof(this->NbrOfMissingPackets));
+    return static_cast<bool>(is);
+  }
 };
 
 #endif // VELODYNEPACKETINTERPRETOR_H
@@ -27,24 +27,50 @@
 =========================================================================*/
 // .NAME PacketFileSender -
 // .SECTION Description
-// This program reads a pcap file and sends the packets using UDP.
-// The default playback speed is based on the timestamps specified in the pcap file
+// This program reads pcap files and sends their packets using UDP.
+// The default playback speed is based on the timestamps specified in the pcap files,
+// the packets of several files are merged by timestamp and sent to the ports of their file.
 
-#include "vtkPacketFileReader.h"
-#include "vvPacketSender.h"
+#include "PacketReplayer.h"
 
 #include <cstdlib>
-#include <ctime>
+#include <iomanip>
 #include <iostream>
 #include <string>
-#include <chrono>
+#include <vector>
 
-#include <boost/thread/thread.hpp>
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
 
 const int OUTPUT_WIDTH = 15; // width of the column (#packet, duration, ...) in the output stream
 
+//-----------------------------------------------------------------------------
+// the port of the i-th file, the files without a port of their own use the ports after
+// the last one given
+unsigned int GetFilePort(const std::vector<unsigned int>& ports, size_t fileIndex)
+{
+  if (fileIndex < ports.size())
+  {
+    return ports[fileIndex];
+  }
+  return ports.back() + static_cast<unsigned int>(fileIndex - ports.size() + 1);
+}
+
+//-----------------------------------------------------------------------------
+void PrintStatistics(const PacketReplayer::Statistics& statistics)
+{
+  const double microSecondsPerSecond = 1e6;
+  std::cout << std::fixed
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.SentPackets
+            << std::right << std::setw(OUTPUT_WIDTH) << std::setprecision(3) << statistics.Duration
+            << std::right << std::setw(OUTPUT_WIDTH) << std::setprecision(1) << statistics.PacketRate
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.MeanLateness * microSecondsPerSecond
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.Jitter * microSecondsPerSecond
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.MaximumLateness * microSecondsPerSecond
+            << std::endl;
+}
+
+//-----------------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
   bool loop = false;  // run the capture 1 time or in loop
@@ -55,15 +81,19 @@ int main(int argc, char* argv[])
       ("help", "produce help message")
       ("ip", po::value<std::string>()->default_value("127.0.0.1"), "destination ip adress")
       ("loop", po::bool_switch(&loop), "run the capture in loop")
-      ("lidarPort", po::value<unsigned int>()->default_value(2368), "destination port for lidar packets")
-      ("GPSPort", po::value<unsigned int>()->default_value(8308), "destination port for GPS packets")
-      ("speed", po::value<double>()->default_value(1), "playback speed")
+      ("lidarPort", po::value<std::vector<unsigned int> >()->multitoken()->default_value(std::vector<unsigned int>(1, 2368), "2368"),
+       "destination port for lidar packets, one per file")
+      ("GPSPort", po::value<std::vector<unsigned int> >()->multitoken()->default_value(std::vector<unsigned int>(1, 8308), "8308"),
+       "destination port for GPS packets, one per file")
+      ("speed", po::value<double>()->default_value(1), "playback speed, 0 to send as fast as possible")
+      ("batch-size", po::value<int>()->default_value(32), "maximum number of packets sent by one system call")
+      ("spin", po::value<double>()->default_value(200), "time in us spent spinning before each packet instead of sleeping")
       ("display-frequency", po::value<unsigned int>()->default_value(1000), "print information after every interval of X sent packets")
       ;
 
   po::options_description hidden("Hidden options");
   hidden.add_options()
-      ("input-file", po::value<std::string>(), "input file")
+      ("input-file", po::value<std::vector<std::string> >(), "input files")
       ;
 
   po::positional_options_description p;
@@ -77,84 +107,62 @@ int main(int argc, char* argv[])
             options(cmdline_options).positional(p).run(), vm);
   po::notify(vm);
 
-  if (vm.count("help") || argc < 2) {
-      cout << "Usage: PacketFileSender <pcap_file> [options]\n";
-      cout << visible << "\n";
+  if (vm.count("help") || !vm.count("input-file")) {
+      std::cout << "Usage: PacketFileSender <pcap_file> [<pcap_file>...] [options]\n";
+      std::cout << visible << "\n";
       return 1;
   }
 
   // convert to the right type
-  std::string filename = vm["input-file"].as<std::string>();
-  double speed = vm["speed"].as<double>();
+  std::vector<std::string> filenames = vm["input-file"].as<std::vector<std::string> >();
   std::string destinationIp = vm["ip"].as<std::string>();
-  unsigned int lidarPort =  vm["lidarPort"].as<unsigned int>();
-  unsigned int GPSPort = vm["GPSPort"].as<unsigned int>();
+  std::vector<unsigned int> lidarPorts = vm["lidarPort"].as<std::vector<unsigned int> >();
+  std::vector<unsigned int> GPSPorts = vm["GPSPort"].as<std::vector<unsigned int> >();
   unsigned int display_frequency = vm["display-frequency"].as<unsigned int>();
 
-  const int microSecondsPerSecond = 1e6;
-
-  std::cout << "Start sending" << std::endl;
-
   try
   {
-    do
+    PacketReplayer replayer(destinationIp);
+    replayer.SetSpeed(vm["speed"].as<double>());
+    replayer.SetBatchSize(vm["batch-size"].as<int>());
+    replayer.SetSpinDuration(vm["spin"].as<double>() * 1e-6);
+
+    // all the packets are loaded before sending, so that the reading never delays them
+    for (size_t i = 0; i < filenames.size(); ++i)
     {
-      auto replayStartTime = std::chrono::steady_clock::now();
+      const unsigned int lidarPort = GetFilePort(lidarPorts, i);
+      const unsigned int GPSPort = GetFilePort(GPSPorts, i);
+      if (!replayer.AddFile(filenames[i], lidarPort, GPSPort))
+      {
+        std::cout << replayer.GetLastError() << std::endl;
+        return 1;
+      }
+      std::cout << filenames[i] << " -> " << destinationIp << ":" << lidarPort << " (GPS " << GPSPort << ")" << std::endl;
+    }
+    std::cout << "Loaded " << replayer.GetNumberOfPackets() << " packets, "
+              << replayer.GetCaptureDuration() << " s of capture" << std::endl;
 
+    std::cout << "Start sending" << std::endl;
+    do
+    {
       // output the column header for the displayed values
-      std::cout << "----------------------------------------------------------------------------" << std::endl
+      std::cout << "------------------------------------------------------------------------------------------" << std::endl
                 << std::right << std::setw(OUTPUT_WIDTH) << "# packets"
                 << std::right << std::setw(OUTPUT_WIDTH) << "duration (s)"
                 << std::right << std::setw(OUTPUT_WIDTH) << "f (Hz)"
                 << std::right << std::setw(OUTPUT_WIDTH) << "delay (us)"
+                << std::right << std::setw(OUTPUT_WIDTH) << "jitter (us)"
+                << std::right << std::setw(OUTPUT_WIDTH) << "max delay (us)"
                 << std::endl
-                << "----------------------------------------------------------------------------" << std::endl;
-
-      // Create a Packet Sender
-      vvPacketSender sender(filename, destinationIp, lidarPort, GPSPort);
+                << "------------------------------------------------------------------------------------------" << std::endl;
 
-      // Case starting time
-      double pcapStartTime = sender.pumpPacket();
+      PacketReplayer::Statistics statistics = replayer.Replay(PrintStatistics, display_frequency);
 
-      while (!sender.IsDone())
+      std::cout << "------------------------------------------------------------------------------------------" << std::endl;
+      PrintStatistics(statistics);
+      if (statistics.SendErrors != 0)
       {
-        // time from the pcap file
-        double pcapCurrentTime = sender.pumpPacket();
-        double pcapmicroSecondsSinceStart = (pcapCurrentTime - pcapStartTime) * microSecondsPerSecond;
-
-        // time from the wall clock
-        auto replayCurrentTime = std::chrono::steady_clock::now();
-        int replaymicroSecondsSinceStart =
-            std::chrono::duration_cast<std::chrono::microseconds>(replayCurrentTime - replayStartTime).count();
-
-        // check if the replay is to much in advance compared to the pcap time step
-        // if this is the case, we sleep the thread until the pcap catch up the replay
-        double time_delay = static_cast<double>(pcapmicroSecondsSinceStart) / speed  - replaymicroSecondsSinceStart;
-
-        if (time_delay > 0)
-        {
-        boost::this_thread::sleep(
-          boost::posix_time::microseconds(static_cast<int>(time_delay)));
-        }
-
-        // Display the user some information
-        if ((sender.GetPacketCount() % display_frequency) == 0)
-        {
-          // Compute nb of packets sended including the one from previous loops
-          int nbPacketSended = sender.GetPacketCount();
-
-          // Compute time since the replay began
-          double secondSinceStart = static_cast<double>(replaymicroSecondsSinceStart) / microSecondsPerSecond;
-
-          // Nice output
-          std::cout << std::fixed
-                    << std::right << std::setw(OUTPUT_WIDTH) << nbPacketSended
-                    << std::fixed << std::right << std::setw(OUTPUT_WIDTH) << secondSinceStart
-                    << std::right << std::setw(OUTPUT_WIDTH)
-                    << static_cast<double>(nbPacketSended) /  secondSinceStart
-                    << std::right << std::setw(OUTPUT_WIDTH) << time_delay
-                    << std::endl;
-        }
+        std::cout << statistics.SendErrors << " packets could not be sent" << std::endl;
       }
     } while (loop);
   }
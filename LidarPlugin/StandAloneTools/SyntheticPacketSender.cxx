@@ -0,0 +1,246 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// .NAME SyntheticPacketSender -
+// .SECTION Description
+// This program synthesizes the data packets of a Velodyne sensor, see
+// VelodynePacketGenerator, to load test LidarView without sensor nor recorded pcap.
+// The packets are either sent using UDP at the rate of the sensor or at a given rate,
+// or passed in process through a PacketRing to a consumer thread, as a PacketReceiver
+// would, to measure the maximum sustainable packet rate.
+
+#include "PacketReplayer.h"
+#include "PacketRing.h"
+#include "VelodynePacketGenerator.h"
+#include "vtkDataPacket.h"
+#include "vtkVelodynePacketInterpreter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+const int OUTPUT_WIDTH = 15; // width of the column (#packet, duration, ...) in the output stream
+
+//-----------------------------------------------------------------------------
+void PrintStatistics(const PacketReplayer::Statistics& statistics)
+{
+  const double microSecondsPerSecond = 1e6;
+  std::cout << std::fixed
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.SentPackets
+            << std::right << std::setw(OUTPUT_WIDTH) << std::setprecision(3) << statistics.Duration
+            << std::right << std::setw(OUTPUT_WIDTH) << std::setprecision(1) << statistics.PacketRate
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.MeanLateness * microSecondsPerSecond
+            << std::right << std::setw(OUTPUT_WIDTH) << statistics.Jitter * microSecondsPerSecond
+            << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Send the packets of the generator using UDP, return the exit code
+int SendPackets(VelodynePacketGenerator& generator, const std::string& destinationIp,
+                unsigned int port, double speed, double duration, bool loop, int batchSize)
+{
+  PacketReplayer replayer(destinationIp);
+  replayer.SetSpeed(speed);
+  replayer.SetBatchSize(batchSize);
+
+  // the packets are generated before sending, so that the generation never delays them
+  std::vector<unsigned char> packet(DataPacketFixedLength::HDLDataPacket::getDataByteLength());
+  while (generator.GetTime() < duration)
+  {
+    const double time = generator.GetTime();
+    generator.Generate(packet.data());
+    if (!replayer.AddPacket(packet.data(), static_cast<unsigned int>(packet.size()), time, port))
+    {
+      std::cout << replayer.GetLastError() << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "Generated " << replayer.GetNumberOfPackets() << " packets, "
+            << replayer.GetCaptureDuration() << " s of capture -> " << destinationIp << ":" << port
+            << std::endl;
+
+  do
+  {
+    std::cout << "---------------------------------------------------------------------------" << std::endl
+              << std::right << std::setw(OUTPUT_WIDTH) << "# packets"
+              << std::right << std::setw(OUTPUT_WIDTH) << "duration (s)"
+              << std::right << std::setw(OUTPUT_WIDTH) << "f (Hz)"
+              << std::right << std::setw(OUTPUT_WIDTH) << "delay (us)"
+              << std::right << std::setw(OUTPUT_WIDTH) << "jitter (us)"
+              << std::endl
+              << "---------------------------------------------------------------------------" << std::endl;
+    PacketReplayer::Statistics statistics = replayer.Replay(PrintStatistics, 10000);
+    std::cout << "---------------------------------------------------------------------------" << std::endl;
+    PrintStatistics(statistics);
+    if (statistics.SendErrors != 0)
+    {
+      std::cout << statistics.SendErrors << " packets could not be sent" << std::endl;
+    }
+  } while (loop);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Pass the packets of the generator to a consumer thread through a ring, as fast as
+// possible, the consumer decodes them if an interpreter is given. Return the exit code.
+int RunInProcess(VelodynePacketGenerator& generator, vtkVelodynePacketInterpreter* interpreter,
+                 double duration, unsigned int port)
+{
+  PacketRing ring;
+  std::atomic<std::uint64_t> consumedPackets(0);
+  std::uint64_t frames = 0;
+  std::thread consumer([&]() {
+    while (const PacketSlot* packet = ring.GetReadSlot())
+    {
+      if (interpreter)
+      {
+        interpreter->ProcessPacket(packet->GetPayloadData(), packet->GetPayloadSize());
+        if (interpreter->IsNewFrameReady())
+        {
+          interpreter->ClearAllFramesAvailable();
+          frames++;
+        }
+      }
+      ring.Release();
+      consumedPackets++;
+    }
+  });
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+  std::uint64_t generatedPackets = 0;
+  std::vector<unsigned char> droppedPacket(DataPacketFixedLength::HDLDataPacket::getDataByteLength());
+  while (generator.GetTime() < duration)
+  {
+    if (PacketSlot* slot = ring.GetWriteSlot())
+    {
+      generator.Generate(*slot, static_cast<unsigned short>(port));
+      ring.Publish();
+    }
+    else
+    {
+      // dropped as by a receiver, the generation goes on
+      generator.Generate(droppedPacket.data());
+    }
+    generatedPackets++;
+  }
+  // let the consumer catch up before stopping it, the ring discards the packets left
+  while (consumedPackets + ring.GetNumberOfDroppedPackets() < generatedPackets)
+  {
+    std::this_thread::yield();
+  }
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  ring.Stop();
+  consumer.join();
+
+  std::cout << "Generated " << generatedPackets << " packets (" << duration << " s of sensor) in "
+            << elapsed << " s: " << std::fixed << std::setprecision(1)
+            << generatedPackets / elapsed << " packets/s, "
+            << generatedPackets / elapsed / generator.GetPacketRate() << " times the sensor rate"
+            << std::endl;
+  std::cout << ring.GetNumberOfDroppedPackets() << " packets dropped by the ring" << std::endl;
+  if (interpreter)
+  {
+    std::cout << frames << " frames decoded" << std::endl;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bool loop = false;  // send the packets 1 time or in loop
+  bool isDualReturn = false;
+  bool decode = false;
+
+  // parse the command line options
+  po::options_description visible("Allowed options");
+  visible.add_options()
+      ("help", "produce help message")
+      ("model", po::value<std::string>()->default_value("VLP16"), "sensor model: HDL32, VLP16, VLP32, HDL64 or VLS128")
+      ("dual", po::bool_switch(&isDualReturn), "synthesize dual return packets")
+      ("rpm", po::value<double>()->default_value(600), "rotation speed of the sensor")
+      ("start-time", po::value<double>()->default_value(0), "time of the first packet, in seconds past the hour")
+      ("duration", po::value<double>()->default_value(10), "duration of the generated packets, in seconds of sensor time")
+      ("output", po::value<std::string>()->default_value("udp"),
+       "udp to send the packets, ring to pass them to a consumer thread as fast as possible")
+      ("ip", po::value<std::string>()->default_value("127.0.0.1"), "destination ip adress")
+      ("lidarPort", po::value<unsigned int>()->default_value(2368), "destination port of the packets")
+      ("rate", po::value<double>()->default_value(0), "packets per second, 0 for the rate of the sensor")
+      ("speed", po::value<double>()->default_value(1), "playback speed when no rate is given, 0 to send as fast as possible")
+      ("batch-size", po::value<int>()->default_value(32), "maximum number of packets sent by one system call")
+      ("loop", po::bool_switch(&loop), "send the packets in loop")
+      ("decode", po::bool_switch(&decode), "decode the packets in the consumer thread of the ring output")
+      ("calibration", po::value<std::string>()->default_value(""),
+       "calibration file used to decode, none for the HDL64 which sends its calibration")
+      ;
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, visible), vm);
+  po::notify(vm);
+
+  VelodynePacketGenerator::Model model;
+  if (vm.count("help") || !VelodynePacketGenerator::GetModelFromString(vm["model"].as<std::string>(), model))
+  {
+    std::cout << "Usage: SyntheticPacketSender [options]\n";
+    std::cout << visible << "\n";
+    return 1;
+  }
+
+  try
+  {
+    VelodynePacketGenerator generator(model, isDualReturn, vm["rpm"].as<double>());
+    generator.SetStartTime(vm["start-time"].as<double>());
+    std::cout << VelodynePacketGenerator::GetModelName(model) << (isDualReturn ? " dual return" : "")
+              << ": " << generator.GetPacketRate() << " packets/s, "
+              << generator.GetNumberOfPacketsPerRotation() << " packets per rotation" << std::endl;
+
+    const double duration = vm["duration"].as<double>();
+    const unsigned int port = vm["lidarPort"].as<unsigned int>();
+    const std::string output = vm["output"].as<std::string>();
+    if (output == "ring")
+    {
+      vtkSmartPointer<vtkVelodynePacketInterpreter> interpreter;
+      if (decode)
+      {
+        interpreter = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
+        interpreter->LoadCalibration(vm["calibration"].as<std::string>());
+        interpreter->ResetCurrentFrame();
+      }
+      return RunInProcess(generator, interpreter, duration, port);
+    }
+    if (output == "udp")
+    {
+      const double rate = vm["rate"].as<double>();
+      const double speed = rate > 0 ? rate / generator.GetPacketRate() : vm["speed"].as<double>();
+      return SendPackets(generator, vm["ip"].as<std::string>(), port, speed, duration, loop,
+                         vm["batch-size"].as<int>());
+    }
+    std::cout << "Unknown output " << output << std::endl;
+    return 1;
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Caught Exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
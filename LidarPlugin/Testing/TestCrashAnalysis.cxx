@@ -0,0 +1,189 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check the packets kept in memory by the crash analysis: the last ones by number or by
+// duration, saved on demand, frozen while the crash capture is written, and saved by the
+// handler of the fatal signals.
+
+// STD
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// BOOST
+#include <boost/filesystem.hpp>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// LOCAL
+#include "CrashAnalysing.h"
+#include "PacketRing.h"
+#include "TestHelpers.h"
+
+namespace
+{
+const unsigned char SOURCE_IP[4] = { 192, 168, 1, 201 };
+const std::size_t PCAP_HEADER_SIZE = 24;
+const std::size_t RECORD_HEADER_SIZE = 16;
+
+//-----------------------------------------------------------------------------
+// Add packets numbered from first, every interval seconds. Every other packet is as large
+// as possible, so that the ring wraps with records of different sizes
+void AddPackets(CrashAnalysisWriter& writer, unsigned int first, unsigned int count,
+                double interval)
+{
+  PacketSlot packet;
+  for (unsigned int number = first; number < first + count; ++number)
+  {
+    const std::uint64_t microseconds = static_cast<std::uint64_t>(number * interval * 1e6);
+    struct timeval receptionTime;
+    receptionTime.tv_sec = static_cast<long>(microseconds / 1000000);
+    receptionTime.tv_usec = static_cast<long>(microseconds % 1000000);
+    std::memcpy(packet.GetPayloadBuffer(), &number, sizeof(number));
+    const unsigned int payloadSize = number % 2 ? PacketSlot::MaximumPayloadSize : 100;
+    packet.SetPayload(payloadSize, SOURCE_IP, 2368, 2368, &receptionTime);
+    writer.AddPacket(packet);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Return the numbers of the packets of a capture, in order, or an empty list if the
+// capture can not be read
+std::vector<unsigned int> ReadPacketNumbers(const boost::filesystem::path& capture)
+{
+  std::vector<unsigned int> numbers;
+  std::ifstream file(capture.string(), std::ios::binary);
+  char pcapHeader[PCAP_HEADER_SIZE];
+  if (!file.read(pcapHeader, sizeof(pcapHeader)))
+  {
+    return numbers;
+  }
+  std::uint32_t recordHeader[RECORD_HEADER_SIZE / 4];
+  while (file.read(reinterpret_cast<char*>(recordHeader), sizeof(recordHeader)))
+  {
+    std::vector<char> data(recordHeader[2]);
+    unsigned int number;
+    if (data.size() < PacketSlot::HeaderSize + sizeof(number) ||
+        !file.read(data.data(), data.size()))
+    {
+      return std::vector<unsigned int>();
+    }
+    std::memcpy(&number, data.data() + PacketSlot::HeaderSize, sizeof(number));
+    numbers.push_back(number);
+  }
+  return numbers;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<unsigned int> Range(unsigned int first, unsigned int last)
+{
+  std::vector<unsigned int> numbers;
+  for (unsigned int number = first; number <= last; ++number)
+  {
+    numbers.push_back(number);
+  }
+  return numbers;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  const boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("LidarViewTestCrashAnalysis-%%%%-%%%%");
+  boost::filesystem::create_directories(directory);
+  const boost::filesystem::path filename = directory / "LidarLastData";
+  const boost::filesystem::path capture = directory / "LidarLastData.pcap";
+  const boost::filesystem::path crashCapture = directory / "LidarLastData_crash.pcap";
+
+  int nbrErrors = 0;
+  {
+    // the last packets by number
+    CrashAnalysisWriter writer;
+    writer.SetFilename(filename.string());
+    writer.SetNbrPacketsToStore(10);
+    writer.Start();
+    AddPackets(writer, 0, 25, 0.1);
+    nbrErrors += TestCondition(writer.SaveCapture(), "the capture must be saved");
+    nbrErrors += TestCondition(ReadPacketNumbers(capture) == Range(15, 24),
+                               "the last 10 packets must be saved in order");
+
+    // the packets added after a save are kept
+    AddPackets(writer, 25, 1, 0.1);
+    writer.SaveCapture();
+    nbrErrors += TestCondition(ReadPacketNumbers(capture) == Range(16, 25),
+                               "the packets must be kept after a save");
+
+    // the ring does not change while the crash capture is written
+    nbrErrors += TestCondition(writer.WriteCapture(nullptr, true),
+                               "the crash capture must be written");
+    AddPackets(writer, 26, 1, 0.1);
+    nbrErrors += TestCondition(ReadPacketNumbers(crashCapture) == Range(16, 25),
+                               "the crash capture must be written in its own file");
+    writer.Stop(true);
+    nbrErrors += TestCondition(ReadPacketNumbers(capture) == Range(16, 25),
+                               "no packet must be added once the crash capture is written");
+
+    // the crash capture is archived by the next session
+    writer.ArchivePreviousLogIfExist();
+    nbrErrors += TestCondition(!boost::filesystem::exists(crashCapture),
+                               "the crash capture must be archived");
+  }
+
+  {
+    // the packets of the last second, 0.3s apart
+    CrashAnalysisWriter writer;
+    writer.SetFilename(filename.string());
+    writer.SetNbrPacketsToStore(1000);
+    writer.SetDurationToStore(1.);
+    writer.Start();
+    AddPackets(writer, 0, 30, 0.3);
+    writer.Stop(true);
+    nbrErrors += TestCondition(ReadPacketNumbers(capture) == Range(26, 29),
+                               "the packets of the last second must be saved");
+  }
+
+#ifndef _WIN32
+  {
+    // a crashing process saves its last packets before dying from the signal
+    boost::filesystem::remove(crashCapture);
+    const pid_t child = fork();
+    if (child == 0)
+    {
+      CrashAnalysisWriter writer;
+      writer.SetFilename(filename.string());
+      writer.SetNbrPacketsToStore(10);
+      writer.Start();
+      AddPackets(writer, 0, 25, 0.1);
+      std::abort();
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    nbrErrors += TestCondition(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT,
+                               "the process must still die from the signal");
+    nbrErrors += TestCondition(ReadPacketNumbers(crashCapture) == Range(15, 24),
+                               "the last packets must be saved on a crash");
+  }
+#endif
+
+  boost::filesystem::remove_all(directory);
+  return nbrErrors;
+}
@@ -0,0 +1,88 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// VTK
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+// LOCAL
+#include "FramePool.h"
+#include "TestHelpers.h"
+
+namespace
+{
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> CreateFrame(vtkIdType numberOfPoints)
+{
+  vtkSmartPointer<vtkPolyData> frame = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetNumberOfPoints(numberOfPoints);
+  frame->SetPoints(points.GetPointer());
+  vtkNew<vtkDoubleArray> array;
+  array->SetName("X");
+  array->SetNumberOfTuples(numberOfPoints);
+  frame->GetPointData()->AddArray(array.GetPointer());
+  vtkNew<vtkCellArray> verts;
+  for (vtkIdType i = 0; i < numberOfPoints; ++i)
+  {
+    verts->InsertNextCell(1, &i);
+  }
+  frame->SetVerts(verts.GetPointer());
+  return frame;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  int nbrErrors = 0;
+  FramePool pool;
+  pool.SetMaximumNumberOfFrames(2);
+
+  vtkSmartPointer<vtkPolyData> frame = CreateFrame(10);
+  vtkPolyData* framePointer = frame.GetPointer();
+  pool.Add(frame);
+  nbrErrors += TestCondition(!pool.Acquire(), "a frame still referenced must not be recycled");
+
+  // a shallow copy shares the arrays of the frame
+  vtkNew<vtkPolyData> output;
+  output->ShallowCopy(frame);
+  frame = nullptr;
+  nbrErrors += TestCondition(!pool.Acquire(), "a frame whose arrays are shared must not be recycled");
+
+  output->Initialize();
+  frame = pool.Acquire();
+  nbrErrors += TestCondition(frame.GetPointer() == framePointer, "a released frame must be recycled");
+  nbrErrors += TestCondition(!pool.Acquire(), "an acquired frame must not be recycled twice");
+  frame = nullptr;
+
+  // the oldest frames are forgotten when the pool is full
+  vtkSmartPointer<vtkPolyData> frame2 = CreateFrame(10);
+  vtkSmartPointer<vtkPolyData> frame3 = CreateFrame(10);
+  pool.Add(frame2);
+  pool.Add(frame3);
+  nbrErrors += TestCondition(pool.GetNumberOfFrames() == 2, "the pool must not grow beyond its size");
+  nbrErrors += TestCondition(!pool.Acquire(), "the released frame must have been forgotten");
+
+  // a disabled pool keeps nothing
+  pool.SetMaximumNumberOfFrames(0);
+  nbrErrors += TestCondition(pool.GetNumberOfFrames() == 0, "a disabled pool must forget its frames");
+  pool.Add(CreateFrame(10));
+  nbrErrors += TestCondition(!pool.Acquire(), "a disabled pool must not recycle frames");
+
+  return nbrErrors;
+}
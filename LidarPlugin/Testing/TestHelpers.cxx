@@ -399,6 +399,17 @@ int TestFrameCount(unsigned int frameCount, unsigned int referenceCount)
   return 0;
 }
 
+//-----------------------------------------------------------------------------
+int TestCondition(bool condition, const std::string& message)
+{
+  if (!condition)
+  {
+    std::cerr << "Test failed : " << message << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 //-----------------------------------------------------------------------------
 int TestPointCount(vtkPolyData* currentFrame, vtkPolyData* currentReference)
 {
@@ -16,6 +16,7 @@
 #define __testHelpers_h
 
 #include <sstream>
+#include <string>
 #include <vector>
 
 class vtkErrorObserver;
@@ -73,6 +74,14 @@ void SetProcessingOptions(vtkLidarReader* HDLReader, vvProcessingOptionsType cur
  */
 int TestFrameCount(unsigned int frameCount, unsigned int referenceCount);
 
+/**
+ * @brief TestCondition Checks a condition of a test
+ * @param condition Condition which must be true
+ * @param message Expected behaviour, printed on failure
+ * @return 0 on success, 1 on failure
+ */
+int TestCondition(bool condition, const std::string& message);
+
 /**
  * @brief TestPointCount Checks the number of points on the actual dataset
  * @param currentFrame Current frame
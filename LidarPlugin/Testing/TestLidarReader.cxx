@@ -12,11 +12,23 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "FrameIndexFile.h"
+#include "FramePrefetcher.h"
 #include "TestHelpers.h"
 #include "vtkLidarReader.h"
 #include "vtkVelodynePacketInterpreter.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <vtkExecutive.h>
+#include <vtkInformation.h>
 #include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
 #include <vtkTimerLog.h>
 #include <vtkPVXMLParser.h>
 #include <vtkPVXMLElement.h>
@@ -85,6 +97,16 @@ int main(int argc, char* argv[])
   std::vector<std::string> referenceFilesList;
   referenceFilesList = GenerateFileList(referenceFileName);
 
+  // The readers save a frame index file next to the pcap, read a copy of it so that
+  // nothing is written in the source tree and each test starts without frame index file
+  const boost::filesystem::path workingDirectory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("LidarViewTestLidarReader-%%%%-%%%%");
+  boost::filesystem::create_directories(workingDirectory);
+  const boost::filesystem::path pcapCopy =
+    workingDirectory / boost::filesystem::path(pcapFileName).filename();
+  boost::filesystem::copy_file(pcapFileName, pcapCopy);
+  pcapFileName = pcapCopy.string();
+
   // Generate a Velodyne HDL reader
   vtkNew<vtkLidarReader> HDLReader;
   auto interp = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
@@ -98,6 +120,7 @@ int main(int argc, char* argv[])
   {
       std::cout << "ERROR, the reader ouput 0 frame!!" << std::endl
                 << "PLEASE CHECK YOUR PCAP FILE OR FILEPATH" << std::endl;
+      boost::filesystem::remove_all(workingDirectory);
       return 1;
   }
 
@@ -136,6 +159,140 @@ int main(int argc, char* argv[])
     retVal += TestRPMValues(currentFrame, currentReference);
   }
 
+  // Frame index tests
+  // A second reader must reuse the frame index saved next to the pcap by the first one
+  // and give exactly the same frames
+  std::cout << "Frame index tests..." << std::endl;
+  const std::string indexFileName =
+    FrameIndexFile(pcapFileName, HDLReader->GetLidarPort(),
+                   HDLReader->GetInterpreter()->GetFrameCatalogParameters()).GetIndexFileName();
+  retVal += TestCondition(!HDLReader->GetFrameCatalogLoadedFromFile(),
+                          "the first reader must build the frame catalog");
+  retVal += TestCondition(boost::filesystem::exists(indexFileName),
+                          "the first reader must save the frame index file " + indexFileName);
+  vtkNew<vtkLidarReader> indexedReader;
+  indexedReader->SetInterpreter(vtkSmartPointer<vtkVelodynePacketInterpreter>::New());
+  indexedReader->SetFileName(pcapFileName);
+  indexedReader->SetCalibrationFileName(correctionFileName);
+  indexedReader->Update();
+  retVal += TestCondition(indexedReader->GetFrameCatalogLoadedFromFile(),
+                          "the second reader must load the frame index file");
+
+  retVal += TestFrameCount(indexedReader->GetNumberOfFrames(), HDLReader->GetNumberOfFrames());
+  if (indexedReader->GetNetworkTimeToDataTime() != HDLReader->GetNetworkTimeToDataTime())
+  {
+    std::cerr << "NetworkTimeToDataTime differs when the frame index is loaded from file" << std::endl;
+    retVal++;
+  }
+  for (int idFrame = 0; idFrame < nbReferences; ++idFrame)
+  {
+    vtkPolyData* currentFrame = GetCurrentFrame(HDLReader.Get(), idFrame+1);
+    vtkPolyData* indexedFrame = GetCurrentFrame(indexedReader.Get(), idFrame+1);
+    retVal += TestPointCount(indexedFrame, currentFrame);
+    retVal += TestPointPositions(indexedFrame, currentFrame);
+  }
+
+  // Frame cache tests
+  // Frames requested a second time through the pipeline must be taken from the cache
+  // and be identical to the decoded ones
+  std::cout << "Frame cache tests..." << std::endl;
+  indexedReader->UpdateInformation();
+  vtkInformation* outInfo = indexedReader->GetExecutive()->GetOutputInformation(0);
+  double* timeSteps = outInfo->Get(vtkStreamingDemandDrivenPipeline::TIME_STEPS());
+  int nbCachedFrames = std::min(outInfo->Length(vtkStreamingDemandDrivenPipeline::TIME_STEPS()), 3);
+  indexedReader->ResetFrameCacheStatistics();
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (int idFrame = 0; idFrame < nbCachedFrames; ++idFrame)
+    {
+      outInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_TIME_STEP(), timeSteps[idFrame]);
+      indexedReader->Update();
+      vtkPolyData* currentFrame = GetCurrentFrame(HDLReader.Get(), idFrame+1);
+      retVal += TestPointCount(indexedReader->GetOutput(), currentFrame);
+      retVal += TestPointPositions(indexedReader->GetOutput(), currentFrame);
+    }
+  }
+  if (indexedReader->GetFrameCacheMisses() != static_cast<vtkTypeUInt64>(nbCachedFrames) ||
+      indexedReader->GetFrameCacheHits() != static_cast<vtkTypeUInt64>(nbCachedFrames))
+  {
+    std::cerr << "Unexpected frame cache statistics: " << indexedReader->GetFrameCacheHits()
+              << " hits, " << indexedReader->GetFrameCacheMisses() << " misses" << std::endl;
+    retVal++;
+  }
+
+  // A frame already cached must be decoded again once the laser selection changes
+  vtkLidarPacketInterpreter* indexedInterpreter = indexedReader->GetInterpreter();
+  const std::vector<bool> laserSelection = indexedInterpreter->GetLaserSelection();
+  std::vector<bool> halfLaserSelection = laserSelection;
+  std::fill(halfLaserSelection.begin(),
+            halfLaserSelection.begin() + indexedInterpreter->GetNumberOfChannels() / 2, false);
+  outInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_TIME_STEP(), timeSteps[0]);
+  indexedReader->Update();
+  const vtkIdType nbAllLasersPoints = indexedReader->GetOutput()->GetNumberOfPoints();
+  indexedInterpreter->SetLaserSelection(halfLaserSelection);
+  indexedReader->Update();
+  const vtkIdType nbHalfLasersPoints = indexedReader->GetOutput()->GetNumberOfPoints();
+  retVal += TestCondition(nbHalfLasersPoints > 0 && nbHalfLasersPoints < nbAllLasersPoints,
+                          "a cached frame must be decoded again with the new laser selection");
+  indexedInterpreter->SetLaserSelection(laserSelection);
+  indexedReader->Update();
+  retVal += TestCondition(indexedReader->GetOutput()->GetNumberOfPoints() == nbAllLasersPoints,
+                          "a cached frame must be decoded again with the previous laser selection");
+
+  // Range decoding tests
+  // Frames decoded in one forward pass, by one or several threads, must be identical
+  // to the frames decoded one by one
+  std::cout << "Range decoding tests..." << std::endl;
+  for (int nbThreads = 1; nbThreads <= 2; ++nbThreads)
+  {
+    indexedReader->SetNumberOfDecodingThreads(nbThreads);
+    int nbRangeFrames = indexedReader->ForEachFrame(1, nbReferences, 1,
+      [&](int idFrame, vtkPolyData* rangeFrame) {
+        vtkPolyData* currentFrame = GetCurrentFrame(HDLReader.Get(), idFrame);
+        retVal += TestPointCount(rangeFrame, currentFrame);
+        retVal += TestPointPositions(rangeFrame, currentFrame);
+        return true;
+      });
+    if (nbRangeFrames != static_cast<int>(nbReferences))
+    {
+      std::cerr << "ForEachFrame decoded " << nbRangeFrames << " frames instead of "
+                << nbReferences << " with " << nbThreads << " thread(s)" << std::endl;
+      retVal++;
+    }
+  }
+
+  // Prefetching tests
+  // A frame decoded in advance by the prefetcher, with a copy of the interpreter, must be
+  // identical to the frame decoded directly. The HDL64 intensities are corrected so that
+  // they depend on its power mode.
+  std::cout << "Prefetching tests..." << std::endl;
+  vtkVelodynePacketInterpreter* velodyneInterpreter =
+    vtkVelodynePacketInterpreter::SafeDownCast(indexedInterpreter);
+  velodyneInterpreter->SetWantIntensityCorrection(true);
+  {
+    FramePrefetcher prefetcher(pcapFileName, "udp", indexedInterpreter->Clone(),
+                               indexedReader->GetFrameCatalog(), 2);
+    prefetcher.SetPlaybackPosition(0, 1);
+    vtkSmartPointer<vtkPolyData> prefetchedFrame;
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!(prefetchedFrame = prefetcher.Take(1)) && std::chrono::steady_clock::now() < timeout)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    indexedReader->Open();
+    vtkSmartPointer<vtkPolyData> decodedFrame = indexedReader->GetFrame(1);
+    indexedReader->Close();
+    retVal += TestCondition(prefetchedFrame && decodedFrame, "the frame must be prefetched");
+    if (prefetchedFrame && decodedFrame)
+    {
+      retVal += TestPointCount(prefetchedFrame, decodedFrame);
+      retVal += TestPointPositions(prefetchedFrame, decodedFrame);
+      retVal += TestPointDataStructure(prefetchedFrame, decodedFrame);
+      retVal += TestPointDataValues(prefetchedFrame, decodedFrame);
+    }
+  }
+  velodyneInterpreter->SetWantIntensityCorrection(false);
+
   // Runtime tests
   // Modifies LidarView's processing options and check that everything run correctly
   std::cout << "Runtime tests..." << std::endl;
@@ -146,5 +303,6 @@ int main(int argc, char* argv[])
   retVal  += TestNetworkTimeToLidarTime(HDLReader.Get(),
                                         referenceNetworkTimeToDataTime);
 
+  boost::filesystem::remove_all(workingDirectory);
   return  retVal;
 }
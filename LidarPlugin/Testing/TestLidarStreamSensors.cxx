@@ -0,0 +1,168 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Receive several synthetic VLP-16 on the loopback with the receive threads of one stream:
+// the packets must reach the sensors whose port and source address match, and the sensors
+// must be removable while the packets keep coming.
+//
+// Usage: TestLidarStreamSensors <VLP-16 calibration file>
+
+// STD
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// BOOST
+#include <boost/asio.hpp>
+
+// LOCAL
+#include "TestHelpers.h"
+#include "VelodynePacketGenerator.h"
+#include "vtkDataPacket.h"
+#include "vtkLidarStream.h"
+#include "vtkVelodynePacketInterpreter.h"
+
+// VTK
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+namespace
+{
+const int LIDAR_PORT = 2470;
+const int SENSOR_PORT = 2471;
+
+//-----------------------------------------------------------------------------
+// Send the packets of a synthetic sensor to a port of the loopback
+class SensorSimulator
+{
+public:
+  SensorSimulator(boost::asio::io_service& ioService, int port)
+    : Generator(VelodynePacketGenerator::VLP16)
+    , Socket(ioService)
+    , Destination(boost::asio::ip::address_v4::loopback(), port)
+    , Packet(DataPacketFixedLength::HDLDataPacket::getDataByteLength())
+  {
+    this->Socket.open(boost::asio::ip::udp::v4());
+  }
+
+  void SendPackets(int numberOfPackets)
+  {
+    for (int i = 0; i < numberOfPackets; ++i)
+    {
+      this->Generator.Generate(this->Packet.data());
+      // the packets sent while the stream restarts are lost, as with a real sensor
+      boost::system::error_code errCode;
+      this->Socket.send_to(boost::asio::buffer(this->Packet), this->Destination, 0, errCode);
+    }
+  }
+
+private:
+  VelodynePacketGenerator Generator;
+  boost::asio::ip::udp::socket Socket;
+  boost::asio::ip::udp::endpoint Destination;
+  std::vector<unsigned char> Packet;
+};
+
+//-----------------------------------------------------------------------------
+// Wait until the stream reached a state, false after a timeout
+bool WaitFor(const std::function<bool()>& condition)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() > end)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkVelodynePacketInterpreter> CreateInterpreter(const std::string& calibration)
+{
+  auto interpreter = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
+  interpreter->SetCalibrationFileName(calibration);
+  interpreter->LoadCalibration(calibration);
+  return interpreter;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Wrong number of arguments. Usage: TestLidarStreamSensors <calibrationFile>"
+              << std::endl;
+    return 1;
+  }
+  const std::string calibrationFile = argv[1];
+
+  int nbrErrors = 0;
+  vtkNew<vtkLidarStream> stream;
+  stream->SetInterpreter(CreateInterpreter(calibrationFile));
+  stream->SetLidarPort(LIDAR_PORT);
+  stream->SetNumberOfReceiveThreads(2);
+  // a sensor on another port, and one on the same port whose source address never matches
+  stream->AddSensor(SENSOR_PORT, CreateInterpreter(calibrationFile), "127.0.0.1");
+  stream->AddSensor(SENSOR_PORT, CreateInterpreter(calibrationFile), "10.0.0.1");
+
+  std::atomic<int> numberOfFrames[3];
+  for (int sensor = 0; sensor < 3; ++sensor)
+  {
+    numberOfFrames[sensor] = 0;
+    std::atomic<int>& counter = numberOfFrames[sensor];
+    stream->AddFrameObserver([&counter](vtkPolyData*) { counter++; }, sensor);
+  }
+  stream->Start();
+
+  // the packets are sent until the end of the test, a bit faster than by the sensors
+  boost::asio::io_service ioService;
+  SensorSimulator lidar(ioService, LIDAR_PORT);
+  SensorSimulator sensor(ioService, SENSOR_PORT);
+  std::atomic<bool> isSending(true);
+  std::thread sender([&]() {
+    while (isSending)
+    {
+      lidar.SendPackets(8);
+      sensor.SendPackets(8);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+
+  nbrErrors += TestCondition(
+    WaitFor([&] { return numberOfFrames[0] >= 5 && numberOfFrames[1] >= 5; }),
+    "the frames of both ports must be assembled");
+  nbrErrors += TestCondition(numberOfFrames[2] == 0,
+                             "the packets of another source address must not be received");
+
+  // the receive threads must not give the packets to the consumers of the removed sensors
+  stream->RemoveAllSensors();
+  nbrErrors += TestCondition(stream->GetNumberOfSensors() == 1, "the sensors must be removed");
+  const int numberOfFramesBeforeRemoval = numberOfFrames[0];
+  nbrErrors += TestCondition(
+    WaitFor([&] { return numberOfFrames[0] >= numberOfFramesBeforeRemoval + 5; }),
+    "the lidar must still be received once the sensors are removed");
+
+  isSending = false;
+  sender.join();
+  stream->Stop();
+  return nbrErrors;
+}
@@ -0,0 +1,195 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check the frames kept by each delivery policy of the PacketConsumer, and the frames
+// dropped by them, with the packets of a synthetic VLP-16. Check also that the sectors
+// narrower than a packet are all delivered.
+//
+// Usage: TestPacketConsumer <VLP-16 calibration file>
+
+// STD
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// LOCAL
+#include "PacketConsumer.h"
+#include "StreamMetrics.h"
+#include "TestHelpers.h"
+#include "VelodynePacketGenerator.h"
+#include "vtkDataPacket.h"
+#include "vtkVelodynePacketInterpreter.h"
+
+// VTK
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+namespace
+{
+using FrameList = std::vector<vtkSmartPointer<vtkPolyData> >;
+
+//-----------------------------------------------------------------------------
+// Interpret a few rotations of packets as the consumer thread would, return the frames
+// given to the frame observers
+FrameList AssembleFrames(PacketConsumer& consumer, const std::string& calibrationFile,
+                         double sectorSize = 0)
+{
+  auto interpreter = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->SetSectorSize(sectorSize);
+  interpreter->ResetCurrentFrame();
+  consumer.SetInterpreter(interpreter);
+
+  FrameList frames;
+  const int observerId = consumer.AddFrameObserver([&frames](vtkPolyData* frame) {
+    frames.push_back(frame);
+  });
+
+  VelodynePacketGenerator generator(VelodynePacketGenerator::VLP16);
+  const unsigned int packetSize = DataPacketFixedLength::HDLDataPacket::getDataByteLength();
+  std::vector<unsigned char> packet(packetSize);
+  const int numberOfPackets = static_cast<int>(6 * generator.GetNumberOfPacketsPerRotation());
+  struct timeval receptionTime = {};
+  for (int i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(packet.data());
+    consumer.HandleSensorData(packet.data(), packetSize, receptionTime);
+  }
+  consumer.RemoveFrameObserver(observerId);
+  consumer.SetInterpreter(nullptr);
+  return frames;
+}
+
+//-----------------------------------------------------------------------------
+// Take the frames waiting in the consumer
+FrameList TakeFrames(PacketConsumer& consumer)
+{
+  FrameList frames;
+  vtkSmartPointer<vtkPolyData> frame;
+  struct timeval firstPacketTime;
+  while (consumer.TakeFrame(frame, firstPacketTime))
+  {
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+//-----------------------------------------------------------------------------
+int TestPolicy(PacketConsumer::DeliveryPolicy policy, int maximumNumberOfFrames,
+               int expectedNumberOfFrames, const std::string& calibrationFile)
+{
+  const std::string name = "policy " + std::to_string(policy) + ": ";
+  PacketConsumer consumer;
+  std::shared_ptr<StreamMetrics> metrics = std::make_shared<StreamMetrics>();
+  consumer.SetMetrics(metrics);
+  consumer.SetDeliveryPolicy(policy);
+  consumer.SetMaximumNumberOfFrames(maximumNumberOfFrames);
+
+  const FrameList assembledFrames = AssembleFrames(consumer, calibrationFile);
+  const std::size_t numberOfAssembledFrames = assembledFrames.size();
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(numberOfAssembledFrames >= 5, name + "the frames must be assembled");
+  if (numberOfAssembledFrames < 5)
+  {
+    return nbrErrors;
+  }
+
+  nbrErrors += TestCondition(consumer.CheckForNewData() == expectedNumberOfFrames,
+                             name + std::to_string(expectedNumberOfFrames) +
+                             " frames must wait to be taken");
+  // the frames which wait are the latest ones, in order
+  const FrameList takenFrames = TakeFrames(consumer);
+  const FrameList latestFrames(assembledFrames.end() - expectedNumberOfFrames,
+                               assembledFrames.end());
+  nbrErrors += TestCondition(takenFrames == latestFrames,
+                             name + "the latest frames must be taken in order");
+  nbrErrors += TestCondition(consumer.CheckForNewData() == 0,
+                             name + "the frames taken must not wait anymore");
+
+  // observers only is not a drop, the frames are not meant to be taken
+  const std::uint64_t numberOfDroppedFrames = policy == PacketConsumer::OBSERVERS_ONLY ?
+    0 : numberOfAssembledFrames - expectedNumberOfFrames;
+  nbrErrors += TestCondition(consumer.GetNumberOfDroppedFrames() == numberOfDroppedFrames &&
+                               metrics->DroppedFrames == numberOfDroppedFrames,
+                             name + "the frames replaced by newer ones must be counted as dropped");
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+int GetFieldValue(vtkPolyData* frame, const char* name)
+{
+  vtkDataArray* array = frame->GetFieldData()->GetArray(name);
+  return array ? static_cast<int>(array->GetTuple1(0)) : -1;
+}
+
+//-----------------------------------------------------------------------------
+// A VLP-16 packet spans about 5 degrees, it completes several sectors of half a degree
+int TestNarrowSectors(const std::string& calibrationFile)
+{
+  PacketConsumer consumer;
+  std::shared_ptr<StreamMetrics> metrics = std::make_shared<StreamMetrics>();
+  consumer.SetMetrics(metrics);
+  consumer.SetDeliveryPolicy(PacketConsumer::OBSERVERS_ONLY);
+
+  const FrameList sectors = AssembleFrames(consumer, calibrationFile, 0.5);
+  VelodynePacketGenerator generator(VelodynePacketGenerator::VLP16);
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(sectors.size() > 6 * generator.GetNumberOfPacketsPerRotation(),
+                             "a packet must complete several sectors");
+  nbrErrors += TestCondition(metrics->AssembledFrames == sectors.size(),
+                             "every sector completed must be counted");
+
+  // each sector follows the previous one, in its rotation or at the start of the next one
+  bool areConsecutive = true;
+  for (std::size_t i = 1; i < sectors.size(); ++i)
+  {
+    const int frameId = GetFieldValue(sectors[i], "FrameId");
+    const int previousFrameId = GetFieldValue(sectors[i - 1], "FrameId");
+    if (frameId == previousFrameId)
+    {
+      areConsecutive &= GetFieldValue(sectors[i], "SectorIndex") ==
+        GetFieldValue(sectors[i - 1], "SectorIndex") + 1;
+    }
+    else
+    {
+      areConsecutive &= frameId == previousFrameId + 1;
+    }
+  }
+  nbrErrors += TestCondition(areConsecutive, "the sectors must be delivered in order");
+  return nbrErrors;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Wrong number of arguments. Usage: TestPacketConsumer <calibrationFile>"
+              << std::endl;
+    return 1;
+  }
+  const std::string calibrationFile = argv[1];
+
+  int nbrErrors = 0;
+  nbrErrors += TestPolicy(PacketConsumer::KEEP_LATEST, 3, 1, calibrationFile);
+  nbrErrors += TestPolicy(PacketConsumer::KEEP_LAST_N, 3, 3, calibrationFile);
+  nbrErrors += TestPolicy(PacketConsumer::ATOMIC_SLOT, 3, 1, calibrationFile);
+  nbrErrors += TestPolicy(PacketConsumer::OBSERVERS_ONLY, 3, 0, calibrationFile);
+  nbrErrors += TestNarrowSectors(calibrationFile);
+  return nbrErrors;
+}
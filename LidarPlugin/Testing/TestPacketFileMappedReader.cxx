@@ -0,0 +1,100 @@
+#include "vtkPacketFileMappedReader.h"
+
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief CompareReaders read a pcap with both reader backends and check that they
+ * return exactly the same packets, times and file positions
+ * @return number of errors
+ */
+int CompareReaders(const std::string& pcapFileName, const std::string& filter)
+{
+  vtkPacketFileReader libpcapReader;
+  vtkPacketFileMappedReader mappedReader;
+  if (!libpcapReader.Open(pcapFileName, filter) || !mappedReader.Open(pcapFileName, filter))
+  {
+    std::cerr << "Could not open " << pcapFileName << std::endl;
+    return 1;
+  }
+  if (!mappedReader.IsMapped())
+  {
+    std::cerr << "The memory mapped reader has fallen back on libpcap for " << pcapFileName
+              << std::endl;
+    return 1;
+  }
+
+  const unsigned char* libpcapData = nullptr;
+  const unsigned char* mappedData = nullptr;
+  unsigned int libpcapLength = 0, mappedLength = 0;
+  double libpcapTime = 0, mappedTime = 0;
+  int64_t libpcapPosition = 0, mappedPosition = 0;
+  std::vector<int64_t> positions;
+  int numberOfPackets = 0;
+
+  while (true)
+  {
+    libpcapReader.GetFilePosition(&libpcapPosition);
+    mappedReader.GetFilePosition(&mappedPosition);
+    bool libpcapHasPacket = libpcapReader.NextPacket(libpcapData, libpcapLength, libpcapTime);
+    bool mappedHasPacket = mappedReader.NextPacket(mappedData, mappedLength, mappedTime);
+    if (libpcapHasPacket != mappedHasPacket)
+    {
+      std::cerr << "The readers do not stop at the same packet: " << numberOfPackets << std::endl;
+      return 1;
+    }
+    if (!libpcapHasPacket)
+    {
+      break;
+    }
+    if (libpcapPosition != mappedPosition || libpcapLength != mappedLength ||
+        libpcapTime != mappedTime || std::memcmp(libpcapData, mappedData, mappedLength) != 0)
+    {
+      std::cerr << "Packet " << numberOfPackets << " differs" << std::endl;
+      return 1;
+    }
+    positions.push_back(mappedPosition);
+    numberOfPackets++;
+  }
+
+  // Jump back to some positions and check the packets with libpcap
+  if (!libpcapReader.Open(pcapFileName, filter) || !mappedReader.Open(pcapFileName, filter))
+  {
+    std::cerr << "Could not reopen " << pcapFileName << std::endl;
+    return 1;
+  }
+  for (size_t i = positions.size() / 2; i < positions.size(); i += positions.size() / 10 + 1)
+  {
+    libpcapReader.SetFilePosition(&positions[i]);
+    mappedReader.SetFilePosition(&positions[i]);
+    libpcapReader.NextPacket(libpcapData, libpcapLength, libpcapTime);
+    mappedReader.NextPacket(mappedData, mappedLength, mappedTime);
+    if (libpcapLength != mappedLength || std::memcmp(libpcapData, mappedData, mappedLength) != 0)
+    {
+      std::cerr << "Packet at position " << positions[i] << " differs after a seek" << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << pcapFileName << " [" << filter << "]: " << numberOfPackets << " identical packets"
+            << std::endl;
+  return numberOfPackets > 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Wrong number of arguments. Usage: TestPacketFileMappedReader <pcapFileName>..."
+              << std::endl;
+    return 1;
+  }
+
+  int retVal = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    retVal += CompareReaders(argv[i], "udp");
+    retVal += CompareReaders(argv[i], "udp port 2368");
+  }
+  return retVal;
+}
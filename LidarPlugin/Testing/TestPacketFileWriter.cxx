@@ -0,0 +1,143 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check that a recording stopped by a write error goes on in a new file when it is started
+// again, without truncating the packets already recorded. The write error is forced with
+// the file size limit of the process.
+
+// STD
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+// BOOST
+#include <boost/filesystem.hpp>
+
+#include <signal.h>
+#include <sys/resource.h>
+
+// LOCAL
+#include "PacketFileWriter.h"
+#include "PacketRing.h"
+#include "StreamMetrics.h"
+#include "TestHelpers.h"
+
+namespace
+{
+const unsigned char SOURCE_IP[4] = { 192, 168, 1, 201 };
+const unsigned int PAYLOAD_SIZE = 1206;
+const std::uint64_t PCAP_HEADER_SIZE = 24;
+const std::uint64_t RECORD_SIZE =
+  BufferedPcapWriter::RecordHeaderSize + PacketSlot::HeaderSize + PAYLOAD_SIZE;
+
+//-----------------------------------------------------------------------------
+void EnqueuePackets(PacketFileWriter& writer, int numberOfPackets)
+{
+  PacketSlot packet;
+  for (int i = 0; i < numberOfPackets; ++i)
+  {
+    packet.SetPayload(PAYLOAD_SIZE, SOURCE_IP, 2368, 2368);
+    writer.Enqueue(packet);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Wait until the writer thread reached a state, false after a timeout
+bool WaitFor(const std::function<bool()>& condition)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() > end)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t GetFileSize(const boost::filesystem::path& path)
+{
+  boost::system::error_code error;
+  const std::uintmax_t size = boost::filesystem::file_size(path, error);
+  return error ? 0 : static_cast<std::uint64_t>(size);
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  // the writes beyond the file size limit fail with EFBIG instead of killing the process
+  signal(SIGXFSZ, SIG_IGN);
+  struct rlimit fileSizeLimit;
+  getrlimit(RLIMIT_FSIZE, &fileSizeLimit);
+
+  const boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("LidarViewTestPacketFileWriter-%%%%-%%%%");
+  boost::filesystem::create_directories(directory);
+  const boost::filesystem::path firstFile = directory / "record.pcap";
+  const boost::filesystem::path secondFile = directory / "record_0001.pcap";
+
+  int nbrErrors = 0;
+  {
+    std::shared_ptr<StreamMetrics> metrics = std::make_shared<StreamMetrics>();
+    PacketFileWriter writer;
+    writer.SetMetrics(metrics);
+    // each packet is on the disk before the next one is written
+    writer.SetSyncInterval(1e-9);
+
+    // a recording which is not split in several files
+    writer.Start(firstFile.string());
+    EnqueuePackets(writer, 100);
+    const std::uint64_t recordedSize = PCAP_HEADER_SIZE + 100 * RECORD_SIZE;
+    nbrErrors += TestCondition(WaitFor([&] { return GetFileSize(firstFile) == recordedSize; }),
+                               "the packets must be recorded");
+
+    // the file cannot grow anymore, the next write fails and the recording stops once the
+    // file is closed
+    struct rlimit limit = fileSizeLimit;
+    limit.rlim_cur = static_cast<rlim_t>(recordedSize);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    EnqueuePackets(writer, 1);
+    nbrErrors += TestCondition(WaitFor([&] { return writer.GetCurrentFileName().empty(); }),
+                               "a write error must stop the recording");
+    nbrErrors += TestCondition(!writer.IsOpen(), "a write error must stop the recording");
+    setrlimit(RLIMIT_FSIZE, &fileSizeLimit);
+    writer.Stop();
+
+    // the recording goes on in a new file
+    writer.Start(firstFile.string());
+    nbrErrors += TestCondition(writer.IsOpen(), "the recording must start again");
+    nbrErrors += TestCondition(writer.GetCurrentFileName() == secondFile.string(),
+                               "the recording must go on in a new file, not in " +
+                               writer.GetCurrentFileName());
+    EnqueuePackets(writer, 10);
+    nbrErrors += TestCondition(
+      WaitFor([&] { return GetFileSize(secondFile) == PCAP_HEADER_SIZE + 10 * RECORD_SIZE; }),
+      "the packets must be recorded in the new file");
+    writer.Close();
+
+    nbrErrors += TestCondition(GetFileSize(firstFile) == recordedSize,
+                               "the packets recorded before the write error must be kept");
+    nbrErrors += TestCondition(metrics->RecordedFiles == 2, "2 files must be recorded");
+  }
+
+  boost::filesystem::remove_all(directory);
+  return nbrErrors;
+}
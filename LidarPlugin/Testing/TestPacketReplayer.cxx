@@ -0,0 +1,177 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replay two pcap files on the loopback as fast as possible, and check that every packet is
+// received once, with the payload read in the files, in the order of the capture times.
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// BOOST
+#include <boost/asio.hpp>
+
+// LOCAL
+#include "PacketReplayer.h"
+#include "TestHelpers.h"
+#include "vtkPacketFileReader.h"
+
+namespace
+{
+//! Largest payload of an UDP datagram over IPv4, larger packets are not replayed
+const unsigned int MAXIMUM_UDP_PAYLOAD_SIZE = 65507;
+
+struct ExpectedPacket
+{
+  std::int64_t Time;
+  std::vector<unsigned char> Payload;
+};
+
+//-----------------------------------------------------------------------------
+// Read the packets of a pcap file with libpcap, with the capture times used by the replayer
+bool ReadPackets(const std::string& filename, std::vector<ExpectedPacket>& packets)
+{
+  vtkPacketFileReader reader;
+  if (!reader.Open(filename))
+  {
+    std::cerr << "Unable to open " << filename << ": " << reader.GetLastError() << std::endl;
+    return false;
+  }
+  const unsigned char* data = nullptr;
+  unsigned int dataLength = 0;
+  double time = 0;
+  while (reader.NextPacket(data, dataLength, time))
+  {
+    if (dataLength > MAXIMUM_UDP_PAYLOAD_SIZE)
+    {
+      continue;
+    }
+    ExpectedPacket packet;
+    packet.Time = static_cast<std::int64_t>(std::llround(time * 1e9));
+    if (!packets.empty())
+    {
+      packet.Time = std::max(packet.Time, packets.back().Time);
+    }
+    packet.Payload.assign(data, data + dataLength);
+    packets.push_back(packet);
+  }
+  return true;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cerr << "Wrong number of arguments. Usage: TestPacketReplayer <pcapFileName> "
+                 "<otherPcapFileName>"
+              << std::endl;
+    return 1;
+  }
+  const std::string firstFileName = argv[1];
+  const std::string secondFileName = argv[2];
+
+  // the packets of the files merged by capture time, the first file first at the same time
+  std::vector<ExpectedPacket> firstPackets, secondPackets, expectedPackets;
+  if (!ReadPackets(firstFileName, firstPackets) || !ReadPackets(secondFileName, secondPackets))
+  {
+    return 1;
+  }
+  std::merge(firstPackets.begin(), firstPackets.end(), secondPackets.begin(),
+             secondPackets.end(), std::back_inserter(expectedPackets),
+             [](const ExpectedPacket& a, const ExpectedPacket& b) { return a.Time < b.Time; });
+
+  // a free port on the loopback, where all the packets of both files are sent, so that
+  // their order can be checked
+  boost::asio::io_service ioService;
+  boost::asio::ip::udp::socket socket(ioService);
+  socket.open(boost::asio::ip::udp::v4());
+  boost::system::error_code errCode;
+  socket.set_option(boost::asio::socket_base::receive_buffer_size(16 << 20), errCode);
+  socket.bind(
+    boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::from_string("127.0.0.1"), 0));
+  socket.non_blocking(true);
+  const int port = socket.local_endpoint().port();
+
+  // the packets are received by a thread of their own, so that the receive buffer of the
+  // socket does not overflow while they are sent as fast as possible
+  std::vector<std::vector<unsigned char>> receivedPackets;
+  std::atomic<bool> isReplayDone(false);
+  std::thread receiver([&]() {
+    std::vector<unsigned char> buffer(MAXIMUM_UDP_PAYLOAD_SIZE);
+    auto lastPacketTime = std::chrono::steady_clock::now();
+    while (receivedPackets.size() < expectedPackets.size())
+    {
+      boost::system::error_code receiveError;
+      const std::size_t size =
+        socket.receive(boost::asio::buffer(buffer.data(), buffer.size()), 0, receiveError);
+      if (!receiveError)
+      {
+        receivedPackets.emplace_back(buffer.begin(), buffer.begin() + size);
+        lastPacketTime = std::chrono::steady_clock::now();
+        continue;
+      }
+      // the packets lost are not waited for forever
+      if (isReplayDone &&
+          std::chrono::steady_clock::now() - lastPacketTime > std::chrono::seconds(2))
+      {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  PacketReplayer replayer("127.0.0.1");
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(replayer.AddFile(firstFileName, port, port) &&
+                               replayer.AddFile(secondFileName, port, port),
+                             "the files must be loaded: " + replayer.GetLastError());
+  replayer.SetSpeed(0);
+  PacketReplayer::Statistics statistics = replayer.Replay();
+  isReplayDone = true;
+  receiver.join();
+
+  std::cout << statistics.SentPackets << " packets sent in " << statistics.Duration << "s, "
+            << receivedPackets.size() << " received" << std::endl;
+
+  nbrErrors += TestCondition(replayer.GetNumberOfPackets() == expectedPackets.size(),
+                             "the replayer must load all the packets of the files");
+  nbrErrors += TestCondition(statistics.SentPackets == expectedPackets.size() &&
+                               statistics.SendErrors == 0,
+                             "all the packets must be sent");
+  nbrErrors += TestCondition(receivedPackets.size() == expectedPackets.size(),
+                             "all the packets must be received");
+  const std::size_t nbrPackets = std::min(receivedPackets.size(), expectedPackets.size());
+  for (std::size_t i = 0; i < nbrPackets; ++i)
+  {
+    if (receivedPackets[i] != expectedPackets[i].Payload)
+    {
+      nbrErrors += TestCondition(false, "packet " + std::to_string(i) +
+                                          " differs from the one of the files, or is not "
+                                          "received in the order of the capture times");
+      break;
+    }
+  }
+
+  return nbrErrors;
+}
@@ -0,0 +1,119 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// STD
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// LOCAL
+#include "PacketRing.h"
+#include "TestHelpers.h"
+
+namespace
+{
+const unsigned char SOURCE_IP[4] = { 192, 168, 1, 201 };
+
+//-----------------------------------------------------------------------------
+void FillPacket(PacketSlot& packet, unsigned int number)
+{
+  std::memcpy(packet.GetPayloadBuffer(), &number, sizeof(number));
+  packet.SetPayload(1206, SOURCE_IP, 2368, 2368);
+}
+
+//-----------------------------------------------------------------------------
+unsigned int GetPacketNumber(const PacketSlot& packet)
+{
+  unsigned int number;
+  std::memcpy(&number, packet.GetPayloadData(), sizeof(number));
+  return number;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  int nbrErrors = 0;
+
+  // a full ring drops the new packets
+  {
+    PacketRing ring(3);
+    nbrErrors += TestCondition(ring.GetCapacity() == 4,
+                               "the capacity must be rounded up to a power of 2");
+    PacketSlot packet;
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+      FillPacket(packet, i);
+      ring.Push(packet);
+    }
+    nbrErrors += TestCondition(ring.GetNumberOfPackets() == 4, "a full ring must not grow");
+    nbrErrors += TestCondition(ring.GetNumberOfDroppedPackets() == 2,
+                               "the dropped packets must be counted");
+    const PacketSlot* first = ring.GetReadSlot();
+    nbrErrors += TestCondition(first && GetPacketNumber(*first) == 0,
+                               "the oldest packet must be read first");
+    nbrErrors += TestCondition(first && first->GetPacketSize() == PacketSlot::HeaderSize + 1206,
+      "the packet must keep its size");
+    ring.Release();
+    ring.Stop();
+    nbrErrors += TestCondition(!ring.GetReadSlot(), "a stopped ring must not return packets");
+  }
+
+  // all packets go through, in order, while the consumer spins, yields and parks
+  {
+    const unsigned int numberOfPackets = 200000;
+    PacketRing ring(64);
+    unsigned int numberOfPacketsRead = 0;
+    unsigned int numberOfPacketsOutOfOrder = 0;
+    std::thread consumer([&]() {
+      unsigned int expected = 0;
+      while (const PacketSlot* packet = ring.GetReadSlot())
+      {
+        if (GetPacketNumber(*packet) != expected)
+        {
+          numberOfPacketsOutOfOrder++;
+        }
+        expected++;
+        numberOfPacketsRead++;
+        ring.Release();
+        if (expected == numberOfPackets)
+        {
+          break;
+        }
+      }
+    });
+
+    PacketSlot packet;
+    for (unsigned int i = 0; i < numberOfPackets; ++i)
+    {
+      FillPacket(packet, i);
+      // wait for room instead of dropping, to check that no packet is lost
+      while (!ring.Push(packet))
+      {
+        std::this_thread::yield();
+      }
+      if (i % 10000 == 0)
+      {
+        // let the consumer park
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+    }
+    consumer.join();
+    nbrErrors += TestCondition(numberOfPacketsRead == numberOfPackets, "all packets must be read");
+    nbrErrors += TestCondition(numberOfPacketsOutOfOrder == 0, "the packets must be read in order");
+  }
+
+  return nbrErrors;
+}
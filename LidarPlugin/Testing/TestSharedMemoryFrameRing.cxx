@@ -0,0 +1,179 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// LOCAL
+#include "SharedMemoryFrameRing.h"
+#include "TestHelpers.h"
+
+namespace
+{
+const std::string NAME = "LidarViewTestSharedMemoryFrameRing";
+
+//-----------------------------------------------------------------------------
+// A frame whose values all derive from its number, so that a torn read is detected
+void PublishFrame(SharedMemoryFrameWriter& writer, std::uint64_t frameNumber)
+{
+  const std::uint64_t numberOfPoints = 1000 + frameNumber % 1000;
+  std::vector<float> points(3 * numberOfPoints, static_cast<float>(frameNumber));
+  std::vector<std::uint16_t> azimuths(numberOfPoints, static_cast<std::uint16_t>(frameNumber));
+  const std::int32_t frameId = static_cast<std::int32_t>(frameNumber);
+
+  writer.BeginFrame(static_cast<double>(frameNumber), numberOfPoints);
+  writer.AddArray("Points", SHARED_MEMORY_FLOAT32, SHARED_MEMORY_POINTS, 3, numberOfPoints, points.data());
+  writer.AddArray("azimuth", SHARED_MEMORY_UINT16, SHARED_MEMORY_POINT_DATA, 1, numberOfPoints,
+                  azimuths.data());
+  writer.AddArray("FrameId", SHARED_MEMORY_INT32, SHARED_MEMORY_FIELD_DATA, 1, 1, &frameId);
+  writer.EndFrame();
+}
+
+//-----------------------------------------------------------------------------
+bool IsConsistent(const SharedMemoryFrameReader::Frame& frame)
+{
+  const SharedMemoryFrameReader::Array* points = frame.GetArray("Points");
+  const SharedMemoryFrameReader::Array* azimuths = frame.GetArray("azimuth");
+  const SharedMemoryFrameReader::Array* frameId = frame.GetArray("FrameId");
+  if (!points || !azimuths || !frameId || frame.Arrays.size() != 3 ||
+      frame.NumberOfPoints != 1000 + frame.FrameNumber % 1000 ||
+      points->NumberOfTuples != frame.NumberOfPoints || points->NumberOfComponents != 3 ||
+      azimuths->NumberOfTuples != frame.NumberOfPoints ||
+      frame.Time != static_cast<double>(frame.FrameNumber) ||
+      *static_cast<const std::int32_t*>(frameId->Data) != static_cast<std::int32_t>(frame.FrameNumber))
+  {
+    return false;
+  }
+  const float* pointValues = static_cast<const float*>(points->Data);
+  const std::uint16_t* azimuthValues = static_cast<const std::uint16_t*>(azimuths->Data);
+  for (std::uint64_t i = 0; i < frame.NumberOfPoints; ++i)
+  {
+    if (pointValues[3 * i] != static_cast<float>(frame.FrameNumber) ||
+        pointValues[3 * i + 2] != static_cast<float>(frame.FrameNumber) ||
+        azimuthValues[i] != static_cast<std::uint16_t>(frame.FrameNumber))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  int nbrErrors = 0;
+
+  // nothing to read before the writer creates the memory
+  SharedMemoryFrameReader reader;
+  SharedMemoryFrameWriter writer;
+  nbrErrors += TestCondition(!reader.Open(NAME), "a reader must not open a missing shared memory");
+
+  // a slot is too small for the largest frames, their arrays are skipped
+  if (!writer.Open(NAME, 4, 64 * 1024))
+  {
+    std::cerr << writer.GetLastError() << std::endl;
+    return 1;
+  }
+  nbrErrors += TestCondition(reader.Open(NAME),
+                             "a reader must open the shared memory: " + reader.GetLastError());
+  nbrErrors += TestCondition(reader.GetNumberOfSlots() == 4, "the ring must have 4 slots");
+
+  SharedMemoryFrameReader::Frame frame;
+  nbrErrors += TestCondition(!reader.ReadLatestFrame(frame),
+                             "there must be no frame before the first one");
+  PublishFrame(writer, 1);
+  nbrErrors += TestCondition(reader.GetNumberOfFrames() == 1, "the first frame must be published");
+  nbrErrors += TestCondition(
+    reader.ReadLatestFrame(frame) && IsConsistent(frame) && frame.FrameNumber == 1,
+    "the first frame must be read");
+  nbrErrors += TestCondition(
+    reader.AcquireFrame(1, frame) && IsConsistent(frame) && reader.IsValid(frame),
+    "the first frame must be acquired without copy");
+
+  // the acquired frame is invalidated once the writer comes back to its slot
+  for (std::uint64_t frameNumber = 2; frameNumber <= 5; ++frameNumber)
+  {
+    PublishFrame(writer, frameNumber);
+  }
+  nbrErrors += TestCondition(!reader.IsValid(frame), "an overwritten frame must not be valid");
+  nbrErrors += TestCondition(!reader.ReadFrame(1, frame), "an overwritten frame must not be read");
+  nbrErrors += TestCondition(reader.ReadFrame(2, frame) && IsConsistent(frame),
+                             "the 4 last frames must be read");
+
+  // a frame larger than a slot loses the arrays which do not fit
+  writer.BeginFrame(0, 10000);
+  std::vector<double> largeArray(10000, 0);
+  nbrErrors += TestCondition(!writer.AddArray("large", SHARED_MEMORY_FLOAT64,
+                                              SHARED_MEMORY_POINT_DATA, 1, largeArray.size(),
+                                              largeArray.data()),
+                             "an array larger than the slot must be skipped");
+  writer.EndFrame();
+  nbrErrors += TestCondition(reader.ReadLatestFrame(frame) && frame.Arrays.empty(),
+                             "a frame without the arrays which do not fit must be published");
+
+  // a reader polling while the writer publishes as fast as possible never gets a torn
+  // frame: the frames it accepts are consistent, the others are rejected
+  const std::uint64_t firstFrameNumber = writer.GetNumberOfFrames() + 1;
+  const std::uint64_t numberOfFrames = 20000;
+  std::atomic<bool> isWriting(true);
+  std::thread writerThread([&]() {
+    for (std::uint64_t i = 0; i < numberOfFrames; ++i)
+    {
+      PublishFrame(writer, firstFrameNumber + i);
+    }
+    isWriting = false;
+  });
+  std::uint64_t framesRead = 0;
+  std::uint64_t inconsistentFrames = 0;
+  std::uint64_t lastFrameNumber = 0;
+  std::uint64_t framesGoingBackward = 0;
+  while (isWriting)
+  {
+    if (reader.ReadLatestFrame(frame) && frame.FrameNumber >= firstFrameNumber)
+    {
+      framesRead++;
+      inconsistentFrames += IsConsistent(frame) ? 0 : 1;
+      framesGoingBackward += frame.FrameNumber < lastFrameNumber ? 1 : 0;
+      lastFrameNumber = frame.FrameNumber;
+    }
+  }
+  writerThread.join();
+  std::cout << framesRead << " reads of the latest frame while " << numberOfFrames
+            << " frames were published" << std::endl;
+  nbrErrors += TestCondition(inconsistentFrames == 0,
+                             std::to_string(inconsistentFrames) + " torn frames were read");
+  nbrErrors += TestCondition(framesGoingBackward == 0, "the latest frame must never go backward");
+  nbrErrors += TestCondition(reader.GetNumberOfFrames() == firstFrameNumber + numberOfFrames - 1,
+                             "all frames must be published");
+
+  // a new writer replaces the memory, the reader reopens it to see the new frames
+  writer.Close();
+  nbrErrors += TestCondition(writer.Open(NAME, 2, 1024 * 1024),
+                             "the shared memory must be created again");
+  nbrErrors += TestCondition(reader.GetNumberOfFrames() != 0,
+                             "the reader must keep the old memory mapped");
+  nbrErrors += TestCondition(reader.Open(NAME) && reader.GetNumberOfFrames() == 0,
+                             "the reader must see the new memory once reopened");
+  writer.Close();
+  nbrErrors += TestCondition(!SharedMemoryFrameReader().Open(NAME),
+                             "the shared memory must be removed");
+
+  return nbrErrors;
+}
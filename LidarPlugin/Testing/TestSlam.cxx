@@ -23,6 +23,8 @@
 #include <vtkVelodynePacketInterpreter.h>
 #include <vtkXMLPolyDataReader.h>
 
+#include <boost/filesystem.hpp>
+
 #include "TestHelpers.h"
 #include "Slam.h"
 
@@ -83,6 +85,16 @@ int main(int argc, char* argv[])
   reader->Update();
   vtkSmartPointer<vtkPolyData> expectedTraj = reader->GetOutput();
 
+  // The reader saves a frame index file next to the pcap, read a copy of it so that
+  // nothing is written in the source tree
+  const boost::filesystem::path workingDirectory = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("LidarViewTestSlam-%%%%-%%%%");
+  boost::filesystem::create_directories(workingDirectory);
+  const boost::filesystem::path pcapCopy =
+    workingDirectory / boost::filesystem::path(pcapFileName).filename();
+  boost::filesystem::copy_file(pcapFileName, pcapCopy);
+  pcapFileName = pcapCopy.string();
+
   // Instantiate a Velodyne HDL reader
   vtkNew<vtkLidarReader> HDLReader;
   auto interp = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
@@ -96,6 +108,7 @@ int main(int argc, char* argv[])
   {
     std::cout << "ERROR, the reader ouput 0 frame" << std::endl
               << "PLEASE CHECK YOUR PCAP FILE OR FILEPATH" << std::endl;
+    boost::filesystem::remove_all(workingDirectory);
     return 1;
   }
 
@@ -126,6 +139,7 @@ int main(int argc, char* argv[])
       retVal +=1;
     }
   }
+  boost::filesystem::remove_all(workingDirectory);
   return retVal;
 }
 
@@ -0,0 +1,103 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// STD
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// LOCAL
+#include "StreamMetrics.h"
+#include "TestHelpers.h"
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  int nbrErrors = 0;
+
+  // an empty histogram reports no latency
+  {
+    LatencyHistogram histogram;
+    nbrErrors += TestCondition(histogram.GetCount() == 0 && histogram.GetMean() == 0. &&
+                                 histogram.GetPercentile(50) == 0. &&
+                                 histogram.GetMaximum() == 0.,
+                               "an empty histogram must report 0");
+  }
+
+  // the percentiles are the upper bounds of their bins, bounded by the maximum
+  {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 97; ++i)
+    {
+      histogram.Add(0.5e-3);
+    }
+    histogram.Add(-1.);
+    histogram.Add(3e-3);
+    histogram.Add(100.);
+
+    nbrErrors += TestCondition(histogram.GetCount() == 100, "every latency must be counted");
+    nbrErrors += TestCondition(histogram.GetBinCount(0) == 98,
+                               "the latencies under 1ms and the negative ones must be in bin 0");
+    nbrErrors += TestCondition(histogram.GetBinCount(2) == 1,
+                               "a latency of 3ms must be in the bin [2, 4[ ms");
+    nbrErrors += TestCondition(histogram.GetBinCount(LatencyHistogram::NumberOfBins - 1) == 1,
+                               "a latency of 100s must be in the last bin");
+    nbrErrors += TestCondition(histogram.GetPercentile(50) == 1., "P50 must be 1ms");
+    nbrErrors += TestCondition(histogram.GetPercentile(99) == 4., "P99 must be 4ms");
+    nbrErrors += TestCondition(histogram.GetPercentile(100) == 1e5,
+                               "the percentiles of the last bin must be the maximum");
+    nbrErrors += TestCondition(histogram.GetMaximum() == 1e5, "the maximum must be 100s");
+    nbrErrors += TestCondition(std::abs(histogram.GetMean() - 1000.515) < 1e-2,
+                               "the mean must be 1000.515ms");
+
+    histogram.Reset();
+    nbrErrors += TestCondition(histogram.GetCount() == 0 && histogram.GetBinCount(0) == 0 &&
+                                 histogram.GetMaximum() == 0.,
+                               "a reset histogram must be empty");
+  }
+
+  // the receive threads add their latencies and raise their marks at the same time
+  {
+    const int numberOfThreads = 4;
+    const int numberOfLatencies = 100000;
+    LatencyHistogram histogram;
+    std::atomic<std::uint64_t> mark(0);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < numberOfThreads; ++thread)
+    {
+      threads.emplace_back([&histogram, &mark, thread]() {
+        for (int i = 0; i < numberOfLatencies; ++i)
+        {
+          const int microseconds = i * numberOfThreads + thread;
+          histogram.Add(microseconds * 1e-6);
+          StreamMetrics::UpdateMaximum(mark, microseconds);
+        }
+      });
+    }
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+
+    const std::uint64_t maximum = numberOfLatencies * numberOfThreads - 1;
+    nbrErrors += TestCondition(histogram.GetCount() == numberOfLatencies * numberOfThreads,
+                               "the latencies of every thread must be counted");
+    nbrErrors += TestCondition(std::abs(histogram.GetMaximum() - maximum / 1e3) < 2e-3,
+                               "the maximum latency of all threads must be kept");
+    nbrErrors += TestCondition(mark == maximum, "the highest mark of all threads must be kept");
+  }
+
+  return nbrErrors;
+}
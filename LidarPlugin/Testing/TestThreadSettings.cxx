@@ -0,0 +1,177 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check the lists of CPUs of the thread settings, and on Linux that the threads are pinned
+// and reniced as requested, with a fallback when the real-time priority is not permitted.
+//
+// Usage: TestThreadSettings <VLP-16 calibration file>
+
+// STD
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// LOCAL
+#include "PacketConsumer.h"
+#include "TestHelpers.h"
+#include "ThreadSettings.h"
+#include "vtkVelodynePacketInterpreter.h"
+
+// VTK
+#include <vtkSmartPointer.h>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+int TestCPUList()
+{
+  int nbrErrors = 0;
+  std::vector<int> cpus;
+  nbrErrors += TestCondition(ParseCPUList(" 6, 0-3 ,2", cpus) &&
+                               cpus == std::vector<int>({ 0, 1, 2, 3, 6 }),
+                             "the CPUs must be sorted without duplicates");
+  nbrErrors += TestCondition(FormatCPUList(cpus) == "0-3,6",
+                             "the consecutive CPUs must be written as a range");
+  nbrErrors += TestCondition(ParseCPUList("", cpus) && cpus.empty(),
+                             "an empty list must be all the CPUs");
+
+  cpus.assign(1, 4);
+  for (const std::string list : { "3-1", "1,,2", "a", "1-", "-1", "12345" })
+  {
+    nbrErrors += TestCondition(!ParseCPUList(list, cpus) && cpus == std::vector<int>(1, 4),
+                               "the list \"" + list + "\" must be refused");
+  }
+
+  ThreadSettings settings;
+  settings.RealTimePriority = 50;
+  settings.CPUs = { 2, 3 };
+  nbrErrors += TestCondition(settings.ToString() == "SCHED_FIFO 50, CPUs 2-3",
+                             "the settings must be described");
+  return nbrErrors;
+}
+
+#ifdef __linux__
+//-----------------------------------------------------------------------------
+// Wait until a thread reached a state, false after a timeout
+bool WaitFor(const std::function<bool()>& condition)
+{
+  const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() > end)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Apply settings to a new thread, return what it reports
+ThreadSettings ApplyInThread(const ThreadSettings& settings)
+{
+  ThreadSettings effectiveSettings;
+  std::thread thread([&]() { effectiveSettings = ApplyThreadSettings(settings, "test"); });
+  thread.join();
+  return effectiveSettings;
+}
+
+//-----------------------------------------------------------------------------
+int TestApplySettings(const std::vector<int>& processCpus, const std::string& calibrationFile)
+{
+  int nbrErrors = 0;
+  const int cpu = processCpus.back();
+
+  // raising the nice value is always permitted
+  ThreadSettings settings;
+  settings.Nice = 19;
+  settings.CPUs = { cpu, 100000 };
+  ThreadSettings effectiveSettings = ApplyInThread(settings);
+  nbrErrors += TestCondition(effectiveSettings.CPUs == std::vector<int>(1, cpu),
+                             "the thread must be pinned to the available CPU only");
+  nbrErrors += TestCondition(effectiveSettings.Nice == 19 &&
+                               effectiveSettings.RealTimePriority == 0,
+                             "the thread must use the nice value");
+
+  // the real-time priority needs CAP_SYS_NICE or RLIMIT_RTPRIO, else the nice value is used
+  settings.RealTimePriority = 10;
+  settings.CPUs = { 100000 };
+  effectiveSettings = ApplyInThread(settings);
+  nbrErrors += TestCondition(effectiveSettings.RealTimePriority == 10 ||
+                               (effectiveSettings.RealTimePriority == 0 &&
+                                effectiveSettings.Nice == 19),
+                             "the thread must use the real-time priority or fall back to nice");
+  nbrErrors += TestCondition(effectiveSettings.CPUs == processCpus,
+                             "the thread must run on any CPU if none requested is available");
+
+  // the consumer thread of a sensor reports the settings it uses
+  auto interpreter = vtkSmartPointer<vtkVelodynePacketInterpreter>::New();
+  interpreter->LoadCalibration(calibrationFile);
+  PacketConsumer consumer;
+  consumer.SetInterpreter(interpreter);
+  settings.RealTimePriority = 0;
+  settings.CPUs.clear();
+  consumer.SetThreadSettings(settings);
+  consumer.SetCPU(cpu);
+  consumer.Start();
+  nbrErrors += TestCondition(
+    WaitFor([&] { return !consumer.GetEffectiveThreadSettings().CPUs.empty(); }),
+    "the consumer thread must report its settings");
+  effectiveSettings = consumer.GetEffectiveThreadSettings();
+  nbrErrors += TestCondition(effectiveSettings.CPUs == std::vector<int>(1, cpu) &&
+                               effectiveSettings.Nice == 19,
+                             "the consumer thread must be pinned to its CPU and reniced");
+  consumer.Stop();
+  return nbrErrors;
+}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Wrong number of arguments. Usage: TestThreadSettings <calibrationFile>"
+              << std::endl;
+    return 1;
+  }
+  const std::string calibrationFile = argv[1];
+
+  int nbrErrors = TestCPUList();
+#ifdef __linux__
+  cpu_set_t cpuSet;
+  if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+  {
+    std::vector<int> processCpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &cpuSet))
+      {
+        processCpus.push_back(cpu);
+      }
+    }
+    nbrErrors += TestApplySettings(processCpus, calibrationFile);
+  }
+#endif
+  return nbrErrors;
+}
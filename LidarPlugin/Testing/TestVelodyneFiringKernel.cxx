@@ -0,0 +1,150 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// STD
+#include <cmath>
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+
+// LOCAL
+#include "VelodyneFiringKernel.h"
+
+using namespace DataPacketFixedLength;
+
+namespace
+{
+//-----------------------------------------------------------------------------
+double RandomValue(double min, double max)
+{
+  return min + (max - min) * static_cast<double>(std::rand()) / RAND_MAX;
+}
+
+//-----------------------------------------------------------------------------
+double ToRadians(double degrees)
+{
+  return degrees * 3.14159265358979323846 / 180.0;
+}
+
+//-----------------------------------------------------------------------------
+void RandomCorrections(HDLLaserCorrection* corrections)
+{
+  for (int i = 0; i < HDL_MAX_NUM_LASERS; ++i)
+  {
+    HDLLaserCorrection& correction = corrections[i];
+    // most sensors have no rotational correction, which is a special case of the formula
+    correction.rotationalCorrection = (i % 3 == 0) ? RandomValue(-5.0, 5.0) : 0.0;
+    correction.verticalCorrection = RandomValue(-30.0, 30.0);
+    correction.distanceCorrection = RandomValue(0.0, 0.1);
+    correction.verticalOffsetCorrection = RandomValue(0.0, 0.1);
+    correction.horizontalOffsetCorrection = RandomValue(-0.05, 0.05);
+    correction.cosVertCorrection = std::cos(ToRadians(correction.verticalCorrection));
+    correction.sinVertCorrection = std::sin(ToRadians(correction.verticalCorrection));
+    correction.cosRotationalCorrection = std::cos(ToRadians(correction.rotationalCorrection));
+    correction.sinRotationalCorrection = std::sin(ToRadians(correction.rotationalCorrection));
+    correction.sinVertOffsetCorrection =
+      correction.verticalOffsetCorrection * correction.sinVertCorrection;
+    correction.cosVertOffsetCorrection =
+      correction.verticalOffsetCorrection * correction.cosVertCorrection;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int TestImplementation(VelodyneFiringKernel::Implementation implementation)
+{
+  if (!VelodyneFiringKernel::IsSupported(implementation))
+  {
+    std::cout << "Implementation " << implementation << " not supported, skipped" << std::endl;
+    return 0;
+  }
+
+  std::vector<double> cosTable(HDL_NUM_ROT_ANGLES), sinTable(HDL_NUM_ROT_ANGLES);
+  for (int i = 0; i < HDL_NUM_ROT_ANGLES; ++i)
+  {
+    cosTable[i] = std::cos(ToRadians(i / 100.0));
+    sinTable[i] = std::sin(ToRadians(i / 100.0));
+  }
+  HDLLaserCorrection corrections[HDL_MAX_NUM_LASERS];
+  RandomCorrections(corrections);
+  FiringCorrections firingCorrections;
+  firingCorrections.Set(corrections);
+  const double distanceResolution = 0.002;
+
+  int nbrErrors = 0;
+  for (int firing = 0; firing < 10000; ++firing)
+  {
+    int azimuths[HDL_LASER_PER_FIRING];
+    int distances[HDL_LASER_PER_FIRING];
+    for (int i = 0; i < HDL_LASER_PER_FIRING; ++i)
+    {
+      azimuths[i] = std::rand() % 36000;
+      distances[i] = std::rand() % 65536;
+    }
+    const int laserOffset = (std::rand() % (HDL_MAX_NUM_LASERS / HDL_LASER_PER_FIRING)) *
+      HDL_LASER_PER_FIRING;
+
+    FiringPositions positions;
+    VelodyneFiringKernel::ComputePositions(azimuths, distances, laserOffset, firingCorrections,
+      distanceResolution, cosTable.data(), sinTable.data(), positions, implementation);
+
+    // compare with the position computed one laser at a time, the results must be identical
+    for (int i = 0; i < HDL_LASER_PER_FIRING; ++i)
+    {
+      const HDLLaserCorrection& correction = corrections[laserOffset + i];
+      double cosAzimuth = cosTable[azimuths[i]];
+      double sinAzimuth = sinTable[azimuths[i]];
+      if (correction.rotationalCorrection != 0)
+      {
+        cosAzimuth = cosTable[azimuths[i]] * correction.cosRotationalCorrection +
+          sinTable[azimuths[i]] * correction.sinRotationalCorrection;
+        sinAzimuth = sinTable[azimuths[i]] * correction.cosRotationalCorrection -
+          cosTable[azimuths[i]] * correction.sinRotationalCorrection;
+      }
+      const double distanceM = distances[i] * distanceResolution + correction.distanceCorrection;
+      const double xyDistance =
+        distanceM * correction.cosVertCorrection - correction.sinVertOffsetCorrection;
+      const double x = xyDistance * sinAzimuth - correction.horizontalOffsetCorrection * cosAzimuth;
+      const double y = xyDistance * cosAzimuth + correction.horizontalOffsetCorrection * sinAzimuth;
+      const double z = distanceM * correction.sinVertCorrection + correction.verticalOffsetCorrection;
+
+      if (positions.X[i] != x || positions.Y[i] != y || positions.Z[i] != z ||
+        positions.Distance[i] != distanceM)
+      {
+        nbrErrors++;
+      }
+    }
+  }
+
+  if (nbrErrors != 0)
+  {
+    std::cerr << "Implementation " << implementation << ": " << nbrErrors
+              << " positions differ from the reference" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  // initialize the random generator to a fixed seed
+  // for test repetability
+  std::srand(1992);
+
+  int nbrErrors = 0;
+  nbrErrors += TestImplementation(VelodyneFiringKernel::SCALAR);
+  nbrErrors += TestImplementation(VelodyneFiringKernel::AVX2);
+  return nbrErrors;
+}
@@ -0,0 +1,507 @@
+// Copyright 2019 Kitware SAS.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check that the synthetic packets of a model are valid and decoded, in full frames and
+// in sectors which have the rpm of their rotation, with a continuous time across the hour
+// rollover and without counting the reordered packets as lost, then measure the packets
+// per second sustained by each stage: generation, transfer through a PacketRing to a
+// consumer thread, and decoding.
+//
+// Usage: TestVelodynePacketGenerator <model> <Single|Dual> [<calibration file>]
+// Without calibration argument the packets are not decoded, an empty calibration file
+// name decodes the HDL64 with the calibration sent in its packets.
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+// LOCAL
+#include "PacketRing.h"
+#include "TestHelpers.h"
+#include "VelodynePacketGenerator.h"
+#include "vtkDataPacket.h"
+#include "vtkVelodynePacketInterpreter.h"
+
+// VTK
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+using namespace DataPacketFixedLength;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const unsigned int PACKET_SIZE = HDLDataPacket::getDataByteLength();
+
+//-----------------------------------------------------------------------------
+double Seconds(const Clock::time_point& start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+void PrintRate(const std::string& stage, std::size_t numberOfPackets, double seconds,
+               double sensorRate)
+{
+  const double rate = numberOfPackets / seconds;
+  std::cout << stage << ": " << static_cast<std::uint64_t>(rate) << " packets/s, "
+            << rate / sensorRate << " times the sensor rate" << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+int GetAzimuth(const std::vector<unsigned char>& packet)
+{
+  return reinterpret_cast<const HDLDataPacket*>(packet.data())->firingData[0].rotationalPosition;
+}
+
+//-----------------------------------------------------------------------------
+SensorType GetExpectedSensorType(VelodynePacketGenerator::Model model)
+{
+  switch (model)
+  {
+    case VelodynePacketGenerator::HDL32:
+      return HDL32E;
+    case VelodynePacketGenerator::VLP16:
+      return VLP16;
+    case VelodynePacketGenerator::VLP32:
+      return VLP32C;
+    case VelodynePacketGenerator::HDL64:
+      return HDL64;
+    default:
+      return VLS128;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int TestPackets(VelodynePacketGenerator::Model model, bool isDualReturn)
+{
+  int nbrErrors = 0;
+  VelodynePacketGenerator generator(model, isDualReturn);
+  // the gpsTimestamp rolls over after 0.1s
+  generator.SetStartTime(3599.9);
+
+  std::vector<unsigned char> data(PACKET_SIZE);
+  const HDLDataPacket* packet = reinterpret_cast<const HDLDataPacket*>(data.data());
+  const std::size_t numberOfPackets = static_cast<std::size_t>(generator.GetPacketRate());
+  unsigned int lastTimestamp = 0;
+  int numberOfRollovers = 0;
+  int numberOfRotations = 0;
+  int lastAzimuth = -1;
+  std::size_t numberOfInvalidPackets = 0;
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(data.data());
+    if (!HDLDataPacket::isValidPacket(data.data(), PACKET_SIZE) ||
+        packet->getSensorType() != GetExpectedSensorType(model) ||
+        packet->isDualModeReturn() != isDualReturn || packet->gpsTimestamp >= 3600000000u)
+    {
+      numberOfInvalidPackets++;
+    }
+    if (i != 0 && packet->gpsTimestamp < lastTimestamp)
+    {
+      numberOfRollovers++;
+    }
+    lastTimestamp = packet->gpsTimestamp;
+    const int azimuth = packet->firingData[0].rotationalPosition;
+    if (azimuth < lastAzimuth)
+    {
+      numberOfRotations++;
+    }
+    lastAzimuth = azimuth;
+  }
+
+  nbrErrors += TestCondition(numberOfInvalidPackets == 0,
+                             "the packets must be valid packets of the model");
+  nbrErrors += TestCondition(numberOfRollovers == 1, "the gpsTimestamp must roll over once");
+  // one second at 600 rpm, from the azimuth 0
+  nbrErrors += TestCondition(numberOfRotations == 9,
+                             "the azimuth must wrap 9 times in a second, not " +
+                             std::to_string(numberOfRotations));
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+int TestDecoding(VelodynePacketGenerator::Model model, bool isDualReturn,
+                 const std::string& calibrationFile)
+{
+  int nbrErrors = 0;
+  VelodynePacketGenerator generator(model, isDualReturn);
+  vtkNew<vtkVelodynePacketInterpreter> interpreter;
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->ResetCurrentFrame();
+
+  // 5 seconds, after the 3 rounds of 4160 packets in which the HDL64 sends its calibration
+  const std::size_t numberOfPackets = static_cast<std::size_t>(5 * generator.GetPacketRate()) +
+    (model == VelodynePacketGenerator::HDL64 ? 4 * 4160 : 0);
+  std::vector<unsigned char> packets(numberOfPackets * PACKET_SIZE);
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(&packets[i * PACKET_SIZE]);
+  }
+
+  int numberOfFrames = 0;
+  vtkIdType numberOfPoints = 0;
+  const Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    interpreter->ProcessPacket(&packets[i * PACKET_SIZE], PACKET_SIZE);
+    if (interpreter->IsNewFrameReady())
+    {
+      numberOfPoints = interpreter->GetLastFrameAvailable()->GetNumberOfPoints();
+      interpreter->ClearAllFramesAvailable();
+      numberOfFrames++;
+    }
+  }
+  PrintRate("decoding", numberOfPackets, Seconds(start), generator.GetPacketRate());
+
+  nbrErrors += TestCondition(interpreter->GetNumberOfChannels() == generator.GetNumberOfLasers(),
+                             "the calibration must have the lasers of the model");
+  nbrErrors += TestCondition(numberOfFrames >= 5, "the packets must be decoded in frames, " +
+                             std::to_string(numberOfFrames) + " frames");
+  nbrErrors += TestCondition(numberOfPoints > 0, "the frames must have points");
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+int TestSectors(VelodynePacketGenerator::Model model, bool isDualReturn,
+                const std::string& calibrationFile)
+{
+  // the frames are split in 4 sectors, which must follow each other in the rotations
+  VelodynePacketGenerator generator(model, isDualReturn);
+  vtkNew<vtkVelodynePacketInterpreter> interpreter;
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->SetSectorSize(90);
+  interpreter->ResetCurrentFrame();
+
+  const std::size_t numberOfPackets = static_cast<std::size_t>(2 * generator.GetPacketRate()) +
+    (model == VelodynePacketGenerator::HDL64 ? 4 * 4160 : 0);
+  std::vector<unsigned char> data(PACKET_SIZE);
+  int numberOfSectors = 0;
+  int numberOfInvalidSectors = 0;
+  int lastFrameId = -1;
+  int lastSectorIndex = -1;
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(data.data());
+    interpreter->ProcessPacket(data.data(), PACKET_SIZE);
+    if (!interpreter->IsNewFrameReady())
+    {
+      continue;
+    }
+    vtkPolyData* sector = interpreter->GetLastFrameAvailable();
+    vtkDataArray* sectorIndexData = sector->GetFieldData()->GetArray("SectorIndex");
+    vtkDataArray* frameIdData = sector->GetFieldData()->GetArray("FrameId");
+    if (!sectorIndexData || !frameIdData)
+    {
+      numberOfInvalidSectors++;
+    }
+    else
+    {
+      const int sectorIndex = static_cast<int>(sectorIndexData->GetTuple1(0));
+      const int frameId = static_cast<int>(frameIdData->GetTuple1(0));
+      const bool isNextSector = frameId == lastFrameId && sectorIndex == lastSectorIndex + 1;
+      const bool isNextFrame = frameId == lastFrameId + 1 && sectorIndex == 0;
+      if (sectorIndex < 0 || sectorIndex > 3 || sector->GetNumberOfPoints() == 0 ||
+          (numberOfSectors != 0 && !isNextSector && !isNextFrame))
+      {
+        numberOfInvalidSectors++;
+      }
+      lastFrameId = frameId;
+      lastSectorIndex = sectorIndex;
+    }
+    interpreter->ClearAllFramesAvailable();
+    numberOfSectors++;
+  }
+
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(numberOfSectors >= 4 * 15,
+                             "the rotations must be split in 4 sectors, " +
+                             std::to_string(numberOfSectors) + " sectors");
+  nbrErrors += TestCondition(numberOfInvalidSectors == 0, "the sectors must be tagged in order, " +
+                             std::to_string(numberOfInvalidSectors) + " invalid sectors");
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+int TestSectorRotationSpeed(VelodynePacketGenerator::Model model, bool isDualReturn,
+                            const std::string& calibrationFile)
+{
+  // the sectors are narrower than the azimuths of a packet, their rpm is the one of the
+  // last rotation
+  VelodynePacketGenerator generator(model, isDualReturn);
+  vtkNew<vtkVelodynePacketInterpreter> interpreter;
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->SetSectorSize(0.5);
+  interpreter->ResetCurrentFrame();
+
+  const std::size_t numberOfPackets = static_cast<std::size_t>(generator.GetPacketRate()) +
+    (model == VelodynePacketGenerator::HDL64 ? 4 * 4160 : 0);
+  std::vector<unsigned char> data(PACKET_SIZE);
+  int numberOfSectors = 0;
+  int numberOfInvalidSectors = 0;
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(data.data());
+    interpreter->ProcessPacket(data.data(), PACKET_SIZE);
+    if (!interpreter->IsNewFrameReady())
+    {
+      continue;
+    }
+    vtkFieldData* fieldData = interpreter->GetLastFrameAvailable()->GetFieldData();
+    // the first rotation, which may start with the first packet, is measured once it ends
+    if (fieldData->GetArray("FrameId")->GetTuple1(0) >= 2)
+    {
+      const double rpm = fieldData->GetArray("RotationPerMinute")->GetTuple1(0);
+      if (std::abs(rpm - 600) > 30)
+      {
+        numberOfInvalidSectors++;
+      }
+      numberOfSectors++;
+    }
+    interpreter->ClearAllFramesAvailable();
+  }
+
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(numberOfSectors > 0, "the rotations must be split in sectors");
+  nbrErrors += TestCondition(numberOfInvalidSectors == 0,
+                             "the sectors must have the rpm of the rotation, " +
+                             std::to_string(numberOfInvalidSectors) + " invalid sectors");
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+int TestPacketLoss(VelodynePacketGenerator::Model model, bool isDualReturn,
+                   const std::string& calibrationFile)
+{
+  // a few packets are lost and a few others are swapped with the next one, in the middle
+  // of the packets and across the rollover of the gpsTimestamp: only the lost ones must
+  // be counted
+  VelodynePacketGenerator generator(model, isDualReturn);
+  const std::size_t numberOfCalibrationPackets =
+    model == VelodynePacketGenerator::HDL64 ? 4 * 4160 : 0;
+  generator.SetStartTime(3599.8 - numberOfCalibrationPackets / generator.GetPacketRate());
+  vtkNew<vtkVelodynePacketInterpreter> interpreter;
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->ResetCurrentFrame();
+
+  const std::size_t numberOfPackets =
+    static_cast<std::size_t>(generator.GetPacketRate()) + numberOfCalibrationPackets;
+  std::vector<std::vector<unsigned char> > packets(numberOfPackets,
+                                                   std::vector<unsigned char>(PACKET_SIZE));
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(packets[i].data());
+  }
+
+  // the swapped packets are taken away from the start of the rotations, where a late
+  // packet would be accounted to another frame than the one its loss was
+  const std::size_t rotationSize =
+    static_cast<std::size_t>(generator.GetNumberOfPacketsPerRotation());
+  std::size_t packetIndex = numberOfCalibrationPackets + rotationSize;
+  for (int i = 0; i < 5; ++i)
+  {
+    while (GetAzimuth(packets[packetIndex]) < 9000 || GetAzimuth(packets[packetIndex]) > 27000)
+    {
+      packetIndex++;
+    }
+    std::swap(packets[packetIndex], packets[packetIndex + 1]);
+    packetIndex += rotationSize;
+  }
+  const int numberOfLostPackets = 3;
+  for (int i = 0; i < numberOfLostPackets; ++i)
+  {
+    packets.erase(packets.begin() + numberOfCalibrationPackets + rotationSize / 2 +
+                  2 * rotationSize * i);
+  }
+
+  double numberOfMissingPackets = 0;
+  for (const std::vector<unsigned char>& packet : packets)
+  {
+    interpreter->ProcessPacket(packet.data(), PACKET_SIZE);
+    if (interpreter->IsNewFrameReady())
+    {
+      vtkFieldData* fieldData = interpreter->GetLastFrameAvailable()->GetFieldData();
+      numberOfMissingPackets += fieldData->GetArray("MissingPackets")->GetTuple1(0);
+      interpreter->ClearAllFramesAvailable();
+    }
+  }
+  return TestCondition(numberOfMissingPackets == numberOfLostPackets,
+                       "only the lost packets must be counted as missing, not " +
+                       std::to_string(numberOfMissingPackets));
+}
+
+//-----------------------------------------------------------------------------
+int TestTimeline(VelodynePacketGenerator::Model model, bool isDualReturn,
+                 const std::string& calibrationFile)
+{
+  // the gpsTimestamp rolls over in the middle of the packets, after the calibration of
+  // the HDL64, but the time of the points must keep increasing
+  VelodynePacketGenerator generator(model, isDualReturn);
+  const std::size_t numberOfCalibrationPackets =
+    model == VelodynePacketGenerator::HDL64 ? 4 * 4160 : 0;
+  generator.SetStartTime(3599.5 - numberOfCalibrationPackets / generator.GetPacketRate());
+  vtkNew<vtkVelodynePacketInterpreter> interpreter;
+  interpreter->LoadCalibration(calibrationFile);
+  interpreter->SetOutputArrays(vtkLidarPacketInterpreter::OUTPUT_ALL);
+  interpreter->ResetCurrentFrame();
+
+  const std::size_t numberOfPackets =
+    static_cast<std::size_t>(generator.GetPacketRate()) + numberOfCalibrationPackets;
+  std::vector<unsigned char> data(PACKET_SIZE);
+  int numberOfFrames = 0;
+  int numberOfInvalidFrames = 0;
+  vtkTypeInt64 lastBaseTime = std::numeric_limits<vtkTypeInt64>::min();
+  double lastTime = 0;
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(data.data());
+    interpreter->ProcessPacket(data.data(), PACKET_SIZE);
+    if (!interpreter->IsNewFrameReady())
+    {
+      continue;
+    }
+    vtkPolyData* frame = interpreter->GetLastFrameAvailable();
+    vtkDataArray* baseTimeData = frame->GetFieldData()->GetArray("FrameBaseTime");
+    vtkDataArray* timeData = frame->GetPointData()->GetArray("adjustedtime");
+    vtkDataArray* timeOffsetData = frame->GetPointData()->GetArray("time_offset");
+    if (frame->GetNumberOfPoints() == 0)
+    {
+      interpreter->ClearAllFramesAvailable();
+      continue;
+    }
+    if (!baseTimeData || !timeData || !timeOffsetData)
+    {
+      numberOfInvalidFrames++;
+      interpreter->ClearAllFramesAvailable();
+      continue;
+    }
+    // in nanoseconds, and the times of the points in microseconds
+    const vtkTypeInt64 baseTime = static_cast<vtkTypeInt64>(baseTimeData->GetTuple1(0));
+    bool isValid = baseTime > lastBaseTime;
+    for (vtkIdType pointId = 0; pointId < frame->GetNumberOfPoints(); ++pointId)
+    {
+      const double time = timeData->GetTuple1(pointId);
+      const double offset = timeOffsetData->GetTuple1(pointId);
+      isValid &= time == static_cast<double>(baseTime / 1000) + offset;
+    }
+    lastTime = timeData->GetTuple1(frame->GetNumberOfPoints() - 1);
+    if (!isValid)
+    {
+      numberOfInvalidFrames++;
+    }
+    lastBaseTime = baseTime;
+    interpreter->ClearAllFramesAvailable();
+    numberOfFrames++;
+  }
+
+  int nbrErrors = 0;
+  nbrErrors += TestCondition(numberOfFrames >= 5, "the packets must be decoded in frames, " +
+                             std::to_string(numberOfFrames) + " frames");
+  nbrErrors += TestCondition(numberOfInvalidFrames == 0,
+                             "the frames must have a continuous timeline, " +
+                             std::to_string(numberOfInvalidFrames) + " invalid frames");
+  nbrErrors += TestCondition(lastTime > 3600e6, "the time must continue after the rollover");
+  return nbrErrors;
+}
+
+//-----------------------------------------------------------------------------
+void BenchmarkGeneration(VelodynePacketGenerator::Model model, bool isDualReturn)
+{
+  VelodynePacketGenerator generator(model, isDualReturn);
+  std::vector<unsigned char> data(PACKET_SIZE);
+  const std::size_t numberOfPackets = 200000;
+  const Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    generator.Generate(data.data());
+  }
+  PrintRate("generation", numberOfPackets, Seconds(start), generator.GetPacketRate());
+}
+
+//-----------------------------------------------------------------------------
+int BenchmarkRing(VelodynePacketGenerator::Model model, bool isDualReturn)
+{
+  // the generator writes in the slots of the ring as a PacketReceiver would, the producer
+  // waits for room instead of dropping, so that the rate is the one the pair sustains
+  VelodynePacketGenerator generator(model, isDualReturn);
+  PacketRing ring;
+  const std::size_t numberOfPackets = 200000;
+  std::size_t numberOfPacketsRead = 0;
+  std::thread consumer([&]() {
+    while (ring.GetReadSlot())
+    {
+      ring.Release();
+      if (++numberOfPacketsRead == numberOfPackets)
+      {
+        break;
+      }
+    }
+  });
+
+  const Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < numberOfPackets; ++i)
+  {
+    PacketSlot* slot = nullptr;
+    while (!(slot = ring.GetWriteSlot()))
+    {
+      std::this_thread::yield();
+    }
+    generator.Generate(*slot);
+    ring.Publish();
+  }
+  consumer.join();
+  PrintRate("ring transfer", numberOfPackets, Seconds(start), generator.GetPacketRate());
+  return TestCondition(numberOfPacketsRead == numberOfPackets,
+                       "all packets must go through the ring");
+}
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  VelodynePacketGenerator::Model model;
+  if (argc < 3 || !VelodynePacketGenerator::GetModelFromString(argv[1], model))
+  {
+    std::cerr << "Usage: " << argv[0] << " <model> <Single|Dual> [<calibration file>]" << std::endl;
+    return 1;
+  }
+  const bool isDualReturn = std::string(argv[2]) == "Dual";
+  std::cout << VelodynePacketGenerator::GetModelName(model) << (isDualReturn ? " dual" : " single")
+            << " return, sensor rate "
+            << VelodynePacketGenerator(model, isDualReturn).GetPacketRate() << " packets/s" << std::endl;
+
+  int nbrErrors = TestPackets(model, isDualReturn);
+  BenchmarkGeneration(model, isDualReturn);
+  nbrErrors += BenchmarkRing(model, isDualReturn);
+  if (argc > 3)
+  {
+    nbrErrors += TestDecoding(model, isDualReturn, argv[3]);
+    nbrErrors += TestSectors(model, isDualReturn, argv[3]);
+    nbrErrors += TestSectorRotationSpeed(model, isDualReturn, argv[3]);
+    nbrErrors += TestTimeline(model, isDualReturn, argv[3]);
+    nbrErrors += TestPacketLoss(model, isDualReturn, argv[3]);
+  }
+  return nbrErrors;
+}
@@ -321,38 +321,33 @@ void pqLidarViewManager::saveFramesToLAS(vtkLidarReader* reader, vtkPolyData* po
     startFrame + (endFrame - startFrame) * 2, getMainWindow());
   progress.setWindowModality(Qt::WindowModal);
 
-  reader->Open();
-  for (int frame = startFrame; frame <= endFrame; ++frame)
-  {
+  // each pass decodes the frames in one go, without seeking to each frame
+  bool canceled = false;
+  reader->ForEachFrame(startFrame, endFrame, 1, [&](int frame, vtkPolyData* data) {
     progress.setValue(frame);
-
-    if (progress.wasCanceled())
+    canceled = progress.wasCanceled();
+    if (!canceled)
     {
-      reader->Close();
-      return;
+      writer.UpdateMetaData(data);
     }
-
-    const vtkSmartPointer<vtkPolyData>& data = reader->GetFrame(frame);
-    writer.UpdateMetaData(data.GetPointer());
+    return !canceled;
+  });
+  if (canceled)
+  {
+    return;
   }
 
   writer.FlushMetaData();
 
-  for (int frame = startFrame; frame <= endFrame; ++frame)
-  {
+  reader->ForEachFrame(startFrame, endFrame, 1, [&](int frame, vtkPolyData* data) {
     progress.setValue(endFrame + (frame - startFrame));
-
-    if (progress.wasCanceled())
+    canceled = progress.wasCanceled();
+    if (!canceled)
     {
-      reader->Close();
-      return;
+      writer.WriteFrame(data);
     }
-
-    const vtkSmartPointer<vtkPolyData>& data = reader->GetFrame(frame);
-    writer.WriteFrame(data.GetPointer());
-  }
-
-  reader->Close();
+    return !canceled;
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -808,7 +808,8 @@ def saveCSV(filename, timesteps):
     writer.FieldAssociation = 'Points'
     writer.Precision = 16
 
-    for t in timesteps:
+    # consecutive frames are decoded without seeking in the pcap file
+    for t in sorted(timesteps):
         app.scene.AnimationTime = t
         writer.FileName = filenameTemplate % t
         writer.UpdatePipeline()
@@ -1269,6 +1270,21 @@ def getReader():
 def getSensor():
     return getattr(app, 'sensor', None)
 
+def getSensorMetrics():
+    """Return the metrics of the live stream as a dict {name: value}, the
+    histograms as lists (see vtkLidarStream::GetMetrics), or None"""
+    sensor = getSensor()
+    if not sensor:
+        return None
+    fieldData = vtk.vtkFieldData()
+    sensor.GetClientSideObject().GetMetrics(fieldData)
+    metrics = {}
+    for i in range(fieldData.GetNumberOfArrays()):
+        array = fieldData.GetArray(i)
+        values = [array.GetValue(j) for j in range(array.GetNumberOfValues())]
+        metrics[array.GetName()] = values[0] if len(values) == 1 else values
+    return metrics
+
 def getLidar():
     return getReader() or getSensor()
 
@@ -2088,7 +2104,7 @@ def updateUIwithNewLidar():
         app.sensorInformationLabel.setText(lidar.GetClientSideObject().GetSensorInformation())
     #Remove some array to display
     ComboBox = getMainWindow().findChild('vvColorToolbar').findChild('pqDisplayColorWidget').findChildren('QComboBox')[0]
-    listOfArrayToRemove = ['RotationPerMinute', 'vtkBlockColors', 'vtkCompositeIndex']
+    listOfArrayToRemove = ['RotationPerMinute', 'MissingPackets', 'AngularGaps', 'vtkBlockColors', 'vtkCompositeIndex']
     for arrayName in listOfArrayToRemove:
         n = ComboBox.findText(arrayName)
         ComboBox.removeItem(n)
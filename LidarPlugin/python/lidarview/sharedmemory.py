@@ -0,0 +1,173 @@
+# Copyright 2019 Kitware SAS.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Read the frames that LidarView publishes in a shared memory ring.
+
+The layout is the one of Common/SharedMemory/SharedMemoryFrameRing.h, which must be
+kept in sync with this module. Only numpy is needed, so that a perception process can
+read the frames without VTK nor ParaView. Linux only, the shared memory is mapped from
+/dev/shm.
+
+    reader = SharedMemoryFrameReader("lidarview")
+    frame = reader.read_latest_frame()
+    if frame is not None:
+        points = frame.arrays["Points"]  # numpy array of shape (NumberOfPoints, 3)
+"""
+import mmap
+import os
+import struct
+
+import numpy
+
+MAGIC = b"LVFRAMES"
+VERSION = 1
+
+POINTS = 0
+POINT_DATA = 1
+FIELD_DATA = 2
+
+DTYPES = {
+    1: numpy.int8,
+    2: numpy.uint8,
+    3: numpy.int16,
+    4: numpy.uint16,
+    5: numpy.int32,
+    6: numpy.uint32,
+    7: numpy.int64,
+    8: numpy.uint64,
+    9: numpy.float32,
+    10: numpy.float64,
+}
+
+# native byte order and sizes, without implicit padding
+RING_HEADER = struct.Struct("=8sIIIIQQII16x")
+NUMBER_OF_FRAMES = struct.Struct("=Q")
+NUMBER_OF_FRAMES_OFFSET = 64
+SLOT_HEADER = struct.Struct("=QQddQIIQ8x")
+GENERATION = struct.Struct("=Q")
+ARRAY_DESCRIPTOR = struct.Struct("=32sIIIIQQ")
+
+MAXIMUM_NUMBER_OF_READ_ATTEMPTS = 4
+
+
+class Frame(object):
+    """A frame read from the ring, its arrays are numpy arrays indexed by name.
+
+    The arrays of a frame returned by acquire_frame are views on the shared memory,
+    which the writer may overwrite: check SharedMemoryFrameReader.is_valid once they
+    are used. The arrays of a frame returned by read_frame are copies.
+    """
+
+    def __init__(self, frame_number, time, publication_time, number_of_points, generation):
+        self.frame_number = frame_number
+        # time given by the publisher, NaN if unknown
+        self.time = time
+        # seconds since the epoch at which the frame was published
+        self.publication_time = publication_time
+        self.number_of_points = number_of_points
+        self.generation = generation
+        self.arrays = {}
+        self.associations = {}
+
+
+class SharedMemoryFrameReader(object):
+    """Map the shared memory created by LidarView and read its frames.
+
+    Raise IOError if the shared memory does not exist yet, or ValueError if it is not
+    initialized or has another layout version. When LidarView creates the shared memory
+    again, after one of its settings changed, the reader must be created again.
+    """
+
+    def __init__(self, name):
+        path = os.path.join("/dev/shm", name.lstrip("/"))
+        with open(path, "rb") as f:
+            self.memory = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if len(self.memory) < RING_HEADER.size or self.memory[:len(MAGIC)] != MAGIC:
+            self.close()
+            raise ValueError("the shared memory %s is not initialized yet" % path)
+        (_, version, self.header_size, self.slot_header_size, self.number_of_slots,
+         self.slot_size, self.slots_offset, self.maximum_number_of_arrays,
+         self.writer_process_id) = RING_HEADER.unpack_from(self.memory, 0)
+        if version != VERSION or \
+           self.slots_offset + self.number_of_slots * self.slot_size > len(self.memory):
+            self.close()
+            raise ValueError("the shared memory %s has the layout version %d instead of %d"
+                             % (path, version, VERSION))
+
+    def close(self):
+        self.memory.close()
+
+    def get_number_of_frames(self):
+        """Number of frames published, the last one being the latest frame"""
+        return NUMBER_OF_FRAMES.unpack_from(self.memory, NUMBER_OF_FRAMES_OFFSET)[0]
+
+    def _get_slot_offset(self, frame_number):
+        return self.slots_offset + ((frame_number - 1) % self.number_of_slots) * self.slot_size
+
+    def acquire_frame(self, frame_number):
+        """Describe a frame without copying it, its arrays are views on the shared memory.
+
+        Return None if the frame is not published yet, is being written or was overwritten.
+        """
+        if frame_number < 1 or frame_number > self.get_number_of_frames():
+            return None
+        slot = self._get_slot_offset(frame_number)
+        generation = GENERATION.unpack_from(self.memory, slot)[0]
+        if generation % 2 != 0:
+            return None
+
+        (_, number, time, publication_time, number_of_points, number_of_arrays,
+         _, _) = SLOT_HEADER.unpack_from(self.memory, slot)
+        frame = Frame(number, time, publication_time, number_of_points, generation)
+        for i in range(min(number_of_arrays, self.maximum_number_of_arrays)):
+            (name, type_, association, number_of_components, _, number_of_tuples,
+             offset) = ARRAY_DESCRIPTOR.unpack_from(
+                 self.memory, slot + SLOT_HEADER.size + i * ARRAY_DESCRIPTOR.size)
+            dtype = DTYPES.get(type_)
+            count = number_of_tuples * number_of_components
+            # the descriptor is garbage if the slot is overwritten meanwhile
+            if dtype is None or offset + count * numpy.dtype(dtype).itemsize > self.slot_size:
+                return None
+            array = numpy.frombuffer(self.memory, dtype=dtype, count=count, offset=slot + offset)
+            if number_of_components > 1:
+                array = array.reshape(number_of_tuples, number_of_components)
+            name = name.split(b"\0", 1)[0].decode("utf-8", "replace")
+            frame.arrays[name] = array
+            frame.associations[name] = association
+
+        if not self.is_valid(frame) or frame.frame_number != frame_number:
+            return None
+        return frame
+
+    def is_valid(self, frame):
+        """Return True if the frame acquired by acquire_frame was not modified since"""
+        slot = self._get_slot_offset(frame.frame_number)
+        return GENERATION.unpack_from(self.memory, slot)[0] == frame.generation
+
+    def read_frame(self, frame_number):
+        """Copy a frame, return None if it is not published yet or was overwritten"""
+        frame = self.acquire_frame(frame_number)
+        if frame is None:
+            return None
+        frame.arrays = dict((name, array.copy()) for name, array in frame.arrays.items())
+        if not self.is_valid(frame):
+            return None
+        return frame
+
+    def read_latest_frame(self):
+        """Copy the latest frame, retrying if it is overwritten while copied"""
+        for _ in range(MAXIMUM_NUMBER_OF_READ_ATTEMPTS):
+            frame = self.read_frame(self.get_number_of_frames())
+            if frame is not None:
+                return frame
+        return None